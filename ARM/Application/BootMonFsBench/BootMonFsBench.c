@@ -0,0 +1,454 @@
+/** @file
+*
+*  Shell application measuring the BootMonFs driver on the media it manages.
+*
+*  For every BootMonFs volume, the volume is remounted then a test file goes
+*  through a create, append, overwrite, read and delete cycle. Each phase
+*  prints its duration and the media accesses the driver issued for it, as
+*  reported by the BootMonFs I/O statistics information type. The driver
+*  must be built with PcdBootMonFsIoStats set, the Versatile Express
+*  platforms set it and build this application with -D BOOTMONFS_BENCH_ENABLE.
+*
+*  Usage: BootMonFsBench [-s <KB>]
+*    -s  Size of the test file in KB, 256 by default.
+*
+*  Copyright (c) 2018 Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Uefi.h>
+#include <Guid/BootMonFsIoStats.h>
+#include <Guid/FileSystemInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Protocol/ShellParameters.h>
+#include <Protocol/SimpleFileSystem.h>
+
+#define BENCH_FILE_NAME       L"bmfsbnch.bin"
+#define BENCH_CHUNK_SIZE      SIZE_4KB
+#define BENCH_DEFAULT_SIZE_KB 256
+
+// Number of chunks rewritten by the overwrite phase, spread over the file.
+#define BENCH_OVERWRITE_COUNT 8
+
+STATIC UINT8 *mChunk;
+
+/**
+  Fill a chunk with the content expected at a given offset of the file.
+**/
+STATIC
+VOID
+FillPattern (
+  OUT UINT8   *Buffer,
+  IN  UINT64  Offset,
+  IN  UINTN   Size
+  )
+{
+  UINTN Index;
+
+  for (Index = 0; Index < Size; Index++) {
+    Buffer[Index] = (UINT8) ((Offset + Index) ^ RShiftU64 (Offset + Index, 12));
+  }
+}
+
+STATIC
+EFI_STATUS
+GetIoStats (
+  IN  EFI_FILE_PROTOCOL    *Root,
+  OUT BOOTMON_FS_IO_STATS  *Stats
+  )
+{
+  UINTN Size;
+
+  Size = sizeof (*Stats);
+  return Root->GetInfo (Root, &gArmBootMonFsIoStatsGuid, &Size, Stats);
+}
+
+STATIC
+VOID
+ResetIoStats (
+  IN EFI_FILE_PROTOCOL  *Root
+  )
+{
+  BOOTMON_FS_IO_STATS Stats;
+
+  ZeroMem (&Stats, sizeof (Stats));
+  Stats.Size = sizeof (Stats);
+  Root->SetInfo (Root, &gArmBootMonFsIoStatsGuid, sizeof (Stats), &Stats);
+}
+
+STATIC
+VOID
+PrintPhase (
+  IN CONST CHAR16       *Name,
+  IN EFI_FILE_PROTOCOL  *Root,
+  IN UINT64             StartTick,
+  IN EFI_STATUS         Status
+  )
+{
+  BOOTMON_FS_IO_STATS Stats;
+  UINT64 ElapsedUs;
+
+  ElapsedUs = DivU64x32 (GetTimeInNanoSecond (GetPerformanceCounter () - StartTick), 1000);
+
+  if (EFI_ERROR (Status)) {
+    Print (L"  %-9s failed after %ldus. (Status=%r)\n", Name, ElapsedUs, Status);
+    return;
+  }
+
+  if (EFI_ERROR (GetIoStats (Root, &Stats))) {
+    Print (L"  %-9s %10ldus\n", Name, ElapsedUs);
+    return;
+  }
+
+  Print (
+    L"  %-9s %10ldus Reads=%ld (0x%lx bytes) Writes=%ld (0x%lx bytes) Blocks=%ld Partial=%ld Flushes=%ld\n",
+    Name,
+    ElapsedUs,
+    Stats.ReadCount,
+    Stats.ReadBytes,
+    Stats.WriteCount,
+    Stats.WriteBytes,
+    Stats.BlocksWritten,
+    Stats.PartialBlocksWritten,
+    Stats.FlushCount);
+}
+
+/**
+  Write a range of the test file in chunks, then close it to flush it.
+**/
+STATIC
+EFI_STATUS
+WriteRange (
+  IN EFI_FILE_PROTOCOL  *Root,
+  IN UINT64             OpenMode,
+  IN UINT64             Offset,
+  IN UINT64             Size
+  )
+{
+  EFI_STATUS Status;
+  EFI_FILE_PROTOCOL *File;
+  UINTN ChunkSize;
+
+  Status = Root->Open (Root, &File, BENCH_FILE_NAME, OpenMode, 0);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = File->SetPosition (File, Offset);
+  while (!EFI_ERROR (Status) && (Size > 0)) {
+    ChunkSize = (UINTN) MIN (Size, BENCH_CHUNK_SIZE);
+    FillPattern (mChunk, Offset, ChunkSize);
+    Status = File->Write (File, &ChunkSize, mChunk);
+    Offset += ChunkSize;
+    Size -= ChunkSize;
+  }
+
+  if (EFI_ERROR (Status)) {
+    File->Close (File);
+    return Status;
+  }
+
+  return File->Close (File);
+}
+
+/**
+  Read the whole test file back in chunks and check its content.
+**/
+STATIC
+EFI_STATUS
+ReadAndVerify (
+  IN EFI_FILE_PROTOCOL  *Root,
+  IN UINT64             FileSize
+  )
+{
+  EFI_STATUS Status;
+  EFI_FILE_PROTOCOL *File;
+  UINT8 *Expected;
+  UINT64 Offset;
+  UINTN ChunkSize;
+
+  Expected = AllocatePool (BENCH_CHUNK_SIZE);
+  if (Expected == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = Root->Open (Root, &File, BENCH_FILE_NAME, EFI_FILE_MODE_READ, 0);
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  for (Offset = 0; Offset < FileSize; Offset += ChunkSize) {
+    ChunkSize = (UINTN) MIN (FileSize - Offset, BENCH_CHUNK_SIZE);
+    Status = File->Read (File, &ChunkSize, mChunk);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+    if (ChunkSize == 0) {
+      Print (L"  File is 0x%lx bytes long, expected 0x%lx\n", Offset, FileSize);
+      Status = EFI_VOLUME_CORRUPTED;
+      break;
+    }
+
+    FillPattern (Expected, Offset, ChunkSize);
+    if (CompareMem (mChunk, Expected, ChunkSize) != 0) {
+      Print (L"  Data mismatch in the chunk at offset 0x%lx\n", Offset);
+      Status = EFI_VOLUME_CORRUPTED;
+      break;
+    }
+  }
+
+  File->Close (File);
+
+Exit:
+  FreePool (Expected);
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+DeleteFile (
+  IN EFI_FILE_PROTOCOL  *Root
+  )
+{
+  EFI_STATUS Status;
+  EFI_FILE_PROTOCOL *File;
+
+  Status = Root->Open (Root, &File, BENCH_FILE_NAME, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return File->Delete (File);
+}
+
+/**
+  Remount a volume and open its root directory.
+
+  The driver scans the media when the volume is first accessed, so the
+  mount phase covers the reconnection and the first GetInfo() call.
+**/
+STATIC
+EFI_STATUS
+Mount (
+  IN  EFI_HANDLE         Handle,
+  OUT EFI_FILE_PROTOCOL  **Root
+  )
+{
+  EFI_STATUS Status;
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *Fs;
+  EFI_FILE_SYSTEM_INFO *FsInfo;
+  UINTN Size;
+
+  gBS->DisconnectController (Handle, NULL, NULL);
+  Status = gBS->ConnectController (Handle, NULL, NULL, TRUE);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = gBS->HandleProtocol (Handle, &gEfiSimpleFileSystemProtocolGuid, (VOID **) &Fs);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Fs->OpenVolume (Fs, Root);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Size = 0;
+  Status = (*Root)->GetInfo (*Root, &gEfiFileSystemInfoGuid, &Size, NULL);
+  if (Status != EFI_BUFFER_TOO_SMALL) {
+    return EFI_ERROR (Status) ? Status : EFI_DEVICE_ERROR;
+  }
+
+  FsInfo = AllocatePool (Size);
+  if (FsInfo == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = (*Root)->GetInfo (*Root, &gEfiFileSystemInfoGuid, &Size, FsInfo);
+  if (!EFI_ERROR (Status)) {
+    Print (L"  Volume 0x%lx bytes, 0x%lx free\n", FsInfo->VolumeSize, FsInfo->FreeSpace);
+  }
+
+  FreePool (FsInfo);
+  return Status;
+}
+
+STATIC
+VOID
+BenchVolume (
+  IN EFI_HANDLE  Handle,
+  IN UINT64      FileSize
+  )
+{
+  EFI_STATUS Status;
+  EFI_FILE_PROTOCOL *Root;
+  UINT64 StartTick;
+  UINT64 Stride;
+  UINTN Index;
+
+  Print (L"BootMonFs volume (Handle=%p)\n", Handle);
+
+  // The counters of the remounted volume start at zero and cover the scan.
+  Root = NULL;
+  StartTick = GetPerformanceCounter ();
+  Status = Mount (Handle, &Root);
+  PrintPhase (L"Mount", Root, StartTick, Status);
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  // A file left by an interrupted run would skew the create phase.
+  DeleteFile (Root);
+
+  ResetIoStats (Root);
+  StartTick = GetPerformanceCounter ();
+  Status = WriteRange (Root, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, 0, FileSize);
+  PrintPhase (L"Create", Root, StartTick, Status);
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  ResetIoStats (Root);
+  StartTick = GetPerformanceCounter ();
+  Status = WriteRange (Root, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, FileSize, FileSize / 4);
+  PrintPhase (L"Append", Root, StartTick, Status);
+  if (EFI_ERROR (Status)) {
+    goto Delete;
+  }
+  FileSize += FileSize / 4;
+
+  // Rewrite chunks spread over the file, each in its own open/close cycle.
+  ResetIoStats (Root);
+  Stride = DivU64x32 (FileSize, BENCH_OVERWRITE_COUNT) & ~((UINT64) BENCH_CHUNK_SIZE - 1);
+  StartTick = GetPerformanceCounter ();
+  for (Index = 0; (Index < BENCH_OVERWRITE_COUNT) && !EFI_ERROR (Status); Index++) {
+    Status = WriteRange (
+               Root,
+               EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE,
+               MultU64x32 (Stride, (UINT32) Index),
+               MIN (BENCH_CHUNK_SIZE, FileSize));
+  }
+  PrintPhase (L"Overwrite", Root, StartTick, Status);
+  if (EFI_ERROR (Status)) {
+    goto Delete;
+  }
+
+  ResetIoStats (Root);
+  StartTick = GetPerformanceCounter ();
+  Status = ReadAndVerify (Root, FileSize);
+  PrintPhase (L"Read", Root, StartTick, Status);
+
+Delete:
+  ResetIoStats (Root);
+  StartTick = GetPerformanceCounter ();
+  Status = DeleteFile (Root);
+  PrintPhase (L"Delete", Root, StartTick, Status);
+
+Exit:
+  if (Root != NULL) {
+    Root->Close (Root);
+  }
+}
+
+EFI_STATUS
+EFIAPI
+UefiMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS Status;
+  EFI_SHELL_PARAMETERS_PROTOCOL *ShellParameters;
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *Fs;
+  EFI_FILE_PROTOCOL *Root;
+  BOOTMON_FS_IO_STATS Stats;
+  EFI_HANDLE *Handles;
+  UINTN HandleCount;
+  UINTN Index;
+  UINTN VolumeCount;
+  UINT64 FileSize;
+
+  FileSize = BENCH_DEFAULT_SIZE_KB * SIZE_1KB;
+  Status = gBS->HandleProtocol (
+                  ImageHandle,
+                  &gEfiShellParametersProtocolGuid,
+                  (VOID **) &ShellParameters);
+
+  if (!EFI_ERROR (Status) && (ShellParameters->Argc > 1)) {
+    if ((ShellParameters->Argc == 3) &&
+        (StrCmp (ShellParameters->Argv[1], L"-s") == 0) &&
+        (StrDecimalToUint64 (ShellParameters->Argv[2]) != 0)) {
+      FileSize = MultU64x32 (StrDecimalToUint64 (ShellParameters->Argv[2]), SIZE_1KB);
+    } else {
+      Print (L"Usage: BootMonFsBench [-s <KB>]\n");
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  mChunk = AllocatePool (BENCH_CHUNK_SIZE);
+  if (mChunk == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gEfiSimpleFileSystemProtocolGuid,
+                  NULL,
+                  &HandleCount,
+                  &Handles);
+
+  if (EFI_ERROR (Status)) {
+    HandleCount = 0;
+    Handles = NULL;
+  }
+
+  // Only BootMonFs volumes know the I/O statistics information type, if the
+  // driver was built with PcdBootMonFsIoStats set.
+  VolumeCount = 0;
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol (
+                    Handles[Index],
+                    &gEfiSimpleFileSystemProtocolGuid,
+                    (VOID **) &Fs);
+
+    if (EFI_ERROR (Status) || EFI_ERROR (Fs->OpenVolume (Fs, &Root))) {
+      continue;
+    }
+
+    Status = GetIoStats (Root, &Stats);
+    Root->Close (Root);
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    BenchVolume (Handles[Index], FileSize);
+    VolumeCount++;
+  }
+
+  if (Handles != NULL) {
+    FreePool (Handles);
+  }
+  FreePool (mChunk);
+
+  if (VolumeCount == 0) {
+    Print (L"No BootMonFs volume counting its I/O found (PcdBootMonFsIoStats)\n");
+    return EFI_NOT_FOUND;
+  }
+
+  return EFI_SUCCESS;
+}
@@ -28,6 +28,11 @@ BootMonFsChecksum (
   IN UINT32 Size
   );
 
+UINT32
+BootMonFsFooterChecksum (
+  IN CONST HW_IMAGE_DESCRIPTION *Desc
+  );
+
 EFI_STATUS
 BootMonFsComputeFooterChecksum (
   IN OUT HW_IMAGE_DESCRIPTION *Footer
@@ -356,9 +361,8 @@ BootMonFsOpenDirectory (
 
   If a file is currently open, its name might not have been written on the
   media yet, and as the "HwDescription" is a mirror in RAM of what is on the
-  media the "HwDescription.Footer.Filename[]" might be outdated. In that case,
-  the up to date name of the file is stored in the "Info" field of the file's
-  description.
+  media the "HwDescription.Footer.Filename[]" might be outdated. In both cases
+  the up to date name is kept in the "Name" field of the file's description.
 
   @param[in]   Instance       Pointer to the description of the volume in which
                               the file has to be search for.
@@ -385,4 +389,91 @@ BootMonGetFileFromPosition (
   OUT BOOTMON_FS_FILE       **File
   );
 
+VOID
+BootMonFsIndexFile (
+  IN BOOTMON_FS_FILE  *File,
+  IN CONST CHAR8      *Name
+  );
+
+VOID
+BootMonFsUnindexFile (
+  IN BOOTMON_FS_FILE  *File
+  );
+
+UINTN
+BootMonFsBlockCount (
+  IN BOOTMON_FS_INSTANCE  *Instance,
+  IN UINT64               FileSize
+  );
+
+VOID
+BootMonFsFreeMapRelease (
+  IN BOOTMON_FS_INSTANCE  *Instance,
+  IN UINTN                BlockStart,
+  IN UINTN                BlockCount
+  );
+
+VOID
+BootMonFsFreeMapReserve (
+  IN BOOTMON_FS_INSTANCE  *Instance,
+  IN UINTN                BlockStart,
+  IN UINTN                BlockCount
+  );
+
+EFI_STATUS
+BootMonFsFreeMapFind (
+  IN  BOOTMON_FS_INSTANCE  *Instance,
+  IN  UINTN                BlockCount,
+  OUT UINTN                *BlockStart
+  );
+
+VOID
+BootMonFsFreeMapDestroy (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  );
+
+VOID
+BootMonFsBuildFreeMap (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  );
+
+EFI_STATUS
+BootMonFsLoadFileData (
+  IN BOOTMON_FS_FILE  *File
+  );
+
+VOID
+BootMonFsInitIoStats (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  );
+
+BOOLEAN
+BootMonFsIsImageValid (
+  IN HW_IMAGE_DESCRIPTION  *Desc,
+  IN EFI_LBA                Lba
+  );
+
+EFI_STATUS
+BootMonFsScanBlock (
+  IN     BOOTMON_FS_INSTANCE      *Instance,
+  IN     HW_IMAGE_DESCRIPTION     *Desc,
+  IN     EFI_LBA                   Lba,
+  IN     UINT64                    DescOffset
+  );
+
+EFI_STATUS
+BootMonFsLoadMountIndex (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  );
+
+VOID
+BootMonFsSaveMountIndex (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  );
+
+EFI_STATUS
+BootMonFsDropMountIndex (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  );
+
 #endif
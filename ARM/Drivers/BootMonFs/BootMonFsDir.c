@@ -145,41 +145,15 @@ GetFileSystemVolumeLabelInfo (
   return Status;
 }
 
-// Helper function that calculates a rough "free space" by:
-// - Taking the media size
-// - Subtracting the sum of all file sizes
-// - Subtracting the block size times the number of files
-//    (To account for the blocks containing the HW_IMAGE_INFO
+// Helper function that returns the free space of the volume: the blocks not
+// used by any image, including the block holding its HW_IMAGE_DESCRIPTION.
 STATIC
 UINT64
 ComputeFreeSpace (
   IN BOOTMON_FS_INSTANCE *Instance
   )
 {
-  LIST_ENTRY   *FileLink;
-  UINT64        FileSizeSum;
-  UINT64        MediaSize;
-  UINTN         NumFiles;
-  EFI_BLOCK_IO_MEDIA *Media;
-  BOOTMON_FS_FILE *File;
-
-  Media = Instance->BlockIo->Media;
-  MediaSize = Media->BlockSize * (Media->LastBlock + 1);
-
-  NumFiles = 0;
-  FileSizeSum = 0;
-  for (FileLink = GetFirstNode (&Instance->RootFile->Link);
-         !IsNull (&Instance->RootFile->Link, FileLink);
-         FileLink = GetNextNode (&Instance->RootFile->Link, FileLink)
-         )
-  {
-    File = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
-    FileSizeSum += BootMonFsGetImageLength (File);
-
-    NumFiles++;
-  }
-
-  return MediaSize - (FileSizeSum + (Media->BlockSize + NumFiles));
+  return MultU64x32 (Instance->FreeBlocks, Instance->Media->BlockSize);
 }
 
 STATIC
@@ -281,6 +255,93 @@ GetBootMonFsFileInfo (
   return Status;
 }
 
+/**
+  Get the address of the contents of a file on memory-mapped NOR flash.
+
+  @param[in]      Instance    A pointer to the description of the volume
+                              the file belongs to.
+  @param[in]      File        A pointer to the description of the file.
+  @param[in out]  BufferSize  The size, in bytes, of the buffer Buffer.
+  @param[out]     Buffer      A pointer to a BOOTMON_FS_FILE_MAPPING.
+
+  @retval  EFI_SUCCESS           The mapping was returned.
+  @retval  EFI_UNSUPPORTED       The file is the root directory or the volume
+                                 is not memory-mapped.
+  @retval  EFI_NOT_READY         The file has data not flushed yet.
+  @retval  EFI_BUFFER_TOO_SMALL  The buffer is too small, BufferSize is updated.
+
+**/
+STATIC
+EFI_STATUS
+GetBootMonFsFileMapping (
+  IN BOOTMON_FS_INSTANCE *Instance,
+  IN BOOTMON_FS_FILE     *File,
+  IN OUT UINTN           *BufferSize,
+  OUT VOID               *Buffer
+  )
+{
+  BOOTMON_FS_FILE_MAPPING  *Mapping;
+  EFI_BLOCK_IO_MEDIA       *Media;
+
+  if ((File == Instance->RootFile) || (Instance->MappedBase == 0)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (File->Dirty || !IsListEmpty (&File->RegionToFlushLink)) {
+    return EFI_NOT_READY;
+  }
+
+  if (*BufferSize < sizeof (BOOTMON_FS_FILE_MAPPING)) {
+    *BufferSize = sizeof (BOOTMON_FS_FILE_MAPPING);
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  Media   = Instance->Media;
+  Mapping = Buffer;
+  Mapping->Size = sizeof (BOOTMON_FS_FILE_MAPPING);
+  if (File->HwDescription.RegionCount == 0) {
+    Mapping->Base   = 0;
+    Mapping->Length = 0;
+  } else {
+    Mapping->Base   = Instance->MappedBase +
+                      ((Media->LowestAlignedLba + File->HwDescription.BlockStart) * Media->BlockSize);
+    Mapping->Length = File->HwDescription.Region[0].Size;
+  }
+
+  *BufferSize = sizeof (BOOTMON_FS_FILE_MAPPING);
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the media accesses issued by a volume since it was mounted or since
+  the counters were last cleared.
+
+  @param[in]      Instance    A pointer to the description of the volume.
+  @param[in out]  BufferSize  The size, in bytes, of the buffer Buffer.
+  @param[out]     Buffer      A pointer to a BOOTMON_FS_IO_STATS.
+
+  @retval  EFI_SUCCESS           The counters were returned.
+  @retval  EFI_BUFFER_TOO_SMALL  The buffer is too small, BufferSize is updated.
+
+**/
+STATIC
+EFI_STATUS
+GetBootMonFsIoStats (
+  IN BOOTMON_FS_INSTANCE *Instance,
+  IN OUT UINTN           *BufferSize,
+  OUT VOID               *Buffer
+  )
+{
+  if (*BufferSize < sizeof (BOOTMON_FS_IO_STATS)) {
+    *BufferSize = sizeof (BOOTMON_FS_IO_STATS);
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem (Buffer, &Instance->IoStats, sizeof (BOOTMON_FS_IO_STATS));
+  *BufferSize = sizeof (BOOTMON_FS_IO_STATS);
+  return EFI_SUCCESS;
+}
+
 /**
   Set the name of a file.
 
@@ -326,6 +387,8 @@ SetFileName (
     // OK, change the filename.
     AsciiStrToUnicodeStrS (AsciiFileName, File->Info->FileName,
       (File->Info->Size - SIZE_OF_EFI_FILE_INFO) / sizeof (CHAR16));
+    BootMonFsIndexFile (File, AsciiFileName);
+    File->Dirty = TRUE;
     return EFI_SUCCESS;
   }
 }
@@ -422,7 +485,10 @@ SetFileSize (
     }
   }
 
-  BootMonFsFile->Info->FileSize = NewSize;
+  if (NewSize != OldSize) {
+    BootMonFsFile->Info->FileSize = NewSize;
+    BootMonFsFile->Dirty = TRUE;
+  }
 
   return EFI_SUCCESS;
 }
@@ -571,6 +637,11 @@ BootMonFsGetInfo (
       Status = GetFileInfo (Instance, File, BufferSize, Buffer);
     } else if (CompareGuid (InformationType, &gArmBootMonFsFileInfoGuid) != 0) {
       Status = GetBootMonFsFileInfo (Instance, File, BufferSize, Buffer);
+    } else if (CompareGuid (InformationType, &gArmBootMonFsFileMappingGuid) != 0) {
+      Status = GetBootMonFsFileMapping (Instance, File, BufferSize, Buffer);
+    } else if (FeaturePcdGet (PcdBootMonFsIoStats) &&
+               (CompareGuid (InformationType, &gArmBootMonFsIoStatsGuid) != 0)) {
+      Status = GetBootMonFsIoStats (Instance, BufferSize, Buffer);
     } else {
       Status = EFI_UNSUPPORTED;
     }
@@ -586,7 +657,8 @@ BootMonFsGetInfo (
                                is the file handle the information is for.
   @param[in]  InformationType  The type identifier for the information being set :
                                EFI_FILE_INFO_ID or EFI_FILE_SYSTEM_INFO_ID or
-                               EFI_FILE_SYSTEM_VOLUME_LABEL_ID
+                               EFI_FILE_SYSTEM_VOLUME_LABEL_ID or
+                               BOOTMON_FS_IO_STATS_ID to clear the I/O statistics
   @param[in]  BufferSize       The size, in bytes, of Buffer.
   @param[in]  Buffer           A pointer to the data buffer to write. The type of the
                                data inside the buffer is indicated by InformationType.
@@ -668,6 +740,17 @@ BootMonFsSetInfo (
     return EFI_WRITE_PROTECTED;
   }
 
+  //
+  // Setting the I/O statistics clears them, the content of the buffer is
+  // ignored.
+  //
+  if (FeaturePcdGet (PcdBootMonFsIoStats) &&
+      CompareGuid (InformationType, &gArmBootMonFsIoStatsGuid)) {
+    ZeroMem (&File->Instance->IoStats, sizeof (BOOTMON_FS_IO_STATS));
+    File->Instance->IoStats.Size = sizeof (BOOTMON_FS_IO_STATS);
+    return EFI_SUCCESS;
+  }
+
   return EFI_UNSUPPORTED;
 }
 
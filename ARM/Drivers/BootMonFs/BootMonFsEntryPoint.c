@@ -54,6 +54,65 @@ EFI_FILE_PROTOCOL mBootMonFsFileTemplate = {
   BootMonFsFlushFile
 };
 
+STATIC
+UINTN
+BootMonFsNameHash (
+  IN CONST CHAR8  *Name
+  )
+{
+  UINT32  Hash;
+
+  // FNV-1a
+  Hash = 0x811C9DC5;
+  while (*Name != '\0') {
+    Hash = (Hash ^ (UINT8)*Name) * 0x01000193;
+    Name++;
+  }
+  return Hash & (BOOTMON_FS_NAME_HASH_BUCKETS - 1);
+}
+
+/**
+  Set the current name of a file and (re)insert it in the name index of its
+  volume.
+
+  @param[in]  File  Pointer to the description of the file.
+  @param[in]  Name  New name of the file, truncated to MAX_NAME_LENGTH - 1
+                    characters.
+
+**/
+VOID
+BootMonFsIndexFile (
+  IN BOOTMON_FS_FILE  *File,
+  IN CONST CHAR8      *Name
+  )
+{
+  BootMonFsUnindexFile (File);
+
+  AsciiStrnCpyS (File->Name, MAX_NAME_LENGTH, Name, MAX_NAME_LENGTH - 1);
+  InsertTailList (
+    &File->Instance->NameHash[BootMonFsNameHash (File->Name)],
+    &File->NameLink
+    );
+}
+
+/**
+  Remove a file from the name index of its volume. Does nothing if the file
+  is not indexed.
+
+  @param[in]  File  Pointer to the description of the file.
+
+**/
+VOID
+BootMonFsUnindexFile (
+  IN BOOTMON_FS_FILE  *File
+  )
+{
+  if (!IsListEmpty (&File->NameLink)) {
+    RemoveEntryList (&File->NameLink);
+    InitializeListHead (&File->NameLink);
+  }
+}
+
 /**
   Search for a file given its name coded in Ascii.
 
@@ -63,9 +122,9 @@ EFI_FILE_PROTOCOL mBootMonFsFileTemplate = {
 
   If a file is currently open, its name might not have been written on the
   media yet, and as the "HwDescription" is a mirror in RAM of what is on the
-  media the "HwDescription.Footer.Filename[]" might be outdated. In that case,
-  the up to date name of the file is stored in the "Info" field of the file's
-  description.
+  media the "HwDescription.Footer.Filename[]" might be outdated. In both cases
+  the up to date name is kept in the "Name" field of the file's description
+  and the file is indexed under it in the name hash table of the volume.
 
   @param[in]   Instance       Pointer to the description of the volume in which
                               the file has to be search for.
@@ -85,27 +144,18 @@ BootMonGetFileFromAsciiFileName (
   OUT BOOTMON_FS_FILE       **File
   )
 {
+  LIST_ENTRY       *Bucket;
   LIST_ENTRY       *Entry;
   BOOTMON_FS_FILE  *FileEntry;
-  CHAR8            OpenFileAsciiFileName[MAX_NAME_LENGTH];
-  CHAR8            *AsciiFileNameToCompare;
 
-  // Go through all the files in the list and return the file handle
-  for (Entry = GetFirstNode (&Instance->RootFile->Link);
-       !IsNull (&Instance->RootFile->Link, Entry);
-       Entry = GetNextNode (&Instance->RootFile->Link, Entry)
+  Bucket = &Instance->NameHash[BootMonFsNameHash (AsciiFileName)];
+  for (Entry = GetFirstNode (Bucket);
+       !IsNull (Bucket, Entry);
+       Entry = GetNextNode (Bucket, Entry)
        )
   {
-    FileEntry = BOOTMON_FS_FILE_FROM_LINK_THIS (Entry);
-    if (FileEntry->Info != NULL) {
-      UnicodeStrToAsciiStrS (FileEntry->Info->FileName, OpenFileAsciiFileName,
-        MAX_NAME_LENGTH);
-      AsciiFileNameToCompare = OpenFileAsciiFileName;
-    } else {
-      AsciiFileNameToCompare = FileEntry->HwDescription.Footer.Filename;
-    }
-
-    if (AsciiStrCmp (AsciiFileNameToCompare, AsciiFileName) == 0) {
+    FileEntry = BOOTMON_FS_FILE_FROM_NAME_LINK (Entry);
+    if (AsciiStrCmp (FileEntry->Name, AsciiFileName) == 0) {
       *File = FileEntry;
       return EFI_SUCCESS;
     }
@@ -113,6 +163,21 @@ BootMonGetFileFromAsciiFileName (
   return EFI_NOT_FOUND;
 }
 
+/**
+  Get the file at a given position in the list of files of the volume.
+
+  The last entry returned is remembered in the directory cursor of the volume,
+  so reading the directory sequentially does not walk the list from its start
+  for every entry. Any change to the list of files invalidates the cursor.
+
+  @param[in]   Instance  Pointer to the description of the volume.
+  @param[in]   Position  Index of the file in the list.
+  @param[out]  File      Pointer to the description of the file if found.
+
+  @retval  EFI_SUCCESS    The file was found.
+  @retval  EFI_NOT_FOUND  There are fewer than Position + 1 files.
+
+**/
 EFI_STATUS
 BootMonGetFileFromPosition (
   IN  BOOTMON_FS_INSTANCE   *Instance,
@@ -121,22 +186,28 @@ BootMonGetFileFromPosition (
   )
 {
   LIST_ENTRY        *Entry;
-  BOOTMON_FS_FILE   *FileEntry;
+  UINTN             Skip;
 
-  // Go through all the files in the list and return the file handle
-  for (Entry = GetFirstNode (&Instance->RootFile->Link);
-       !IsNull (&Instance->RootFile->Link, Entry) && (&Instance->RootFile->Link != Entry);
-       Entry = GetNextNode (&Instance->RootFile->Link, Entry)
-       )
-  {
-    if (Position == 0) {
-      FileEntry = BOOTMON_FS_FILE_FROM_LINK_THIS (Entry);
-      *File = FileEntry;
-      return EFI_SUCCESS;
-    }
-    Position--;
+  if ((Instance->DirCursor != NULL) && (Position >= Instance->DirCursorPosition)) {
+    Entry = Instance->DirCursor;
+    Skip  = Position - Instance->DirCursorPosition;
+  } else {
+    Entry = GetFirstNode (&Instance->RootFile->Link);
+    Skip  = Position;
   }
-  return EFI_NOT_FOUND;
+
+  for (; !IsNull (&Instance->RootFile->Link, Entry) && (Skip > 0); Skip--) {
+    Entry = GetNextNode (&Instance->RootFile->Link, Entry);
+  }
+
+  if (IsNull (&Instance->RootFile->Link, Entry)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Instance->DirCursor = Entry;
+  Instance->DirCursorPosition = Position;
+  *File = BOOTMON_FS_FILE_FROM_LINK_THIS (Entry);
+  return EFI_SUCCESS;
 }
 
 EFI_STATUS
@@ -154,6 +225,7 @@ BootMonFsCreateFile (
 
   NewFile->Signature = BOOTMON_FS_FILE_SIGNATURE;
   InitializeListHead (&NewFile->Link);
+  InitializeListHead (&NewFile->NameLink);
   InitializeListHead (&NewFile->RegionToFlushLink);
   NewFile->Instance = Instance;
 
@@ -321,6 +393,7 @@ BootMonFsDriverStart (
   EFI_STATUS           Status;
   UINTN                VolumeNameSize;
   EFI_FILE_INFO       *Info;
+  UINTN                Index;
 
   Instance = AllocateZeroPool (sizeof (BOOTMON_FS_INSTANCE));
   if (Instance == NULL) {
@@ -359,6 +432,13 @@ BootMonFsDriverStart (
   Instance->ControllerHandle = ControllerHandle;
   Instance->Media = Instance->BlockIo->Media;
   Instance->Binding = DriverBinding;
+  if (FeaturePcdGet (PcdBootMonFsIoStats)) {
+    BootMonFsInitIoStats (Instance);
+  }
+  for (Index = 0; Index < BOOTMON_FS_NAME_HASH_BUCKETS; Index++) {
+    InitializeListHead (&Instance->NameHash[Index]);
+  }
+  InitializeListHead (&Instance->FreeExtents);
 
     // Initialize the Simple File System Protocol
   Instance->Fs.Revision = EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION;
@@ -482,6 +562,9 @@ BootMonFsDriverStop (
       &gEfiSimpleFileSystemProtocolGuid, &Instance->Fs,
       NULL);
 
+  BootMonFsSaveMountIndex (Instance);
+  RemoveEntryList (&Instance->Link);
+  BootMonFsFreeMapDestroy (Instance);
   FreePool (Instance->RootFile->Info);
   FreePool (Instance->RootFile);
   FreePool (Instance);
@@ -489,6 +572,29 @@ BootMonFsDriverStop (
   return Status;
 }
 
+/**
+  Save the index of the volumes changed since they were mounted, the content
+  of the volumes should not change anymore before the next boot.
+
+  @param[in]  Event    The ReadyToBoot event.
+  @param[in]  Context  Unused.
+
+**/
+STATIC
+VOID
+EFIAPI
+BootMonFsOnReadyToBoot (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  LIST_ENTRY  *Link;
+
+  for (Link = GetFirstNode (&mInstances); !IsNull (&mInstances, Link); Link = GetNextNode (&mInstances, Link)) {
+    BootMonFsSaveMountIndex (BOOTMON_FS_FROM_LINK (Link));
+  }
+}
+
 //
 // Simple Network Protocol Driver Global Variables
 //
@@ -509,9 +615,20 @@ BootMonFsEntryPoint (
   )
 {
   EFI_STATUS  Status;
+  EFI_EVENT   ReadyToBootEvent;
 
   InitializeListHead (&mInstances);
 
+  if (PcdGetBool (PcdBootMonFsMountIndex)) {
+    Status = EfiCreateEventReadyToBootEx (
+               TPL_CALLBACK,
+               BootMonFsOnReadyToBoot,
+               NULL,
+               &ReadyToBootEvent
+               );
+    ASSERT_EFI_ERROR (Status);
+  }
+
   // Initialize the list of Device Paths that could support BootMonFs
   Status = SupportedDevicePathsInit ();
   if (!EFI_ERROR (Status)) {
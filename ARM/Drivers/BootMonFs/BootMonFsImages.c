@@ -15,75 +15,187 @@
 #include <Library/IoLib.h>
 #include <Library/NorFlashPlatformLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
 
 #include <Protocol/SimpleFileSystem.h>
 
 #include "BootMonFsInternal.h"
 
-UINT32
-BootMonFsChecksum (
-  IN VOID   *Data,
-  IN UINT32 Size
+typedef
+UINT64
+(EFIAPI *BOOTMON_FS_SUM_WORDS) (
+  IN CONST VOID  *Data,
+  IN UINTN       Size
+  );
+
+#if defined (MDE_CPU_AARCH64) || defined (MDE_CPU_ARM)
+UINT64
+EFIAPI
+BootMonFsSumWordsNeon (
+  IN CONST VOID  *Data,
+  IN UINTN       Size
+  );
+#endif
+
+// Words in the known answer buffer, enough to cover both the 32-byte loop and
+// the word tail of the accelerated sum.
+#define BOOTMON_FS_SUM_KAT_WORDS  37
+
+STATIC BOOTMON_FS_SUM_WORDS mSumWords = NULL;
+
+/**
+  Plain sum of 32-bit words, the portable engine behind the checksums.
+**/
+STATIC
+UINT64
+EFIAPI
+BootMonFsSumWordsC (
+  IN CONST VOID  *Data,
+  IN UINTN       Size
   )
 {
-  UINT32  *Ptr;
-  UINT32  Word;
-  UINT32  Checksum;
-
-  ASSERT (Size % 4 == 0);
+  CONST UINT32  *Ptr;
+  UINT64         Sum;
 
-  Checksum = 0;
-  Ptr = (UINT32*)Data;
+  Ptr = (CONST UINT32*)Data;
+  Sum = 0;
 
-  while (Size > 0) {
-    Word = *Ptr++;
+  while (Size >= 4) {
+    Sum += *Ptr++;
     Size -= 4;
+  }
 
-    if (Word > ~Checksum) {
-      Checksum++;
-    }
+  return Sum;
+}
+
+/**
+  Pick the word sum engine, the NEON one only if it agrees with the portable
+  one on a known buffer.
+**/
+STATIC
+VOID
+BootMonFsSelectSumEngine (
+  VOID
+  )
+{
+#if defined (MDE_CPU_AARCH64) || defined (MDE_CPU_ARM)
+  UINT32  Kat[BOOTMON_FS_SUM_KAT_WORDS];
+  UINTN   Index;
+
+#ifdef MDE_CPU_ARM
+  // NEON is only usable if the platform turned the VFP on.
+  if (FixedPcdGet32 (PcdVFPEnabled) == 0) {
+    mSumWords = BootMonFsSumWordsC;
+    return;
+  }
+#endif
+
+  // Mix of large words to exercise the carries between the 32-bit lanes.
+  for (Index = 0; Index < BOOTMON_FS_SUM_KAT_WORDS; Index++) {
+    Kat[Index] = 0xFFFFFFFF - ((UINT32)Index * 0x01234567);
+  }
 
-    Checksum += Word;
+  if (BootMonFsSumWordsNeon (Kat, sizeof (Kat)) == BootMonFsSumWordsC (Kat, sizeof (Kat))) {
+    mSumWords = BootMonFsSumWordsNeon;
+    return;
   }
 
-  return ~Checksum;
+  DEBUG ((DEBUG_ERROR, "BootMonFs: NEON checksum failed the known answer test\n"));
+#endif
+
+  mSumWords = BootMonFsSumWordsC;
 }
 
-EFI_STATUS
-BootMonFsComputeFooterChecksum (
-  IN OUT HW_IMAGE_DESCRIPTION *Footer
+STATIC
+UINT64
+BootMonFsSumWords (
+  IN CONST VOID  *Data,
+  IN UINTN       Size
   )
 {
-  HW_IMAGE_DESCRIPTION *Description;
-  UINT32                Index;
+  ASSERT (Size % 4 == 0);
 
-  Footer->Attributes = 1;
+  if (mSumWords == NULL) {
+    BootMonFsSelectSumEngine ();
+  }
+
+  return mSumWords (Data, Size);
+}
 
-  Description = AllocateZeroPool (sizeof (HW_IMAGE_DESCRIPTION));
-  if (Description == NULL) {
-    DEBUG ((DEBUG_ERROR, "BootMonFsComputeFooterChecksum: Unable to allocate memory.\n"));
-    return EFI_OUT_OF_RESOURCES;
+/**
+  Fold a plain word sum into the BootMon checksum.
+
+  BootMon adds the words with an end-around carry, i.e. in one's complement.
+  That addition is order independent, so the words can be summed in any
+  order on 64 bits first and the carries folded back in at the end.
+**/
+STATIC
+UINT32
+BootMonFsFoldSum (
+  IN UINT64   Sum
+  )
+{
+  while ((Sum >> 32) != 0) {
+    Sum = (Sum & 0xFFFFFFFF) + (Sum >> 32);
   }
 
-  // Copy over to temporary shim
-  CopyMem (Description, Footer, sizeof (HW_IMAGE_DESCRIPTION));
+  return ~(UINT32)Sum;
+}
 
-  // BootMon doesn't checksum the previous checksum
-  Description->FooterChecksum = 0;
+UINT32
+BootMonFsChecksum (
+  IN VOID   *Data,
+  IN UINT32 Size
+  )
+{
+  return BootMonFsFoldSum (BootMonFsSumWords (Data, Size));
+}
 
-  // Blank out regions which aren't being used.
-  for (Index = Footer->RegionCount; Index < HW_IMAGE_DESCRIPTION_REGION_MAX; Index++) {
-    Description->Region[Index].Checksum = 0;
-    Description->Region[Index].LoadAddress = 0;
-    Description->Region[Index].Offset = 0;
-    Description->Region[Index].Size = 0;
+/**
+  Compute the checksum of an image description in place.
+
+  BootMon checksums the description with Attributes set to 1 and with the
+  FooterChecksum word and the unused regions cleared. Rather than building
+  such a copy, the whole description is summed and the words which would
+  have been cleared are taken back out.
+
+  @param[in]  Desc    The image description.
+
+  @return The footer checksum of Desc.
+**/
+UINT32
+BootMonFsFooterChecksum (
+  IN CONST HW_IMAGE_DESCRIPTION *Desc
+  )
+{
+  UINT64  Sum;
+  UINT32  Index;
+
+  Sum = BootMonFsSumWords (Desc, sizeof (HW_IMAGE_DESCRIPTION));
+
+  Sum -= Desc->FooterChecksum;
+  Sum -= Desc->Attributes;
+  Sum += 1;
+
+  for (Index = Desc->RegionCount; Index < HW_IMAGE_DESCRIPTION_REGION_MAX; Index++) {
+    Sum -= Desc->Region[Index].LoadAddress;
+    Sum -= Desc->Region[Index].Size;
+    Sum -= Desc->Region[Index].Offset;
+    Sum -= Desc->Region[Index].Checksum;
   }
 
-  // Compute the checksum
-  Footer->FooterChecksum = BootMonFsChecksum (Description, sizeof (HW_IMAGE_DESCRIPTION));
+  return BootMonFsFoldSum (Sum);
+}
 
-  FreePool (Description);
+EFI_STATUS
+BootMonFsComputeFooterChecksum (
+  IN OUT HW_IMAGE_DESCRIPTION *Footer
+  )
+{
+  Footer->Attributes = 1;
+  Footer->FooterChecksum = BootMonFsFooterChecksum (Footer);
 
   return EFI_SUCCESS;
 }
@@ -94,9 +206,7 @@ BootMonFsIsImageValid (
   IN EFI_LBA                Lba
   )
 {
-  EFI_STATUS            Status;
   HW_IMAGE_FOOTER      *Footer;
-  UINT32                Checksum;
 
   Footer = &Desc->Footer;
 
@@ -118,13 +228,7 @@ BootMonFsIsImageValid (
     return FALSE;
   }
 
-  Checksum = Desc->FooterChecksum;
-  Status = BootMonFsComputeFooterChecksum (Desc);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "Warning: failed to compute checksum for image '%a'\n", Desc->Footer.Filename));
-  }
-
-  if (Desc->FooterChecksum != Checksum) {
+  if (BootMonFsFooterChecksum (Desc) != Desc->FooterChecksum) {
     DEBUG ((DEBUG_ERROR, "Warning: image '%a' checksum mismatch.\n", Desc->Footer.Filename));
   }
 
@@ -135,57 +239,243 @@ BootMonFsIsImageValid (
   return TRUE;
 }
 
+/**
+  Find the memory-mapped window of the NOR flash region backing the volume.
+
+  The NOR flash driver exposes each region with a vendor hardware device path
+  carrying the GUID of its NOR_FLASH_DESCRIPTION. The window is only used when
+  its geometry matches the media, in which case LBA 0 is at its start.
+
+  @param[in]  Instance    The BootMonFs instance.
+
+  @return The base address of the window, 0 if the media is not mapped.
+**/
 STATIC
+UINTN
+BootMonFsGetMappedBase (
+  IN BOOTMON_FS_INSTANCE *Instance
+  )
+{
+  EFI_DEVICE_PATH_PROTOCOL  *Node;
+  VENDOR_DEVICE_PATH        *Vendor;
+  NOR_FLASH_DESCRIPTION     *NorFlashDevices;
+  UINT32                     NorFlashDeviceCount;
+  UINT32                     Index;
+  EFI_STATUS                 Status;
+
+  if (Instance->DevicePath == NULL) {
+    return 0;
+  }
+
+  // The vendor node is the last one of the region device path.
+  Vendor = NULL;
+  for (Node = Instance->DevicePath; !IsDevicePathEnd (Node); Node = NextDevicePathNode (Node)) {
+    if ((DevicePathType (Node) == HARDWARE_DEVICE_PATH) &&
+        (DevicePathSubType (Node) == HW_VENDOR_DP)) {
+      Vendor = (VENDOR_DEVICE_PATH*)Node;
+    }
+  }
+
+  if (Vendor == NULL) {
+    return 0;
+  }
+
+  Status = NorFlashPlatformGetDevices (&NorFlashDevices, &NorFlashDeviceCount);
+  if (EFI_ERROR (Status)) {
+    return 0;
+  }
+
+  for (Index = 0; Index < NorFlashDeviceCount; Index++) {
+    if (CompareGuid (&NorFlashDevices[Index].Guid, &Vendor->Guid) &&
+        (NorFlashDevices[Index].BlockSize == Instance->Media->BlockSize) &&
+        (NorFlashDevices[Index].Size ==
+         MultU64x32 (Instance->Media->LastBlock + 1, Instance->Media->BlockSize))) {
+      return NorFlashDevices[Index].RegionBaseAddress;
+    }
+  }
+
+  return 0;
+}
+
+/**
+  Check the image description found at the end of a block and, if it is
+  valid, add the image to the volume.
+
+  @param[in]  Instance      The BootMonFs instance.
+  @param[in]  Desc          The image description.
+  @param[in]  Lba           The block the description was read from.
+  @param[in]  DescOffset    Byte offset on media of the description.
+**/
 EFI_STATUS
-BootMonFsDiscoverNextImage (
+BootMonFsScanBlock (
   IN     BOOTMON_FS_INSTANCE      *Instance,
-  IN OUT EFI_LBA                  *LbaStart,
-  IN OUT BOOTMON_FS_FILE          *File
+  IN     HW_IMAGE_DESCRIPTION     *Desc,
+  IN     EFI_LBA                   Lba,
+  IN     UINT64                    DescOffset
+  )
+{
+  BOOTMON_FS_FILE  *NewFile;
+  EFI_STATUS        Status;
+
+  if (!BootMonFsIsImageValid (Desc, (Lba - Instance->Media->LowestAlignedLba))) {
+    return EFI_SUCCESS;
+  }
+
+  DEBUG ((EFI_D_ERROR, "Found image: %a in block %d.\n",
+    &(Desc->Footer.Filename),
+    (UINTN)(Lba - Instance->Media->LowestAlignedLba)
+    ));
+
+  // File objects are only created for the blocks holding an image.
+  Status = BootMonFsCreateFile (Instance, &NewFile);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  CopyMem (&NewFile->HwDescription, Desc, sizeof (HW_IMAGE_DESCRIPTION));
+  NewFile->HwDescAddress = DescOffset;
+
+  InsertTailList (&Instance->RootFile->Link, &NewFile->Link);
+  BootMonFsIndexFile (NewFile, NewFile->HwDescription.Footer.Filename);
+  Instance->DirCursor = NULL;
+  return EFI_SUCCESS;
+}
+
+/**
+  Scan the block footers straight from the memory-mapped NOR flash.
+
+  The footer signatures are checked in place, a footer is only copied out
+  to be validated when they match. The NOR flash driver leaves the device in read array mode
+  after each operation, so the window reads back the flash contents.
+**/
+STATIC
+EFI_STATUS
+BootMonFsScanMapped (
+  IN BOOTMON_FS_INSTANCE *Instance,
+  IN UINTN                MappedBase
+  )
+{
+  HW_IMAGE_DESCRIPTION  *MappedDesc;
+  HW_IMAGE_DESCRIPTION   Desc;
+  EFI_LBA                Lba;
+  UINT64                 DescOffset;
+  EFI_STATUS             Status;
+
+  for (Lba = 0; Lba <= Instance->Media->LastBlock; Lba++) {
+    DescOffset = ((Lba + 1) * Instance->Media->BlockSize) - sizeof (HW_IMAGE_DESCRIPTION);
+    MappedDesc = (HW_IMAGE_DESCRIPTION*)(MappedBase + (UINTN)DescOffset);
+
+    if ((MappedDesc->Footer.FooterSignature1 != HW_IMAGE_FOOTER_SIGNATURE_1) ||
+        (MappedDesc->Footer.FooterSignature2 != HW_IMAGE_FOOTER_SIGNATURE_2)) {
+      continue;
+    }
+
+    CopyMem (&Desc, MappedDesc, sizeof (HW_IMAGE_DESCRIPTION));
+    Status = BootMonFsScanBlock (Instance, &Desc, Lba, DescOffset);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Scan the block footers through DiskIo.
+
+  Blocks small enough to fit several in BOOTMON_FS_SCAN_BATCH_SIZE are read
+  in batches. Large blocks only have their footer read, reading them whole to
+  save calls would move the entire media for a few bytes per block.
+**/
+STATIC
+EFI_STATUS
+BootMonFsScanDiskIo (
+  IN BOOTMON_FS_INSTANCE *Instance
   )
 {
   EFI_DISK_IO_PROTOCOL  *DiskIo;
-  EFI_LBA                CurrentLba;
+  HW_IMAGE_DESCRIPTION   Desc;
+  UINT8                 *Batch;
+  UINT32                 BlockSize;
+  UINTN                  BatchBlocks;
+  UINTN                  Count;
+  UINTN                  Index;
+  EFI_LBA                Lba;
   UINT64                 DescOffset;
   EFI_STATUS             Status;
 
   DiskIo = Instance->DiskIo;
+  BlockSize = Instance->Media->BlockSize;
+  BatchBlocks = BOOTMON_FS_SCAN_BATCH_SIZE / BlockSize;
+  Batch = NULL;
 
-  CurrentLba = *LbaStart;
+  if (BatchBlocks > 1) {
+    Batch = AllocatePool (BatchBlocks * BlockSize);
+  }
 
-  // Look for images in the rest of this block
-  while (CurrentLba <= Instance->Media->LastBlock) {
-    // Work out the byte offset into media of the image description in this block
-    // If present, the image description is at the very end of the block.
-    DescOffset = ((CurrentLba + 1) * Instance->Media->BlockSize) - sizeof (HW_IMAGE_DESCRIPTION);
+  Status = EFI_SUCCESS;
+  Lba = 0;
+  while (Lba <= Instance->Media->LastBlock) {
+    if (Batch == NULL) {
+      // Only read the image description at the very end of the block.
+      DescOffset = ((Lba + 1) * BlockSize) - sizeof (HW_IMAGE_DESCRIPTION);
+      Status = DiskIo->ReadDisk (DiskIo,
+                         Instance->Media->MediaId,
+                         DescOffset,
+                         sizeof (HW_IMAGE_DESCRIPTION),
+                         &Desc
+                         );
+      if (EFI_ERROR (Status)) {
+        // Mount what was found so far, as the block by block scan always did.
+        DEBUG ((DEBUG_ERROR, "BootMonFsScanDiskIo: read failed at block %ld. (Status=%r)\n", Lba, Status));
+        Status = EFI_SUCCESS;
+        break;
+      }
+
+      Status = BootMonFsScanBlock (Instance, &Desc, Lba, DescOffset);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+
+      Lba++;
+      continue;
+    }
 
-    // Read the image description from media
+    Count = (UINTN)MIN ((UINT64)BatchBlocks, Instance->Media->LastBlock - Lba + 1);
     Status = DiskIo->ReadDisk (DiskIo,
                        Instance->Media->MediaId,
-                       DescOffset,
-                       sizeof (HW_IMAGE_DESCRIPTION),
-                       &File->HwDescription
+                       MultU64x32 (Lba, BlockSize),
+                       Count * BlockSize,
+                       Batch
                        );
     if (EFI_ERROR (Status)) {
-      return Status;
+      DEBUG ((DEBUG_ERROR, "BootMonFsScanDiskIo: read failed at block %ld. (Status=%r)\n", Lba, Status));
+      Status = EFI_SUCCESS;
+      break;
     }
 
-    // If we found a valid image description...
-    if (BootMonFsIsImageValid (&File->HwDescription, (CurrentLba - Instance->Media->LowestAlignedLba))) {
-      DEBUG ((EFI_D_ERROR, "Found image: %a in block %d.\n",
-        &(File->HwDescription.Footer.Filename),
-        (UINTN)(CurrentLba - Instance->Media->LowestAlignedLba)
-        ));
-      File->HwDescAddress = DescOffset;
+    for (Index = 0; Index < Count; Index++, Lba++) {
+      CopyMem (&Desc,
+        Batch + ((Index + 1) * BlockSize) - sizeof (HW_IMAGE_DESCRIPTION),
+        sizeof (HW_IMAGE_DESCRIPTION));
 
-      *LbaStart = CurrentLba + 1;
-      return EFI_SUCCESS;
-    } else {
-      CurrentLba++;
+      DescOffset = ((Lba + 1) * BlockSize) - sizeof (HW_IMAGE_DESCRIPTION);
+      Status = BootMonFsScanBlock (Instance, &Desc, Lba, DescOffset);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+    }
+
+    if (EFI_ERROR (Status)) {
+      break;
     }
   }
 
-  *LbaStart = CurrentLba;
-  return EFI_NOT_FOUND;
+  if (Batch != NULL) {
+    FreePool (Batch);
+  }
+
+  return Status;
 }
 
 EFI_STATUS
@@ -194,29 +484,31 @@ BootMonFsInitialize (
   )
 {
   EFI_STATUS               Status;
-  EFI_LBA                  Lba;
-  UINT32                   ImageCount;
-  BOOTMON_FS_FILE          *NewFile;
+  BOOLEAN                  Scanned;
 
-  ImageCount = 0;
-  Lba = 0;
+  Instance->MappedBase = BootMonFsGetMappedBase (Instance);
 
-  while (1) {
-    Status = BootMonFsCreateFile (Instance, &NewFile);
-    if (EFI_ERROR (Status)) {
-      return Status;
+  // An index left by a previous mount saves the scan of every block
+  Scanned = FALSE;
+  Status = BootMonFsLoadMountIndex (Instance);
+  if (EFI_ERROR (Status)) {
+    Scanned = TRUE;
+    if (Instance->MappedBase != 0) {
+      Status = BootMonFsScanMapped (Instance, Instance->MappedBase);
+    } else {
+      Status = BootMonFsScanDiskIo (Instance);
     }
+  }
 
-    Status = BootMonFsDiscoverNextImage (Instance, &Lba, NewFile);
-    if (EFI_ERROR (Status)) {
-      // Free NewFile allocated by BootMonFsCreateFile ()
-      FreePool (NewFile);
-      break;
-    }
-    InsertTailList (&Instance->RootFile->Link, &NewFile->Link);
-    ImageCount++;
+  if (EFI_ERROR (Status)) {
+    return Status;
   }
 
+  BootMonFsBuildFreeMap (Instance);
+
   Instance->Initialized = TRUE;
+  if (Scanned) {
+    BootMonFsSaveMountIndex (Instance);
+  }
   return EFI_SUCCESS;
 }
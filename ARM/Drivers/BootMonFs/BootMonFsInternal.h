@@ -27,6 +27,8 @@
 #include <Protocol/SimpleFileSystem.h>
 
 #include <Guid/BootMonFsFileInfo.h>
+#include <Guid/BootMonFsFileMapping.h>
+#include <Guid/BootMonFsIoStats.h>
 #include <Guid/FileInfo.h>
 #include <Guid/FileSystemInfo.h>
 #include <Guid/FileSystemVolumeLabelInfo.h>
@@ -35,20 +37,35 @@
 
 #define BOOTMON_FS_VOLUME_LABEL   L"NOR Flash"
 
+// Largest read issued while scanning the block footers at mount time.
+#define BOOTMON_FS_SCAN_BATCH_SIZE  SIZE_64KB
+
+// Number of buckets of the file name hash table, must be a power of two.
+#define BOOTMON_FS_NAME_HASH_BUCKETS  64
+
 typedef struct _BOOTMON_FS_INSTANCE BOOTMON_FS_INSTANCE;
 
+// Data written to an open file and not flushed yet. The regions of a file
+// are sorted by offset and never overlap nor touch, BootMonFsWriteFile()
+// merges a write into the regions it overlaps or extends.
 typedef struct {
   LIST_ENTRY            Link;
   VOID*                 Buffer;
   UINTN                 Size;
-  UINT64                Offset; // Offset from the start of the file
+  UINTN                 Capacity; // Allocated size of Buffer
+  UINT64                Offset;   // Offset from the start of the file
 } BOOTMON_FS_FILE_REGION;
 
 typedef struct {
   UINT32                Signature;
-  LIST_ENTRY            Link;
+  LIST_ENTRY            Link;     // Files of the volume, in the order of their blocks
+  LIST_ENTRY            NameLink; // Files of the same name hash bucket
   BOOTMON_FS_INSTANCE   *Instance;
 
+  // Current name of the file, either as written on the media or as set by
+  // SetInfo() on an open file that has not been flushed yet.
+  CHAR8                 Name[MAX_NAME_LENGTH];
+
   UINTN                 HwDescAddress;
   HW_IMAGE_DESCRIPTION  HwDescription;
 
@@ -61,14 +78,25 @@ typedef struct {
   EFI_FILE_INFO         *Info;
   UINT64                Position;
   // If the file needs to be flushed then this list contain the memory
-  // buffer that creates this file
+  // buffers that create this file, see BOOTMON_FS_FILE_REGION
   LIST_ENTRY            RegionToFlushLink;
   UINT64                OpenMode;
+  // TRUE if the data, the name or the size of the file changed since it was
+  // last flushed.
+  BOOLEAN               Dirty;
 } BOOTMON_FS_FILE;
 
+// Run of unused blocks of the volume, see BootMonFsSpace.c
+typedef struct {
+  LIST_ENTRY            Link;
+  UINTN                 BlockStart;
+  UINTN                 BlockCount;
+} BOOTMON_FS_FREE_EXTENT;
+
 #define BOOTMON_FS_FILE_SIGNATURE              SIGNATURE_32('b', 'o', 't', 'f')
 #define BOOTMON_FS_FILE_FROM_FILE_THIS(a)      CR (a, BOOTMON_FS_FILE, File, BOOTMON_FS_FILE_SIGNATURE)
 #define BOOTMON_FS_FILE_FROM_LINK_THIS(a)      CR (a, BOOTMON_FS_FILE, Link, BOOTMON_FS_FILE_SIGNATURE)
+#define BOOTMON_FS_FILE_FROM_NAME_LINK(a)      CR (a, BOOTMON_FS_FILE, NameLink, BOOTMON_FS_FILE_SIGNATURE)
 
 struct _BOOTMON_FS_INSTANCE {
   UINT32                               Signature;
@@ -77,7 +105,10 @@ struct _BOOTMON_FS_INSTANCE {
   LIST_ENTRY                           Link;
 
   EFI_DRIVER_BINDING_PROTOCOL         *Binding;
-  EFI_DISK_IO_PROTOCOL                *DiskIo;
+  EFI_DISK_IO_PROTOCOL                *DiskIo;     // Counting DiskIo if PcdBootMonFsIoStats, see BootMonFsIoStats.c
+  EFI_DISK_IO_PROTOCOL                *RawDiskIo;  // DiskIo of the controller, if counting
+  EFI_DISK_IO_PROTOCOL                 CountingDiskIo;
+  BOOTMON_FS_IO_STATS                  IoStats;
   EFI_BLOCK_IO_PROTOCOL               *BlockIo;
   EFI_BLOCK_IO_MEDIA                  *Media;
   EFI_DEVICE_PATH_PROTOCOL            *DevicePath;
@@ -89,6 +120,20 @@ struct _BOOTMON_FS_INSTANCE {
 
   BOOTMON_FS_FILE                     *RootFile; // All the other files are linked to this root
   BOOLEAN                              Initialized;
+  UINTN                                MappedBase; // Address of LBA 0 if memory-mapped, else 0
+
+  LIST_ENTRY                           NameHash[BOOTMON_FS_NAME_HASH_BUCKETS];
+
+  // Directory read cursor: the entry returned for the root file position
+  // DirCursorPosition. NULL when the file list changed since it was set.
+  LIST_ENTRY                          *DirCursor;
+  UINTN                                DirCursorPosition;
+
+  LIST_ENTRY                           FreeExtents; // BOOTMON_FS_FREE_EXTENT sorted by block
+  UINT64                               FreeBlocks;
+
+  // TRUE while the saved mount index matches the volume, see BootMonFsMountIndex.c
+  BOOLEAN                              MountIndexSaved;
 };
 
 #define BOOTMON_FS_SIGNATURE            SIGNATURE_32('b', 'o', 't', 'm')
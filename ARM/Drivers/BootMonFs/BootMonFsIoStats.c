@@ -0,0 +1,106 @@
+/** @file
+*
+*  Accounting of the media accesses of a BootMonFs volume.
+*
+*  The driver reaches the media through a DiskIo protocol owned by the volume
+*  instance that counts the accesses and forwards them to the DiskIo protocol
+*  of the controller.
+*
+*  Copyright (c) 2018, Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include "BootMonFsInternal.h"
+
+#define BOOTMON_FS_FROM_DISK_IO_THIS(a) \
+  CR (a, BOOTMON_FS_INSTANCE, CountingDiskIo, BOOTMON_FS_SIGNATURE)
+
+STATIC
+EFI_STATUS
+EFIAPI
+BootMonFsCountingReadDisk (
+  IN EFI_DISK_IO_PROTOCOL  *This,
+  IN UINT32                MediaId,
+  IN UINT64                Offset,
+  IN UINTN                 BufferSize,
+  OUT VOID                 *Buffer
+  )
+{
+  BOOTMON_FS_INSTANCE  *Instance;
+
+  Instance = BOOTMON_FS_FROM_DISK_IO_THIS (This);
+  Instance->IoStats.ReadCount++;
+  Instance->IoStats.ReadBytes += BufferSize;
+
+  return Instance->RawDiskIo->ReadDisk (Instance->RawDiskIo, MediaId, Offset,
+                                        BufferSize, Buffer);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+BootMonFsCountingWriteDisk (
+  IN EFI_DISK_IO_PROTOCOL  *This,
+  IN UINT32                MediaId,
+  IN UINT64                Offset,
+  IN UINTN                 BufferSize,
+  IN VOID                  *Buffer
+  )
+{
+  BOOTMON_FS_INSTANCE  *Instance;
+  UINT32               BlockSize;
+  UINT64               FirstBlock;
+  UINT64               LastBlock;
+
+  Instance  = BOOTMON_FS_FROM_DISK_IO_THIS (This);
+  BlockSize = Instance->Media->BlockSize;
+
+  Instance->IoStats.WriteCount++;
+  Instance->IoStats.WriteBytes += BufferSize;
+  if (BufferSize != 0) {
+    FirstBlock = DivU64x32 (Offset, BlockSize);
+    LastBlock  = DivU64x32 (Offset + BufferSize - 1, BlockSize);
+    Instance->IoStats.BlocksWritten += LastBlock - FirstBlock + 1;
+
+    if (ModU64x32 (Offset, BlockSize) != 0) {
+      Instance->IoStats.PartialBlocksWritten++;
+    }
+    if ((ModU64x32 (Offset + BufferSize, BlockSize) != 0) &&
+        ((LastBlock != FirstBlock) || (ModU64x32 (Offset, BlockSize) == 0))) {
+      Instance->IoStats.PartialBlocksWritten++;
+    }
+  }
+
+  return Instance->RawDiskIo->WriteDisk (Instance->RawDiskIo, MediaId, Offset,
+                                         BufferSize, Buffer);
+}
+
+/**
+  Route the media accesses of a volume through its counting DiskIo protocol.
+
+  @param[in]  Instance  The volume, its DiskIo field holds the DiskIo protocol
+                        of the controller.
+
+**/
+VOID
+BootMonFsInitIoStats (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  )
+{
+  Instance->RawDiskIo = Instance->DiskIo;
+  Instance->CountingDiskIo.Revision  = Instance->RawDiskIo->Revision;
+  Instance->CountingDiskIo.ReadDisk  = BootMonFsCountingReadDisk;
+  Instance->CountingDiskIo.WriteDisk = BootMonFsCountingWriteDisk;
+  Instance->DiskIo = &Instance->CountingDiskIo;
+
+  ZeroMem (&Instance->IoStats, sizeof (Instance->IoStats));
+  Instance->IoStats.Size = sizeof (Instance->IoStats);
+}
@@ -0,0 +1,452 @@
+/** @file
+*
+*  Mount index of a BootMonFs volume.
+*
+*  Mounting a volume reads the footer of every block to find the images. When
+*  PcdBootMonFsMountIndex is set, the list of images found is kept in a
+*  non-volatile variable and the next mount reads the descriptions it
+*  references and the footers of the blocks it leaves free, but not the
+*  blocks inside the indexed images. Each indexed image must still be valid,
+*  at the same place and with the same footer checksum, and no free block may
+*  end with a valid footer, otherwise the volume is scanned. The free blocks
+*  are checked as images can be written there without going through this
+*  driver, e.g. by the motherboard configuration controller, and the free
+*  space map would otherwise let the driver overwrite them.
+*
+*  The variable is deleted before the driver first changes the volume, so a
+*  reset in the middle of an update leads to a scan, and written again after
+*  a scan, when the platform is ready to boot and when the driver stops.
+*
+*  Copyright (c) 2018, Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+#include "BootMonFsInternal.h"
+
+#define BOOTMON_FS_MOUNT_INDEX_SIGNATURE  SIGNATURE_32('b', 'm', 'i', 'x')
+#define BOOTMON_FS_MOUNT_INDEX_VERSION    2
+
+#define BOOTMON_FS_MOUNT_INDEX_NAME_LENGTH  32
+
+typedef struct {
+  UINT32  BlockStart;
+  UINT32  BlockEnd;
+  UINT32  FooterChecksum;
+} BOOTMON_FS_MOUNT_INDEX_ENTRY;
+
+typedef struct {
+  UINT32  Signature;
+  UINT32  Version;
+  UINT32  Crc32;        // Of the whole variable, computed with this field zero
+  UINT32  EntryCount;
+  // Geometry of the media the index was taken from
+  UINT32  MediaId;
+  UINT32  BlockSize;
+  UINT64  LastBlock;
+  // Followed by EntryCount BOOTMON_FS_MOUNT_INDEX_ENTRY, in block order
+} BOOTMON_FS_MOUNT_INDEX;
+
+/**
+  Name of the variable holding the index of a volume, derived from the device
+  path of the volume.
+**/
+STATIC
+EFI_STATUS
+BootMonFsMountIndexName (
+  IN  BOOTMON_FS_INSTANCE  *Instance,
+  OUT CHAR16               *Name
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Crc;
+
+  if (Instance->DevicePath == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = gBS->CalculateCrc32 (Instance->DevicePath,
+                  GetDevicePathSize (Instance->DevicePath), &Crc);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  UnicodeSPrint (Name, BOOTMON_FS_MOUNT_INDEX_NAME_LENGTH * sizeof (CHAR16),
+    L"BootMonFsIndex%08X", Crc);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+BootMonFsMountIndexCrc (
+  IN  BOOTMON_FS_MOUNT_INDEX  *Index,
+  IN  UINTN                   Size,
+  OUT UINT32                  *Crc
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      StoredCrc;
+
+  StoredCrc = Index->Crc32;
+  Index->Crc32 = 0;
+  Status = gBS->CalculateCrc32 (Index, Size, Crc);
+  Index->Crc32 = StoredCrc;
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+BootMonFsReadDescription (
+  IN  BOOTMON_FS_INSTANCE   *Instance,
+  IN  UINT64                DescOffset,
+  OUT HW_IMAGE_DESCRIPTION  *Desc
+  )
+{
+  if (Instance->MappedBase != 0) {
+    CopyMem (Desc, (VOID*)(Instance->MappedBase + (UINTN)DescOffset), sizeof (HW_IMAGE_DESCRIPTION));
+    return EFI_SUCCESS;
+  }
+
+  return Instance->DiskIo->ReadDisk (Instance->DiskIo, Instance->Media->MediaId,
+                             DescOffset, sizeof (HW_IMAGE_DESCRIPTION), Desc);
+}
+
+/**
+  Check that none of the blocks in a range ends with a valid image footer.
+
+  @param[in]  Instance    The volume.
+  @param[in]  FirstBlock  First block of the range.
+  @param[in]  EndBlock    Block following the range.
+
+  @retval  EFI_SUCCESS    No block of the range holds the end of an image.
+  @retval  EFI_CRC_ERROR  One of them does, the volume has to be scanned.
+  @retval  Others         A footer could not be read.
+
+**/
+STATIC
+EFI_STATUS
+BootMonFsCheckFreeBlocks (
+  IN BOOTMON_FS_INSTANCE  *Instance,
+  IN UINT64               FirstBlock,
+  IN UINT64               EndBlock
+  )
+{
+  HW_IMAGE_DESCRIPTION  *MappedDesc;
+  HW_IMAGE_DESCRIPTION  Desc;
+  UINT64                Lba;
+  UINT64                DescOffset;
+  EFI_STATUS            Status;
+
+  for (Lba = FirstBlock; Lba < EndBlock; Lba++) {
+    DescOffset = MultU64x32 (Lba + 1, Instance->Media->BlockSize) - sizeof (HW_IMAGE_DESCRIPTION);
+
+    // As for a scan, only copy out the footers whose signatures match
+    if (Instance->MappedBase != 0) {
+      MappedDesc = (HW_IMAGE_DESCRIPTION*)(Instance->MappedBase + (UINTN)DescOffset);
+      if ((MappedDesc->Footer.FooterSignature1 != HW_IMAGE_FOOTER_SIGNATURE_1) ||
+          (MappedDesc->Footer.FooterSignature2 != HW_IMAGE_FOOTER_SIGNATURE_2)) {
+        continue;
+      }
+    }
+
+    Status = BootMonFsReadDescription (Instance, DescOffset, &Desc);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (BootMonFsIsImageValid (&Desc, Lba - Instance->Media->LowestAlignedLba)) {
+      DEBUG ((DEBUG_WARN, "BootMonFs: Block %ld holds an image missing from the mount index\n", Lba));
+      return EFI_CRC_ERROR;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Mount a volume from its index.
+
+  @param[in]  Instance  The volume, its list of files is empty.
+
+  @retval  EFI_SUCCESS      The files of the index were added to the volume.
+  @retval  EFI_UNSUPPORTED  The mount index is disabled.
+  @retval  EFI_NOT_FOUND    There is no index for the volume.
+  @retval  EFI_CRC_ERROR    The index is corrupted or does not match the
+                            media, the volume has to be scanned.
+
+**/
+EFI_STATUS
+BootMonFsLoadMountIndex (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  )
+{
+  EFI_STATUS                    Status;
+  CHAR16                        Name[BOOTMON_FS_MOUNT_INDEX_NAME_LENGTH];
+  BOOTMON_FS_MOUNT_INDEX        *Index;
+  BOOTMON_FS_MOUNT_INDEX_ENTRY  *Entry;
+  HW_IMAGE_DESCRIPTION          *Descs;
+  UINTN                         Size;
+  UINTN                         EntryIndex;
+  UINT64                        NextBlock;
+  UINT64                        DescOffset;
+  UINT32                        BlockSize;
+  UINT32                        Crc;
+
+  if (!PcdGetBool (PcdBootMonFsMountIndex)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = BootMonFsMountIndexName (Instance, Name);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Size = 0;
+  Status = gRT->GetVariable (Name, &gArmBootMonFsMountIndexGuid, NULL, &Size, NULL);
+  if (Status != EFI_BUFFER_TOO_SMALL) {
+    return EFI_NOT_FOUND;
+  }
+  if (Size < sizeof (BOOTMON_FS_MOUNT_INDEX)) {
+    return EFI_CRC_ERROR;
+  }
+
+  Index = AllocatePool (Size);
+  if (Index == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Descs = NULL;
+
+  Status = gRT->GetVariable (Name, &gArmBootMonFsMountIndexGuid, NULL, &Size, Index);
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  Status = EFI_CRC_ERROR;
+  BlockSize = Instance->Media->BlockSize;
+  if ((Index->Signature != BOOTMON_FS_MOUNT_INDEX_SIGNATURE) ||
+      (Index->Version != BOOTMON_FS_MOUNT_INDEX_VERSION) ||
+      (Index->EntryCount > Size / sizeof (BOOTMON_FS_MOUNT_INDEX_ENTRY)) ||
+      (Size != sizeof (BOOTMON_FS_MOUNT_INDEX) + (Index->EntryCount * sizeof (BOOTMON_FS_MOUNT_INDEX_ENTRY))) ||
+      EFI_ERROR (BootMonFsMountIndexCrc (Index, Size, &Crc)) || (Crc != Index->Crc32)) {
+    DEBUG ((DEBUG_WARN, "BootMonFs: Discarding corrupted mount index %s\n", Name));
+    goto Exit;
+  }
+
+  if ((Index->MediaId != Instance->Media->MediaId) ||
+      (Index->BlockSize != BlockSize) ||
+      (Index->LastBlock != Instance->Media->LastBlock)) {
+    DEBUG ((DEBUG_WARN, "BootMonFs: Mount index %s is for another media\n", Name));
+    goto Exit;
+  }
+
+  if (Index->EntryCount != 0) {
+    Descs = AllocatePool (Index->EntryCount * sizeof (HW_IMAGE_DESCRIPTION));
+    if (Descs == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+      goto Exit;
+    }
+  }
+
+  // Check all the images and the free blocks between them before adding any
+  // of the images to the volume
+  Entry = (BOOTMON_FS_MOUNT_INDEX_ENTRY*)(Index + 1);
+  NextBlock = 0;
+  for (EntryIndex = 0; EntryIndex < Index->EntryCount; EntryIndex++) {
+    if ((Entry[EntryIndex].BlockStart < NextBlock) ||
+        (Entry[EntryIndex].BlockStart > Entry[EntryIndex].BlockEnd) ||
+        (Entry[EntryIndex].BlockEnd > Instance->Media->LastBlock)) {
+      Status = EFI_CRC_ERROR;
+      goto Exit;
+    }
+
+    Status = BootMonFsCheckFreeBlocks (Instance, NextBlock, Entry[EntryIndex].BlockStart);
+    if (EFI_ERROR (Status)) {
+      goto Exit;
+    }
+    NextBlock = (UINT64)Entry[EntryIndex].BlockEnd + 1;
+
+    DescOffset = MultU64x32 (NextBlock, BlockSize) - sizeof (HW_IMAGE_DESCRIPTION);
+    Status = BootMonFsReadDescription (Instance, DescOffset, &Descs[EntryIndex]);
+    if (EFI_ERROR (Status)) {
+      goto Exit;
+    }
+
+    if (!BootMonFsIsImageValid (&Descs[EntryIndex], Entry[EntryIndex].BlockEnd) ||
+        (Descs[EntryIndex].BlockStart != Entry[EntryIndex].BlockStart) ||
+        (Descs[EntryIndex].FooterChecksum != Entry[EntryIndex].FooterChecksum)) {
+      DEBUG ((DEBUG_WARN, "BootMonFs: The image in block %d changed since the volume was indexed\n",
+        Entry[EntryIndex].BlockEnd));
+      Status = EFI_CRC_ERROR;
+      goto Exit;
+    }
+  }
+
+  Status = BootMonFsCheckFreeBlocks (Instance, NextBlock, Instance->Media->LastBlock + 1);
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  for (EntryIndex = 0; EntryIndex < Index->EntryCount; EntryIndex++) {
+    DescOffset = MultU64x32 ((UINT64)Entry[EntryIndex].BlockEnd + 1, BlockSize) - sizeof (HW_IMAGE_DESCRIPTION);
+    Status = BootMonFsScanBlock (Instance, &Descs[EntryIndex], Entry[EntryIndex].BlockEnd, DescOffset);
+    if (EFI_ERROR (Status)) {
+      goto Exit;
+    }
+  }
+
+  Instance->MountIndexSaved = TRUE;
+  Status = EFI_SUCCESS;
+
+Exit:
+  if (Descs != NULL) {
+    FreePool (Descs);
+  }
+  FreePool (Index);
+  return Status;
+}
+
+/**
+  Save the index of a mounted volume, unless the saved one is up to date.
+
+  @param[in]  Instance  The volume.
+
+**/
+VOID
+BootMonFsSaveMountIndex (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  )
+{
+  EFI_STATUS                    Status;
+  CHAR16                        Name[BOOTMON_FS_MOUNT_INDEX_NAME_LENGTH];
+  BOOTMON_FS_MOUNT_INDEX        *Index;
+  BOOTMON_FS_MOUNT_INDEX_ENTRY  *Entry;
+  LIST_ENTRY                    *FileLink;
+  BOOTMON_FS_FILE               *File;
+  UINTN                         EntryCount;
+  UINTN                         Size;
+  UINT32                        Crc;
+
+  if (!PcdGetBool (PcdBootMonFsMountIndex) ||
+      !Instance->Initialized || Instance->MountIndexSaved) {
+    return;
+  }
+
+  Status = BootMonFsMountIndexName (Instance, Name);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  // Only the images on the media, files not flushed yet have no block
+  EntryCount = 0;
+  for (FileLink = GetFirstNode (&Instance->RootFile->Link);
+       !IsNull (&Instance->RootFile->Link, FileLink);
+       FileLink = GetNextNode (&Instance->RootFile->Link, FileLink)
+       )
+  {
+    File = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
+    if (File->HwDescription.RegionCount != 0) {
+      EntryCount++;
+    }
+  }
+
+  Size = sizeof (BOOTMON_FS_MOUNT_INDEX) + (EntryCount * sizeof (BOOTMON_FS_MOUNT_INDEX_ENTRY));
+  Index = AllocateZeroPool (Size);
+  if (Index == NULL) {
+    return;
+  }
+
+  Index->Signature  = BOOTMON_FS_MOUNT_INDEX_SIGNATURE;
+  Index->Version    = BOOTMON_FS_MOUNT_INDEX_VERSION;
+  Index->EntryCount = (UINT32)EntryCount;
+  Index->MediaId    = Instance->Media->MediaId;
+  Index->BlockSize  = Instance->Media->BlockSize;
+  Index->LastBlock  = Instance->Media->LastBlock;
+
+  // The files are kept in the order of their blocks
+  Entry = (BOOTMON_FS_MOUNT_INDEX_ENTRY*)(Index + 1);
+  for (FileLink = GetFirstNode (&Instance->RootFile->Link);
+       !IsNull (&Instance->RootFile->Link, FileLink);
+       FileLink = GetNextNode (&Instance->RootFile->Link, FileLink)
+       )
+  {
+    File = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
+    if (File->HwDescription.RegionCount != 0) {
+      Entry->BlockStart     = File->HwDescription.BlockStart;
+      Entry->BlockEnd       = File->HwDescription.BlockEnd;
+      Entry->FooterChecksum = File->HwDescription.FooterChecksum;
+      Entry++;
+    }
+  }
+
+  // BootMonFsMountIndexCrc() puts the former value of the field back
+  Status = BootMonFsMountIndexCrc (Index, Size, &Crc);
+  if (!EFI_ERROR (Status)) {
+    Index->Crc32 = Crc;
+    Status = gRT->SetVariable (
+                    Name,
+                    &gArmBootMonFsMountIndexGuid,
+                    EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                    Size,
+                    Index
+                    );
+  }
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "BootMonFs: Failed to save the mount index %s. (Status=%r)\n", Name, Status));
+  } else {
+    Instance->MountIndexSaved = TRUE;
+  }
+
+  FreePool (Index);
+}
+
+/**
+  Delete the saved index of a volume before changing its content.
+
+  @param[in]  Instance  The volume.
+
+  @retval  EFI_SUCCESS  The volume has no saved index anymore.
+  @retval  Others       The index could not be deleted, the volume must not
+                        be changed as the next mount would trust the index.
+
+**/
+EFI_STATUS
+BootMonFsDropMountIndex (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  )
+{
+  EFI_STATUS  Status;
+  CHAR16      Name[BOOTMON_FS_MOUNT_INDEX_NAME_LENGTH];
+
+  if (!Instance->MountIndexSaved) {
+    return EFI_SUCCESS;
+  }
+
+  Status = BootMonFsMountIndexName (Instance, Name);
+  if (!EFI_ERROR (Status)) {
+    Status = gRT->SetVariable (Name, &gArmBootMonFsMountIndexGuid, 0, 0, NULL);
+  }
+  if (EFI_ERROR (Status) && (Status != EFI_NOT_FOUND)) {
+    DEBUG ((DEBUG_ERROR, "BootMonFs: Failed to delete the mount index. (Status=%r)\n", Status));
+    return Status;
+  }
+
+  Instance->MountIndexSaved = FALSE;
+  return EFI_SUCCESS;
+}
@@ -12,6 +12,8 @@
 *
 **/
 
+#include <Library/PcdLib.h>
+
 #include "BootMonFsInternal.h"
 
 // Clear a file's image description on storage media:
@@ -20,75 +22,63 @@
 // and the beginning of the write should be filled. It's therefore possible that
 // BootMonFs metadata, that comes after the end of a file, could be left there
 // and wrongly detected by BootMonFsImageInBlock.
+//
+// Only the footer signatures are cleared, that is enough for the scan to
+// ignore the description. Clearing bits is a program-only operation on NOR
+// flash, the flash driver does not have to erase the block holding the
+// description to invalidate it.
 STATIC
 EFI_STATUS
 InvalidateImageDescription (
-  IN  BOOTMON_FS_FILE  *File
+  IN  BOOTMON_FS_FILE  *File,
+  IN  UINTN             HwDescAddress
   )
 {
   EFI_DISK_IO_PROTOCOL   *DiskIo;
   EFI_BLOCK_IO_PROTOCOL  *BlockIo;
   UINT32                  MediaId;
-  VOID                   *Buffer;
-  EFI_STATUS              Status;
+  UINT32                  Signatures[2];
 
   DiskIo = File->Instance->DiskIo;
   BlockIo = File->Instance->BlockIo;
   MediaId = BlockIo->Media->MediaId;
 
-  Buffer = AllocateZeroPool (sizeof (HW_IMAGE_DESCRIPTION));
+  ZeroMem (Signatures, sizeof (Signatures));
 
-  if (Buffer == NULL) {
-    return EFI_OUT_OF_RESOURCES;
-  }
-
-  Status = DiskIo->WriteDisk (DiskIo,
-                    MediaId,
-                    File->HwDescAddress,
-                    sizeof (HW_IMAGE_DESCRIPTION),
-                    Buffer
-                    );
-
-  FreePool(Buffer);
-
-  return Status;
+  return DiskIo->WriteDisk (DiskIo,
+                   MediaId,
+                   HwDescAddress + OFFSET_OF (HW_IMAGE_DESCRIPTION, Footer.FooterSignature1),
+                   sizeof (Signatures),
+                   Signatures
+                   );
 }
 
 /**
-  Write the description of a file to storage media.
+  Build the description of a file, without writing it to the media.
 
-  This function uses DiskIo to write to the media, so call BlockIo->FlushBlocks()
-  after calling it to ensure the data are written on the media.
-
-  @param[in]  File       Description of the file whose description on the
-                         storage media has to be updated.
-  @param[in]  FileName   Name of the file. Its length is assumed to be
-                         lower than MAX_NAME_LENGTH.
-  @param[in]  DataSize   Number of data bytes of the file.
-  @param[in]  FileStart  File's starting position on media. FileStart must
-                         be aligned to the media's block size.
-
-  @retval  EFI_WRITE_PROTECTED  The device cannot be written to.
-  @retval  EFI_DEVICE_ERROR     The device reported an error while performing
-                                the write operation.
+  @param[in]   File         Description of the file.
+  @param[in]   FileName     Name of the file. Its length is assumed to be
+                            lower than MAX_NAME_LENGTH.
+  @param[in]   DataSize     Number of data bytes of the file.
+  @param[in]   FileStart    File's starting position on media. FileStart must
+                            be aligned to the media's block size.
+  @param[out]  Description  The description to write at the end of the last
+                            block of the file.
 
 **/
 STATIC
 EFI_STATUS
-WriteFileDescription (
-  IN  BOOTMON_FS_FILE  *File,
-  IN  CHAR8            *FileName,
-  IN  UINT32            DataSize,
-  IN  UINT64            FileStart
+BuildFileDescription (
+  IN  BOOTMON_FS_FILE       *File,
+  IN  CHAR8                 *FileName,
+  IN  UINT32                DataSize,
+  IN  UINT64                FileStart,
+  OUT HW_IMAGE_DESCRIPTION  *Description
   )
 {
-  EFI_STATUS            Status;
-  EFI_DISK_IO_PROTOCOL  *DiskIo;
-  UINTN                 BlockSize;
-  UINT32                FileSize;
-  HW_IMAGE_DESCRIPTION  *Description;
+  UINTN   BlockSize;
+  UINT32  FileSize;
 
-  DiskIo    = File->Instance->DiskIo;
   BlockSize = File->Instance->BlockIo->Media->BlockSize;
   ASSERT (FileStart % BlockSize == 0);
 
@@ -97,7 +87,8 @@ WriteFileDescription (
   //
 
   FileSize = DataSize + sizeof (HW_IMAGE_DESCRIPTION);
-  Description = &File->HwDescription;
+  CopyMem (Description, &File->HwDescription, sizeof (HW_IMAGE_DESCRIPTION));
+
   Description->Attributes = 1;
   Description->BlockStart = FileStart / BlockSize;
   Description->BlockEnd   = Description->BlockStart + (FileSize / BlockSize);
@@ -118,38 +109,252 @@ WriteFileDescription (
   Description->Region[0].Offset = Description->BlockStart * BlockSize;
   Description->Region[0].Size = DataSize;
 
-  Status = BootMonFsComputeFooterChecksum (Description);
+  return BootMonFsComputeFooterChecksum (Description);
+}
+
+/**
+  Make a description built by BuildFileDescription() the description of the
+  file, once it has been written to the media.
+
+  @param[in]  File         Description of the file.
+  @param[in]  Description  The new description of the file.
+
+**/
+STATIC
+VOID
+CommitFileDescription (
+  IN  BOOTMON_FS_FILE       *File,
+  IN  HW_IMAGE_DESCRIPTION  *Description
+  )
+{
+  UINTN  BlockSize;
+
+  BlockSize = File->Instance->BlockIo->Media->BlockSize;
+
+  // Move the blocks of the file in the free-extent map
+  if (File->HwDescription.RegionCount != 0) {
+    BootMonFsFreeMapRelease (
+      File->Instance,
+      File->HwDescription.BlockStart,
+      File->HwDescription.BlockEnd - File->HwDescription.BlockStart + 1
+      );
+  }
+  BootMonFsFreeMapReserve (
+    File->Instance,
+    Description->BlockStart,
+    Description->BlockEnd - Description->BlockStart + 1
+    );
+
+  CopyMem (&File->HwDescription, Description, sizeof (HW_IMAGE_DESCRIPTION));
+  File->HwDescAddress = ((Description->BlockEnd + 1) * BlockSize) - sizeof (HW_IMAGE_DESCRIPTION);
+}
+
+// Move a file to its place in the list of files of the volume, which is in
+// disk order. Files not on the media yet keep their place.
+// Parameters:
+// File - the file to move in the list.
+// BlockStart - the first block of the file on the media.
+STATIC
+VOID
+BootMonFsSortFile (
+  IN  BOOTMON_FS_FILE     *File,
+  IN  UINTN                BlockStart
+  )
+{
+  LIST_ENTRY              *FileLink;
+  BOOTMON_FS_FILE         *RootFile;
+  BOOTMON_FS_FILE         *FileEntry;
+
+  RootFile = File->Instance->RootFile;
+
+  // Insert the file before the first image following it.
+  RemoveEntryList (&File->Link);
+  for (FileLink = GetFirstNode (&RootFile->Link);
+       !IsNull (&RootFile->Link, FileLink);
+       FileLink = GetNextNode (&RootFile->Link, FileLink)
+       )
+  {
+    FileEntry = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
+    if ((FileEntry->HwDescription.RegionCount != 0) &&
+        (FileEntry->HwDescription.BlockStart > BlockStart)) {
+      break;
+    }
+  }
+  InsertTailList (FileLink, &File->Link);
+  File->Instance->DirCursor = NULL;
+}
+
+// Copy an image to free blocks of the volume and rewrite its description
+// there. The image must be made of a single region and the destination must
+// not overlap it: the image is left intact on the media until its copy,
+// description included, is written.
+// Parameters:
+// File - the image to move.
+// BlockStart - the new first block of the image.
+// Buffer - a buffer of the size of a block.
+STATIC
+EFI_STATUS
+BootMonFsMoveImage (
+  IN  BOOTMON_FS_FILE     *File,
+  IN  UINTN                BlockStart,
+  IN  VOID                *Buffer
+  )
+{
+  EFI_STATUS               Status;
+  EFI_DISK_IO_PROTOCOL    *DiskIo;
+  EFI_BLOCK_IO_MEDIA      *Media;
+  UINTN                    BlockSize;
+  UINTN                    BlockCount;
+  UINTN                    Index;
+  UINTN                    OldHwDescAddress;
+  UINT64                   Source;
+  UINT64                   Destination;
+  CHAR8                    AsciiFileName[MAX_NAME_LENGTH];
+  HW_IMAGE_DESCRIPTION     Description;
+
+  DiskIo    = File->Instance->DiskIo;
+  Media     = File->Instance->Media;
+  BlockSize = Media->BlockSize;
+
+  BlockCount = BootMonFsBlockCount (File->Instance,
+                 File->HwDescription.Region[0].Size + sizeof (HW_IMAGE_DESCRIPTION));
+  ASSERT ((BlockStart + BlockCount <= File->HwDescription.BlockStart) ||
+          (BlockStart > File->HwDescription.BlockEnd));
+
+  AsciiStrnCpyS (AsciiFileName, MAX_NAME_LENGTH,
+    File->HwDescription.Footer.Filename, MAX_NAME_LENGTH - 1);
+  Status = BuildFileDescription (
+             File,
+             AsciiFileName,
+             File->HwDescription.Region[0].Size,
+             (UINT64)BlockStart * BlockSize,
+             &Description
+             );
   if (EFI_ERROR (Status)) {
     return Status;
   }
 
-  File->HwDescAddress = ((Description->BlockEnd + 1) * BlockSize) - sizeof (HW_IMAGE_DESCRIPTION);
+  for (Index = 0; Index < BlockCount; Index++) {
+    Source      = (UINT64)(File->HwDescription.BlockStart + Index) * BlockSize;
+    Destination = (UINT64)(BlockStart + Index) * BlockSize;
+
+    Status = DiskIo->ReadDisk (DiskIo, Media->MediaId, Source, BlockSize, Buffer);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    // The new description goes in the copy of the last block, it costs no
+    // additional erase.
+    if (Index == BlockCount - 1) {
+      CopyMem ((UINT8*)Buffer + BlockSize - sizeof (HW_IMAGE_DESCRIPTION),
+        &Description, sizeof (HW_IMAGE_DESCRIPTION));
+    }
+    Status = DiskIo->WriteDisk (DiskIo, Media->MediaId, Destination, BlockSize, Buffer);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  // The copy does not overlap the image and its description is written
+  // before the old one is cleared, an interrupted move leaves two copies of
+  // the image rather than none.
+  OldHwDescAddress = File->HwDescAddress;
+  CommitFileDescription (File, &Description);
+
+  return InvalidateImageDescription (File, OldHwDescAddress);
+}
+
+// Gather the free space of the volume at its end by moving the images
+// towards its start, keeping their order. Images made of more than one
+// region are not moved.
+//
+// An image is only ever copied to blocks it does not occupy. When the free
+// space in front of it is smaller than the image, it is first copied to
+// another free extent and then back to its final place. If there is no such
+// extent the image stays where it is.
+// Parameters:
+// Instance - the volume to compact.
+STATIC
+EFI_STATUS
+BootMonFsCompact (
+  IN  BOOTMON_FS_INSTANCE  *Instance
+  )
+{
+  EFI_STATUS               Status;
+  LIST_ENTRY              *FileLink;
+  BOOTMON_FS_FILE         *FileEntry;
+  UINTN                    NextBlock;
+  UINTN                    BlockCount;
+  UINTN                    ScratchBlock;
+  VOID                    *Buffer;
+
+  Buffer = AllocatePool (Instance->Media->BlockSize);
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = EFI_SUCCESS;
+  NextBlock = 0;
+  for (FileLink = GetFirstNode (&Instance->RootFile->Link);
+       !IsNull (&Instance->RootFile->Link, FileLink);
+       FileLink = GetNextNode (&Instance->RootFile->Link, FileLink)
+       )
+  {
+    FileEntry = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
+    // Skip files that aren't on disk yet
+    if (FileEntry->HwDescription.RegionCount == 0) {
+      continue;
+    }
+
+    if ((FileEntry->HwDescription.RegionCount == 1) &&
+        (FileEntry->HwDescription.BlockStart > NextBlock)) {
+      BlockCount = FileEntry->HwDescription.BlockEnd - FileEntry->HwDescription.BlockStart + 1;
 
-  // Update the file description on the media
-  Status = DiskIo->WriteDisk (
-                    DiskIo,
-                    File->Instance->Media->MediaId,
-                    File->HwDescAddress,
-                    sizeof (HW_IMAGE_DESCRIPTION),
-                    Description
-                    );
-  ASSERT_EFI_ERROR (Status);
+      // The free extent found is never the one in front of the image, it is
+      // smaller than the image.
+      if ((NextBlock + BlockCount > FileEntry->HwDescription.BlockStart) &&
+          !EFI_ERROR (BootMonFsFreeMapFind (Instance, BlockCount, &ScratchBlock))) {
+        DEBUG ((DEBUG_INFO, "BootMonFs: Moving %a from block %d to block %d\n",
+          FileEntry->HwDescription.Footer.Filename,
+          FileEntry->HwDescription.BlockStart,
+          ScratchBlock));
+
+        Status = BootMonFsMoveImage (FileEntry, ScratchBlock, Buffer);
+      }
+
+      if (!EFI_ERROR (Status) &&
+          ((NextBlock + BlockCount <= FileEntry->HwDescription.BlockStart) ||
+           (NextBlock > FileEntry->HwDescription.BlockEnd))) {
+        DEBUG ((DEBUG_INFO, "BootMonFs: Moving %a from block %d to block %d\n",
+          FileEntry->HwDescription.Footer.Filename,
+          FileEntry->HwDescription.BlockStart,
+          NextBlock));
+
+        Status = BootMonFsMoveImage (FileEntry, NextBlock, Buffer);
+      }
+      if (EFI_ERROR (Status)) {
+        // The image may have been left in the scratch extent.
+        BootMonFsSortFile (FileEntry, FileEntry->HwDescription.BlockStart);
+        break;
+      }
+    }
+
+    NextBlock = MAX (NextBlock, (UINTN)FileEntry->HwDescription.BlockEnd + 1);
+  }
+
+  FreePool (Buffer);
+  Instance->BlockIo->FlushBlocks (Instance->BlockIo);
+  Instance->IoStats.FlushCount++;
 
   return Status;
 }
 
 // Find a space on media for a file that has not yet been flushed to disk.
-// Just returns the first space that's big enough.
-// This function could easily be adapted to:
-// - Find space for moving an existing file that has outgrown its space
-//   (We do not currently move files, just return EFI_VOLUME_FULL)
-// - Find space for a fragment of a file that has outgrown its space
-//   (We do not currently fragment files - it's not clear whether fragmentation
-//    is actually part of BootMonFs as there is no spec)
-// - Be more clever about finding space (choosing the largest or smallest
-//   suitable space)
+// Returns the smallest free extent of the volume big enough for the file. If
+// the free space is large enough but too fragmented and
+// PcdBootMonFsCompactOnFull is set, the volume is compacted first.
 // Parameters:
 // File - the new (not yet flushed) file for which we need to find space.
+// FileSize - the size of the file data plus its description.
 // FileStart - the position on media of the file (in bytes).
 STATIC
 EFI_STATUS
@@ -159,55 +364,134 @@ BootMonFsFindSpaceForNewFile (
   OUT UINT64              *FileStart
   )
 {
-  LIST_ENTRY              *FileLink;
-  BOOTMON_FS_FILE         *RootFile;
-  BOOTMON_FS_FILE         *FileEntry;
-  UINTN                    BlockSize;
-  EFI_BLOCK_IO_MEDIA      *Media;
+  EFI_STATUS               Status;
+  BOOTMON_FS_INSTANCE     *Instance;
+  UINTN                    BlockCount;
+  UINTN                    BlockStart;
 
-  Media = File->Instance->BlockIo->Media;
-  BlockSize = Media->BlockSize;
-  RootFile = File->Instance->RootFile;
+  Instance = File->Instance;
 
   // This function must only be called for file which has not been flushed into
   // Flash yet
   ASSERT (File->HwDescription.RegionCount == 0);
 
-  *FileStart = 0;
-  // Go through all the files in the list
-  for (FileLink = GetFirstNode (&RootFile->Link);
-         !IsNull (&RootFile->Link, FileLink);
-         FileLink = GetNextNode (&RootFile->Link, FileLink)
-         )
+  BlockCount = BootMonFsBlockCount (Instance, FileSize);
+  Status = BootMonFsFreeMapFind (Instance, BlockCount, &BlockStart);
+  if ((Status == EFI_VOLUME_FULL) &&
+      PcdGetBool (PcdBootMonFsCompactOnFull) &&
+      (BlockCount <= Instance->FreeBlocks)) {
+    Status = BootMonFsCompact (Instance);
+    if (!EFI_ERROR (Status)) {
+      Status = BootMonFsFreeMapFind (Instance, BlockCount, &BlockStart);
+    }
+  }
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  BootMonFsSortFile (File, BlockStart);
+
+  *FileStart = (UINT64)BlockStart * Instance->Media->BlockSize;
+  return EFI_SUCCESS;
+}
+
+// End of the space a file can grow into where it is: the start of the next
+// image on the media or the end of the volume.
+// Parameters:
+// File - the file, its image must be on the media.
+STATIC
+UINT64
+BootMonFsEndOfAppendSpace (
+  IN  BOOTMON_FS_FILE     *File
+  )
+{
+  BOOTMON_FS_INSTANCE     *Instance;
+  LIST_ENTRY              *FileLink;
+  BOOTMON_FS_FILE         *NextFile;
+
+  Instance = File->Instance;
+  for (FileLink = GetNextNode (&Instance->RootFile->Link, &File->Link);
+       !IsNull (&Instance->RootFile->Link, FileLink);
+       FileLink = GetNextNode (&Instance->RootFile->Link, FileLink)
+       )
   {
-    FileEntry = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
+    NextFile = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
     // Skip files that aren't on disk yet
-    if (FileEntry->HwDescription.RegionCount == 0) {
-      continue;
+    if (NextFile->HwDescription.RegionCount != 0) {
+      return MultU64x32 (NextFile->HwDescription.BlockStart, Instance->Media->BlockSize);
     }
+  }
+
+  return MultU64x32 (Instance->Media->LastBlock + 1, Instance->Media->BlockSize);
+}
+
+// Find a new place for a file that outgrew the space after its image. The
+// new place never overlaps the image, which stays valid on the media until
+// the flush has written the whole file there. If no free extent is large
+// enough the volume is compacted, which may also leave enough room after the
+// image to grow the file where it is.
+// Parameters:
+// File - the file, its image must be made of a single region.
+// FileSize - the new size of the file data plus its description.
+// FileStart - the position on media to flush the file to.
+// ReservedBlocks - number of blocks reserved at FileStart if the file is
+//                  to be moved there, 0 if it grows where it is.
+STATIC
+EFI_STATUS
+BootMonFsRelocateFile (
+  IN  BOOTMON_FS_FILE     *File,
+  IN  UINT64              FileSize,
+  OUT UINT64              *FileStart,
+  OUT UINTN               *ReservedBlocks
+  )
+{
+  EFI_STATUS               Status;
+  BOOTMON_FS_INSTANCE     *Instance;
+  UINTN                    BlockSize;
+  UINTN                    BlockCount;
+  UINTN                    BlockStart;
+
+  Instance   = File->Instance;
+  BlockSize  = Instance->Media->BlockSize;
+  BlockCount = BootMonFsBlockCount (Instance, FileSize);
+  *ReservedBlocks = 0;
+
+  // Even compacted, the volume only has its free blocks and the blocks of
+  // the file to hold the file.
+  if (BlockCount > Instance->FreeBlocks +
+                   (File->HwDescription.BlockEnd - File->HwDescription.BlockStart + 1)) {
+    return EFI_VOLUME_FULL;
+  }
 
-    // If the free space preceding the file is big enough to contain the new
-    // file then use it!
-    if (((FileEntry->HwDescription.BlockStart * BlockSize) - *FileStart)
-        >= FileSize) {
-      // The file list must be in disk-order
-      RemoveEntryList (&File->Link);
-      File->Link.BackLink = FileLink->BackLink;
-      File->Link.ForwardLink = FileLink;
-      FileLink->BackLink->ForwardLink = &File->Link;
-      FileLink->BackLink = &File->Link;
+  Status = BootMonFsFreeMapFind (Instance, BlockCount, &BlockStart);
+  if (Status == EFI_VOLUME_FULL) {
+    Status = BootMonFsCompact (Instance);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
 
+    *FileStart = MultU64x32 (File->HwDescription.BlockStart, BlockSize);
+    if (BootMonFsEndOfAppendSpace (File) - *FileStart >= MultU64x32 (BlockCount, BlockSize)) {
       return EFI_SUCCESS;
-    } else {
-      *FileStart = (FileEntry->HwDescription.BlockEnd + 1) * BlockSize;
     }
+    Status = BootMonFsFreeMapFind (Instance, BlockCount, &BlockStart);
   }
-  // See if there's space after the last file
-  if ((((Media->LastBlock + 1) * BlockSize) - *FileStart) >= FileSize) {
-    return EFI_SUCCESS;
-  } else {
-    return EFI_VOLUME_FULL;
+  if (EFI_ERROR (Status)) {
+    return Status;
   }
+
+  BootMonFsFreeMapReserve (Instance, BlockStart, BlockCount);
+
+  // The flush writes the whole file at its new place
+  Status = BootMonFsLoadFileData (File);
+  if (EFI_ERROR (Status)) {
+    BootMonFsFreeMapRelease (Instance, BlockStart, BlockCount);
+    return Status;
+  }
+
+  *FileStart = MultU64x32 (BlockStart, BlockSize);
+  *ReservedBlocks = BlockCount;
+  return EFI_SUCCESS;
 }
 
 // Free the resources in the file's Region list.
@@ -232,6 +516,53 @@ FreeFileRegions (
   }
 }
 
+/**
+  Check whether a range of the media is going to be written by a flush.
+
+  @param[in]  File        Description of the file being flushed.
+  @param[in]  FileStart   Position of the file on the media.
+  @param[in]  TailStart   Start of the write ending with the description.
+  @param[in]  TailEnd     End of the write ending with the description.
+  @param[in]  Address     Start of the range on the media.
+  @param[in]  Size        Size of the range.
+
+  @retval  TRUE   The flush writes over the whole range.
+  @retval  FALSE  The range is, at least partially, left as is.
+
+**/
+STATIC
+BOOLEAN
+BootMonFsIsRangeFlushed (
+  IN BOOTMON_FS_FILE  *File,
+  IN UINT64           FileStart,
+  IN UINT64           TailStart,
+  IN UINT64           TailEnd,
+  IN UINT64           Address,
+  IN UINTN            Size
+  )
+{
+  LIST_ENTRY              *RegionToFlushLink;
+  BOOTMON_FS_FILE_REGION  *Region;
+
+  if ((Address >= TailStart) && (Address + Size <= TailEnd)) {
+    return TRUE;
+  }
+
+  for (RegionToFlushLink = GetFirstNode (&File->RegionToFlushLink);
+       !IsNull (&File->RegionToFlushLink, RegionToFlushLink);
+       RegionToFlushLink = GetNextNode (&File->RegionToFlushLink, RegionToFlushLink)
+       )
+  {
+    Region = (BOOTMON_FS_FILE_REGION*)RegionToFlushLink;
+    if ((Address >= FileStart + Region->Offset) &&
+        (Address + Size <= FileStart + Region->Offset + Region->Size)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
 /**
   Flush all modified data associated with a file to a device.
 
@@ -262,18 +593,22 @@ BootMonFsFlushFile (
   CHAR8                    AsciiFileName[MAX_NAME_LENGTH];
   LIST_ENTRY              *RegionToFlushLink;
   BOOTMON_FS_FILE         *File;
-  BOOTMON_FS_FILE         *NextFile;
   BOOTMON_FS_FILE_REGION  *Region;
-  LIST_ENTRY              *FileLink;
-  UINTN                    CurrentPhysicalSize;
   UINT64                   FileStart;
-  UINT64                   FileEnd;
+  UINT64                   NewFileSize;
+  UINT64                   NewPhysicalSize;
+  UINTN                    ReservedBlocks;
+  UINTN                    OldHwDescAddress;
+  BOOLEAN                  UpdateDescription;
+  HW_IMAGE_DESCRIPTION     Description;
+  UINT64                   DescAddress;
+  UINT64                   DescEnd;
+  UINT64                   TailStart;
   UINT64                   RegionStart;
   UINT64                   RegionEnd;
-  UINT64                   NewDataSize;
-  UINT64                   NewFileSize;
-  UINT64                   EndOfAppendSpace;
-  BOOLEAN                  HasSpace;
+  UINT64                   CoverStart;
+  UINT64                   OldSignatures;
+  UINT8                   *TailBuffer;
 
   if (This == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -288,6 +623,17 @@ BootMonFsFlushFile (
     return EFI_ACCESS_DENIED;
   }
 
+  if (!File->Dirty) {
+    return EFI_SUCCESS;
+  }
+
+  // Flushing the file may move its image or, to make room for it, the
+  // images of other files.
+  Status = BootMonFsDropMountIndex (File->Instance);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
   Instance  = File->Instance;
   Info      = File->Info;
   BlockIo   = Instance->BlockIo;
@@ -297,6 +643,9 @@ BootMonFsFlushFile (
 
   UnicodeStrToAsciiStrS (Info->FileName, AsciiFileName, MAX_NAME_LENGTH);
 
+  ReservedBlocks   = 0;
+  OldHwDescAddress = 0;
+
   // If the file doesn't exist then find a space for it
   if (File->HwDescription.RegionCount == 0) {
     Status = BootMonFsFindSpaceForNewFile (
@@ -310,124 +659,184 @@ BootMonFsFlushFile (
   } else {
     FileStart = File->HwDescription.BlockStart * BlockSize;
   }
-  // FileEnd is the current NOR address of the end of the file's data
-  FileEnd = FileStart + File->HwDescription.Region[0].Size;
-
-  for (RegionToFlushLink = GetFirstNode (&File->RegionToFlushLink);
-       !IsNull (&File->RegionToFlushLink, RegionToFlushLink);
-       RegionToFlushLink = GetNextNode (&File->RegionToFlushLink, RegionToFlushLink)
-       )
-  {
-    Region = (BOOTMON_FS_FILE_REGION*)RegionToFlushLink;
-    if (Region->Size == 0) {
-      continue;
-    }
-
-    // RegionStart and RegionEnd are the the intended NOR address of the
-    // start and end of the region
-    RegionStart = FileStart   + Region->Offset;
-    RegionEnd   = RegionStart + Region->Size;
+  // Appending to the file moves its description. Check once that the whole
+  // new file fits before programming anything.
+  //
+  // Note: Since seeking past the end of the file with SetPosition() is
+  //  valid, it's possible there will be a gap between the current end of
+  //  the file and the beginning of the new data. Since the UEFI spec
+  //  says nothing about this case (except "a subsequent write would grow
+  //  the file"), we just leave garbage in the gap.
+  if (Info->FileSize > File->HwDescription.Region[0].Size) {
+    NewFileSize = Info->FileSize + sizeof (HW_IMAGE_DESCRIPTION);
+    NewPhysicalSize = MultU64x32 (BootMonFsBlockCount (Instance, NewFileSize), BlockSize);
+    if ((NewPhysicalSize > BootMonFsGetPhysicalSize (File)) &&
+        (BootMonFsEndOfAppendSpace (File) - FileStart < NewPhysicalSize)) {
+      // There isn't a space for the file.
+      // Options here are to move the file or fragment it. However as files
+      // may represent boot images at fixed positions, these options will
+      // break booting if the bootloader doesn't use BootMonFs to find the
+      // image. Files are only moved when the platform opted in.
+      if (!PcdGetBool (PcdBootMonFsCompactOnFull) ||
+          (File->HwDescription.RegionCount != 1)) {
+        return EFI_VOLUME_FULL;
+      }
 
-    if (RegionEnd < FileEnd) {
-      // Handle regions representing edits to existing portions of the file
-      // Write the region data straight into the file
-      Status = DiskIo->WriteDisk (DiskIo,
-                        Media->MediaId,
-                        RegionStart,
-                        Region->Size,
-                        Region->Buffer
-                        );
+      Status = BootMonFsRelocateFile (File, NewFileSize, &FileStart, &ReservedBlocks);
       if (EFI_ERROR (Status)) {
         return Status;
       }
-    } else {
-      // Handle regions representing appends to the file
-      //
-      // Note: Since seeking past the end of the file with SetPosition() is
-      //  valid, it's possible there will be a gap between the current end of
-      //  the file and the beginning of the new region. Since the UEFI spec
-      //  says nothing about this case (except "a subsequent write would grow
-      //  the file"), we just leave garbage in the gap.
-
-      // Check if there is space to append the new region
-      HasSpace = FALSE;
-      NewDataSize = RegionEnd - FileStart;
-      NewFileSize = NewDataSize + sizeof (HW_IMAGE_DESCRIPTION);
-      CurrentPhysicalSize = BootMonFsGetPhysicalSize (File);
-      if (NewFileSize <= CurrentPhysicalSize) {
-        HasSpace = TRUE;
-      } else {
-        // Get the File Description for the next file
-        FileLink = GetNextNode (&Instance->RootFile->Link, &File->Link);
-        if (!IsNull (&Instance->RootFile->Link, FileLink)) {
-          NextFile = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
-
-          // If there is space between the beginning of the current file and the
-          // beginning of the next file then use it
-          EndOfAppendSpace = NextFile->HwDescription.BlockStart * BlockSize;
-        } else {
-          // We are flushing the last file.
-          EndOfAppendSpace = (Media->LastBlock + 1) * BlockSize;
-        }
-        if (EndOfAppendSpace - FileStart >= NewFileSize) {
-          HasSpace = TRUE;
-        }
+      if (ReservedBlocks != 0) {
+        // The current image is cleared once the file is at its new place
+        OldHwDescAddress = File->HwDescAddress;
       }
+    }
+  }
 
-      if (HasSpace == TRUE) {
-        // Invalidate the current image description of the file if any.
-        if (File->HwDescAddress != 0) {
-          Status = InvalidateImageDescription (File);
-          if (EFI_ERROR (Status)) {
-            return Status;
-          }
-        }
-
-        // Write the new file data
-        Status = DiskIo->WriteDisk (
-                    DiskIo,
-                    Media->MediaId,
-                    RegionStart,
-                    Region->Size,
-                    Region->Buffer
-                    );
-        if (EFI_ERROR (Status)) {
-          return Status;
-        }
+  //
+  // On NOR flash every partial block write makes the flash driver erase and
+  // program the whole block. Rather than writing the new description on its
+  // own after the data, it goes at the end of a single write with the tail of
+  // the data, padded with the erased value. The tail block of the file is then
+  // erased once per flush.
+  //
+  UpdateDescription =
+    (AsciiStrCmp (AsciiFileName, File->HwDescription.Footer.Filename) != 0) ||
+    (File->HwDescAddress == 0) ||
+    (Info->FileSize != File->HwDescription.Region[0].Size);
+
+  TailBuffer  = NULL;
+  TailStart   = 0;
+  CoverStart  = 0;
+  DescEnd     = 0;
+  Region      = NULL;
+  RegionStart = 0;
+  if (UpdateDescription) {
+    Status = BuildFileDescription (File, AsciiFileName, Info->FileSize, FileStart, &Description);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    DescEnd     = (UINT64)(Description.BlockEnd + 1) * BlockSize;
+    DescAddress = DescEnd - sizeof (HW_IMAGE_DESCRIPTION);
+
+    // The tail write starts at the beginning of the block of the description
+    // unless it holds file data. Data pending in the last extent is part of
+    // the tail write, data already on the media is left untouched.
+    TailStart  = MAX (DescEnd - BlockSize, FileStart + Info->FileSize);
+    CoverStart = TailStart;
+    if (!IsListEmpty (&File->RegionToFlushLink)) {
+      Region = (BOOTMON_FS_FILE_REGION*)GetPreviousNode (&File->RegionToFlushLink, &File->RegionToFlushLink);
+      RegionStart = FileStart + Region->Offset;
+      RegionEnd   = RegionStart + Region->Size;
+      if ((Region->Size != 0) && (RegionEnd == FileStart + Info->FileSize) &&
+          (RegionEnd > DescEnd - BlockSize)) {
+        TailStart  = MAX (DescEnd - BlockSize, RegionStart);
+        CoverStart = RegionStart;
+      }
+    }
 
-        Status = WriteFileDescription (File, AsciiFileName, NewDataSize, FileStart);
+    TailBuffer = AllocatePool ((UINTN)(DescEnd - TailStart));
+    if (TailBuffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    SetMem (TailBuffer, (UINTN)(DescEnd - TailStart), 0xFF);
+    if (TailStart < FileStart + Info->FileSize) {
+      CopyMem (TailBuffer,
+        (UINT8*)Region->Buffer + (TailStart - RegionStart),
+        (UINTN)(FileStart + Info->FileSize - TailStart));
+    }
+    CopyMem (TailBuffer + (DescAddress - TailStart), &Description, sizeof (HW_IMAGE_DESCRIPTION));
+
+    // The current description of the file has to be cleared if it is not at
+    // the same place and no data is going to be written over it.
+    if ((File->HwDescAddress != 0) && (File->HwDescAddress != DescAddress) &&
+        (OldHwDescAddress == 0)) {
+      OldSignatures = File->HwDescAddress +
+                      OFFSET_OF (HW_IMAGE_DESCRIPTION, Footer.FooterSignature1);
+      if (!BootMonFsIsRangeFlushed (File, FileStart, CoverStart, DescEnd,
+             OldSignatures, 2 * sizeof (UINT32))) {
+        Status = InvalidateImageDescription (File, File->HwDescAddress);
         if (EFI_ERROR (Status)) {
-          return Status;
+          goto Exit;
         }
-
-      } else {
-        // There isn't a space for the file.
-        // Options here are to move the file or fragment it. However as files
-        // may represent boot images at fixed positions, these options will
-        // break booting if the bootloader doesn't use BootMonFs to find the
-        // image.
-
-        return EFI_VOLUME_FULL;
       }
     }
   }
 
-  FreeFileRegions (File);
-  Info->PhysicalSize = BootMonFsGetPhysicalSize (File);
+  // The pending extents are sorted, disjoint and already merged by
+  // BootMonFsWriteFile(). Each one is programmed with a single write that
+  // DiskIo splits into whole blocks plus at most a partial block at each end.
+  for (RegionToFlushLink = GetFirstNode (&File->RegionToFlushLink);
+       !IsNull (&File->RegionToFlushLink, RegionToFlushLink);
+       RegionToFlushLink = GetNextNode (&File->RegionToFlushLink, RegionToFlushLink)
+       )
+  {
+    Region = (BOOTMON_FS_FILE_REGION*)RegionToFlushLink;
+    RegionStart = FileStart + Region->Offset;
+    RegionEnd   = RegionStart + Region->Size;
+    if (UpdateDescription) {
+      // Leave the part of the extent in the tail write to it
+      RegionEnd = MIN (RegionEnd, MAX (TailStart, RegionStart));
+    }
+    if (RegionEnd == RegionStart) {
+      continue;
+    }
 
-  if ((AsciiStrCmp (AsciiFileName, File->HwDescription.Footer.Filename) != 0) ||
-      (Info->FileSize != File->HwDescription.Region[0].Size)               ) {
-    Status = WriteFileDescription (File, AsciiFileName, Info->FileSize, FileStart);
+    Status = DiskIo->WriteDisk (
+                DiskIo,
+                Media->MediaId,
+                RegionStart,
+                (UINTN)(RegionEnd - RegionStart),
+                Region->Buffer
+                );
     if (EFI_ERROR (Status)) {
-      return Status;
+      goto Exit;
     }
   }
 
+  // The description is written last, an interrupted flush leaves no
+  // description pointing at data not written yet.
+  if (UpdateDescription) {
+    Status = DiskIo->WriteDisk (
+                DiskIo,
+                Media->MediaId,
+                TailStart,
+                (UINTN)(DescEnd - TailStart),
+                TailBuffer
+                );
+    if (EFI_ERROR (Status)) {
+      goto Exit;
+    }
+    CommitFileDescription (File, &Description);
+    ReservedBlocks = 0;
+  }
+
+  // The whole file is at its new place, its former image can go. If it
+  // cannot be cleared the file is flushed all the same, the next mount finds
+  // a stale copy of it.
+  if (OldHwDescAddress != 0) {
+    BootMonFsSortFile (File, File->HwDescription.BlockStart);
+    Status = InvalidateImageDescription (File, OldHwDescAddress);
+  }
+
+  FreeFileRegions (File);
+  Info->PhysicalSize = BootMonFsGetPhysicalSize (File);
+
   // Flush DiskIo Buffers (see UEFI Spec 12.7 - DiskIo buffers are flushed by
   // calling FlushBlocks on the same device's BlockIo).
   BlockIo->FlushBlocks (BlockIo);
+  Instance->IoStats.FlushCount++;
+  File->Dirty = FALSE;
 
-  return EFI_SUCCESS;
+Exit:
+  if (ReservedBlocks != 0) {
+    // The file was not written at its new place, it stays at the old one
+    BootMonFsFreeMapRelease (Instance, (UINTN)DivU64x32 (FileStart, BlockSize), ReservedBlocks);
+  }
+  if (TailBuffer != NULL) {
+    FreePool (TailBuffer);
+  }
+  return Status;
 }
 
 /**
@@ -463,6 +872,12 @@ BootMonFsCloseFile (
     This->Flush (This);
     FreePool (File->Info);
     File->Info = NULL;
+
+    // A closed file is known by the name on the media. They differ if the
+    // file was renamed but the flush failed or had nothing to write.
+    if (AsciiStrCmp (File->Name, File->HwDescription.Footer.Filename) != 0) {
+      BootMonFsIndexFile (File, File->HwDescription.Footer.Filename);
+    }
   }
 
   return EFI_SUCCESS;
@@ -678,6 +1093,10 @@ BootMonFsOpenFile (
         goto Error;
       }
       InsertHeadList (&Instance->RootFile->Link, &File->Link);
+      BootMonFsIndexFile (File, AsciiFileName);
+      Instance->DirCursor = NULL;
+      // The description of the new file is written when it is flushed
+      File->Dirty = TRUE;
       Info->Attribute = Attributes;
     } else {
       //
@@ -778,16 +1197,29 @@ BootMonFsDelete (
 
   // If (RegionCount is greater than 0) then the file already exists
   if (File->HwDescription.RegionCount > 0) {
+    Status = BootMonFsDropMountIndex (File->Instance);
+    if (EFI_ERROR (Status)) {
+      return EFI_WARN_DELETE_FAILURE;
+    }
+
     // Invalidate the last Block
-    Status = InvalidateImageDescription (File);
+    Status = InvalidateImageDescription (File, File->HwDescAddress);
     ASSERT_EFI_ERROR (Status);
     if (EFI_ERROR (Status)) {
       return  EFI_WARN_DELETE_FAILURE;
     }
+
+    BootMonFsFreeMapRelease (
+      File->Instance,
+      File->HwDescription.BlockStart,
+      File->HwDescription.BlockEnd - File->HwDescription.BlockStart + 1
+      );
   }
 
   // Remove the entry from the list
   RemoveEntryList (&File->Link);
+  BootMonFsUnindexFile (File);
+  File->Instance->DirCursor = NULL;
   FreePool (File->Info);
   FreePool (File);
 
@@ -20,9 +20,61 @@
 
 #include "BootMonFsInternal.h"
 
+/**
+  Copy the data of the regions not flushed yet over a buffer read from the
+  media.
+
+  @param[in]      File    Description of the open file.
+  @param[in]      Offset  Offset in the file of the data in Buffer.
+  @param[in]      Size    Size of Buffer.
+  @param[in out]  Buffer  Data of the file as read from the media.
+
+**/
+STATIC
+VOID
+BootMonFsOverlayRegions (
+  IN     BOOTMON_FS_FILE  *File,
+  IN     UINT64           Offset,
+  IN     UINTN            Size,
+  IN OUT UINT8            *Buffer
+  )
+{
+  LIST_ENTRY              *RegionList;
+  LIST_ENTRY              *Link;
+  BOOTMON_FS_FILE_REGION  *Region;
+  UINT64                  Start;
+  UINT64                  End;
+
+  RegionList = &File->RegionToFlushLink;
+  for (Link = GetFirstNode (RegionList);
+       !IsNull (RegionList, Link);
+       Link = GetNextNode (RegionList, Link)
+       )
+  {
+    Region = (BOOTMON_FS_FILE_REGION*)Link;
+    // The regions are sorted by offset
+    if (Region->Offset >= Offset + Size) {
+      break;
+    }
+
+    Start = MAX (Region->Offset, Offset);
+    End   = MIN (Region->Offset + Region->Size, Offset + Size);
+    if (Start < End) {
+      CopyMem (
+        Buffer + (Start - Offset),
+        (UINT8*)Region->Buffer + (Start - Region->Offset),
+        (UINTN)(End - Start)
+        );
+    }
+  }
+}
+
 /**
   Read data from an open file.
 
+  Data written to the file and not flushed yet are read from the memory
+  buffers they are held in, so reading does not force a flush.
+
   @param[in]      This        A pointer to the EFI_FILE_PROTOCOL instance that
                               is the file handle to read data from.
   @param[in out]  BufferSize  On input, the size of the Buffer. On output, the
@@ -53,6 +105,8 @@ BootMonFsReadFile (
   UINT64                FileStart;
   EFI_STATUS            Status;
   UINTN                 RemainingFileSize;
+  UINT64                OnMediaSize;
+  UINTN                 ReadSize;
 
   if ((This == NULL)       ||
       (BufferSize == NULL) ||
@@ -64,10 +118,6 @@ BootMonFsReadFile (
     return EFI_INVALID_PARAMETER;
   }
 
-  // Ensure the file has been written in Flash before reading it.
-  // This keeps the code simple and avoids having to manage a non-flushed file.
-  BootMonFsFlushFile (This);
-
   Instance  = File->Instance;
   DiskIo    = Instance->DiskIo;
   Media     = Instance->Media;
@@ -92,20 +142,222 @@ BootMonFsReadFile (
     *BufferSize = RemainingFileSize;
   }
 
-  Status = DiskIo->ReadDisk (
-                    DiskIo,
-                    Media->MediaId,
-                    FileStart + File->Position,
-                    *BufferSize,
-                    Buffer
-                    );
-  if (EFI_ERROR (Status)) {
-    *BufferSize = 0;
+  // Read what is on the media, the part of the file appended since the last
+  // flush that no pending write covers reads as zeros.
+  OnMediaSize = (File->HwDescription.RegionCount != 0) ?
+                File->HwDescription.Region[0].Size : 0;
+  ReadSize = 0;
+  if (File->Position < OnMediaSize) {
+    ReadSize = (UINTN)MIN (*BufferSize, OnMediaSize - File->Position);
+    Status = DiskIo->ReadDisk (
+                      DiskIo,
+                      Media->MediaId,
+                      FileStart + File->Position,
+                      ReadSize,
+                      Buffer
+                      );
+    if (EFI_ERROR (Status)) {
+      *BufferSize = 0;
+      return Status;
+    }
   }
+  if (ReadSize < *BufferSize) {
+    ZeroMem ((UINT8*)Buffer + ReadSize, *BufferSize - ReadSize);
+  }
+
+  BootMonFsOverlayRegions (File, File->Position, *BufferSize, Buffer);
 
   File->Position += *BufferSize;
 
-  return Status;
+  return EFI_SUCCESS;
+}
+
+/**
+  Merge data written to an open file into its list of regions to flush.
+
+  The regions overlapping or touching [Offset, Offset + Size) are merged with
+  the new data into a single region, the new data taking precedence. A region
+  grown at its end keeps spare capacity so a file written sequentially in
+  small chunks ends up in one buffer without copying it at every write.
+
+  @param[in]  File    Description of the open file.
+  @param[in]  Offset  Offset in the file of the data.
+  @param[in]  Size    Number of bytes to write.
+  @param[in]  Buffer  Data to write.
+
+  @retval  EFI_SUCCESS           The data was merged.
+  @retval  EFI_OUT_OF_RESOURCES  Unable to allocate the merged buffer. The
+                                 regions are left unchanged.
+
+**/
+STATIC
+EFI_STATUS
+BootMonFsMergeRegion (
+  IN BOOTMON_FS_FILE  *File,
+  IN UINT64           Offset,
+  IN UINTN            Size,
+  IN VOID             *Buffer
+  )
+{
+  LIST_ENTRY              *RegionList;
+  LIST_ENTRY              *Link;
+  LIST_ENTRY              *NextLink;
+  BOOTMON_FS_FILE_REGION  *Region;
+  BOOTMON_FS_FILE_REGION  *Merged;
+  UINT64                  Start;
+  UINT64                  End;
+  UINTN                   Capacity;
+  UINT8                   *NewBuffer;
+
+  RegionList = &File->RegionToFlushLink;
+
+  // Find the first region ending at or after the start of the new data
+  Region = NULL;
+  for (Link = GetFirstNode (RegionList);
+       !IsNull (RegionList, Link);
+       Link = GetNextNode (RegionList, Link)
+       )
+  {
+    Region = (BOOTMON_FS_FILE_REGION*)Link;
+    if (Region->Offset + Region->Size >= Offset) {
+      break;
+    }
+  }
+
+  if (IsNull (RegionList, Link) || (Region->Offset > Offset + Size)) {
+    // Nothing to merge with, insert a new region before Link
+    Region = (BOOTMON_FS_FILE_REGION*)AllocateZeroPool (sizeof (BOOTMON_FS_FILE_REGION));
+    if (Region == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Region->Buffer = AllocateCopyPool (Size, Buffer);
+    if (Region->Buffer == NULL) {
+      FreePool (Region);
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Region->Size     = Size;
+    Region->Capacity = Size;
+    Region->Offset   = Offset;
+    InsertTailList (Link, &Region->Link);
+    return EFI_SUCCESS;
+  }
+
+  // Compute the extent of the merged region
+  Start = MIN (Region->Offset, Offset);
+  End   = MAX (Region->Offset + Region->Size, Offset + Size);
+  for (Link = GetNextNode (RegionList, &Region->Link);
+       !IsNull (RegionList, Link);
+       Link = GetNextNode (RegionList, Link)
+       )
+  {
+    Merged = (BOOTMON_FS_FILE_REGION*)Link;
+    if (Merged->Offset > End) {
+      break;
+    }
+    End = MAX (End, Merged->Offset + Merged->Size);
+  }
+
+  if ((Start != Region->Offset) || (End - Start > Region->Capacity)) {
+    Capacity = (UINTN)(End - Start);
+    if ((Start == Region->Offset) && (Capacity < 2 * Region->Capacity)) {
+      Capacity = 2 * Region->Capacity;
+    }
+
+    NewBuffer = AllocatePool (Capacity);
+    if (NewBuffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    CopyMem (NewBuffer + (Region->Offset - Start), Region->Buffer, Region->Size);
+    FreePool (Region->Buffer);
+    Region->Buffer   = NewBuffer;
+    Region->Capacity = Capacity;
+    Region->Offset   = Start;
+  }
+
+  // Move the data of the following regions into the merged one
+  for (Link = GetNextNode (RegionList, &Region->Link);
+       !IsNull (RegionList, Link) && (((BOOTMON_FS_FILE_REGION*)Link)->Offset <= End);
+       Link = NextLink
+       )
+  {
+    NextLink = GetNextNode (RegionList, Link);
+    Merged = (BOOTMON_FS_FILE_REGION*)Link;
+    CopyMem (
+      (UINT8*)Region->Buffer + (Merged->Offset - Start),
+      Merged->Buffer,
+      Merged->Size
+      );
+    RemoveEntryList (Link);
+    FreePool (Merged->Buffer);
+    FreePool (Merged);
+  }
+
+  CopyMem ((UINT8*)Region->Buffer + (Offset - Start), Buffer, Size);
+  Region->Size = (UINTN)(End - Start);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Move the data of a file from the media into its list of regions to flush.
+
+  The image of the file on the media and its blocks in the free-extent map
+  are left untouched, the next flush can then write the whole file at
+  another place before the image is dropped.
+
+  @param[in]  File  Description of the open file.
+
+  @retval  EFI_SUCCESS           The data are in memory.
+  @retval  EFI_OUT_OF_RESOURCES  Not enough memory to hold the data.
+  @retval  EFI_DEVICE_ERROR      The data could not be read.
+
+**/
+EFI_STATUS
+BootMonFsLoadFileData (
+  IN BOOTMON_FS_FILE  *File
+  )
+{
+  EFI_STATUS            Status;
+  EFI_DISK_IO_PROTOCOL  *DiskIo;
+  EFI_BLOCK_IO_MEDIA    *Media;
+  UINT64                FileStart;
+  UINTN                 Size;
+  UINT8                 *Buffer;
+
+  if (File->HwDescription.RegionCount == 0) {
+    return EFI_SUCCESS;
+  }
+
+  DiskIo    = File->Instance->DiskIo;
+  Media     = File->Instance->Media;
+  FileStart = (Media->LowestAlignedLba + File->HwDescription.BlockStart) * Media->BlockSize;
+  Size      = File->HwDescription.Region[0].Size;
+
+  if (Size != 0) {
+    Buffer = AllocatePool (Size);
+    if (Buffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Status = DiskIo->ReadDisk (DiskIo, Media->MediaId, FileStart, Size, Buffer);
+    if (!EFI_ERROR (Status)) {
+      // The pending writes take precedence over the data on the media
+      BootMonFsOverlayRegions (File, 0, Size, Buffer);
+      Status = BootMonFsMergeRegion (File, 0, Size, Buffer);
+    }
+
+    FreePool (Buffer);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  File->Dirty = TRUE;
+
+  return EFI_SUCCESS;
 }
 
 /**
@@ -137,7 +389,7 @@ BootMonFsWriteFile (
   )
 {
   BOOTMON_FS_FILE         *File;
-  BOOTMON_FS_FILE_REGION  *Region;
+  EFI_STATUS              Status;
 
   if (This == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -151,26 +403,18 @@ BootMonFsWriteFile (
     return EFI_ACCESS_DENIED;
   }
 
-  // Allocate and initialize the memory region
-  Region = (BOOTMON_FS_FILE_REGION*)AllocateZeroPool (sizeof (BOOTMON_FS_FILE_REGION));
-  if (Region == NULL) {
-    *BufferSize = 0;
-    return EFI_OUT_OF_RESOURCES;
+  if (*BufferSize == 0) {
+    return EFI_SUCCESS;
   }
 
-  Region->Buffer = AllocateCopyPool (*BufferSize, Buffer);
-  if (Region->Buffer == NULL) {
+  Status = BootMonFsMergeRegion (File, File->Position, *BufferSize, Buffer);
+  if (EFI_ERROR (Status)) {
     *BufferSize = 0;
-    FreePool (Region);
-    return EFI_OUT_OF_RESOURCES;
+    return Status;
   }
 
-  Region->Size   = *BufferSize;
-  Region->Offset = File->Position;
-
-  InsertTailList (&File->RegionToFlushLink, &Region->Link);
-
   File->Position += *BufferSize;
+  File->Dirty = TRUE;
 
   if (File->Position > File->Info->FileSize) {
     File->Info->FileSize = File->Position;
@@ -0,0 +1,319 @@
+/** @file
+*
+*  Free-extent map of a BootMonFs volume.
+*
+*  The blocks of the volume not used by any image are kept as a list of free
+*  extents sorted by block number, coalesced and never touching. The map is
+*  built once when the volume is mounted and updated whenever the description
+*  of an image is written or invalidated, so the free space of the volume is
+*  known without walking the files.
+*
+*  Copyright (c) 2018, Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Library/BaseLib.h>
+
+#include "BootMonFsInternal.h"
+
+#define BOOTMON_FS_FREE_EXTENT_FROM_LINK(a) \
+  BASE_CR (a, BOOTMON_FS_FREE_EXTENT, Link)
+
+/**
+  Number of blocks used by an image, including the block holding its
+  description.
+
+  This matches the BlockEnd computed by BuildFileDescription().
+
+  @param[in]  Instance  Description of the volume.
+  @param[in]  FileSize  Size of the image data plus its description.
+
+  @return  Number of blocks.
+
+**/
+UINTN
+BootMonFsBlockCount (
+  IN BOOTMON_FS_INSTANCE  *Instance,
+  IN UINT64               FileSize
+  )
+{
+  return (UINTN)DivU64x32 (FileSize, Instance->Media->BlockSize) + 1;
+}
+
+/**
+  Mark a range of blocks as free.
+
+  If the map cannot grow the range is left out of it, the blocks are then
+  seen as used until the next mount, which is safe.
+
+  @param[in]  Instance    Description of the volume.
+  @param[in]  BlockStart  First block of the range.
+  @param[in]  BlockCount  Number of blocks of the range.
+
+**/
+VOID
+BootMonFsFreeMapRelease (
+  IN BOOTMON_FS_INSTANCE  *Instance,
+  IN UINTN                BlockStart,
+  IN UINTN                BlockCount
+  )
+{
+  LIST_ENTRY              *Link;
+  BOOTMON_FS_FREE_EXTENT  *Extent;
+  BOOTMON_FS_FREE_EXTENT  *Prev;
+  BOOTMON_FS_FREE_EXTENT  *Next;
+
+  if (BlockCount == 0) {
+    return;
+  }
+
+  // Find the first extent after the range
+  Next = NULL;
+  for (Link = GetFirstNode (&Instance->FreeExtents);
+       !IsNull (&Instance->FreeExtents, Link);
+       Link = GetNextNode (&Instance->FreeExtents, Link)
+       )
+  {
+    Next = BOOTMON_FS_FREE_EXTENT_FROM_LINK (Link);
+    if (Next->BlockStart >= BlockStart) {
+      break;
+    }
+  }
+  if (IsNull (&Instance->FreeExtents, Link)) {
+    Next = NULL;
+  }
+
+  Link = GetPreviousNode (&Instance->FreeExtents, Link);
+  Prev = IsNull (&Instance->FreeExtents, Link) ? NULL : BOOTMON_FS_FREE_EXTENT_FROM_LINK (Link);
+
+  ASSERT ((Prev == NULL) || (Prev->BlockStart + Prev->BlockCount <= BlockStart));
+  ASSERT ((Next == NULL) || (BlockStart + BlockCount <= Next->BlockStart));
+
+  Instance->FreeBlocks += BlockCount;
+
+  if ((Prev != NULL) && (Prev->BlockStart + Prev->BlockCount == BlockStart)) {
+    Prev->BlockCount += BlockCount;
+    if ((Next != NULL) && (Prev->BlockStart + Prev->BlockCount == Next->BlockStart)) {
+      Prev->BlockCount += Next->BlockCount;
+      RemoveEntryList (&Next->Link);
+      FreePool (Next);
+    }
+    return;
+  }
+
+  if ((Next != NULL) && (BlockStart + BlockCount == Next->BlockStart)) {
+    Next->BlockStart  = BlockStart;
+    Next->BlockCount += BlockCount;
+    return;
+  }
+
+  Extent = AllocatePool (sizeof (BOOTMON_FS_FREE_EXTENT));
+  if (Extent == NULL) {
+    Instance->FreeBlocks -= BlockCount;
+    return;
+  }
+
+  Extent->BlockStart = BlockStart;
+  Extent->BlockCount = BlockCount;
+  // Insert before Next, or at the tail if there is none
+  InsertTailList ((Next != NULL) ? &Next->Link : &Instance->FreeExtents, &Extent->Link);
+}
+
+/**
+  Mark a range of blocks as used.
+
+  Only the part of the range that is free is removed from the map. If an
+  extent has to be split and the map cannot grow, the end of the extent is
+  dropped from the map, it is then seen as used until the next mount.
+
+  @param[in]  Instance    Description of the volume.
+  @param[in]  BlockStart  First block of the range.
+  @param[in]  BlockCount  Number of blocks of the range.
+
+**/
+VOID
+BootMonFsFreeMapReserve (
+  IN BOOTMON_FS_INSTANCE  *Instance,
+  IN UINTN                BlockStart,
+  IN UINTN                BlockCount
+  )
+{
+  LIST_ENTRY              *Link;
+  LIST_ENTRY              *NextLink;
+  BOOTMON_FS_FREE_EXTENT  *Extent;
+  BOOTMON_FS_FREE_EXTENT  *Tail;
+  UINTN                   BlockEnd;
+  UINTN                   ExtentEnd;
+
+  BlockEnd = BlockStart + BlockCount;
+
+  for (Link = GetFirstNode (&Instance->FreeExtents);
+       !IsNull (&Instance->FreeExtents, Link);
+       Link = NextLink
+       )
+  {
+    NextLink = GetNextNode (&Instance->FreeExtents, Link);
+    Extent = BOOTMON_FS_FREE_EXTENT_FROM_LINK (Link);
+    ExtentEnd = Extent->BlockStart + Extent->BlockCount;
+
+    if (Extent->BlockStart >= BlockEnd) {
+      break;
+    }
+    if (ExtentEnd <= BlockStart) {
+      continue;
+    }
+
+    if ((Extent->BlockStart >= BlockStart) && (ExtentEnd <= BlockEnd)) {
+      // The whole extent is used
+      Instance->FreeBlocks -= Extent->BlockCount;
+      RemoveEntryList (Link);
+      FreePool (Extent);
+    } else if (Extent->BlockStart >= BlockStart) {
+      // The head of the extent is used
+      Instance->FreeBlocks -= BlockEnd - Extent->BlockStart;
+      Extent->BlockCount = ExtentEnd - BlockEnd;
+      Extent->BlockStart = BlockEnd;
+    } else if (ExtentEnd <= BlockEnd) {
+      // The tail of the extent is used
+      Instance->FreeBlocks -= ExtentEnd - BlockStart;
+      Extent->BlockCount = BlockStart - Extent->BlockStart;
+    } else {
+      // The range is in the middle of the extent
+      Instance->FreeBlocks -= ExtentEnd - BlockStart;
+      Extent->BlockCount = BlockStart - Extent->BlockStart;
+
+      Tail = AllocatePool (sizeof (BOOTMON_FS_FREE_EXTENT));
+      if (Tail != NULL) {
+        Tail->BlockStart = BlockEnd;
+        Tail->BlockCount = ExtentEnd - BlockEnd;
+        Instance->FreeBlocks += Tail->BlockCount;
+        InsertHeadList (Link, &Tail->Link);
+      }
+      break;
+    }
+  }
+}
+
+/**
+  Find the smallest free extent that can hold a range of blocks.
+
+  @param[in]   Instance    Description of the volume.
+  @param[in]   BlockCount  Number of blocks needed.
+  @param[out]  BlockStart  First block of the extent found.
+
+  @retval  EFI_SUCCESS      An extent was found.
+  @retval  EFI_VOLUME_FULL  No free extent is large enough.
+
+**/
+EFI_STATUS
+BootMonFsFreeMapFind (
+  IN  BOOTMON_FS_INSTANCE  *Instance,
+  IN  UINTN                BlockCount,
+  OUT UINTN                *BlockStart
+  )
+{
+  LIST_ENTRY              *Link;
+  BOOTMON_FS_FREE_EXTENT  *Extent;
+  BOOTMON_FS_FREE_EXTENT  *Best;
+
+  if (BlockCount > Instance->FreeBlocks) {
+    return EFI_VOLUME_FULL;
+  }
+
+  Best = NULL;
+  for (Link = GetFirstNode (&Instance->FreeExtents);
+       !IsNull (&Instance->FreeExtents, Link);
+       Link = GetNextNode (&Instance->FreeExtents, Link)
+       )
+  {
+    Extent = BOOTMON_FS_FREE_EXTENT_FROM_LINK (Link);
+    if ((Extent->BlockCount >= BlockCount) &&
+        ((Best == NULL) || (Extent->BlockCount < Best->BlockCount))) {
+      Best = Extent;
+      if (Best->BlockCount == BlockCount) {
+        break;
+      }
+    }
+  }
+
+  if (Best == NULL) {
+    return EFI_VOLUME_FULL;
+  }
+
+  *BlockStart = Best->BlockStart;
+  return EFI_SUCCESS;
+}
+
+/**
+  Free all the extents of the map.
+
+  @param[in]  Instance  Description of the volume.
+
+**/
+VOID
+BootMonFsFreeMapDestroy (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  )
+{
+  LIST_ENTRY  *Link;
+
+  while (!IsListEmpty (&Instance->FreeExtents)) {
+    Link = GetFirstNode (&Instance->FreeExtents);
+    RemoveEntryList (Link);
+    FreePool (BOOTMON_FS_FREE_EXTENT_FROM_LINK (Link));
+  }
+  Instance->FreeBlocks = 0;
+}
+
+/**
+  Build the free-extent map from the images found on the volume.
+
+  The list of files must be in disk order, as left by the mount scan.
+
+  @param[in]  Instance  Description of the volume.
+
+**/
+VOID
+BootMonFsBuildFreeMap (
+  IN BOOTMON_FS_INSTANCE  *Instance
+  )
+{
+  LIST_ENTRY       *FileLink;
+  BOOTMON_FS_FILE  *File;
+  UINTN            NextBlock;
+  UINTN            BlockCount;
+
+  BootMonFsFreeMapDestroy (Instance);
+
+  BlockCount = (UINTN)Instance->Media->LastBlock + 1;
+  NextBlock  = 0;
+  for (FileLink = GetFirstNode (&Instance->RootFile->Link);
+       !IsNull (&Instance->RootFile->Link, FileLink);
+       FileLink = GetNextNode (&Instance->RootFile->Link, FileLink)
+       )
+  {
+    File = BOOTMON_FS_FILE_FROM_LINK_THIS (FileLink);
+    if (File->HwDescription.RegionCount == 0) {
+      continue;
+    }
+
+    if (File->HwDescription.BlockStart > NextBlock) {
+      BootMonFsFreeMapRelease (Instance, NextBlock,
+        MIN (File->HwDescription.BlockStart, BlockCount) - NextBlock);
+    }
+    NextBlock = MAX (NextBlock, (UINTN)File->HwDescription.BlockEnd + 1);
+    if (NextBlock >= BlockCount) {
+      return;
+    }
+  }
+
+  BootMonFsFreeMapRelease (Instance, NextBlock, BlockCount - NextBlock);
+}
@@ -0,0 +1,50 @@
+/** @file
+*
+*  Host build counterpart of the AutoGen.h the EDK2 build generates for
+*  BootMonFs.inf: force-included in every source, it declares the GUIDs and
+*  PCDs of the module. The PCDs are plain variables, see HostLib.c, so a test
+*  can change them between two mounts.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __HOST_AUTOGEN_H__
+#define __HOST_AUTOGEN_H__
+
+#include <PiDxe.h>
+#include <Library/PcdLib.h>
+
+extern EFI_GUID gArmBootMonFsFileInfoGuid;
+extern EFI_GUID gArmBootMonFsFileMappingGuid;
+extern EFI_GUID gArmBootMonFsIoStatsGuid;
+extern EFI_GUID gArmBootMonFsMountIndexGuid;
+extern EFI_GUID gEfiEventReadyToBootGuid;
+extern EFI_GUID gEfiFileSystemInfoGuid;
+extern EFI_GUID gEfiFileInfoGuid;
+extern EFI_GUID gEfiFileSystemVolumeLabelInfoIdGuid;
+
+extern EFI_GUID gEfiDiskIoProtocolGuid;
+extern EFI_GUID gEfiBlockIoProtocolGuid;
+extern EFI_GUID gEfiSimpleFileSystemProtocolGuid;
+extern EFI_GUID gEfiDevicePathProtocolGuid;
+extern EFI_GUID gEfiDevicePathFromTextProtocolGuid;
+extern EFI_GUID gEfiDriverBindingProtocolGuid;
+
+#define PcdGetBool(TokenName)     HostPcd_##TokenName
+#define PcdGetPtr(TokenName)      HostPcd_##TokenName
+#define FeaturePcdGet(TokenName)  HostPcd_##TokenName
+#define FixedPcdGet32(TokenName)  HostPcd_##TokenName
+
+extern CHAR16   *HostPcd_PcdBootMonFsSupportedDevicePaths;
+extern BOOLEAN  HostPcd_PcdBootMonFsCompactOnFull;
+extern BOOLEAN  HostPcd_PcdBootMonFsMountIndex;
+extern BOOLEAN  HostPcd_PcdBootMonFsIoStats;
+
+#endif
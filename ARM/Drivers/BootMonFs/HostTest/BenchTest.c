@@ -0,0 +1,569 @@
+/** @file
+*
+*  Run a workload of the boot flow on a BootMonFs volume, once on an unmapped
+*  and once on a memory-mapped simulated NOR flash region, and report for
+*  each phase the flash operations it cost, the simulated time they take and
+*  the accesses the driver counted. The contents of the files are checked
+*  after each phase, and the counters of the driver must match the DiskIo
+*  accesses the region saw.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <stdio.h>
+
+#include "../BootMonFsInternal.h"
+
+#include "HostLib.h"
+#include "TestLib.h"
+
+#define BLOCK_SIZE         SIZE_64KB
+#define BLOCK_COUNT        48
+#define FILE_COUNT         7
+#define APPEND_FILE        6
+#define APPEND_CHUNK       SIZE_4KB
+#define APPEND_COUNT       16
+#define OVERWRITE_FILE     3
+#define OVERWRITE_CHUNK    SIZE_4KB
+#define OVERWRITE_COUNT    4
+#define GROW_FILE          0
+#define GROW_BLOCKS        30
+#define MAX_FILE_SIZE      (GROW_BLOCKS * BLOCK_SIZE)
+
+// Size of the data of a file taking Blocks blocks
+#define FILE_SIZE(Blocks, Index)  ((Blocks) * BLOCK_SIZE - SIZE_4KB - (Index) * 100)
+
+//
+// Blocks of the files as they are created, the odd ones are deleted before
+// "a" grows past the largest free extent, which compacts the volume.
+//
+STATIC CONST UINTN   mFileBlocks[FILE_COUNT] = { 2, 6, 3, 6, 3, 6, 2 };
+STATIC CONST CHAR16  *mFileNames[FILE_COUNT] = {
+  L"a.bin", L"b.bin", L"c.bin", L"d.bin", L"e.bin", L"f.bin", L"g.bin"
+};
+
+typedef struct {
+  CHAR16   *Name;
+  UINT8    *Data;
+  UINTN    Size;
+  BOOLEAN  Present;
+} BENCH_FILE;
+
+STATIC BENCH_FILE  mFiles[FILE_COUNT];
+STATIC UINTN       mFailures;
+
+STATIC
+VOID
+Fail (
+  IN CONST CHAR8  *Phase,
+  IN CONST CHAR8  *What,
+  IN UINTN        Index
+  )
+{
+  printf ("  %s: %s (file %u)\n", Phase, What, (UINT32)Index);
+  mFailures++;
+}
+
+/**
+  Clear the counters of the region and of the driver before a phase.
+**/
+STATIC
+VOID
+BeginPhase (
+  IN NOR_FLASH_SIM      *Flash,
+  IN EFI_FILE_PROTOCOL  *Root     OPTIONAL
+  )
+{
+  BOOTMON_FS_IO_STATS  IoStats;
+  EFI_STATUS           Status;
+
+  ZeroMem (&Flash->Stats, sizeof (Flash->Stats));
+  if (Root != NULL) {
+    ZeroMem (&IoStats, sizeof (IoStats));
+    IoStats.Size = sizeof (IoStats);
+    Status = Root->SetInfo (Root, &gArmBootMonFsIoStatsGuid, sizeof (IoStats), &IoStats);
+    if (EFI_ERROR (Status)) {
+      Fail ("stats", "SetInfo() failed", 0);
+    }
+  }
+}
+
+/**
+  Print the counters of a phase and check that the driver counted all the
+  DiskIo accesses the region saw. The driver does not use BlockIo to access
+  the media.
+**/
+STATIC
+VOID
+EndPhase (
+  IN CONST CHAR8        *Phase,
+  IN NOR_FLASH_SIM      *Flash,
+  IN EFI_FILE_PROTOCOL  *Root
+  )
+{
+  BOOTMON_FS_IO_STATS  IoStats;
+  EFI_STATUS           Status;
+  UINTN                Size;
+
+  Size = sizeof (IoStats);
+  Status = Root->GetInfo (Root, &gArmBootMonFsIoStatsGuid, &Size, &IoStats);
+  if (EFI_ERROR (Status)) {
+    Fail (Phase, "GetInfo() failed", 0);
+    ZeroMem (&IoStats, sizeof (IoStats));
+  }
+
+  printf ("  %-10s %6llu %9llu %6llu %9llu %9llu %6llu %10.1f | %7llu %6llu\n",
+    Phase,
+    (unsigned long long)Flash->Stats.ReadCount,
+    (unsigned long long)(Flash->Stats.ReadBytes / SIZE_1KB),
+    (unsigned long long)Flash->Stats.WriteCount,
+    (unsigned long long)(Flash->Stats.WriteBytes / SIZE_1KB),
+    (unsigned long long)(Flash->Stats.ProgrammedBytes / SIZE_1KB),
+    (unsigned long long)Flash->Stats.EraseCount,
+    (double)Flash->Stats.TimeNs / 1000000.0,
+    (unsigned long long)IoStats.BlocksWritten,
+    (unsigned long long)IoStats.PartialBlocksWritten);
+
+  if ((IoStats.ReadCount != Flash->Stats.ReadCount)   ||
+      (IoStats.ReadBytes != Flash->Stats.ReadBytes)   ||
+      (IoStats.WriteCount != Flash->Stats.WriteCount) ||
+      (IoStats.WriteBytes != Flash->Stats.WriteBytes)) {
+    Fail (Phase, "the driver counters differ from the flash ones", 0);
+  }
+}
+
+/**
+  Read the directory to its end, which mounts the volume if it is not yet.
+
+  @return The number of files in the directory.
+**/
+STATIC
+UINTN
+ListDirectory (
+  IN EFI_FILE_PROTOCOL  *Root
+  )
+{
+  UINT8       Buffer[SIZE_OF_EFI_FILE_INFO + MAX_NAME_LENGTH * sizeof (CHAR16)];
+  EFI_STATUS  Status;
+  UINTN       Size;
+  UINTN       Count;
+
+  Root->SetPosition (Root, 0);
+  Count = 0;
+  for (;;) {
+    Size = sizeof (Buffer);
+    Status = Root->Read (Root, &Size, Buffer);
+    if (EFI_ERROR (Status) || (Size == 0)) {
+      break;
+    }
+    Count++;
+  }
+  return Count;
+}
+
+STATIC
+VOID
+CheckFiles (
+  IN CONST CHAR8        *Phase,
+  IN EFI_FILE_PROTOCOL  *Root
+  )
+{
+  UINTN  Index;
+  UINTN  Count;
+
+  Count = 0;
+  for (Index = 0; Index < FILE_COUNT; Index++) {
+    if (!mFiles[Index].Present) {
+      continue;
+    }
+    Count++;
+    if (!TestCheckFile (Root, mFiles[Index].Name, mFiles[Index].Data, mFiles[Index].Size)) {
+      Fail (Phase, "wrong contents", Index);
+    }
+  }
+  if (ListDirectory (Root) != Count) {
+    Fail (Phase, "wrong number of files in the directory", 0);
+  }
+}
+
+/**
+  @return The number of free blocks of the volume.
+**/
+STATIC
+UINT64
+FreeBlockCount (
+  IN EFI_FILE_PROTOCOL  *Root
+  )
+{
+  UINT8                 Buffer[SIZE_OF_EFI_FILE_SYSTEM_INFO + MAX_NAME_LENGTH * sizeof (CHAR16)];
+  EFI_FILE_SYSTEM_INFO  *Info;
+  UINTN                 Size;
+
+  Info = (EFI_FILE_SYSTEM_INFO *)Buffer;
+  Size = sizeof (Buffer);
+  if (EFI_ERROR (Root->GetInfo (Root, &gEfiFileSystemInfoGuid, &Size, Info))) {
+    return 0;
+  }
+  return Info->FreeSpace / BLOCK_SIZE;
+}
+
+/**
+  Mount a region as a phase and check the files on it.
+
+  @param[out] ReadCount  Number of reads the mount took, optional.
+**/
+STATIC
+EFI_FILE_PROTOCOL *
+MountPhase (
+  IN  CONST CHAR8    *Phase,
+  IN  NOR_FLASH_SIM  *Flash,
+  OUT UINT64         *ReadCount  OPTIONAL
+  )
+{
+  EFI_FILE_PROTOCOL  *Root;
+
+  BeginPhase (Flash, NULL);
+  Root = TestMount (Flash);
+  if (Root == NULL) {
+    Fail (Phase, "the volume does not mount", 0);
+    return NULL;
+  }
+  ListDirectory (Root);
+  EndPhase (Phase, Flash, Root);
+  if (ReadCount != NULL) {
+    *ReadCount = Flash->Stats.ReadCount;
+  }
+  CheckFiles (Phase, Root);
+  return Root;
+}
+
+/**
+  Append chunks to a file, flushing it after each of them.
+**/
+STATIC
+VOID
+AppendPhase (
+  IN NOR_FLASH_SIM      *Flash,
+  IN EFI_FILE_PROTOCOL  *Root
+  )
+{
+  BENCH_FILE         *Bench;
+  EFI_FILE_PROTOCOL  *File;
+  EFI_STATUS         Status;
+  UINTN              Chunk;
+  UINTN              Size;
+
+  Bench = &mFiles[APPEND_FILE];
+  BeginPhase (Flash, Root);
+  Status = Root->Open (Root, &File, Bench->Name, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+  if (EFI_ERROR (Status)) {
+    Fail ("append", "Open() failed", APPEND_FILE);
+    return;
+  }
+  File->SetPosition (File, Bench->Size);
+  for (Chunk = 0; Chunk < APPEND_COUNT; Chunk++) {
+    TestFillPattern (Bench->Data + Bench->Size, APPEND_CHUNK, (UINT32)(1000 + Chunk));
+    Size = APPEND_CHUNK;
+    Status = File->Write (File, &Size, Bench->Data + Bench->Size);
+    if (!EFI_ERROR (Status)) {
+      Status = File->Flush (File);
+    }
+    if (EFI_ERROR (Status)) {
+      Fail ("append", "Write() or Flush() failed", APPEND_FILE);
+      break;
+    }
+    Bench->Size += APPEND_CHUNK;
+  }
+  File->Close (File);
+  EndPhase ("append", Flash, Root);
+  CheckFiles ("append", Root);
+}
+
+/**
+  Write over chunks spread across a file, then flush it once.
+**/
+STATIC
+VOID
+OverwritePhase (
+  IN NOR_FLASH_SIM      *Flash,
+  IN EFI_FILE_PROTOCOL  *Root
+  )
+{
+  BENCH_FILE         *Bench;
+  EFI_FILE_PROTOCOL  *File;
+  EFI_STATUS         Status;
+  UINTN              Chunk;
+  UINTN              Offset;
+  UINTN              Size;
+
+  Bench = &mFiles[OVERWRITE_FILE];
+  BeginPhase (Flash, Root);
+  Status = Root->Open (Root, &File, Bench->Name, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+  if (EFI_ERROR (Status)) {
+    Fail ("overwrite", "Open() failed", OVERWRITE_FILE);
+    return;
+  }
+  for (Chunk = 0; Chunk < OVERWRITE_COUNT; Chunk++) {
+    Offset = (Bench->Size - OVERWRITE_CHUNK) / OVERWRITE_COUNT * Chunk;
+    TestFillPattern (Bench->Data + Offset, OVERWRITE_CHUNK, (UINT32)(2000 + Chunk));
+    File->SetPosition (File, Offset);
+    Size = OVERWRITE_CHUNK;
+    Status = File->Write (File, &Size, Bench->Data + Offset);
+    if (EFI_ERROR (Status)) {
+      Fail ("overwrite", "Write() failed", OVERWRITE_FILE);
+      break;
+    }
+  }
+  if (EFI_ERROR (File->Flush (File))) {
+    Fail ("overwrite", "Flush() failed", OVERWRITE_FILE);
+  }
+  File->Close (File);
+  EndPhase ("overwrite", Flash, Root);
+  CheckFiles ("overwrite", Root);
+}
+
+/**
+  Run the workload on a new region.
+
+  @param[in]  Mapped  TRUE to describe the region as memory-mapped.
+**/
+STATIC
+VOID
+RunBench (
+  IN BOOLEAN  Mapped
+  )
+{
+  NOR_FLASH_SIM      *Flash;
+  EFI_FILE_PROTOCOL  *Root;
+  BENCH_FILE         *Bench;
+  EFI_STATUS         Status;
+  UINTN              Index;
+  UINT64             ReadCount;
+
+  printf ("%s region, %u blocks of %u KB\n", Mapped ? "memory-mapped" : "unmapped",
+    BLOCK_COUNT, BLOCK_SIZE / SIZE_1KB);
+  printf ("  %-10s %6s %9s %6s %9s %9s %6s %10s | %7s %6s\n", "phase", "reads", "read KB",
+    "writes", "write KB", "prog KB", "erases", "time ms", "blocks", "partial");
+
+  for (Index = 0; Index < FILE_COUNT; Index++) {
+    Bench = &mFiles[Index];
+    Bench->Name = (CHAR16 *)mFileNames[Index];
+    Bench->Data = AllocateZeroPool (MAX_FILE_SIZE);
+    ASSERT (Bench->Data != NULL);
+    Bench->Size = FILE_SIZE (mFileBlocks[Index], Index);
+    TestFillPattern (Bench->Data, Bench->Size, (UINT32)Index);
+    Bench->Present = FALSE;
+  }
+
+  Flash = NorFlashSimCreate (BLOCK_SIZE, BLOCK_COUNT, NULL, Mapped);
+  Root = MountPhase ("mount", Flash, NULL);
+  if (Root == NULL) {
+    goto Exit;
+  }
+
+  BeginPhase (Flash, Root);
+  for (Index = 0; Index < FILE_COUNT; Index++) {
+    Bench = &mFiles[Index];
+    Status = TestWriteFile (Root, Bench->Name, Bench->Data, Bench->Size);
+    if (EFI_ERROR (Status)) {
+      Fail ("create", "TestWriteFile() failed", Index);
+    }
+    Bench->Present = !EFI_ERROR (Status);
+  }
+  EndPhase ("create", Flash, Root);
+  CheckFiles ("create", Root);
+
+  AppendPhase (Flash, Root);
+  OverwritePhase (Flash, Root);
+
+  BeginPhase (Flash, Root);
+  CheckFiles ("read", Root);
+  EndPhase ("read", Flash, Root);
+
+  // Remount by scanning the media, then from the index saved at ReadyToBoot
+  TestUnmount (Flash);
+  HostPcd_PcdBootMonFsMountIndex = FALSE;
+  Root = MountPhase ("scan", Flash, NULL);
+  HostPcd_PcdBootMonFsMountIndex = TRUE;
+  if (Root == NULL) {
+    goto Exit;
+  }
+  HostSignalReadyToBoot ();
+  TestUnmount (Flash);
+  Root = MountPhase ("index", Flash, &ReadCount);
+  if (Root == NULL) {
+    goto Exit;
+  }
+  // Only the descriptions of the indexed images and the footers of the free
+  // blocks are read
+  if (!Mapped && (ReadCount > FILE_COUNT + FreeBlockCount (Root))) {
+    Fail ("index", "the volume was scanned", 0);
+  }
+
+  // Free extents of 6 blocks between the files and of 19 blocks after them
+  BeginPhase (Flash, Root);
+  for (Index = 1; Index < FILE_COUNT; Index += 2) {
+    if (EFI_ERROR (TestDeleteFile (Root, mFiles[Index].Name))) {
+      Fail ("delete", "TestDeleteFile() failed", Index);
+    }
+    mFiles[Index].Present = FALSE;
+  }
+  EndPhase ("delete", Flash, Root);
+  CheckFiles ("delete", Root);
+
+  Bench = &mFiles[GROW_FILE];
+  BeginPhase (Flash, Root);
+  Bench->Size = FILE_SIZE (GROW_BLOCKS, GROW_FILE);
+  TestFillPattern (Bench->Data, Bench->Size, 3000);
+  if (EFI_ERROR (TestWriteFile (Root, Bench->Name, Bench->Data, Bench->Size))) {
+    Fail ("compact", "TestWriteFile() failed", GROW_FILE);
+  }
+  EndPhase ("compact", Flash, Root);
+  CheckFiles ("compact", Root);
+
+  TestUnmount (Flash);
+  Root = MountPhase ("remount", Flash, NULL);
+  if (Root != NULL) {
+    TestUnmount (Flash);
+  }
+
+Exit:
+  NorFlashSimDestroy (Flash);
+  for (Index = 0; Index < FILE_COUNT; Index++) {
+    FreePool (mFiles[Index].Data);
+  }
+}
+
+/**
+  An image written to the free space of an indexed volume without going
+  through the driver, here with PcdBootMonFsMountIndex cleared so that the
+  saved index is left as it was, must be found at the next mount.
+**/
+STATIC
+VOID
+CheckExternalImage (
+  IN BOOLEAN  Mapped
+  )
+{
+  NOR_FLASH_SIM      *Flash;
+  EFI_FILE_PROTOCOL  *Root;
+  UINT8              Data[2][SIZE_4KB];
+  UINTN              Index;
+
+  for (Index = 0; Index < 2; Index++) {
+    TestFillPattern (Data[Index], sizeof (Data[Index]), (UINT32)(5000 + Index));
+  }
+
+  Flash = NorFlashSimCreate (BLOCK_SIZE, 8, NULL, Mapped);
+  Root = TestMount (Flash);
+  if ((Root == NULL) || EFI_ERROR (TestWriteFile (Root, L"a.bin", Data[0], sizeof (Data[0])))) {
+    Fail ("external", "the indexed image was not written", 0);
+    goto Exit;
+  }
+  HostSignalReadyToBoot ();
+  TestUnmount (Flash);
+
+  HostPcd_PcdBootMonFsMountIndex = FALSE;
+  Root = TestMount (Flash);
+  if ((Root == NULL) || EFI_ERROR (TestWriteFile (Root, L"b.bin", Data[1], sizeof (Data[1])))) {
+    Fail ("external", "the external image was not written", 0);
+  }
+  if (Root != NULL) {
+    TestUnmount (Flash);
+  }
+  HostPcd_PcdBootMonFsMountIndex = TRUE;
+
+  Root = TestMount (Flash);
+  if (Root == NULL) {
+    Fail ("external", "the volume does not mount", 0);
+    goto Exit;
+  }
+  for (Index = 0; Index < 2; Index++) {
+    if (!TestCheckFile (Root, (Index == 0) ? L"a.bin" : L"b.bin", Data[Index], sizeof (Data[Index]))) {
+      Fail ("external", "wrong contents", Index);
+    }
+  }
+  if (ListDirectory (Root) != 2) {
+    Fail ("external", "wrong number of files in the directory", 0);
+  }
+  TestUnmount (Flash);
+
+Exit:
+  NorFlashSimDestroy (Flash);
+}
+
+/**
+  Without PcdBootMonFsIoStats the driver must not count the accesses and
+  must reject the information type.
+**/
+STATIC
+VOID
+CheckStatsDisabled (
+  VOID
+  )
+{
+  NOR_FLASH_SIM        *Flash;
+  EFI_FILE_PROTOCOL    *Root;
+  BOOTMON_FS_IO_STATS  IoStats;
+  EFI_STATUS           Status;
+  UINTN                Size;
+  UINT8                Data[SIZE_4KB];
+
+  HostPcd_PcdBootMonFsIoStats = FALSE;
+  Flash = NorFlashSimCreate (BLOCK_SIZE, 4, NULL, FALSE);
+  Root = TestMount (Flash);
+  if (Root == NULL) {
+    Fail ("no stats", "the volume does not mount", 0);
+    NorFlashSimDestroy (Flash);
+    return;
+  }
+
+  TestFillPattern (Data, sizeof (Data), 4000);
+  if (EFI_ERROR (TestWriteFile (Root, L"a.bin", Data, sizeof (Data))) ||
+      !TestCheckFile (Root, L"a.bin", Data, sizeof (Data))) {
+    Fail ("no stats", "wrong contents", 0);
+  }
+
+  Size = sizeof (IoStats);
+  Status = Root->GetInfo (Root, &gArmBootMonFsIoStatsGuid, &Size, &IoStats);
+  if (Status != EFI_UNSUPPORTED) {
+    Fail ("no stats", "GetInfo() did not return EFI_UNSUPPORTED", 0);
+  }
+  Status = Root->SetInfo (Root, &gArmBootMonFsIoStatsGuid, sizeof (IoStats), &IoStats);
+  if (Status != EFI_UNSUPPORTED) {
+    Fail ("no stats", "SetInfo() did not return EFI_UNSUPPORTED", 0);
+  }
+
+  TestUnmount (Flash);
+  NorFlashSimDestroy (Flash);
+  HostPcd_PcdBootMonFsIoStats = TRUE;
+}
+
+int
+main (
+  int   argc,
+  char  **argv
+  )
+{
+  HostPcd_PcdBootMonFsIoStats = TRUE;
+  HostPcd_PcdBootMonFsMountIndex = TRUE;
+  HostPcd_PcdBootMonFsCompactOnFull = TRUE;
+  TestInitialize ();
+
+  mFailures = 0;
+  RunBench (FALSE);
+  RunBench (TRUE);
+  CheckExternalImage (FALSE);
+  CheckExternalImage (TRUE);
+  CheckStatsDisabled ();
+
+  printf ("%u failures\n", (UINT32)mFailures);
+  return (mFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+/** @file
+*
+*  Compare the BootMonFs checksums with the word by word algorithm the driver
+*  used before they were computed from a 64-bit sum, on random buffers and
+*  random image descriptions, including descriptions whose unused regions are
+*  not blank.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <stdio.h>
+
+#include "../BootMonFsInternal.h"
+
+#define BUFFER_ITERATIONS       20000
+#define DESCRIPTION_ITERATIONS  200000
+#define BUFFER_MAX_WORDS        300
+
+STATIC UINT64  mRandomState = 0x9E3779B97F4A7C15ULL;
+
+STATIC
+UINT32
+Random32 (
+  VOID
+  )
+{
+  // xorshift64*
+  mRandomState ^= mRandomState >> 12;
+  mRandomState ^= mRandomState << 25;
+  mRandomState ^= mRandomState >> 27;
+  return (UINT32)((mRandomState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+/**
+  Random word, biased towards the values where an end-around carry happens.
+**/
+STATIC
+UINT32
+RandomWord (
+  VOID
+  )
+{
+  switch (Random32 () % 8) {
+  case 0:
+    return 0;
+  case 1:
+    return 0xFFFFFFFF;
+  case 2:
+    return 0xFFFFFFFF - (Random32 () % 16);
+  default:
+    return Random32 ();
+  }
+}
+
+/**
+  BootMonFsChecksum() before it summed on 64 bits: one's complement sum with
+  the carry added back after every word.
+**/
+STATIC
+UINT32
+ReferenceChecksum (
+  IN CONST VOID  *Data,
+  IN UINT32      Size
+  )
+{
+  CONST UINT32  *Ptr;
+  UINT32        Word;
+  UINT32        Checksum;
+
+  Checksum = 0;
+  Ptr = Data;
+
+  while (Size > 0) {
+    Word = *Ptr++;
+    Size -= 4;
+
+    if (Word > ~Checksum) {
+      Checksum++;
+    }
+
+    Checksum += Word;
+  }
+
+  return ~Checksum;
+}
+
+/**
+  BootMonFsComputeFooterChecksum() before it summed the description in place:
+  checksum of a copy with Attributes set to 1 and with the FooterChecksum word
+  and every field of the unused regions cleared.
+**/
+STATIC
+UINT32
+ReferenceFooterChecksum (
+  IN CONST HW_IMAGE_DESCRIPTION  *Desc
+  )
+{
+  HW_IMAGE_DESCRIPTION  Description;
+  UINT32                Index;
+
+  CopyMem (&Description, Desc, sizeof (HW_IMAGE_DESCRIPTION));
+  Description.Attributes = 1;
+  Description.FooterChecksum = 0;
+
+  for (Index = Description.RegionCount; Index < HW_IMAGE_DESCRIPTION_REGION_MAX; Index++) {
+    Description.Region[Index].Checksum = 0;
+    Description.Region[Index].LoadAddress = 0;
+    Description.Region[Index].Offset = 0;
+    Description.Region[Index].Size = 0;
+  }
+
+  return ReferenceChecksum (&Description, sizeof (HW_IMAGE_DESCRIPTION));
+}
+
+STATIC
+VOID
+RandomDescription (
+  OUT HW_IMAGE_DESCRIPTION  *Desc
+  )
+{
+  UINT32  *Word;
+  UINTN   Index;
+
+  Word = (UINT32*)Desc;
+  for (Index = 0; Index < sizeof (HW_IMAGE_DESCRIPTION) / sizeof (UINT32); Index++) {
+    Word[Index] = RandomWord ();
+  }
+
+  // Mostly valid region counts, sometimes out of range ones.
+  Desc->RegionCount = Random32 () % (HW_IMAGE_DESCRIPTION_REGION_MAX + 3);
+}
+
+STATIC
+UINTN
+TestBufferChecksum (
+  VOID
+  )
+{
+  UINT32  Buffer[BUFFER_MAX_WORDS];
+  UINT32  Words;
+  UINTN   Iteration;
+  UINTN   Index;
+  UINTN   Failures;
+
+  Failures = 0;
+  for (Iteration = 0; Iteration < BUFFER_ITERATIONS; Iteration++) {
+    Words = Random32 () % (BUFFER_MAX_WORDS + 1);
+    for (Index = 0; Index < Words; Index++) {
+      Buffer[Index] = RandomWord ();
+    }
+
+    if (BootMonFsChecksum (Buffer, Words * 4) != ReferenceChecksum (Buffer, Words * 4)) {
+      if (Failures++ < 10) {
+        printf ("  buffer of %u words: 0x%08x, expected 0x%08x\n", Words,
+          BootMonFsChecksum (Buffer, Words * 4), ReferenceChecksum (Buffer, Words * 4));
+      }
+    }
+  }
+  return Failures;
+}
+
+STATIC
+UINTN
+TestFooterChecksum (
+  VOID
+  )
+{
+  HW_IMAGE_DESCRIPTION  Desc;
+  HW_IMAGE_DESCRIPTION  Copy;
+  UINTN                 Iteration;
+  UINTN                 Failures;
+
+  Failures = 0;
+  for (Iteration = 0; Iteration < DESCRIPTION_ITERATIONS; Iteration++) {
+    RandomDescription (&Desc);
+    CopyMem (&Copy, &Desc, sizeof (Desc));
+
+    if (BootMonFsFooterChecksum (&Desc) != ReferenceFooterChecksum (&Desc)) {
+      if (Failures++ < 10) {
+        printf ("  description with %u regions: 0x%08x, expected 0x%08x\n", Desc.RegionCount,
+          BootMonFsFooterChecksum (&Desc), ReferenceFooterChecksum (&Desc));
+      }
+    }
+
+    // The checksum is computed in place, the description must not change.
+    if (CompareMem (&Copy, &Desc, sizeof (Desc)) != 0) {
+      if (Failures++ < 10) {
+        printf ("  BootMonFsFooterChecksum() changed the description\n");
+      }
+    }
+  }
+  return Failures;
+}
+
+/**
+  A description sealed by BootMonFsComputeFooterChecksum() must carry the
+  checksum of the reference algorithm and be accepted at mount time.
+**/
+STATIC
+UINTN
+TestComputeFooterChecksum (
+  VOID
+  )
+{
+  HW_IMAGE_DESCRIPTION  Desc;
+  UINTN                 Iteration;
+  UINTN                 Failures;
+
+  Failures = 0;
+  for (Iteration = 0; Iteration < DESCRIPTION_ITERATIONS / 10; Iteration++) {
+    RandomDescription (&Desc);
+    Desc.BlockStart = Random32 () % 64;
+    Desc.BlockEnd = Desc.BlockStart + Random32 () % 64;
+    Desc.Footer.FooterSignature1 = HW_IMAGE_FOOTER_SIGNATURE_1;
+    Desc.Footer.FooterSignature2 = HW_IMAGE_FOOTER_SIGNATURE_2;
+    Desc.Footer.Version = HW_IMAGE_FOOTER_VERSION2;
+    Desc.Footer.Offset = HW_IMAGE_FOOTER_OFFSET2;
+
+    BootMonFsComputeFooterChecksum (&Desc);
+
+    if ((Desc.Attributes != 1) || (Desc.FooterChecksum != ReferenceFooterChecksum (&Desc)) ||
+        !BootMonFsIsImageValid (&Desc, Desc.BlockEnd)) {
+      if (Failures++ < 10) {
+        printf ("  sealed description with %u regions: 0x%08x, expected 0x%08x\n", Desc.RegionCount,
+          Desc.FooterChecksum, ReferenceFooterChecksum (&Desc));
+      }
+    }
+  }
+  return Failures;
+}
+
+int
+main (
+  int   argc,
+  char  **argv
+  )
+{
+  UINTN  Failures;
+  UINTN  Total;
+
+  Total = 0;
+
+  Failures = TestBufferChecksum ();
+  printf ("BootMonFsChecksum:              %u random buffers, %u failures\n", BUFFER_ITERATIONS, (UINT32)Failures);
+  Total += Failures;
+
+  Failures = TestFooterChecksum ();
+  printf ("BootMonFsFooterChecksum:        %u random descriptions, %u failures\n", DESCRIPTION_ITERATIONS, (UINT32)Failures);
+  Total += Failures;
+
+  Failures = TestComputeFooterChecksum ();
+  printf ("BootMonFsComputeFooterChecksum: %u sealed descriptions, %u failures\n", DESCRIPTION_ITERATIONS / 10, (UINT32)Failures);
+  Total += Failures;
+
+  return (Total == 0) ? 0 : 1;
+}
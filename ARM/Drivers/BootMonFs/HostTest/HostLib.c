@@ -0,0 +1,1423 @@
+/** @file
+*
+*  Host implementation of the library classes and services BootMonFs uses:
+*  lists, strings, memory, printing, device paths, a small protocol database
+*  standing for the boot services and a RAM variable store standing for the
+*  runtime services.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/NorFlashPlatformLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+#include <Protocol/DevicePathFromText.h>
+
+#include <Guid/FileInfo.h>
+#include <Guid/FileSystemInfo.h>
+#include <Guid/FileSystemVolumeLabelInfo.h>
+
+#include "HostLib.h"
+
+//
+// GUIDs, with the values of the package declarations
+//
+EFI_GUID gArmBootMonFsFileInfoGuid           = { 0x41e26b9c, 0xada6, 0x45b3, { 0x80, 0x8e, 0x23, 0x57, 0xa3, 0x5b, 0x60, 0xd6 } };
+EFI_GUID gArmBootMonFsFileMappingGuid        = { 0x5b8f3e21, 0x9c4d, 0x4a7b, { 0x8e, 0x16, 0xd2, 0xa9, 0x4f, 0x07, 0xc3, 0xb8 } };
+EFI_GUID gArmBootMonFsIoStatsGuid            = { 0xc1a7e5d3, 0x6b2f, 0x4e90, { 0x9d, 0x4a, 0x3f, 0x8b, 0x21, 0xe6, 0xa7, 0xc5 } };
+EFI_GUID gArmBootMonFsMountIndexGuid         = { 0x8e2d4c71, 0x35a9, 0x4f06, { 0xb8, 0x1c, 0x6d, 0x97, 0xe0, 0x42, 0xa5, 0x3f } };
+EFI_GUID gEfiEventReadyToBootGuid            = { 0x7ce88fb3, 0x4bd7, 0x4679, { 0x87, 0xa8, 0xa8, 0xd8, 0xde, 0xe5, 0x0d, 0x2b } };
+EFI_GUID gEfiFileSystemInfoGuid              = EFI_FILE_SYSTEM_INFO_ID;
+EFI_GUID gEfiFileInfoGuid                    = EFI_FILE_INFO_ID;
+EFI_GUID gEfiFileSystemVolumeLabelInfoIdGuid = EFI_FILE_SYSTEM_VOLUME_LABEL_ID;
+EFI_GUID gEfiDiskIoProtocolGuid              = { 0xce345171, 0xba0b, 0x11d2, { 0x8e, 0x4f, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiBlockIoProtocolGuid             = { 0x964e5b21, 0x6459, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiSimpleFileSystemProtocolGuid    = { 0x964e5b22, 0x6459, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiDevicePathProtocolGuid          = { 0x09576e91, 0x6d3f, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiDevicePathFromTextProtocolGuid  = { 0x05c99a21, 0xc70f, 0x4ad2, { 0x8a, 0x5f, 0x35, 0xdf, 0x33, 0x43, 0xf5, 0x1e } };
+EFI_GUID gEfiDriverBindingProtocolGuid       = { 0x18a031ab, 0xb443, 0x4d1a, { 0xa5, 0xc0, 0x0c, 0x09, 0x26, 0x1e, 0x9f, 0x71 } };
+
+//
+// PCDs, with their default values in BootMonFs.dec
+//
+CHAR16   *HostPcd_PcdBootMonFsSupportedDevicePaths = L"";
+BOOLEAN  HostPcd_PcdBootMonFsCompactOnFull = FALSE;
+BOOLEAN  HostPcd_PcdBootMonFsMountIndex = FALSE;
+BOOLEAN  HostPcd_PcdBootMonFsIoStats = FALSE;
+
+BOOLEAN  HostDebugEnabled = FALSE;
+
+//
+// Debug
+//
+
+STATIC CONST CHAR8 *mStatusString[] = {
+  "Success",
+  "Load Error",
+  "Invalid Parameter",
+  "Unsupported",
+  "Bad Buffer Size",
+  "Buffer Too Small",
+  "Not Ready",
+  "Device Error",
+  "Write Protected",
+  "Out of Resources",
+  "Volume Corrupt",
+  "Volume Full",
+  "No Media",
+  "Media changed",
+  "Not Found",
+  "Access Denied"
+};
+
+/**
+  Format a string the way PrintLib does, for the subset of the syntax used
+  by the driver: the flags '-' and '0', a width, 'l' and the types a, s, c,
+  d, u, x, X, p, r, g and %.
+**/
+UINTN
+EFIAPI
+AsciiVSPrint (
+  OUT CHAR8        *StartOfBuffer,
+  IN  UINTN        BufferSize,
+  IN  CONST CHAR8  *FormatString,
+  IN  VA_LIST      Marker
+  )
+{
+  CHAR8         Item[64];
+  CONST CHAR8   *Text;
+  CONST CHAR16  *Wide;
+  CHAR8         Spec[16];
+  UINTN         Length;
+  UINTN         Out;
+  UINTN         Width;
+  BOOLEAN       Left;
+  BOOLEAN       Zero;
+  BOOLEAN       Long;
+  EFI_STATUS    Status;
+  EFI_GUID      *Guid;
+  UINTN         Index;
+
+  Out = 0;
+  while (*FormatString != '\0') {
+    if (*FormatString != '%') {
+      if (Out + 1 < BufferSize) {
+        StartOfBuffer[Out] = *FormatString;
+      }
+      Out++;
+      FormatString++;
+      continue;
+    }
+
+    FormatString++;
+    Left = FALSE;
+    Zero = FALSE;
+    Long = FALSE;
+    Width = 0;
+    for (;; FormatString++) {
+      if (*FormatString == '-') {
+        Left = TRUE;
+      } else if (*FormatString == '0' && Width == 0) {
+        Zero = TRUE;
+      } else if (*FormatString >= '0' && *FormatString <= '9') {
+        Width = Width * 10 + (*FormatString - '0');
+      } else if (*FormatString == '*') {
+        Width = VA_ARG (Marker, UINTN);
+      } else if (*FormatString == 'l' || *FormatString == 'L') {
+        Long = TRUE;
+      } else {
+        break;
+      }
+    }
+
+    Text = Item;
+    switch (*FormatString) {
+    case 'a':
+      Text = VA_ARG (Marker, CHAR8 *);
+      if (Text == NULL) {
+        Text = "<null string>";
+      }
+      break;
+    case 's':
+    case 'S':
+      Wide = VA_ARG (Marker, CHAR16 *);
+      if (Wide == NULL) {
+        Text = "<null string>";
+        break;
+      }
+      for (Index = 0; Index < sizeof (Item) - 1 && Wide[Index] != 0; Index++) {
+        Item[Index] = (CHAR8)Wide[Index];
+      }
+      Item[Index] = '\0';
+      break;
+    case 'c':
+      Item[0] = (CHAR8)VA_ARG (Marker, UINTN);
+      Item[1] = '\0';
+      break;
+    case 'd':
+    case 'u':
+    case 'x':
+    case 'X':
+      snprintf (Spec, sizeof (Spec), "%%%s%s%c", Zero ? "0" : "", "*ll", *FormatString == 'd' ? 'd' : *FormatString);
+      if (*FormatString == 'd') {
+        snprintf (Item, sizeof (Item), Spec, (int)Width, Long ? VA_ARG (Marker, long long) : (long long)VA_ARG (Marker, int));
+      } else {
+        snprintf (Item, sizeof (Item), Spec, (int)Width, Long ? VA_ARG (Marker, unsigned long long) : (unsigned long long)VA_ARG (Marker, unsigned int));
+      }
+      Width = 0;
+      break;
+    case 'p':
+      snprintf (Item, sizeof (Item), "%p", VA_ARG (Marker, VOID *));
+      break;
+    case 'r':
+      Status = VA_ARG (Marker, EFI_STATUS);
+      if (Status == EFI_SUCCESS) {
+        Text = mStatusString[0];
+      } else if (EFI_ERROR (Status) && (Status & ~MAX_BIT) < ARRAY_SIZE (mStatusString)) {
+        Text = mStatusString[Status & ~MAX_BIT];
+      } else {
+        snprintf (Item, sizeof (Item), "%s status 0x%llx", EFI_ERROR (Status) ? "Error" : "Warning", (unsigned long long)Status);
+      }
+      break;
+    case 'g':
+      Guid = VA_ARG (Marker, EFI_GUID *);
+      snprintf (Item, sizeof (Item), "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+        Guid->Data1, Guid->Data2, Guid->Data3, Guid->Data4[0], Guid->Data4[1], Guid->Data4[2],
+        Guid->Data4[3], Guid->Data4[4], Guid->Data4[5], Guid->Data4[6], Guid->Data4[7]);
+      break;
+    case '%':
+      Item[0] = '%';
+      Item[1] = '\0';
+      break;
+    default:
+      Item[0] = '\0';
+      FormatString--;
+      break;
+    }
+    FormatString++;
+
+    Length = strlen (Text);
+    for (; !Left && Width > Length; Width--) {
+      if (Out + 1 < BufferSize) {
+        StartOfBuffer[Out] = ' ';
+      }
+      Out++;
+    }
+    for (Index = 0; Index < Length; Index++, Out++) {
+      if (Out + 1 < BufferSize) {
+        StartOfBuffer[Out] = Text[Index];
+      }
+    }
+    for (; Width > Length; Width--, Out++) {
+      if (Out + 1 < BufferSize) {
+        StartOfBuffer[Out] = ' ';
+      }
+    }
+  }
+
+  if (BufferSize > 0) {
+    StartOfBuffer[MIN (Out, BufferSize - 1)] = '\0';
+  }
+  return MIN (Out, BufferSize > 0 ? BufferSize - 1 : 0);
+}
+
+UINTN
+EFIAPI
+AsciiSPrint (
+  OUT CHAR8        *StartOfBuffer,
+  IN  UINTN        BufferSize,
+  IN  CONST CHAR8  *FormatString,
+  ...
+  )
+{
+  VA_LIST  Marker;
+  UINTN    Length;
+
+  VA_START (Marker, FormatString);
+  Length = AsciiVSPrint (StartOfBuffer, BufferSize, FormatString, Marker);
+  VA_END (Marker);
+  return Length;
+}
+
+UINTN
+EFIAPI
+UnicodeSPrint (
+  OUT CHAR16        *StartOfBuffer,
+  IN  UINTN         BufferSize,
+  IN  CONST CHAR16  *FormatString,
+  ...
+  )
+{
+  CHAR8    Format[256];
+  CHAR8    *Buffer;
+  VA_LIST  Marker;
+  UINTN    Length;
+  UINTN    Index;
+
+  for (Index = 0; Index < sizeof (Format) - 1 && FormatString[Index] != 0; Index++) {
+    Format[Index] = (CHAR8)FormatString[Index];
+  }
+  Format[Index] = '\0';
+
+  Buffer = malloc (BufferSize / sizeof (CHAR16));
+  ASSERT (Buffer != NULL);
+
+  VA_START (Marker, FormatString);
+  Length = AsciiVSPrint (Buffer, BufferSize / sizeof (CHAR16), Format, Marker);
+  VA_END (Marker);
+
+  for (Index = 0; Index <= Length; Index++) {
+    StartOfBuffer[Index] = (UINT8)Buffer[Index];
+  }
+  free (Buffer);
+  return Length;
+}
+
+VOID
+HostDebugPrint (
+  IN UINTN        ErrorLevel,
+  IN CONST CHAR8  *Format,
+  ...
+  )
+{
+  CHAR8    Buffer[512];
+  VA_LIST  Marker;
+
+  if (!HostDebugEnabled || ((ErrorLevel & DEBUG_ERROR) == 0)) {
+    return;
+  }
+
+  VA_START (Marker, Format);
+  AsciiVSPrint (Buffer, sizeof (Buffer), Format, Marker);
+  VA_END (Marker);
+  fputs (Buffer, stderr);
+}
+
+VOID
+HostAssert (
+  IN CONST CHAR8  *FileName,
+  IN UINTN        LineNumber,
+  IN CONST CHAR8  *Description
+  )
+{
+  fprintf (stderr, "ASSERT %s(%lu): %s\n", FileName, (unsigned long)LineNumber, Description);
+  abort ();
+}
+
+//
+// Memory
+//
+
+VOID *
+EFIAPI
+AllocatePool (
+  IN UINTN  AllocationSize
+  )
+{
+  return malloc (AllocationSize == 0 ? 1 : AllocationSize);
+}
+
+VOID *
+EFIAPI
+AllocateZeroPool (
+  IN UINTN  AllocationSize
+  )
+{
+  return calloc (1, AllocationSize == 0 ? 1 : AllocationSize);
+}
+
+VOID *
+EFIAPI
+AllocateCopyPool (
+  IN UINTN       AllocationSize,
+  IN CONST VOID  *Buffer
+  )
+{
+  VOID  *Memory;
+
+  Memory = AllocatePool (AllocationSize);
+  if (Memory != NULL) {
+    memcpy (Memory, Buffer, AllocationSize);
+  }
+  return Memory;
+}
+
+VOID *
+EFIAPI
+ReallocatePool (
+  IN UINTN  OldSize,
+  IN UINTN  NewSize,
+  IN VOID   *OldBuffer  OPTIONAL
+  )
+{
+  VOID  *NewBuffer;
+
+  NewBuffer = AllocateZeroPool (NewSize);
+  if (NewBuffer != NULL && OldBuffer != NULL) {
+    memcpy (NewBuffer, OldBuffer, MIN (OldSize, NewSize));
+    free (OldBuffer);
+  }
+  return NewBuffer;
+}
+
+VOID
+EFIAPI
+FreePool (
+  IN VOID  *Buffer
+  )
+{
+  ASSERT (Buffer != NULL);
+  free (Buffer);
+}
+
+//
+// Lists
+//
+
+LIST_ENTRY *
+EFIAPI
+InitializeListHead (
+  IN OUT LIST_ENTRY  *ListHead
+  )
+{
+  ListHead->ForwardLink = ListHead;
+  ListHead->BackLink = ListHead;
+  return ListHead;
+}
+
+LIST_ENTRY *
+EFIAPI
+InsertHeadList (
+  IN OUT LIST_ENTRY  *ListHead,
+  IN OUT LIST_ENTRY  *Entry
+  )
+{
+  Entry->ForwardLink = ListHead->ForwardLink;
+  Entry->BackLink = ListHead;
+  Entry->ForwardLink->BackLink = Entry;
+  ListHead->ForwardLink = Entry;
+  return ListHead;
+}
+
+LIST_ENTRY *
+EFIAPI
+InsertTailList (
+  IN OUT LIST_ENTRY  *ListHead,
+  IN OUT LIST_ENTRY  *Entry
+  )
+{
+  Entry->ForwardLink = ListHead;
+  Entry->BackLink = ListHead->BackLink;
+  Entry->BackLink->ForwardLink = Entry;
+  ListHead->BackLink = Entry;
+  return ListHead;
+}
+
+LIST_ENTRY *
+EFIAPI
+GetFirstNode (
+  IN CONST LIST_ENTRY  *List
+  )
+{
+  return List->ForwardLink;
+}
+
+LIST_ENTRY *
+EFIAPI
+GetNextNode (
+  IN CONST LIST_ENTRY  *List,
+  IN CONST LIST_ENTRY  *Node
+  )
+{
+  return Node->ForwardLink;
+}
+
+LIST_ENTRY *
+EFIAPI
+GetPreviousNode (
+  IN CONST LIST_ENTRY  *List,
+  IN CONST LIST_ENTRY  *Node
+  )
+{
+  return Node->BackLink;
+}
+
+BOOLEAN
+EFIAPI
+IsListEmpty (
+  IN CONST LIST_ENTRY  *ListHead
+  )
+{
+  return (BOOLEAN)(ListHead->ForwardLink == ListHead);
+}
+
+BOOLEAN
+EFIAPI
+IsNull (
+  IN CONST LIST_ENTRY  *List,
+  IN CONST LIST_ENTRY  *Node
+  )
+{
+  return (BOOLEAN)(Node == List);
+}
+
+BOOLEAN
+EFIAPI
+IsNodeAtEnd (
+  IN CONST LIST_ENTRY  *List,
+  IN CONST LIST_ENTRY  *Node
+  )
+{
+  return (BOOLEAN)(!IsNull (List, Node) && List->BackLink == Node);
+}
+
+LIST_ENTRY *
+EFIAPI
+RemoveEntryList (
+  IN CONST LIST_ENTRY  *Entry
+  )
+{
+  ASSERT (!IsListEmpty (Entry));
+
+  Entry->ForwardLink->BackLink = Entry->BackLink;
+  Entry->BackLink->ForwardLink = Entry->ForwardLink;
+  return Entry->ForwardLink;
+}
+
+//
+// Strings
+//
+
+UINTN
+EFIAPI
+StrLen (
+  IN CONST CHAR16  *String
+  )
+{
+  UINTN  Length;
+
+  for (Length = 0; String[Length] != 0; Length++) {
+  }
+  return Length;
+}
+
+UINTN
+EFIAPI
+StrSize (
+  IN CONST CHAR16  *String
+  )
+{
+  return (StrLen (String) + 1) * sizeof (CHAR16);
+}
+
+INTN
+EFIAPI
+StrCmp (
+  IN CONST CHAR16  *FirstString,
+  IN CONST CHAR16  *SecondString
+  )
+{
+  while (*FirstString != 0 && *FirstString == *SecondString) {
+    FirstString++;
+    SecondString++;
+  }
+  return *FirstString - *SecondString;
+}
+
+INTN
+EFIAPI
+StrnCmp (
+  IN CONST CHAR16  *FirstString,
+  IN CONST CHAR16  *SecondString,
+  IN UINTN         Length
+  )
+{
+  if (Length == 0) {
+    return 0;
+  }
+  while (*FirstString != 0 && *FirstString == *SecondString && Length > 1) {
+    FirstString++;
+    SecondString++;
+    Length--;
+  }
+  return *FirstString - *SecondString;
+}
+
+CHAR16 *
+EFIAPI
+StrStr (
+  IN CONST CHAR16  *String,
+  IN CONST CHAR16  *SearchString
+  )
+{
+  UINTN  Length;
+
+  Length = StrLen (SearchString);
+  for (; *String != 0; String++) {
+    if (StrnCmp (String, SearchString, Length) == 0) {
+      return (CHAR16 *)String;
+    }
+  }
+  return (Length == 0) ? (CHAR16 *)String : NULL;
+}
+
+RETURN_STATUS
+EFIAPI
+StrCpyS (
+  OUT CHAR16       *Destination,
+  IN  UINTN        DestMax,
+  IN  CONST CHAR16 *Source
+  )
+{
+  if (StrLen (Source) >= DestMax) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  memcpy (Destination, Source, StrSize (Source));
+  return EFI_SUCCESS;
+}
+
+UINTN
+EFIAPI
+AsciiStrLen (
+  IN CONST CHAR8  *String
+  )
+{
+  return strlen (String);
+}
+
+UINTN
+EFIAPI
+AsciiStrSize (
+  IN CONST CHAR8  *String
+  )
+{
+  return strlen (String) + 1;
+}
+
+INTN
+EFIAPI
+AsciiStrCmp (
+  IN CONST CHAR8  *FirstString,
+  IN CONST CHAR8  *SecondString
+  )
+{
+  return strcmp (FirstString, SecondString);
+}
+
+RETURN_STATUS
+EFIAPI
+AsciiStrCpyS (
+  OUT CHAR8        *Destination,
+  IN  UINTN        DestMax,
+  IN  CONST CHAR8  *Source
+  )
+{
+  if (strlen (Source) >= DestMax) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  strcpy (Destination, Source);
+  return EFI_SUCCESS;
+}
+
+RETURN_STATUS
+EFIAPI
+AsciiStrnCpyS (
+  OUT CHAR8        *Destination,
+  IN  UINTN        DestMax,
+  IN  CONST CHAR8  *Source,
+  IN  UINTN        Length
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Length && Source[Index] != '\0'; Index++) {
+    if (Index + 1 >= DestMax) {
+      return EFI_BUFFER_TOO_SMALL;
+    }
+    Destination[Index] = Source[Index];
+  }
+  Destination[Index] = '\0';
+  return EFI_SUCCESS;
+}
+
+RETURN_STATUS
+EFIAPI
+AsciiStrToUnicodeStrS (
+  IN  CONST CHAR8  *Source,
+  OUT CHAR16       *Destination,
+  IN  UINTN        DestMax
+  )
+{
+  UINTN  Index;
+
+  if (strlen (Source) >= DestMax) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  for (Index = 0; Source[Index] != '\0'; Index++) {
+    Destination[Index] = (UINT8)Source[Index];
+  }
+  Destination[Index] = 0;
+  return EFI_SUCCESS;
+}
+
+RETURN_STATUS
+EFIAPI
+UnicodeStrToAsciiStrS (
+  IN  CONST CHAR16  *Source,
+  OUT CHAR8         *Destination,
+  IN  UINTN         DestMax
+  )
+{
+  UINTN  Index;
+
+  if (StrLen (Source) >= DestMax) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  for (Index = 0; Source[Index] != 0; Index++) {
+    if (Source[Index] > 0x7F) {
+      return EFI_INVALID_PARAMETER;
+    }
+    Destination[Index] = (CHAR8)Source[Index];
+  }
+  Destination[Index] = '\0';
+  return EFI_SUCCESS;
+}
+
+/**
+  Remove the "." and ".." components of a '\' separated path, as the
+  BaseLib version does.
+**/
+CHAR16 *
+EFIAPI
+PathCleanUpDirectories (
+  IN CHAR16  *Path
+  )
+{
+  CHAR16  *In;
+  CHAR16  *Out;
+  CHAR16  *Start;
+
+  In = Path;
+  Out = Path;
+  while (*In != 0) {
+    if (In[0] == L'\\' && In[1] == L'.' && (In[2] == L'\\' || In[2] == 0)) {
+      In += 2;
+      continue;
+    }
+    if (In[0] == L'\\' && In[1] == L'.' && In[2] == L'.' && (In[3] == L'\\' || In[3] == 0)) {
+      In += 3;
+      for (Start = Out; Start > Path && *(Start - 1) != L'\\'; Start--) {
+      }
+      Out = (Start > Path) ? Start - 1 : Path;
+      continue;
+    }
+    *Out++ = *In++;
+  }
+  *Out = 0;
+  if (*Path == 0) {
+    Path[0] = L'\\';
+    Path[1] = 0;
+  }
+  return Path;
+}
+
+UINT64
+EFIAPI
+MultU64x32 (
+  IN UINT64  Multiplicand,
+  IN UINT32  Multiplier
+  )
+{
+  return Multiplicand * Multiplier;
+}
+
+UINT64
+EFIAPI
+DivU64x32 (
+  IN UINT64  Dividend,
+  IN UINT32  Divisor
+  )
+{
+  return Dividend / Divisor;
+}
+
+UINT32
+EFIAPI
+ModU64x32 (
+  IN UINT64  Dividend,
+  IN UINT32  Divisor
+  )
+{
+  return (UINT32)(Dividend % Divisor);
+}
+
+UINT32
+EFIAPI
+CalculateCrc32 (
+  IN VOID   *Buffer,
+  IN UINTN  Length
+  )
+{
+  UINT32  Crc;
+  UINT8   *Ptr;
+  UINTN   Bit;
+
+  Crc = 0xFFFFFFFF;
+  for (Ptr = Buffer; Length > 0; Length--, Ptr++) {
+    Crc ^= *Ptr;
+    for (Bit = 0; Bit < 8; Bit++) {
+      Crc = (Crc >> 1) ^ ((Crc & 1) ? 0xEDB88320 : 0);
+    }
+  }
+  return ~Crc;
+}
+
+//
+// Device paths
+//
+
+UINT8
+EFIAPI
+DevicePathType (
+  IN CONST VOID  *Node
+  )
+{
+  return ((CONST EFI_DEVICE_PATH_PROTOCOL *)Node)->Type;
+}
+
+UINT8
+EFIAPI
+DevicePathSubType (
+  IN CONST VOID  *Node
+  )
+{
+  return ((CONST EFI_DEVICE_PATH_PROTOCOL *)Node)->SubType;
+}
+
+UINTN
+EFIAPI
+DevicePathNodeLength (
+  IN CONST VOID  *Node
+  )
+{
+  CONST UINT8  *Length;
+
+  Length = ((CONST EFI_DEVICE_PATH_PROTOCOL *)Node)->Length;
+  return Length[0] | (Length[1] << 8);
+}
+
+EFI_DEVICE_PATH_PROTOCOL *
+EFIAPI
+NextDevicePathNode (
+  IN CONST VOID  *Node
+  )
+{
+  return (EFI_DEVICE_PATH_PROTOCOL *)((UINT8 *)Node + DevicePathNodeLength (Node));
+}
+
+BOOLEAN
+EFIAPI
+IsDevicePathEndType (
+  IN CONST VOID  *Node
+  )
+{
+  return (BOOLEAN)(DevicePathType (Node) == END_DEVICE_PATH_TYPE);
+}
+
+BOOLEAN
+EFIAPI
+IsDevicePathEnd (
+  IN CONST VOID  *Node
+  )
+{
+  return (BOOLEAN)(IsDevicePathEndType (Node) &&
+                   DevicePathSubType (Node) == END_ENTIRE_DEVICE_PATH_SUBTYPE);
+}
+
+UINTN
+EFIAPI
+GetDevicePathSize (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath
+  )
+{
+  CONST EFI_DEVICE_PATH_PROTOCOL  *Node;
+
+  if (DevicePath == NULL) {
+    return 0;
+  }
+  for (Node = DevicePath; !IsDevicePathEnd (Node); Node = NextDevicePathNode (Node)) {
+  }
+  return ((UINT8 *)Node - (UINT8 *)DevicePath) + DevicePathNodeLength (Node);
+}
+
+EFI_DEVICE_PATH_PROTOCOL *
+EFIAPI
+AppendDevicePathInstance (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath         OPTIONAL,
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePathInstance OPTIONAL
+  )
+{
+  UINT8   *NewPath;
+  UINTN   Size;
+  UINTN   InstanceSize;
+
+  if (DevicePath == NULL) {
+    return AllocateCopyPool (GetDevicePathSize (DevicePathInstance), DevicePathInstance);
+  }
+  if (DevicePathInstance == NULL) {
+    return NULL;
+  }
+
+  Size = GetDevicePathSize (DevicePath);
+  InstanceSize = GetDevicePathSize (DevicePathInstance);
+  NewPath = AllocatePool (Size + InstanceSize);
+  ASSERT (NewPath != NULL);
+
+  CopyMem (NewPath, DevicePath, Size);
+  // The end node of the first path becomes an end of instance node.
+  NewPath[Size - 4 + 1] = END_INSTANCE_DEVICE_PATH_SUBTYPE;
+  CopyMem (NewPath + Size, DevicePathInstance, InstanceSize);
+  return (EFI_DEVICE_PATH_PROTOCOL *)NewPath;
+}
+
+EFI_DEVICE_PATH_PROTOCOL *
+EFIAPI
+GetNextDevicePathInstance (
+  IN OUT EFI_DEVICE_PATH_PROTOCOL  **DevicePath,
+  OUT UINTN                        *Size
+  )
+{
+  EFI_DEVICE_PATH_PROTOCOL  *Node;
+  EFI_DEVICE_PATH_PROTOCOL  *Instance;
+
+  if (*DevicePath == NULL) {
+    *Size = 0;
+    return NULL;
+  }
+
+  for (Node = *DevicePath; !IsDevicePathEndType (Node); Node = NextDevicePathNode (Node)) {
+  }
+
+  *Size = ((UINT8 *)Node - (UINT8 *)*DevicePath) + sizeof (EFI_DEVICE_PATH_PROTOCOL);
+  Instance = AllocateCopyPool (*Size, *DevicePath);
+  ASSERT (Instance != NULL);
+  ((EFI_DEVICE_PATH_PROTOCOL *)((UINT8 *)Instance + *Size - sizeof (EFI_DEVICE_PATH_PROTOCOL)))->SubType =
+    END_ENTIRE_DEVICE_PATH_SUBTYPE;
+
+  if (DevicePathSubType (Node) == END_ENTIRE_DEVICE_PATH_SUBTYPE) {
+    *DevicePath = NULL;
+  } else {
+    *DevicePath = NextDevicePathNode (Node);
+  }
+  return Instance;
+}
+
+EFI_DEVICE_PATH_PROTOCOL *
+HostVendorDevicePath (
+  IN CONST EFI_GUID  *Guid
+  )
+{
+  struct {
+    VENDOR_DEVICE_PATH        Vendor;
+    EFI_DEVICE_PATH_PROTOCOL  End;
+  } __attribute__ ((packed)) *Path;
+
+  Path = AllocateZeroPool (sizeof (*Path));
+  ASSERT (Path != NULL);
+
+  Path->Vendor.Header.Type = HARDWARE_DEVICE_PATH;
+  Path->Vendor.Header.SubType = HW_VENDOR_DP;
+  Path->Vendor.Header.Length[0] = sizeof (VENDOR_DEVICE_PATH);
+  CopyMem (&Path->Vendor.Guid, Guid, sizeof (EFI_GUID));
+  Path->End.Type = END_DEVICE_PATH_TYPE;
+  Path->End.SubType = END_ENTIRE_DEVICE_PATH_SUBTYPE;
+  Path->End.Length[0] = sizeof (EFI_DEVICE_PATH_PROTOCOL);
+  return (EFI_DEVICE_PATH_PROTOCOL *)Path;
+}
+
+/**
+  ConvertTextToDevicePath() of the host, it only knows the VenHw(GUID) node,
+  the only one the NOR flash regions use.
+**/
+STATIC
+EFI_DEVICE_PATH_PROTOCOL *
+EFIAPI
+HostConvertTextToDevicePath (
+  IN CONST CHAR16  *TextDevicePath
+  )
+{
+  CHAR8          Text[64];
+  EFI_GUID       Guid;
+  unsigned int   Field[11];
+  UINTN          Index;
+
+  if (UnicodeStrToAsciiStrS (TextDevicePath, Text, sizeof (Text)) != EFI_SUCCESS) {
+    return NULL;
+  }
+  if (sscanf (Text, "VenHw(%8x-%4x-%4x-%2x%2x-%2x%2x%2x%2x%2x%2x)",
+        &Field[0], &Field[1], &Field[2], &Field[3], &Field[4], &Field[5],
+        &Field[6], &Field[7], &Field[8], &Field[9], &Field[10]) != 11) {
+    return NULL;
+  }
+
+  Guid.Data1 = Field[0];
+  Guid.Data2 = (UINT16)Field[1];
+  Guid.Data3 = (UINT16)Field[2];
+  for (Index = 0; Index < 8; Index++) {
+    Guid.Data4[Index] = (UINT8)Field[3 + Index];
+  }
+  return HostVendorDevicePath (&Guid);
+}
+
+STATIC EFI_DEVICE_PATH_FROM_TEXT_PROTOCOL mDevicePathFromText = {
+  NULL,
+  HostConvertTextToDevicePath
+};
+
+//
+// NOR flash platform library, the devices are registered by the test
+//
+
+NOR_FLASH_DESCRIPTION  *HostNorFlashDevices = NULL;
+UINT32                 HostNorFlashDeviceCount = 0;
+
+EFI_STATUS
+NorFlashPlatformInitialization (
+  VOID
+  )
+{
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+NorFlashPlatformGetDevices (
+  OUT NOR_FLASH_DESCRIPTION   **NorFlashDescriptions,
+  OUT UINT32                  *Count
+  )
+{
+  if (HostNorFlashDeviceCount == 0) {
+    return EFI_NOT_FOUND;
+  }
+  *NorFlashDescriptions = HostNorFlashDevices;
+  *Count = HostNorFlashDeviceCount;
+  return EFI_SUCCESS;
+}
+
+//
+// Boot services: a protocol database of HOST_HANDLE
+//
+
+#define HOST_HANDLE_PROTOCOLS  8
+
+typedef struct {
+  EFI_GUID  *Guid;
+  VOID      *Interface;
+  UINTN     OpenByDriver;
+} HOST_PROTOCOL;
+
+typedef struct _HOST_HANDLE  HOST_HANDLE;
+struct _HOST_HANDLE {
+  HOST_HANDLE    *Next;
+  HOST_PROTOCOL  Protocol[HOST_HANDLE_PROTOCOLS];
+};
+
+STATIC HOST_HANDLE  *mHandles = NULL;
+
+STATIC
+HOST_PROTOCOL *
+HostFindProtocol (
+  IN EFI_HANDLE  Handle,
+  IN EFI_GUID    *Guid
+  )
+{
+  HOST_HANDLE  *Entry;
+  UINTN        Index;
+
+  for (Entry = mHandles; Entry != NULL; Entry = Entry->Next) {
+    if (Entry != Handle) {
+      continue;
+    }
+    for (Index = 0; Index < HOST_HANDLE_PROTOCOLS; Index++) {
+      if (Entry->Protocol[Index].Guid != NULL && CompareGuid (Entry->Protocol[Index].Guid, Guid)) {
+        return &Entry->Protocol[Index];
+      }
+    }
+  }
+  return NULL;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostOpenProtocol (
+  IN  EFI_HANDLE  Handle,
+  IN  EFI_GUID    *Protocol,
+  OUT VOID        **Interface OPTIONAL,
+  IN  EFI_HANDLE  AgentHandle,
+  IN  EFI_HANDLE  ControllerHandle,
+  IN  UINT32      Attributes
+  )
+{
+  HOST_PROTOCOL  *Entry;
+
+  Entry = HostFindProtocol (Handle, Protocol);
+  if (Entry == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+  if ((Attributes & EFI_OPEN_PROTOCOL_BY_DRIVER) != 0) {
+    if (Entry->OpenByDriver != 0) {
+      return EFI_ACCESS_DENIED;
+    }
+    Entry->OpenByDriver++;
+  }
+  if (Interface != NULL) {
+    *Interface = Entry->Interface;
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostCloseProtocol (
+  IN EFI_HANDLE  Handle,
+  IN EFI_GUID    *Protocol,
+  IN EFI_HANDLE  AgentHandle,
+  IN EFI_HANDLE  ControllerHandle
+  )
+{
+  HOST_PROTOCOL  *Entry;
+
+  Entry = HostFindProtocol (Handle, Protocol);
+  if (Entry == NULL || Entry->OpenByDriver == 0) {
+    return EFI_NOT_FOUND;
+  }
+  Entry->OpenByDriver--;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostLocateProtocol (
+  IN  EFI_GUID  *Protocol,
+  IN  VOID      *Registration OPTIONAL,
+  OUT VOID      **Interface
+  )
+{
+  HOST_HANDLE  *Entry;
+  UINTN        Index;
+
+  if (CompareGuid (Protocol, &gEfiDevicePathFromTextProtocolGuid)) {
+    *Interface = &mDevicePathFromText;
+    return EFI_SUCCESS;
+  }
+
+  for (Entry = mHandles; Entry != NULL; Entry = Entry->Next) {
+    for (Index = 0; Index < HOST_HANDLE_PROTOCOLS; Index++) {
+      if (Entry->Protocol[Index].Guid != NULL && CompareGuid (Entry->Protocol[Index].Guid, Protocol)) {
+        *Interface = Entry->Protocol[Index].Interface;
+        return EFI_SUCCESS;
+      }
+    }
+  }
+  return EFI_NOT_FOUND;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostInstallMultipleProtocolInterfaces (
+  IN OUT EFI_HANDLE  *Handle,
+  ...
+  )
+{
+  HOST_HANDLE  *Entry;
+  EFI_GUID     *Guid;
+  VOID         *Interface;
+  VA_LIST      Marker;
+  UINTN        Index;
+
+  if (*Handle == NULL) {
+    Entry = AllocateZeroPool (sizeof (HOST_HANDLE));
+    ASSERT (Entry != NULL);
+    Entry->Next = mHandles;
+    mHandles = Entry;
+    *Handle = Entry;
+  }
+  Entry = *Handle;
+
+  VA_START (Marker, Handle);
+  for (Guid = VA_ARG (Marker, EFI_GUID *); Guid != NULL; Guid = VA_ARG (Marker, EFI_GUID *)) {
+    Interface = VA_ARG (Marker, VOID *);
+    if (HostFindProtocol (Entry, Guid) != NULL) {
+      VA_END (Marker);
+      return EFI_INVALID_PARAMETER;
+    }
+    for (Index = 0; Index < HOST_HANDLE_PROTOCOLS && Entry->Protocol[Index].Guid != NULL; Index++) {
+    }
+    ASSERT (Index < HOST_HANDLE_PROTOCOLS);
+    Entry->Protocol[Index].Guid = Guid;
+    Entry->Protocol[Index].Interface = Interface;
+    Entry->Protocol[Index].OpenByDriver = 0;
+  }
+  VA_END (Marker);
+  return EFI_SUCCESS;
+}
+
+/**
+  The protocols are looked up by interface on every handle, the driver passes
+  the address of the handle rather than the handle to this service.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+HostUninstallMultipleProtocolInterfaces (
+  IN EFI_HANDLE  Handle,
+  ...
+  )
+{
+  HOST_HANDLE  *Entry;
+  EFI_GUID     *Guid;
+  VOID         *Interface;
+  VA_LIST      Marker;
+  UINTN        Index;
+  EFI_STATUS   Status;
+
+  Status = EFI_SUCCESS;
+  VA_START (Marker, Handle);
+  for (Guid = VA_ARG (Marker, EFI_GUID *); Guid != NULL; Guid = VA_ARG (Marker, EFI_GUID *)) {
+    Interface = VA_ARG (Marker, VOID *);
+    Status = EFI_NOT_FOUND;
+    for (Entry = mHandles; Entry != NULL && Status != EFI_SUCCESS; Entry = Entry->Next) {
+      for (Index = 0; Index < HOST_HANDLE_PROTOCOLS; Index++) {
+        if (Entry->Protocol[Index].Guid != NULL &&
+            CompareGuid (Entry->Protocol[Index].Guid, Guid) &&
+            Entry->Protocol[Index].Interface == Interface) {
+          Entry->Protocol[Index].Guid = NULL;
+          Status = EFI_SUCCESS;
+          break;
+        }
+      }
+    }
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+  VA_END (Marker);
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostCalculateCrc32 (
+  IN  VOID    *Data,
+  IN  UINTN   DataSize,
+  OUT UINT32  *Crc32
+  )
+{
+  *Crc32 = CalculateCrc32 (Data, DataSize);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_TPL
+EFIAPI
+HostRaiseTpl (
+  IN EFI_TPL  NewTpl
+  )
+{
+  return TPL_APPLICATION;
+}
+
+STATIC
+VOID
+EFIAPI
+HostRestoreTpl (
+  IN EFI_TPL  OldTpl
+  )
+{
+}
+
+STATIC EFI_BOOT_SERVICES mBootServices = {
+  HostOpenProtocol,
+  HostCloseProtocol,
+  HostLocateProtocol,
+  HostInstallMultipleProtocolInterfaces,
+  HostUninstallMultipleProtocolInterfaces,
+  HostCalculateCrc32,
+  HostRaiseTpl,
+  HostRestoreTpl
+};
+
+//
+// Runtime services: a RAM variable store
+//
+
+typedef struct _HOST_VARIABLE  HOST_VARIABLE;
+struct _HOST_VARIABLE {
+  HOST_VARIABLE  *Next;
+  CHAR16         *Name;
+  EFI_GUID       Guid;
+  UINT32         Attributes;
+  UINTN          DataSize;
+  VOID           *Data;
+};
+
+STATIC HOST_VARIABLE  *mVariables = NULL;
+
+STATIC
+HOST_VARIABLE **
+HostFindVariable (
+  IN CHAR16    *Name,
+  IN EFI_GUID  *Guid
+  )
+{
+  HOST_VARIABLE  **Link;
+
+  for (Link = &mVariables; *Link != NULL; Link = &(*Link)->Next) {
+    if (StrCmp ((*Link)->Name, Name) == 0 && CompareGuid (&(*Link)->Guid, Guid)) {
+      break;
+    }
+  }
+  return Link;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostGetVariable (
+  IN     CHAR16    *VariableName,
+  IN     EFI_GUID  *VendorGuid,
+  OUT    UINT32    *Attributes OPTIONAL,
+  IN OUT UINTN     *DataSize,
+  OUT    VOID      *Data OPTIONAL
+  )
+{
+  HOST_VARIABLE  *Variable;
+
+  Variable = *HostFindVariable (VariableName, VendorGuid);
+  if (Variable == NULL) {
+    return EFI_NOT_FOUND;
+  }
+  if (*DataSize < Variable->DataSize) {
+    *DataSize = Variable->DataSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  if (Attributes != NULL) {
+    *Attributes = Variable->Attributes;
+  }
+  *DataSize = Variable->DataSize;
+  CopyMem (Data, Variable->Data, Variable->DataSize);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostSetVariable (
+  IN CHAR16    *VariableName,
+  IN EFI_GUID  *VendorGuid,
+  IN UINT32    Attributes,
+  IN UINTN     DataSize,
+  IN VOID      *Data
+  )
+{
+  HOST_VARIABLE  **Link;
+  HOST_VARIABLE  *Variable;
+
+  Link = HostFindVariable (VariableName, VendorGuid);
+  Variable = *Link;
+
+  if (DataSize == 0 || Attributes == 0) {
+    if (Variable == NULL) {
+      return EFI_NOT_FOUND;
+    }
+    *Link = Variable->Next;
+    FreePool (Variable->Name);
+    FreePool (Variable->Data);
+    FreePool (Variable);
+    return EFI_SUCCESS;
+  }
+
+  if (Variable == NULL) {
+    Variable = AllocateZeroPool (sizeof (HOST_VARIABLE));
+    ASSERT (Variable != NULL);
+    Variable->Name = AllocateCopyPool (StrSize (VariableName), VariableName);
+    CopyMem (&Variable->Guid, VendorGuid, sizeof (EFI_GUID));
+    *Link = Variable;
+  } else {
+    FreePool (Variable->Data);
+  }
+  Variable->Attributes = Attributes;
+  Variable->DataSize = DataSize;
+  Variable->Data = AllocateCopyPool (DataSize, Data);
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_RUNTIME_SERVICES mRuntimeServices = {
+  HostGetVariable,
+  HostSetVariable
+};
+
+STATIC EFI_SYSTEM_TABLE mSystemTable = {
+  &mBootServices,
+  &mRuntimeServices
+};
+
+EFI_HANDLE            gImageHandle = (EFI_HANDLE)&mSystemTable;
+EFI_SYSTEM_TABLE      *gST = &mSystemTable;
+EFI_BOOT_SERVICES     *gBS = &mBootServices;
+EFI_RUNTIME_SERVICES  *gRT = &mRuntimeServices;
+
+//
+// ReadyToBoot
+//
+
+STATIC EFI_EVENT_NOTIFY  mReadyToBootNotify = NULL;
+STATIC VOID              *mReadyToBootContext = NULL;
+
+EFI_STATUS
+EFIAPI
+EfiCreateEventReadyToBootEx (
+  IN  EFI_TPL           NotifyTpl,
+  IN  EFI_EVENT_NOTIFY  NotifyFunction  OPTIONAL,
+  IN  VOID              *NotifyContext  OPTIONAL,
+  OUT EFI_EVENT         *ReadyToBootEvent
+  )
+{
+  mReadyToBootNotify = NotifyFunction;
+  mReadyToBootContext = NotifyContext;
+  *ReadyToBootEvent = (EFI_EVENT)&mReadyToBootNotify;
+  return EFI_SUCCESS;
+}
+
+VOID
+HostSignalReadyToBoot (
+  VOID
+  )
+{
+  if (mReadyToBootNotify != NULL) {
+    mReadyToBootNotify ((EFI_EVENT)&mReadyToBootNotify, mReadyToBootContext);
+  }
+}
@@ -0,0 +1,48 @@
+/** @file
+*
+*  Services of the host environment a test uses to set up and drive the
+*  BootMonFs sources, see HostLib.c.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __HOST_LIB_H__
+#define __HOST_LIB_H__
+
+#include <Library/NorFlashPlatformLib.h>
+#include <Protocol/DevicePath.h>
+
+// Devices returned by NorFlashPlatformGetDevices(), none by default.
+extern NOR_FLASH_DESCRIPTION  *HostNorFlashDevices;
+extern UINT32                 HostNorFlashDeviceCount;
+
+/**
+  Build a device path made of a hardware vendor node, the device path the
+  NOR flash driver gives to each of its regions.
+
+  @param[in]  Guid    The vendor GUID.
+
+  @return The device path, to be freed with FreePool().
+**/
+EFI_DEVICE_PATH_PROTOCOL *
+HostVendorDevicePath (
+  IN CONST EFI_GUID  *Guid
+  );
+
+/**
+  Call the notification function registered with
+  EfiCreateEventReadyToBootEx(), if any.
+**/
+VOID
+HostSignalReadyToBoot (
+  VOID
+  );
+
+#endif
@@ -0,0 +1,394 @@
+/** @file
+*
+*  RAM backed simulation of a NOR flash region. The region is exposed as the
+*  NOR flash driver exposes it, through BlockIo and DiskIo protocols on a
+*  handle carrying a VenHw() device path, so the BootMonFs driver binds to it
+*  as it does on the platform.
+*
+*  The flash can only clear bits when it is programmed, setting them back
+*  takes the erase of a whole block. Every operation is counted and costs a
+*  simulated time, so the tests can compare the cost of the driver's accesses
+*  to the media. A test can also cut the power after a given number of writes
+*  to check what the driver leaves on the media when it is interrupted.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include "HostLib.h"
+#include "NorFlashSim.h"
+
+EFI_GUID gNorFlashSimGuid       = { 0x2ac4d9b0, 0x57e3, 0x4b1e, { 0x9a, 0x64, 0x13, 0xc8, 0x7f, 0x0e, 0xb2, 0x5d } };
+EFI_GUID gNorFlashSimMappedGuid = { 0x6f0b3e85, 0xc1d2, 0x4a97, { 0xb3, 0x58, 0xe4, 0x2a, 0x90, 0x7c, 0x16, 0xdb } };
+
+#define NOR_FLASH_SIM_FROM_BLOCK_IO(a)  BASE_CR (a, NOR_FLASH_SIM, BlockIo)
+#define NOR_FLASH_SIM_FROM_DISK_IO(a)   BASE_CR (a, NOR_FLASH_SIM, DiskIo)
+
+#define WORDS(Size)  (((UINT64)(Size) + 3) / 4)
+
+STATIC NOR_FLASH_DESCRIPTION  mMappedRegion;
+
+STATIC
+EFI_STATUS
+NorFlashSimRead (
+  IN  NOR_FLASH_SIM  *Flash,
+  IN  UINT64         Offset,
+  IN  UINTN          Size,
+  OUT VOID           *Buffer
+  )
+{
+  if ((Offset > Flash->Size) || (Size > Flash->Size - Offset)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Flash->Stats.ReadCount++;
+  Flash->Stats.ReadBytes += Size;
+  Flash->Stats.TimeNs += WORDS (Size) * Flash->Timing.ReadWordNs;
+
+  CopyMem (Buffer, Flash->Memory + Offset, Size);
+  return EFI_SUCCESS;
+}
+
+/**
+  Program a range of a block, the bits can only go from 1 to 0.
+**/
+STATIC
+VOID
+NorFlashSimProgram (
+  IN NOR_FLASH_SIM  *Flash,
+  IN UINT64         Offset,
+  IN UINTN          Size,
+  IN CONST UINT8    *Data
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Size; Index++) {
+    Flash->Memory[Offset + Index] &= Data[Index];
+  }
+
+  Flash->Stats.ProgrammedBytes += Size;
+  Flash->Stats.TimeNs += WORDS (Size) * Flash->Timing.ProgramWordNs;
+}
+
+STATIC
+VOID
+NorFlashSimErase (
+  IN NOR_FLASH_SIM  *Flash,
+  IN EFI_LBA        Lba
+  )
+{
+  SetMem (Flash->Memory + Lba * Flash->Media.BlockSize, Flash->Media.BlockSize, 0xFF);
+
+  Flash->Stats.EraseCount++;
+  Flash->Stats.TimeNs += (UINT64)Flash->Timing.EraseBlockUs * 1000;
+}
+
+/**
+  Check whether programming a range would need to set bits.
+**/
+STATIC
+BOOLEAN
+NorFlashSimNeedsErase (
+  IN NOR_FLASH_SIM  *Flash,
+  IN UINT64         Offset,
+  IN UINTN          Size,
+  IN CONST UINT8    *Data
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Size; Index++) {
+    if ((Flash->Memory[Offset + Index] & Data[Index]) != Data[Index]) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/**
+  Write a range of the region block by block.
+
+  @param[in]  Erase  TRUE to erase every block written, as BlockIo writes do,
+                     FALSE to only erase the blocks where bits must be set.
+**/
+STATIC
+EFI_STATUS
+NorFlashSimWrite (
+  IN NOR_FLASH_SIM  *Flash,
+  IN UINT64         Offset,
+  IN UINTN          Size,
+  IN CONST UINT8    *Buffer,
+  IN BOOLEAN        Erase
+  )
+{
+  UINT32   BlockSize;
+  EFI_LBA  FirstLba;
+  EFI_LBA  Lba;
+  UINT64   BlockStart;
+  UINT64   Start;
+  UINT64   End;
+  UINTN    Operations;
+  BOOLEAN  Cut;
+  BOOLEAN  NeedsErase;
+  UINT8    *Block;
+
+  if ((Offset > Flash->Size) || (Size > Flash->Size - Offset)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (Flash->PowerCut) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Flash->Stats.WriteCount++;
+  Flash->Stats.WriteBytes += Size;
+
+  Cut = (Flash->WritesBeforeCut == 0);
+  if (Flash->WritesBeforeCut != MAX_UINTN) {
+    Flash->WritesBeforeCut--;
+  }
+  if (Size == 0) {
+    return EFI_SUCCESS;
+  }
+
+  BlockSize  = Flash->Media.BlockSize;
+  FirstLba   = Offset / BlockSize;
+  Operations = (UINTN)((Offset + Size - 1) / BlockSize - FirstLba + 1);
+
+  for (Lba = FirstLba; Lba < FirstLba + Operations; Lba++) {
+    BlockStart = Lba * BlockSize;
+    Start      = MAX (Offset, BlockStart);
+    End        = MIN (Offset + Size, BlockStart + BlockSize);
+    NeedsErase = Erase || NorFlashSimNeedsErase (Flash, Start, (UINTN)(End - Start), Buffer + (Start - Offset));
+
+    if (Cut && (Lba - FirstLba == Operations / 2)) {
+      if (NeedsErase) {
+        NorFlashSimErase (Flash, Lba);
+      } else {
+        NorFlashSimProgram (Flash, Start, (UINTN)(End - Start) / 2, Buffer + (Start - Offset));
+      }
+      Flash->PowerCut = TRUE;
+      return EFI_DEVICE_ERROR;
+    }
+
+    if (!NeedsErase) {
+      NorFlashSimProgram (Flash, Start, (UINTN)(End - Start), Buffer + (Start - Offset));
+      continue;
+    }
+
+    // The part of the block not written is read back and programmed again
+    // after the erase.
+    Block = AllocatePool (BlockSize);
+    ASSERT (Block != NULL);
+    if (End - Start != BlockSize) {
+      CopyMem (Block, Flash->Memory + BlockStart, BlockSize);
+      Flash->Stats.TimeNs += WORDS (BlockSize) * Flash->Timing.ReadWordNs;
+    }
+    CopyMem (Block + (Start - BlockStart), Buffer + (Start - Offset), (UINTN)(End - Start));
+
+    NorFlashSimErase (Flash, Lba);
+    NorFlashSimProgram (Flash, BlockStart, BlockSize, Block);
+    FreePool (Block);
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+NorFlashSimReset (
+  IN EFI_BLOCK_IO_PROTOCOL  *This,
+  IN BOOLEAN                ExtendedVerification
+  )
+{
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+NorFlashSimReadBlocks (
+  IN  EFI_BLOCK_IO_PROTOCOL  *This,
+  IN  UINT32                 MediaId,
+  IN  EFI_LBA                Lba,
+  IN  UINTN                  BufferSize,
+  OUT VOID                   *Buffer
+  )
+{
+  NOR_FLASH_SIM  *Flash;
+
+  Flash = NOR_FLASH_SIM_FROM_BLOCK_IO (This);
+  if ((BufferSize % Flash->Media.BlockSize) != 0) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+  return NorFlashSimRead (Flash, Lba * Flash->Media.BlockSize, BufferSize, Buffer);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+NorFlashSimWriteBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL  *This,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  IN VOID                   *Buffer
+  )
+{
+  NOR_FLASH_SIM  *Flash;
+
+  Flash = NOR_FLASH_SIM_FROM_BLOCK_IO (This);
+  if ((BufferSize % Flash->Media.BlockSize) != 0) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+  return NorFlashSimWrite (Flash, Lba * Flash->Media.BlockSize, BufferSize, Buffer, TRUE);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+NorFlashSimFlushBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL  *This
+  )
+{
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+NorFlashSimReadDisk (
+  IN  EFI_DISK_IO_PROTOCOL  *This,
+  IN  UINT32                MediaId,
+  IN  UINT64                Offset,
+  IN  UINTN                 BufferSize,
+  OUT VOID                  *Buffer
+  )
+{
+  return NorFlashSimRead (NOR_FLASH_SIM_FROM_DISK_IO (This), Offset, BufferSize, Buffer);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+NorFlashSimWriteDisk (
+  IN EFI_DISK_IO_PROTOCOL  *This,
+  IN UINT32                MediaId,
+  IN UINT64                Offset,
+  IN UINTN                 BufferSize,
+  IN VOID                  *Buffer
+  )
+{
+  return NorFlashSimWrite (NOR_FLASH_SIM_FROM_DISK_IO (This), Offset, BufferSize, Buffer, FALSE);
+}
+
+NOR_FLASH_SIM *
+NorFlashSimCreate (
+  IN UINT32       BlockSize,
+  IN UINTN        BlockCount,
+  IN CONST UINT8  *Contents OPTIONAL,
+  IN BOOLEAN      Mapped
+  )
+{
+  NOR_FLASH_SIM  *Flash;
+  EFI_STATUS     Status;
+
+  Flash = AllocateZeroPool (sizeof (NOR_FLASH_SIM));
+  ASSERT (Flash != NULL);
+
+  Flash->Size = (UINTN)BlockSize * BlockCount;
+  Flash->Memory = AllocatePool (Flash->Size);
+  ASSERT (Flash->Memory != NULL);
+  if (Contents != NULL) {
+    CopyMem (Flash->Memory, Contents, Flash->Size);
+  } else {
+    SetMem (Flash->Memory, Flash->Size, 0xFF);
+  }
+  Flash->WritesBeforeCut = MAX_UINTN;
+
+  Flash->Timing.ReadWordNs    = 100;
+  Flash->Timing.ProgramWordNs = 10000;
+  Flash->Timing.EraseBlockUs  = 500000;
+
+  Flash->Media.MediaId      = 1;
+  Flash->Media.MediaPresent = TRUE;
+  Flash->Media.BlockSize    = BlockSize;
+  Flash->Media.IoAlign      = 4;
+  Flash->Media.LastBlock    = BlockCount - 1;
+
+  Flash->BlockIo.Revision    = 0x00020001;
+  Flash->BlockIo.Media       = &Flash->Media;
+  Flash->BlockIo.Reset       = NorFlashSimReset;
+  Flash->BlockIo.ReadBlocks  = NorFlashSimReadBlocks;
+  Flash->BlockIo.WriteBlocks = NorFlashSimWriteBlocks;
+  Flash->BlockIo.FlushBlocks = NorFlashSimFlushBlocks;
+
+  Flash->DiskIo.Revision  = 0x00010000;
+  Flash->DiskIo.ReadDisk  = NorFlashSimReadDisk;
+  Flash->DiskIo.WriteDisk = NorFlashSimWriteDisk;
+
+  Flash->Mapped = Mapped;
+  if (Mapped) {
+    ASSERT (HostNorFlashDeviceCount == 0);
+    mMappedRegion.DeviceBaseAddress = (UINTN)Flash->Memory;
+    mMappedRegion.RegionBaseAddress = (UINTN)Flash->Memory;
+    mMappedRegion.Size              = Flash->Size;
+    mMappedRegion.BlockSize         = BlockSize;
+    CopyMem (&mMappedRegion.Guid, &gNorFlashSimMappedGuid, sizeof (EFI_GUID));
+    HostNorFlashDevices     = &mMappedRegion;
+    HostNorFlashDeviceCount = 1;
+    Flash->DevicePath = HostVendorDevicePath (&gNorFlashSimMappedGuid);
+  } else {
+    Flash->DevicePath = HostVendorDevicePath (&gNorFlashSimGuid);
+  }
+
+  Status = gBS->InstallMultipleProtocolInterfaces (
+                  &Flash->Handle,
+                  &gEfiBlockIoProtocolGuid, &Flash->BlockIo,
+                  &gEfiDiskIoProtocolGuid, &Flash->DiskIo,
+                  &gEfiDevicePathProtocolGuid, Flash->DevicePath,
+                  NULL
+                  );
+  ASSERT_EFI_ERROR (Status);
+
+  return Flash;
+}
+
+VOID
+NorFlashSimDestroy (
+  IN NOR_FLASH_SIM  *Flash
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = gBS->UninstallMultipleProtocolInterfaces (
+                  Flash->Handle,
+                  &gEfiBlockIoProtocolGuid, &Flash->BlockIo,
+                  &gEfiDiskIoProtocolGuid, &Flash->DiskIo,
+                  &gEfiDevicePathProtocolGuid, Flash->DevicePath,
+                  NULL
+                  );
+  ASSERT_EFI_ERROR (Status);
+
+  if (Flash->Mapped) {
+    HostNorFlashDevices     = NULL;
+    HostNorFlashDeviceCount = 0;
+  }
+
+  FreePool (Flash->DevicePath);
+  FreePool (Flash->Memory);
+  FreePool (Flash);
+}
@@ -0,0 +1,112 @@
+/** @file
+*
+*  RAM backed simulation of a NOR flash region, with the BlockIo, DiskIo and
+*  device path protocols the NOR flash driver installs for each region, see
+*  NorFlashSim.c.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __NOR_FLASH_SIM_H__
+#define __NOR_FLASH_SIM_H__
+
+#include <Protocol/BlockIo.h>
+#include <Protocol/DiskIo.h>
+#include <Protocol/DevicePath.h>
+
+// Vendor GUIDs of the device paths of the simulated regions, the second one
+// is the one of the memory-mapped region, if any.
+extern EFI_GUID  gNorFlashSimGuid;
+extern EFI_GUID  gNorFlashSimMappedGuid;
+
+//
+// Cost of the flash operations. The defaults, see NorFlashSimCreate(), are
+// the orders of magnitude of parallel NOR flash parts.
+//
+typedef struct {
+  UINT32  ReadWordNs;         // Read of a 32-bit word
+  UINT32  ProgramWordNs;      // Program of a 32-bit word
+  UINT32  EraseBlockUs;       // Erase of a block
+} NOR_FLASH_SIM_TIMING;
+
+//
+// Operations on the flash since the region was created or the statistics
+// were last cleared. Reads through the memory-mapped window are not seen.
+//
+typedef struct {
+  UINT64  ReadCount;          // BlockIo and DiskIo reads
+  UINT64  ReadBytes;
+  UINT64  WriteCount;         // BlockIo and DiskIo writes
+  UINT64  WriteBytes;
+  UINT64  ProgrammedBytes;    // Bytes programmed, erase rewrites included
+  UINT64  EraseCount;         // Blocks erased
+  UINT64  TimeNs;             // Simulated time of the operations
+} NOR_FLASH_SIM_STATS;
+
+typedef struct {
+  EFI_HANDLE                Handle;
+  EFI_BLOCK_IO_MEDIA        Media;
+  EFI_BLOCK_IO_PROTOCOL     BlockIo;
+  EFI_DISK_IO_PROTOCOL      DiskIo;
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+  UINT8                     *Memory;
+  UINTN                     Size;
+  BOOLEAN                   Mapped;
+
+  NOR_FLASH_SIM_TIMING      Timing;
+  NOR_FLASH_SIM_STATS       Stats;
+
+  // Number of writes that complete before the power is cut, MAX_UINTN to
+  // never cut it. The write that hits the cut completes half of the block
+  // operations it needs then stops in the middle of the next one: a block
+  // to erase is left erased, a block to program is left half programmed.
+  // It and all the following writes fail.
+  UINTN                     WritesBeforeCut;
+  BOOLEAN                   PowerCut;
+} NOR_FLASH_SIM;
+
+/**
+  Create a region and install its protocols on a new handle.
+
+  The region is erased and programmed as the NOR flash driver does it: a
+  BlockIo write erases and programs whole blocks, a DiskIo write only
+  programs a block if it just clears bits and otherwise reads the block back,
+  erases it and programs it again.
+
+  @param[in]  BlockSize   Size of an erase block.
+  @param[in]  BlockCount  Number of blocks of the region.
+  @param[in]  Contents    Initial contents of the region, NULL for an erased
+                          region.
+  @param[in]  Mapped      TRUE to also describe the region as a memory-mapped
+                          NOR flash device to NorFlashPlatformGetDevices().
+                          Only one region can be mapped at a time.
+
+  @return The region.
+**/
+NOR_FLASH_SIM *
+NorFlashSimCreate (
+  IN UINT32       BlockSize,
+  IN UINTN        BlockCount,
+  IN CONST UINT8  *Contents OPTIONAL,
+  IN BOOLEAN      Mapped
+  );
+
+/**
+  Uninstall the protocols of a region and free it. The region must not be
+  bound to a driver anymore.
+
+  @param[in]  Flash  The region.
+**/
+VOID
+NorFlashSimDestroy (
+  IN NOR_FLASH_SIM  *Flash
+  );
+
+#endif
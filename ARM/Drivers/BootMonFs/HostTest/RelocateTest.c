@@ -0,0 +1,325 @@
+/** @file
+*
+*  Grow files that no longer fit where they are on volumes with
+*  PcdBootMonFsCompactOnFull set, so that the flush moves them or compacts
+*  the volume, and cut the power after each write of the flush in turn. After
+*  every cut each file must still be on the media, the grown file with its
+*  former or its new contents.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <stdio.h>
+
+#include "../BootMonFsInternal.h"
+
+#include "TestLib.h"
+
+#define BLOCK_SIZE        SIZE_4KB
+#define MAX_FILES         8
+
+// Size of the data of a file taking Blocks blocks
+#define FILE_SIZE(Blocks) (((Blocks) - 1) * BLOCK_SIZE + 1000)
+
+typedef struct {
+  CONST CHAR8  *Name;
+  UINTN        Blocks;
+  BOOLEAN      Keep;      // FALSE for the files deleted to leave free space
+} LAYOUT_FILE;
+
+typedef struct {
+  CONST CHAR8  *Description;
+  UINTN        BlockCount;
+  LAYOUT_FILE  Files[MAX_FILES];  // Written in order from block 0
+  UINTN        Grow;              // Index of the file to grow
+  UINTN        NewBlocks;         // New size of the file to grow
+  BOOLEAN      VolumeFull;        // The file cannot grow
+  BOOLEAN      PowerCuts;         // Cut the power after each write in turn
+} SCENARIO;
+
+STATIC CONST SCENARIO  mScenarios[] = {
+  {
+    "move to a free extent",
+    16,
+    { { "a", 2, TRUE }, { "b", 2, TRUE } },
+    0, 4, FALSE, TRUE
+  },
+  {
+    // "b" is copied to the free extent at 6 then back to 2, "c" moves from
+    // 10 to 5 and "a" then moves to 9.
+    "compact through a scratch extent then move",
+    16,
+    { { "a", 2, TRUE }, { "g1", 1, FALSE }, { "b", 3, TRUE }, { "g2", 4, FALSE },
+      { "c", 4, TRUE }, { "g3", 2, FALSE } },
+    0, 5, FALSE, TRUE
+  },
+  {
+    "compact then grow in place",
+    8,
+    { { "g1", 3, FALSE }, { "a", 3, TRUE }, { "g2", 2, FALSE } },
+    1, 7, FALSE, FALSE
+  },
+  {
+    "more than the free blocks and the blocks of the file",
+    8,
+    { { "a", 3, TRUE }, { "b", 2, TRUE } },
+    0, 7, TRUE, FALSE
+  },
+};
+
+STATIC
+VOID
+FileName (
+  IN  CONST CHAR8  *AsciiName,
+  OUT CHAR16       *Name
+  )
+{
+  AsciiStrToUnicodeStrS (AsciiName, Name, MAX_NAME_LENGTH);
+}
+
+STATIC
+UINT8 *
+FileData (
+  IN UINTN   Index,
+  IN UINTN   Blocks
+  )
+{
+  UINT8  *Data;
+
+  Data = AllocatePool (FILE_SIZE (Blocks));
+  ASSERT (Data != NULL);
+  TestFillPattern (Data, FILE_SIZE (Blocks), (UINT32)(Index * 100 + Blocks));
+  return Data;
+}
+
+/**
+  Write the files of a scenario on an erased region, delete the ones not to
+  keep and return a copy of the media.
+**/
+STATIC
+UINT8 *
+BuildLayout (
+  IN CONST SCENARIO  *Scenario
+  )
+{
+  NOR_FLASH_SIM      *Flash;
+  EFI_FILE_PROTOCOL  *Root;
+  CONST LAYOUT_FILE  *File;
+  CHAR16             Name[MAX_NAME_LENGTH];
+  UINT8              *Data;
+  UINT8              *Media;
+  EFI_STATUS         Status;
+  UINTN              Index;
+
+  Flash = NorFlashSimCreate (BLOCK_SIZE, Scenario->BlockCount, NULL, FALSE);
+  Root = TestMount (Flash);
+  ASSERT (Root != NULL);
+
+  for (Index = 0; Index < MAX_FILES && Scenario->Files[Index].Name != NULL; Index++) {
+    File = &Scenario->Files[Index];
+    FileName (File->Name, Name);
+    Data = FileData (Index, File->Blocks);
+    Status = TestWriteFile (Root, Name, Data, FILE_SIZE (File->Blocks));
+    ASSERT_EFI_ERROR (Status);
+    FreePool (Data);
+  }
+  for (Index = 0; Index < MAX_FILES && Scenario->Files[Index].Name != NULL; Index++) {
+    File = &Scenario->Files[Index];
+    if (!File->Keep) {
+      FileName (File->Name, Name);
+      Status = TestDeleteFile (Root, Name);
+      ASSERT_EFI_ERROR (Status);
+    }
+  }
+
+  TestUnmount (Flash);
+  Media = AllocateCopyPool (Flash->Size, Flash->Memory);
+  ASSERT (Media != NULL);
+  NorFlashSimDestroy (Flash);
+  return Media;
+}
+
+/**
+  Check the files of a scenario on the media and through a new mount.
+
+  @param[in]  Grown  TRUE if the grown file must have its new contents,
+                     FALSE if either its former or its new contents will do.
+**/
+STATIC
+UINTN
+CheckFiles (
+  IN CONST SCENARIO  *Scenario,
+  IN NOR_FLASH_SIM   *Flash,
+  IN BOOLEAN         Grown
+  )
+{
+  NOR_FLASH_SIM      *Copy;
+  EFI_FILE_PROTOCOL  *Root;
+  CONST LAYOUT_FILE  *File;
+  CHAR16             Name[MAX_NAME_LENGTH];
+  UINT8              *Data;
+  UINT8              *NewData;
+  UINTN              Count;
+  UINTN              NewCount;
+  UINTN              OtherCount;
+  UINTN              Failures;
+  UINTN              Index;
+
+  Failures = 0;
+  Copy = NorFlashSimCreate (BLOCK_SIZE, Scenario->BlockCount, Flash->Memory, FALSE);
+  Root = TestMount (Copy);
+  if (Root == NULL) {
+    printf ("  the volume does not mount anymore\n");
+    NorFlashSimDestroy (Copy);
+    return 1;
+  }
+
+  for (Index = 0; Index < MAX_FILES && Scenario->Files[Index].Name != NULL; Index++) {
+    File = &Scenario->Files[Index];
+    if (!File->Keep) {
+      continue;
+    }
+    FileName (File->Name, Name);
+    Data = FileData (Index, File->Blocks);
+    Count = TestCountImages (Flash, File->Name, Data, FILE_SIZE (File->Blocks), &OtherCount);
+
+    if (Index == Scenario->Grow) {
+      NewData = FileData (Index, Scenario->NewBlocks);
+      NewCount = TestCountImages (Flash, File->Name, NewData, FILE_SIZE (Scenario->NewBlocks), &OtherCount);
+      if (Grown ? (NewCount != 1) || (Count != 0) : (Count + NewCount == 0) || (OtherCount != Count)) {
+        printf ("  %s: %u former and %u new images\n", File->Name, (UINT32)Count, (UINT32)NewCount);
+        Failures++;
+      }
+      if (!TestCheckFile (Root, Name, NewData, FILE_SIZE (Scenario->NewBlocks)) &&
+          (Grown || !TestCheckFile (Root, Name, Data, FILE_SIZE (File->Blocks)))) {
+        printf ("  %s: wrong contents after mount\n", File->Name);
+        Failures++;
+      }
+      FreePool (NewData);
+    } else {
+      if ((Count == 0) || (OtherCount != 0)) {
+        printf ("  %s: %u images, %u with other contents\n", File->Name, (UINT32)Count, (UINT32)OtherCount);
+        Failures++;
+      }
+      if (!TestCheckFile (Root, Name, Data, FILE_SIZE (File->Blocks))) {
+        printf ("  %s: wrong contents after mount\n", File->Name);
+        Failures++;
+      }
+    }
+    FreePool (Data);
+  }
+
+  TestUnmount (Copy);
+  NorFlashSimDestroy (Copy);
+  return Failures;
+}
+
+/**
+  Grow the file of a scenario on a copy of its layout.
+
+  @param[in]  WritesBeforeCut  Number of writes before the power is cut,
+                               MAX_UINTN to let the flush complete.
+  @param[out] Completed        TRUE if the power was not cut.
+  @param[out] WriteCount       Number of writes issued.
+**/
+STATIC
+UINTN
+RunScenario (
+  IN  CONST SCENARIO  *Scenario,
+  IN  CONST UINT8     *Layout,
+  IN  UINTN           WritesBeforeCut,
+  OUT BOOLEAN         *Completed,
+  OUT UINTN           *WriteCount
+  )
+{
+  NOR_FLASH_SIM      *Flash;
+  EFI_FILE_PROTOCOL  *Root;
+  CHAR16             Name[MAX_NAME_LENGTH];
+  UINT8              *NewData;
+  EFI_STATUS         Status;
+  UINTN              Failures;
+
+  Failures = 0;
+  Flash = NorFlashSimCreate (BLOCK_SIZE, Scenario->BlockCount, Layout, FALSE);
+  Root = TestMount (Flash);
+  ASSERT (Root != NULL);
+
+  FileName (Scenario->Files[Scenario->Grow].Name, Name);
+  NewData = FileData (Scenario->Grow, Scenario->NewBlocks);
+  Flash->WritesBeforeCut = WritesBeforeCut;
+  Status = TestWriteFile (Root, Name, NewData, FILE_SIZE (Scenario->NewBlocks));
+  FreePool (NewData);
+
+  *Completed = !Flash->PowerCut;
+  *WriteCount = Flash->Stats.WriteCount;
+  TestUnmount (Flash);
+
+  if (*Completed) {
+    if (Scenario->VolumeFull ? (Status != EFI_VOLUME_FULL) || (Flash->Stats.WriteCount != 0) : EFI_ERROR (Status)) {
+      printf ("  flush: status 0x%lx after %u writes\n", (unsigned long)Status, (UINT32)Flash->Stats.WriteCount);
+      Failures++;
+    }
+    Failures += CheckFiles (Scenario, Flash, !Scenario->VolumeFull);
+  } else {
+    if (!EFI_ERROR (Status)) {
+      printf ("  flush succeeded with the power cut\n");
+      Failures++;
+    }
+    Failures += CheckFiles (Scenario, Flash, FALSE);
+    if (Failures != 0) {
+      printf ("  power cut after %u writes\n", (UINT32)WritesBeforeCut);
+    }
+  }
+
+  NorFlashSimDestroy (Flash);
+  return Failures;
+}
+
+int
+main (
+  int   argc,
+  char  **argv
+  )
+{
+  CONST SCENARIO  *Scenario;
+  UINT8           *Layout;
+  UINTN           Index;
+  UINTN           Cut;
+  UINTN           WriteCount;
+  UINTN           CutWriteCount;
+  BOOLEAN         Completed;
+  UINTN           Failures;
+  UINTN           Total;
+
+  TestInitialize ();
+  HostPcd_PcdBootMonFsCompactOnFull = TRUE;
+
+  Total = 0;
+  for (Index = 0; Index < ARRAY_SIZE (mScenarios); Index++) {
+    Scenario = &mScenarios[Index];
+    Layout = BuildLayout (Scenario);
+
+    Failures = RunScenario (Scenario, Layout, MAX_UINTN, &Completed, &WriteCount);
+    Cut = 0;
+    if (Scenario->PowerCuts) {
+      for (Cut = 0; Cut < WriteCount; Cut++) {
+        Failures += RunScenario (Scenario, Layout, Cut, &Completed, &CutWriteCount);
+        ASSERT (!Completed);
+      }
+    }
+
+    printf ("%-55s %3u writes, %3u power cuts, %u failures\n",
+      Scenario->Description, (UINT32)WriteCount, (UINT32)Cut, (UINT32)Failures);
+    Total += Failures;
+    FreePool (Layout);
+  }
+
+  return (Total == 0) ? 0 : 1;
+}
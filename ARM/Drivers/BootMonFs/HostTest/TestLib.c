@@ -0,0 +1,212 @@
+/** @file
+*
+*  Helpers shared by the tests that mount BootMonFs volumes on simulated NOR
+*  flash regions: the driver is bound to a region through its driver binding
+*  protocol and the files are accessed through EFI_FILE_PROTOCOL, as a UEFI
+*  application would.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include "../BootMonFsInternal.h"
+
+#include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include "HostLib.h"
+#include "TestLib.h"
+
+extern EFI_DRIVER_BINDING_PROTOCOL  mBootMonFsDriverBinding;
+
+EFI_STATUS
+EFIAPI
+BootMonFsEntryPoint (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  );
+
+VOID
+TestInitialize (
+  VOID
+  )
+{
+  STATIC CHAR16  DevicePaths[128];
+  EFI_STATUS     Status;
+
+  UnicodeSPrint (DevicePaths, sizeof (DevicePaths), L"VenHw(%g);VenHw(%g)",
+    &gNorFlashSimGuid, &gNorFlashSimMappedGuid);
+  HostPcd_PcdBootMonFsSupportedDevicePaths = DevicePaths;
+
+  Status = BootMonFsEntryPoint (gImageHandle, gST);
+  ASSERT_EFI_ERROR (Status);
+}
+
+EFI_FILE_PROTOCOL *
+TestMount (
+  IN NOR_FLASH_SIM  *Flash
+  )
+{
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *Fs;
+  EFI_FILE_PROTOCOL                *Root;
+  EFI_STATUS                       Status;
+
+  Status = mBootMonFsDriverBinding.Supported (&mBootMonFsDriverBinding, Flash->Handle, NULL);
+  if (!EFI_ERROR (Status)) {
+    Status = mBootMonFsDriverBinding.Start (&mBootMonFsDriverBinding, Flash->Handle, NULL);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->OpenProtocol (Flash->Handle, &gEfiSimpleFileSystemProtocolGuid, (VOID **)&Fs,
+                    gImageHandle, Flash->Handle, EFI_OPEN_PROTOCOL_GET_PROTOCOL);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = Fs->OpenVolume (Fs, &Root);
+  }
+  if (EFI_ERROR (Status)) {
+    return NULL;
+  }
+  return Root;
+}
+
+VOID
+TestUnmount (
+  IN NOR_FLASH_SIM  *Flash
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = mBootMonFsDriverBinding.Stop (&mBootMonFsDriverBinding, Flash->Handle, 0, NULL);
+  ASSERT_EFI_ERROR (Status);
+}
+
+EFI_STATUS
+TestWriteFile (
+  IN EFI_FILE_PROTOCOL  *Root,
+  IN CONST CHAR16       *Name,
+  IN CONST VOID         *Data,
+  IN UINTN              Size
+  )
+{
+  EFI_FILE_PROTOCOL  *File;
+  EFI_STATUS         Status;
+
+  Status = Root->Open (Root, &File, (CHAR16 *)Name,
+                   EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, 0);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = File->Write (File, &Size, (VOID *)Data);
+  if (!EFI_ERROR (Status)) {
+    Status = File->Flush (File);
+  }
+  File->Close (File);
+  return Status;
+}
+
+BOOLEAN
+TestCheckFile (
+  IN EFI_FILE_PROTOCOL  *Root,
+  IN CONST CHAR16       *Name,
+  IN CONST VOID         *Data,
+  IN UINTN              Size
+  )
+{
+  EFI_FILE_PROTOCOL  *File;
+  EFI_STATUS         Status;
+  UINT8              *Buffer;
+  UINTN              ReadSize;
+  BOOLEAN            Match;
+
+  Status = Root->Open (Root, &File, (CHAR16 *)Name, EFI_FILE_MODE_READ, 0);
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  // One byte more than expected to catch a longer file
+  ReadSize = Size + 1;
+  Buffer = AllocatePool (ReadSize);
+  ASSERT (Buffer != NULL);
+  Status = File->Read (File, &ReadSize, Buffer);
+  Match = !EFI_ERROR (Status) && (ReadSize == Size) && (CompareMem (Buffer, Data, Size) == 0);
+
+  FreePool (Buffer);
+  File->Close (File);
+  return Match;
+}
+
+EFI_STATUS
+TestDeleteFile (
+  IN EFI_FILE_PROTOCOL  *Root,
+  IN CONST CHAR16       *Name
+  )
+{
+  EFI_FILE_PROTOCOL  *File;
+  EFI_STATUS         Status;
+
+  Status = Root->Open (Root, &File, (CHAR16 *)Name, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  return File->Delete (File);
+}
+
+UINTN
+TestCountImages (
+  IN  NOR_FLASH_SIM  *Flash,
+  IN  CONST CHAR8    *Name,
+  IN  CONST VOID     *Data,
+  IN  UINTN          Size,
+  OUT UINTN          *OtherCount
+  )
+{
+  HW_IMAGE_DESCRIPTION  Desc;
+  EFI_LBA               Lba;
+  UINT64                Offset;
+  UINTN                 Count;
+
+  Count = 0;
+  *OtherCount = 0;
+  for (Lba = 0; Lba <= Flash->Media.LastBlock; Lba++) {
+    Offset = (Lba + 1) * Flash->Media.BlockSize - sizeof (HW_IMAGE_DESCRIPTION);
+    CopyMem (&Desc, Flash->Memory + Offset, sizeof (HW_IMAGE_DESCRIPTION));
+    if (!BootMonFsIsImageValid (&Desc, Lba) ||
+        (AsciiStrCmp (Desc.Footer.Filename, Name) != 0)) {
+      continue;
+    }
+
+    if ((Desc.RegionCount == 1) && (Desc.Region[0].Size == Size) &&
+        (Desc.Region[0].Offset + Size <= Offset) &&
+        (CompareMem (Flash->Memory + Desc.Region[0].Offset, Data, Size) == 0)) {
+      Count++;
+    } else {
+      (*OtherCount)++;
+    }
+  }
+  return Count;
+}
+
+VOID
+TestFillPattern (
+  OUT VOID   *Buffer,
+  IN  UINTN  Size,
+  IN  UINT32 Seed
+  )
+{
+  UINT8   *Byte;
+  UINT32  State;
+  UINTN   Index;
+
+  Byte = Buffer;
+  State = Seed * 2654435761U + 1;
+  for (Index = 0; Index < Size; Index++) {
+    State = State * 1103515245 + 12345;
+    Byte[Index] = (UINT8)(State >> 16);
+  }
+}
@@ -0,0 +1,141 @@
+/** @file
+*
+*  Helpers shared by the tests that mount BootMonFs volumes on simulated NOR
+*  flash regions, see TestLib.c.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __TEST_LIB_H__
+#define __TEST_LIB_H__
+
+#include <Protocol/SimpleFileSystem.h>
+
+#include "NorFlashSim.h"
+
+/**
+  Run the entry point of the driver, with the device paths of the simulated
+  regions as the only supported device paths. Called once per program.
+**/
+VOID
+TestInitialize (
+  VOID
+  );
+
+/**
+  Bind the driver to a region and open the root directory of its volume.
+
+  @param[in]  Flash  The region.
+
+  @return The root directory, NULL if the driver did not start.
+**/
+EFI_FILE_PROTOCOL *
+TestMount (
+  IN NOR_FLASH_SIM  *Flash
+  );
+
+/**
+  Unbind the driver from a region.
+
+  @param[in]  Flash  The region.
+**/
+VOID
+TestUnmount (
+  IN NOR_FLASH_SIM  *Flash
+  );
+
+/**
+  Create a file, or write over an existing one from its start, and flush it.
+
+  @param[in]  Root  The root directory of the volume.
+  @param[in]  Name  The name of the file.
+  @param[in]  Data  The contents of the file.
+  @param[in]  Size  The size of the contents.
+
+  @return The status of the first operation that failed, EFI_SUCCESS if the
+          file was flushed.
+**/
+EFI_STATUS
+TestWriteFile (
+  IN EFI_FILE_PROTOCOL  *Root,
+  IN CONST CHAR16       *Name,
+  IN CONST VOID         *Data,
+  IN UINTN              Size
+  );
+
+/**
+  Check the contents of a file.
+
+  @param[in]  Root  The root directory of the volume.
+  @param[in]  Name  The name of the file.
+  @param[in]  Data  The expected contents.
+  @param[in]  Size  The expected size.
+
+  @retval  TRUE   The file exists with these contents.
+  @retval  FALSE  It does not or its contents differ.
+**/
+BOOLEAN
+TestCheckFile (
+  IN EFI_FILE_PROTOCOL  *Root,
+  IN CONST CHAR16       *Name,
+  IN CONST VOID         *Data,
+  IN UINTN              Size
+  );
+
+/**
+  Delete a file.
+
+  @param[in]  Root  The root directory of the volume.
+  @param[in]  Name  The name of the file.
+
+  @return The status of Open() or Delete().
+**/
+EFI_STATUS
+TestDeleteFile (
+  IN EFI_FILE_PROTOCOL  *Root,
+  IN CONST CHAR16       *Name
+  );
+
+/**
+  Look for the images of a file on the media of a region, as the driver
+  finds them at mount time.
+
+  @param[in]  Flash       The region.
+  @param[in]  Name        The name of the file.
+  @param[in]  Data        The contents the images must have.
+  @param[in]  Size        The size of the contents.
+  @param[out] OtherCount  Number of images of the file with other contents.
+
+  @return The number of images of the file with these contents.
+**/
+UINTN
+TestCountImages (
+  IN  NOR_FLASH_SIM  *Flash,
+  IN  CONST CHAR8    *Name,
+  IN  CONST VOID     *Data,
+  IN  UINTN          Size,
+  OUT UINTN          *OtherCount
+  );
+
+/**
+  Fill a buffer with a pattern specific to a seed.
+
+  @param[out] Buffer  The buffer.
+  @param[in]  Size    The size of the buffer.
+  @param[in]  Seed    The seed.
+**/
+VOID
+TestFillPattern (
+  OUT VOID   *Buffer,
+  IN  UINTN  Size,
+  IN  UINT32 Seed
+  );
+
+#endif
@@ -0,0 +1,43 @@
+/** @file
+*
+*  Copyright (c) 2018, Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials are licensed and made available
+*  under the terms and conditions of the BSD License which accompanies this
+*  distribution. The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS, WITHOUT
+*  WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __BOOTMON_FS_FILE_MAPPING_H__
+#define __BOOTMON_FS_FILE_MAPPING_H__
+
+//
+// Information type returned by GetInfo() for a file of a BootMonFs volume
+// backed by memory-mapped NOR flash. The file contents can then be read in
+// place, without going through Read().
+//
+// GetInfo() returns EFI_UNSUPPORTED if the volume is not memory-mapped and
+// EFI_NOT_READY if the file has data that are not flushed yet. The mapping
+// stays valid while the file is open and nothing is written to the volume.
+//
+#define BOOTMON_FS_FILE_MAPPING_ID \
+  { \
+    0x5b8f3e21, 0x9c4d, 0x4a7b, {0x8e, 0x16, 0xd2, 0xa9, 0x4f, 0x07, 0xc3, 0xb8 } \
+  }
+
+typedef struct {
+  // The size of the structure.
+  UINT64                Size;
+
+  // Address of the first byte of the file and number of bytes of the file.
+  EFI_PHYSICAL_ADDRESS  Base;
+  UINT64                Length;
+} BOOTMON_FS_FILE_MAPPING;
+
+extern EFI_GUID gArmBootMonFsFileMappingGuid;
+
+#endif // __BOOTMON_FS_FILE_MAPPING_H__
@@ -0,0 +1,49 @@
+/** @file
+*
+*  Copyright (c) 2018, Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials are licensed and made available
+*  under the terms and conditions of the BSD License which accompanies this
+*  distribution. The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS, WITHOUT
+*  WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __BOOTMON_FS_IO_STATS_H__
+#define __BOOTMON_FS_IO_STATS_H__
+
+//
+// Information type giving the media accesses issued by a BootMonFs volume
+// since it was mounted. GetInfo() on any handle of the volume returns the
+// counters, SetInfo() with this type clears them. The driver only counts the
+// accesses when built with PcdBootMonFsIoStats set, both return
+// EFI_UNSUPPORTED otherwise.
+//
+#define BOOTMON_FS_IO_STATS_ID \
+  { \
+    0xc1a7e5d3, 0x6b2f, 0x4e90, {0x9d, 0x4a, 0x3f, 0x8b, 0x21, 0xe6, 0xa7, 0xc5 } \
+  }
+
+typedef struct {
+  // The size of the structure.
+  UINT64    Size;
+
+  UINT64    ReadCount;      // DiskIo reads
+  UINT64    ReadBytes;
+  UINT64    WriteCount;     // DiskIo writes
+  UINT64    WriteBytes;
+  // Media blocks touched by the writes. On NOR flash a block is the erase
+  // unit, each of them costs an erase and a program.
+  UINT64    BlocksWritten;
+  // Blocks only partly covered by a write, the disk layer reads them back
+  // before programming them.
+  UINT64    PartialBlocksWritten;
+  UINT64    FlushCount;     // BlockIo FlushBlocks() calls
+} BOOTMON_FS_IO_STATS;
+
+extern EFI_GUID gArmBootMonFsIoStatsGuid;
+
+#endif // __BOOTMON_FS_IO_STATS_H__
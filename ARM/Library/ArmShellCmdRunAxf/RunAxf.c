@@ -14,6 +14,7 @@
 *
 **/
 
+#include <Guid/BootMonFsFileMapping.h>
 #include <Guid/GlobalVariable.h>
 
 #include <Library/PrintLib.h>
@@ -161,11 +162,15 @@ ShellDynCmdRunAxfHandler (
   RUNAXF_LOAD_LIST  *LoadNode;
   CHAR16            *TmpFileName;
   CHAR16            *TmpChar16;
+  BOOTMON_FS_FILE_MAPPING  Mapping;
+  UINTN              MappingSize;
+  BOOLEAN            FileMapped;
 
 
   ShellStatus = SHELL_SUCCESS;
   FileHandle = NULL;
   FileData = NULL;
+  FileMapped = FALSE;
   InitializeListHead (&LoadList);
 
   // Only install if they are not there yet? First time or every time?
@@ -237,6 +242,25 @@ ShellDynCmdRunAxfHandler (
         FileSize = (UINTN) Info->FileSize;
         FreePool (Info);
 
+        //
+        // A file on memory-mapped NOR flash is parsed and loaded straight
+        // from the flash. The mapping stays valid after ExitBootServices() as
+        // nothing writes to the flash any more.
+        //
+        MappingSize = sizeof (Mapping);
+        Status = ((EFI_FILE_HANDLE)FileHandle)->GetInfo (
+                                                  (EFI_FILE_HANDLE)FileHandle,
+                                                  &gArmBootMonFsFileMappingGuid,
+                                                  &MappingSize,
+                                                  &Mapping
+                                                  );
+        if (!EFI_ERROR (Status) && (Mapping.Base != 0) && (Mapping.Length >= FileSize)) {
+          FileData = (VOID*)(UINTN)Mapping.Base;
+          FileMapped = TRUE;
+        }
+      }
+
+      if ((FileHandle != NULL) && !FileMapped) {
         //
         // Allocate buffer to read file. 'Runtime' so we can access it after
         // ExitBootServices().
@@ -291,7 +315,9 @@ ShellDynCmdRunAxfHandler (
       } else {
         ShellPrintHiiEx (-1, -1, NULL, STRING_TOKEN (STR_RUNAXF_BAD_FILE),
                          gRunAxfHiiHandle);
-        SHELL_FREE_NON_NULL (FileData);
+        if (!FileMapped) {
+          SHELL_FREE_NON_NULL (FileData);
+        }
         ShellStatus = SHELL_UNSUPPORTED;
       }
     }
@@ -343,7 +369,9 @@ ShellDynCmdRunAxfHandler (
     FreePool (Node);
     Node = NextNode;
   }
-  SHELL_FREE_NON_NULL (FileData);
+  if (!FileMapped) {
+    SHELL_FREE_NON_NULL (FileData);
+  }
   if (FileHandle != NULL) {
     ShellCloseFile (&FileHandle);
   }
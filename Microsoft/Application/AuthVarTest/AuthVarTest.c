@@ -25,8 +25,11 @@
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
+#include <Library/ShellLib.h>
 #include <Protocol/ShellParameters.h>
 
+#include <AuthVarLog.h>
+
 #include <EdkTest.h>
 
 MODULE ("UEFI authenticated variables functional tests");
@@ -61,6 +64,51 @@ AuthVarInfo mSecureBootVariables[] = {
   }
 };
 
+//
+// Benchmark mode, see UefiMain. Latencies are reported per operation with
+// the EdkTest.h CSV helpers, storage growth as the drop in remaining space
+// reported by QueryVariableInfo. Only gRT is used so any variable driver
+// can be measured, every variable lives under TestVendorGuid.
+//
+#define BENCH_DEFAULT_ITERATIONS      100
+#define BENCH_MAX_SAMPLES             8192
+#define BENCH_MAX_DATA_SIZE           SIZE_64KB
+#define BENCH_BOOT_OPTION_COUNT       8
+#define BENCH_CHURN_VARIABLE_COUNT    16
+
+typedef enum {
+  BenchOpGet = 0,
+  BenchOpSet,
+  BenchOpDelete,
+  BenchOpGetNext,
+  BenchOpSweep,
+  BenchOpQuery,
+  BenchOpMax
+} BENCH_VARIABLE_OP;
+
+STATIC CONST CHAR16 *mBenchOpNames[BenchOpMax] = {
+  L"GetVariable",
+  L"SetVariable",
+  L"DeleteVariable",
+  L"GetNextVariableName",
+  L"EnumerationSweep",
+  L"QueryVariableInfo"
+};
+
+STATIC CONST UINT32 mBenchNvAttributes = (EFI_VARIABLE_NON_VOLATILE |
+                                          EFI_VARIABLE_RUNTIME_ACCESS |
+                                          EFI_VARIABLE_BOOTSERVICE_ACCESS);
+STATIC CONST UINT32 mBenchVolatileAttributes = (EFI_VARIABLE_RUNTIME_ACCESS |
+                                                EFI_VARIABLE_BOOTSERVICE_ACCESS);
+
+UINT32 mBenchIterations = BENCH_DEFAULT_ITERATIONS;
+CONST CHAR16 *mReplayFileName = NULL;
+BENCH_SAMPLES mBenchSamples[BenchOpMax];
+UINT64 mBenchNvRemaining;
+UINT64 mBenchVolatileRemaining;
+INT64 mBenchNvGrowth;
+INT64 mBenchVolatileGrowth;
+
 VOID
 VerifyAreEqualBytes (
   IN CONST UINT8   *LeftBuffer,
@@ -1188,6 +1236,628 @@ TestValidNonVolatileVars (
   }
 }
 
+STATIC
+EFI_STATUS
+BenchGetVariable (
+  IN CHAR16       *VariableName,
+  OUT UINT32      *Attributes OPTIONAL,
+  IN OUT UINTN    *DataSize,
+  OUT VOID        *Data
+  )
+{
+  EFI_STATUS Status;
+  UINT64 TimerStart;
+
+  TimerStart = HpcTimerStart ();
+  Status = gRT->GetVariable (VariableName, &TestVendorGuid, Attributes, DataSize, Data);
+  BenchSampleAdd (&mBenchSamples[BenchOpGet], TimerStart);
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+BenchSetVariable (
+  IN CHAR16       *VariableName,
+  IN EFI_GUID     *VendorGuid,
+  IN UINT32       Attributes,
+  IN UINTN        DataSize,
+  IN VOID         *Data
+  )
+{
+  EFI_STATUS Status;
+  UINT64 TimerStart;
+  BOOLEAN Delete;
+
+  Delete = (Attributes == 0) ||
+           ((DataSize == 0) && ((Attributes & EFI_VARIABLE_APPEND_WRITE) == 0));
+
+  TimerStart = HpcTimerStart ();
+  Status = gRT->SetVariable (VariableName, VendorGuid, Attributes, DataSize, Data);
+  BenchSampleAdd (&mBenchSamples[Delete ? BenchOpDelete : BenchOpSet], TimerStart);
+
+  return Status;
+}
+
+/**
+  Step an enumeration, growing mEnumVariableName as needed.
+
+  @param  VariableNameBufferSize  Size of mEnumVariableName, updated on growth.
+  @param  VendorGuid              The enumeration vendor GUID cursor.
+**/
+STATIC
+EFI_STATUS
+BenchGetNextVariableName (
+  IN OUT UINTN    *VariableNameBufferSize,
+  IN OUT EFI_GUID *VendorGuid
+  )
+{
+  EFI_STATUS Status;
+  UINTN VariableNameSize;
+  UINT64 TimerStart;
+
+  VariableNameSize = *VariableNameBufferSize;
+  TimerStart = HpcTimerStart ();
+  Status = gRT->GetNextVariableName (&VariableNameSize, mEnumVariableName, VendorGuid);
+  BenchSampleAdd (&mBenchSamples[BenchOpGetNext], TimerStart);
+
+  if (Status == EFI_BUFFER_TOO_SMALL) {
+    mEnumVariableName = ReallocatePool (*VariableNameBufferSize, VariableNameSize, mEnumVariableName);
+    if (mEnumVariableName == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    *VariableNameBufferSize = VariableNameSize;
+
+    TimerStart = HpcTimerStart ();
+    Status = gRT->GetNextVariableName (&VariableNameSize, mEnumVariableName, VendorGuid);
+    BenchSampleAdd (&mBenchSamples[BenchOpGetNext], TimerStart);
+  }
+
+  return Status;
+}
+
+STATIC
+VOID
+BenchQueryRemaining (
+  OUT UINT64  *NvRemaining,
+  OUT UINT64  *VolatileRemaining
+  )
+{
+  UINT64 MaximumVariableStorageSize;
+  UINT64 MaximumVariableSize;
+  UINT64 TimerStart;
+
+  *NvRemaining = 0;
+  *VolatileRemaining = 0;
+
+  TimerStart = HpcTimerStart ();
+  gRT->QueryVariableInfo (mBenchNvAttributes, &MaximumVariableStorageSize, NvRemaining, &MaximumVariableSize);
+  BenchSampleAdd (&mBenchSamples[BenchOpQuery], TimerStart);
+
+  TimerStart = HpcTimerStart ();
+  gRT->QueryVariableInfo (mBenchVolatileAttributes, &MaximumVariableStorageSize, VolatileRemaining, &MaximumVariableSize);
+  BenchSampleAdd (&mBenchSamples[BenchOpQuery], TimerStart);
+}
+
+/**
+  Release the samples of a benchmark mix.
+**/
+STATIC
+VOID
+BenchMixFreeSamples (
+  VOID
+  )
+{
+  UINTN Op;
+
+  for (Op = 0; Op < BenchOpMax; Op++) {
+    BenchSamplesFree (&mBenchSamples[Op]);
+  }
+}
+
+/**
+  Start a benchmark mix: reset the samples and snapshot the remaining storage.
+**/
+STATIC
+VOID
+BenchMixBegin (
+  VOID
+  )
+{
+  BOOLEAN Allocated;
+  UINTN Op;
+
+  Allocated = TRUE;
+  for (Op = 0; Op < BenchOpMax; Op++) {
+    if (!BenchSamplesInit (&mBenchSamples[Op], BENCH_MAX_SAMPLES)) {
+      Allocated = FALSE;
+    }
+  }
+
+  if (mImageData == NULL) {
+    mImageData = AllocatePool (BENCH_MAX_DATA_SIZE);
+    if (mImageData == NULL) {
+      Allocated = FALSE;
+    }
+  }
+
+  // VERIFY does not return on failure, release the samples first.
+  if (!Allocated) {
+    BenchMixFreeSamples ();
+  }
+  VERIFY_IS_TRUE (Allocated, "Allocate the benchmark buffers");
+
+  RandomBytes (mImageData, BENCH_MAX_DATA_SIZE);
+
+  mBenchNvGrowth = 0;
+  mBenchVolatileGrowth = 0;
+  BenchQueryRemaining (&mBenchNvRemaining, &mBenchVolatileRemaining);
+}
+
+/**
+  Record the storage growth of a benchmark mix. Called while the variables
+  of the mix are still present, before the mix deletes them.
+**/
+STATIC
+VOID
+BenchMixMeasureGrowth (
+  VOID
+  )
+{
+  UINT64 NvRemaining;
+  UINT64 VolatileRemaining;
+
+  BenchQueryRemaining (&NvRemaining, &VolatileRemaining);
+  mBenchNvGrowth = (INT64) (mBenchNvRemaining - NvRemaining);
+  mBenchVolatileGrowth = (INT64) (mBenchVolatileRemaining - VolatileRemaining);
+}
+
+/**
+  End a benchmark mix: print the latency rows and the storage growth
+  recorded by BenchMixMeasureGrowth.
+**/
+STATIC
+VOID
+BenchMixEnd (
+  IN CONST CHAR16   *MixName
+  )
+{
+  CHAR16 RowName[64];
+  UINTN Op;
+
+  BenchPrintCsvHeader ();
+  for (Op = 0; Op < BenchOpMax; Op++) {
+    if (mBenchSamples[Op].Count != 0) {
+      UnicodeSPrint (RowName, sizeof (RowName), L"%s.%s", MixName, mBenchOpNames[Op]);
+      BenchPrintCsv (RowName, 0, &mBenchSamples[Op]);
+    }
+  }
+  BenchMixFreeSamples ();
+
+  PRINTF_ (L"Mix,NvGrowthBytes,VolatileGrowthBytes\n");
+  PRINTF_ (
+    L"%s,%ld,%ld\n",
+    MixName,
+    mBenchNvGrowth,
+    mBenchVolatileGrowth);
+}
+
+/**
+  Benchmark: a boot manager reordering boot options. Each iteration reads
+  and rotates BenchBootOrder, then rewrites one of the load options.
+**/
+VOID
+BenchBootOrderChurn (
+  VOID
+  )
+{
+  CHAR16 OptionName[32];
+  UINT16 BootOrder[BENCH_BOOT_OPTION_COUNT];
+  UINT16 First;
+  UINTN DataSize;
+  UINTN OptionSize;
+  UINT32 Iteration;
+  UINTN Idx;
+
+  BenchMixBegin ();
+
+  for (Idx = 0; Idx < BENCH_BOOT_OPTION_COUNT; Idx++) {
+    BootOrder[Idx] = (UINT16) Idx;
+    UnicodeSPrint (OptionName, sizeof (OptionName), L"BenchBoot%04X", (UINT32) Idx);
+    VERIFY_SUCCEEDED (BenchSetVariable (OptionName, &TestVendorGuid, mBenchNvAttributes, 96 + Idx * 8, mImageData));
+  }
+
+  VERIFY_SUCCEEDED (BenchSetVariable (L"BenchBootOrder", &TestVendorGuid, mBenchNvAttributes, sizeof (BootOrder), BootOrder));
+
+  for (Iteration = 0; Iteration < mBenchIterations; Iteration++) {
+    DataSize = sizeof (BootOrder);
+    VERIFY_SUCCEEDED (BenchGetVariable (L"BenchBootOrder", NULL, &DataSize, BootOrder));
+
+    First = BootOrder[0];
+    CopyMem (&BootOrder[0], &BootOrder[1], sizeof (BootOrder) - sizeof (BootOrder[0]));
+    BootOrder[BENCH_BOOT_OPTION_COUNT - 1] = First;
+    VERIFY_SUCCEEDED (BenchSetVariable (L"BenchBootOrder", &TestVendorGuid, mBenchNvAttributes, sizeof (BootOrder), BootOrder));
+
+    Idx = Iteration % BENCH_BOOT_OPTION_COUNT;
+    UnicodeSPrint (OptionName, sizeof (OptionName), L"BenchBoot%04X", (UINT32) Idx);
+    OptionSize = BENCH_MAX_DATA_SIZE;
+    VERIFY_SUCCEEDED (BenchGetVariable (OptionName, NULL, &OptionSize, mImageData));
+    ((UINT8 *) mImageData)[0] = (UINT8) Iteration;
+    VERIFY_SUCCEEDED (BenchSetVariable (OptionName, &TestVendorGuid, mBenchNvAttributes, OptionSize, mImageData));
+  }
+
+  BenchMixMeasureGrowth ();
+
+  for (Idx = 0; Idx < BENCH_BOOT_OPTION_COUNT; Idx++) {
+    UnicodeSPrint (OptionName, sizeof (OptionName), L"BenchBoot%04X", (UINT32) Idx);
+    BenchSetVariable (OptionName, &TestVendorGuid, 0, 0, NULL);
+  }
+  BenchSetVariable (L"BenchBootOrder", &TestVendorGuid, 0, 0, NULL);
+
+  BenchMixEnd (L"BootOrderChurn");
+}
+
+/**
+  Create, read back and delete a spread of variable sizes.
+**/
+STATIC
+VOID
+BenchChurn (
+  IN CONST CHAR16   *MixName,
+  IN UINT32         Attributes
+  )
+{
+  CHAR16 VariableName[32];
+  UINTN DataSize;
+  UINT32 Iteration;
+  UINTN Idx;
+
+  BenchMixBegin ();
+
+  for (Iteration = 0; Iteration < mBenchIterations; Iteration++) {
+    for (Idx = 0; Idx < BENCH_CHURN_VARIABLE_COUNT; Idx++) {
+      UnicodeSPrint (VariableName, sizeof (VariableName), L"BenchChurn%u", (UINT32) Idx);
+      VERIFY_SUCCEEDED (BenchSetVariable (VariableName, &TestVendorGuid, Attributes, 8 << (Idx % 8), mImageData));
+    }
+
+    for (Idx = 0; Idx < BENCH_CHURN_VARIABLE_COUNT; Idx++) {
+      UnicodeSPrint (VariableName, sizeof (VariableName), L"BenchChurn%u", (UINT32) Idx);
+      DataSize = BENCH_MAX_DATA_SIZE;
+      VERIFY_SUCCEEDED (BenchGetVariable (VariableName, NULL, &DataSize, mImageData));
+    }
+
+    if (Iteration == mBenchIterations - 1) {
+      BenchMixMeasureGrowth ();
+    }
+
+    for (Idx = 0; Idx < BENCH_CHURN_VARIABLE_COUNT; Idx++) {
+      UnicodeSPrint (VariableName, sizeof (VariableName), L"BenchChurn%u", (UINT32) Idx);
+      VERIFY_SUCCEEDED (BenchSetVariable (VariableName, &TestVendorGuid, 0, 0, NULL));
+    }
+  }
+
+  BenchMixEnd (MixName);
+}
+
+VOID
+BenchVolatileChurn (
+  VOID
+  )
+{
+  BenchChurn (L"VolatileChurn", mBenchVolatileAttributes);
+}
+
+VOID
+BenchNonVolatileChurn (
+  VOID
+  )
+{
+  BenchChurn (L"NonVolatileChurn", mBenchNvAttributes);
+}
+
+/**
+  Benchmark: full GetNextVariableName sweeps over the store with extra
+  BENCH_CHURN_VARIABLE_COUNT variables present.
+**/
+VOID
+BenchEnumerationSweep (
+  VOID
+  )
+{
+  CHAR16 VariableName[32];
+  EFI_GUID VendorGuid;
+  EFI_STATUS Status;
+  UINTN VariableNameBufferSize;
+  UINT64 TimerStart;
+  UINT32 Sweep;
+  UINTN Idx;
+
+  BenchMixBegin ();
+
+  for (Idx = 0; Idx < BENCH_CHURN_VARIABLE_COUNT; Idx++) {
+    UnicodeSPrint (VariableName, sizeof (VariableName), L"BenchEnum%u", (UINT32) Idx);
+    VERIFY_SUCCEEDED (BenchSetVariable (VariableName, &TestVendorGuid, mBenchNvAttributes, 32, mImageData));
+  }
+
+  VariableNameBufferSize = 64 * sizeof (CHAR16);
+  mEnumVariableName = AllocateZeroPool (VariableNameBufferSize);
+  VERIFY_IS_NOT_NULL (mEnumVariableName);
+
+  for (Sweep = 0; Sweep < MAX (mBenchIterations / 10, 1); Sweep++) {
+    mEnumVariableName[0] = L'\0';
+    TimerStart = HpcTimerStart ();
+    do {
+      Status = BenchGetNextVariableName (&VariableNameBufferSize, &VendorGuid);
+    } while (!EFI_ERROR (Status));
+    BenchSampleAdd (&mBenchSamples[BenchOpSweep], TimerStart);
+
+    VERIFY_ARE_EQUAL (EFI_STATUS, EFI_NOT_FOUND, Status);
+  }
+
+  FreePool (mEnumVariableName);
+  mEnumVariableName = NULL;
+
+  BenchMixMeasureGrowth ();
+
+  for (Idx = 0; Idx < BENCH_CHURN_VARIABLE_COUNT; Idx++) {
+    UnicodeSPrint (VariableName, sizeof (VariableName), L"BenchEnum%u", (UINT32) Idx);
+    BenchSetVariable (VariableName, &TestVendorGuid, 0, 0, NULL);
+  }
+
+  BenchMixEnd (L"EnumerationSweep");
+}
+
+/**
+  Benchmark: large authenticated db writes. The pre-signed db blob from the
+  FV is written once, then appended to on every iteration. Requires the
+  same clean SecureBoot state as TestValidAuthVars.
+**/
+VOID
+BenchAuthDbAppend (
+  VOID
+  )
+{
+  STATIC CONST UINT32 AuthAttributes = (EFI_VARIABLE_NON_VOLATILE |
+                                        EFI_VARIABLE_RUNTIME_ACCESS |
+                                        EFI_VARIABLE_BOOTSERVICE_ACCESS |
+                                        EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS);
+  VOID *Blob;
+  UINTN BlobSize;
+  UINT32 Iteration;
+
+  BenchMixBegin ();
+
+  Blob = NULL;
+  BlobSize = 0;
+  VERIFY_SUCCEEDED (GetSectionFromAnyFv (
+                      mSecureBootVariables[0].BinaryBlobFvFfsNameGuid,
+                      EFI_SECTION_RAW,
+                      0,
+                      &Blob,
+                      &BlobSize),
+                    "Getting db binary blob from FV");
+
+  // Hand the blob over to TestCleanup in case a verification fails.
+  mActualImageData = Blob;
+
+  VERIFY_SUCCEEDED (BenchSetVariable (
+                      mSecureBootVariables[0].VariableName,
+                      mSecureBootVariables[0].VendorGuid,
+                      AuthAttributes,
+                      BlobSize,
+                      Blob));
+
+  for (Iteration = 0; Iteration < mBenchIterations; Iteration++) {
+    VERIFY_SUCCEEDED (BenchSetVariable (
+                        mSecureBootVariables[0].VariableName,
+                        mSecureBootVariables[0].VendorGuid,
+                        AuthAttributes | EFI_VARIABLE_APPEND_WRITE,
+                        BlobSize,
+                        Blob));
+  }
+
+  BenchMixMeasureGrowth ();
+
+  // Same deletion as DeleteAndCheckVariable, fine without a PK.
+  VERIFY_SUCCEEDED (BenchSetVariable (
+                      mSecureBootVariables[0].VariableName,
+                      mSecureBootVariables[0].VendorGuid,
+                      AuthAttributes,
+                      0,
+                      NULL));
+
+  BenchMixEnd (L"AuthDbAppend");
+}
+
+/**
+  Benchmark: replay a VarLog.bin trace captured by AuthVarOpteeRuntimeDxe.
+
+  The log records names, sizes and attributes but no vendor GUIDs or data,
+  so every variable is replayed under TestVendorGuid with random data and
+  authenticated writes are replayed as plain writes of the same size. Names
+  longer than the log field were truncated at capture time. The variables
+  set by the replay are deleted when it completes.
+**/
+VOID
+BenchReplayVarLog (
+  VOID
+  )
+{
+  SHELL_FILE_HANDLE FileHandle;
+  VAR_LOG_FILE_HEADER *Header;
+  VAR_LOG_ENTRY *Entry;
+  EFI_GUID VendorGuid;
+  CHAR16 VariableName[VAR_LOG_STR_PARAM_MAX_LENGTH + 1];
+  UINT64 FileSize;
+  UINTN ReadSize;
+  UINTN VariableNameBufferSize;
+  UINTN DataSize;
+  UINT32 Attributes;
+  UINT32 Idx;
+  UINT64 Unused;
+  UINT64 TimerStart;
+  EFI_STATUS Status;
+
+  BenchMixBegin ();
+
+  VERIFY_SUCCEEDED (ShellOpenFileByName (mReplayFileName, &FileHandle, EFI_FILE_MODE_READ, 0),
+                    "Opening %s", mReplayFileName);
+
+  Status = ShellGetFileSize (FileHandle, &FileSize);
+  if (!EFI_ERROR (Status) && ((FileSize < sizeof (*Header)) || (FileSize > MAX_UINT32))) {
+    Status = EFI_VOLUME_CORRUPTED;
+  }
+
+  if (!EFI_ERROR (Status)) {
+    ReadSize = (UINTN) FileSize;
+    mActualImageData = AllocatePool (ReadSize);
+    Status = (mActualImageData == NULL) ? EFI_OUT_OF_RESOURCES :
+             ShellReadFile (FileHandle, &ReadSize, mActualImageData);
+    if (!EFI_ERROR (Status) && (ReadSize != FileSize)) {
+      Status = EFI_VOLUME_CORRUPTED;
+    }
+  }
+
+  ShellCloseFile (&FileHandle);
+  VERIFY_SUCCEEDED (Status, "Reading %s", mReplayFileName);
+
+  Header = (VAR_LOG_FILE_HEADER *) mActualImageData;
+  VERIFY_ARE_EQUAL (UINT32, VAR_LOG_FILE_SIGNATURE, Header->Signature);
+  VERIFY_ARE_EQUAL (UINT32, VAR_LOG_FILE_VERSION, Header->Version);
+  VERIFY_IS_TRUE ((Header->HeaderSize >= sizeof (*Header)) && (Header->HeaderSize <= FileSize));
+  VERIFY_IS_TRUE (Header->EntrySize >= sizeof (VAR_LOG_ENTRY));
+  VERIFY_IS_TRUE (Header->EntryCount <= (FileSize - Header->HeaderSize) / Header->EntrySize,
+                  "Log truncated");
+
+  VariableNameBufferSize = 64 * sizeof (CHAR16);
+  mEnumVariableName = AllocateZeroPool (VariableNameBufferSize);
+  VERIFY_IS_NOT_NULL (mEnumVariableName);
+
+  for (Idx = 0; Idx < Header->EntryCount; Idx++) {
+    Entry = (VAR_LOG_ENTRY *) ((UINT8 *) Header + Header->HeaderSize + Idx * Header->EntrySize);
+
+    CopyMem (VariableName, Entry->StrParam, sizeof (Entry->StrParam));
+    VariableName[VAR_LOG_STR_PARAM_MAX_LENGTH] = L'\0';
+
+    Attributes = 0;
+    Attributes |= Entry->IsNV ? EFI_VARIABLE_NON_VOLATILE : 0;
+    Attributes |= Entry->IsBS ? EFI_VARIABLE_BOOTSERVICE_ACCESS : 0;
+    Attributes |= Entry->IsAppendWrite ? EFI_VARIABLE_APPEND_WRITE : 0;
+    if (Attributes & EFI_VARIABLE_NON_VOLATILE) {
+      Attributes |= EFI_VARIABLE_BOOTSERVICE_ACCESS;
+    }
+
+    switch (Entry->Operation) {
+    case VAR_LOG_OP_GET:
+      if (VariableName[0] != L'\0') {
+        DataSize = BENCH_MAX_DATA_SIZE;
+        BenchGetVariable (VariableName, NULL, &DataSize, mImageData);
+      }
+      break;
+
+    case VAR_LOG_OP_GET_NEXT:
+      Status = BenchGetNextVariableName (&VariableNameBufferSize, &VendorGuid);
+      if (EFI_ERROR (Status)) {
+        mEnumVariableName[0] = L'\0';
+      }
+      break;
+
+    case VAR_LOG_OP_SET:
+      if (VariableName[0] != L'\0') {
+        DataSize = MIN ((UINTN) MAX (Entry->IntParam, 0), BENCH_MAX_DATA_SIZE);
+        if ((Attributes & EFI_VARIABLE_BOOTSERVICE_ACCESS) == 0) {
+          DataSize = 0;
+        }
+        BenchSetVariable (VariableName, &TestVendorGuid, Attributes, DataSize, mImageData);
+      }
+      break;
+
+    case VAR_LOG_OP_QUERY:
+      TimerStart = HpcTimerStart ();
+      gRT->QueryVariableInfo (
+             (Attributes != 0) ? Attributes : mBenchNvAttributes,
+             &Unused,
+             &Unused,
+             &Unused);
+      BenchSampleAdd (&mBenchSamples[BenchOpQuery], TimerStart);
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  BenchMixMeasureGrowth ();
+
+  // Leave the store as the replay found it, as far as TestVendorGuid goes.
+  for (Idx = 0; Idx < Header->EntryCount; Idx++) {
+    Entry = (VAR_LOG_ENTRY *) ((UINT8 *) Header + Header->HeaderSize + Idx * Header->EntrySize);
+    if ((Entry->Operation == VAR_LOG_OP_SET) && (Entry->StrParam[0] != L'\0')) {
+      CopyMem (VariableName, Entry->StrParam, sizeof (Entry->StrParam));
+      VariableName[VAR_LOG_STR_PARAM_MAX_LENGTH] = L'\0';
+      gRT->SetVariable (VariableName, &TestVendorGuid, 0, 0, NULL);
+    }
+  }
+
+  FreePool (mEnumVariableName);
+  mEnumVariableName = NULL;
+
+  BenchMixEnd (L"Replay");
+}
+
+/**
+  Parse the shell command line.
+
+  AuthVarTest                 Run the functional tests.
+  AuthVarTest -b [Iterations] Run the benchmark mixes.
+  AuthVarTest -r <VarLog.bin> Replay a captured variable log.
+
+  @param  ImageHandle   The application image handle.
+  @param  Benchmark     Set to TRUE for the benchmark and replay modes.
+
+  @retval EFI_SUCCESS             The command line was parsed.
+  @retval EFI_INVALID_PARAMETER   Unknown arguments, the usage was printed.
+**/
+STATIC
+EFI_STATUS
+ParseCommandLine (
+  IN EFI_HANDLE   ImageHandle,
+  OUT BOOLEAN     *Benchmark
+  )
+{
+  EFI_STATUS Status;
+  EFI_SHELL_PARAMETERS_PROTOCOL *ShellParameters;
+
+  *Benchmark = FALSE;
+
+  Status = gBS->HandleProtocol (
+                  ImageHandle,
+                  &gEfiShellParametersProtocolGuid,
+                  (VOID **) &ShellParameters);
+
+  if (EFI_ERROR (Status) || (ShellParameters->Argc < 2)) {
+    return EFI_SUCCESS;
+  }
+
+  if (StrCmp (ShellParameters->Argv[1], L"-b") == 0) {
+    if (ShellParameters->Argc > 2) {
+      mBenchIterations = (UINT32) StrDecimalToUintn (ShellParameters->Argv[2]);
+    }
+
+    if (mBenchIterations != 0) {
+      *Benchmark = TRUE;
+      return EFI_SUCCESS;
+    }
+  } else if ((StrCmp (ShellParameters->Argv[1], L"-r") == 0) && (ShellParameters->Argc > 2)) {
+    mReplayFileName = ShellParameters->Argv[2];
+    *Benchmark = TRUE;
+    return EFI_SUCCESS;
+  }
+
+  Print (L"Usage: AuthVarTest [-b [Iterations] | -r VarLog.bin]\n");
+  return EFI_INVALID_PARAMETER;
+}
+
 BOOLEAN
 ModuleSetup (
   VOID
@@ -1248,6 +1918,9 @@ TestCleanup (
     mEnumVariableName = NULL;
   }
 
+  // A benchmark mix that failed a verification did not reach BenchMixEnd.
+  BenchMixFreeSamples ();
+
   // Always clear out the overflow variable, this can break
   // other tests.
   gRT->SetVariable (
@@ -1265,21 +1938,37 @@ UefiMain (
   IN EFI_SYSTEM_TABLE  *SystemTable
   )
 {
+  BOOLEAN Benchmark;
+
   mImageHandle = ImageHandle;
 
+  if (EFI_ERROR (ParseCommandLine (ImageHandle, &Benchmark))) {
+    return 1;
+  }
+
   MODULE_SETUP (ModuleSetup);
   TEST_SETUP (TestSetup);
   TEST_CLEANUP (TestCleanup);
 
-  TEST_FUNC (TestValidNonVolatileVars);
-  TEST_FUNC (VerifyAppendShrinkReplacePersist);
-  TEST_FUNC (VerifyNameHandling);
-  TEST_FUNC (VerifyQuery);
-  TEST_FUNC (TestValidAuthVars);
-  TEST_FUNC (TestInvalidAuthVars);
-
-  // Run this last
-  TEST_FUNC (VerifyOverflow);
+  if (mReplayFileName != NULL) {
+    TEST_FUNC (BenchReplayVarLog);
+  } else if (Benchmark) {
+    TEST_FUNC (BenchBootOrderChurn);
+    TEST_FUNC (BenchVolatileChurn);
+    TEST_FUNC (BenchNonVolatileChurn);
+    TEST_FUNC (BenchEnumerationSweep);
+    TEST_FUNC (BenchAuthDbAppend);
+  } else {
+    TEST_FUNC (TestValidNonVolatileVars);
+    TEST_FUNC (VerifyAppendShrinkReplacePersist);
+    TEST_FUNC (VerifyNameHandling);
+    TEST_FUNC (VerifyQuery);
+    TEST_FUNC (TestValidAuthVars);
+    TEST_FUNC (TestInvalidAuthVars);
+
+    // Run this last
+    TEST_FUNC (VerifyOverflow);
+  }
 
   if (!RUN_MODULE(0, NULL)) {
     return 1;
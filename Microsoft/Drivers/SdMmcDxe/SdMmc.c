@@ -663,6 +663,7 @@ Exit:
           Status);
       } else {
         HostInst->RpmbIoProtocolInstalled = FALSE;
+        EfiEventGroupSignal (&gEfiRpmbIoUninstallEventGroupGuid);
       }
     }
 
@@ -808,6 +809,9 @@ UninstallAllProtocols (
     }
 
     HostInst->RpmbIoProtocolInstalled = FALSE;
+
+    // Let RPMB IO consumers caching the interface know it is now gone.
+    EfiEventGroupSignal (&gEfiRpmbIoUninstallEventGroupGuid);
   }
 
   if (HostInst->DevicePathProtocolInstalled) {
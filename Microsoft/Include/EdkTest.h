@@ -17,7 +17,9 @@
 #include <Uefi.h>
 
 #include <Library/UefiLib.h>
+#include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
 #include <Library/TimerLib.h>
 
 #ifndef C_ASSERT
@@ -152,6 +154,143 @@ HpcTimerElapsedMilliseconds (
           gHpcTicksPerSeconds__);
 }
 
+// Benchmark Helpers
+
+typedef struct {
+  UINT64    *Ticks;
+  UINT32    Count;
+  UINT32    Capacity;
+} BENCH_SAMPLES;
+
+/** Allocates room for Capacity samples.
+
+  @retval TRUE on success, FALSE if the sample buffer could not be allocated.
+**/
+__inline__
+static
+BOOLEAN
+BenchSamplesInit (
+  OUT BENCH_SAMPLES   *Samples,
+  IN UINT32           Capacity
+  )
+{
+  Samples->Ticks = AllocatePool (Capacity * sizeof (UINT64));
+  Samples->Count = 0;
+  Samples->Capacity = (Samples->Ticks != NULL) ? Capacity : 0;
+  return (Samples->Ticks != NULL);
+}
+
+__inline__
+static
+VOID
+BenchSamplesFree (
+  IN OUT BENCH_SAMPLES  *Samples
+  )
+{
+  if (Samples->Ticks != NULL) {
+    FreePool (Samples->Ticks);
+  }
+
+  Samples->Ticks = NULL;
+  Samples->Count = 0;
+  Samples->Capacity = 0;
+}
+
+/** Records the ticks elapsed since a HpcTimerStart () time stamp.
+**/
+__inline__
+static
+VOID
+BenchSampleAdd (
+  IN OUT BENCH_SAMPLES  *Samples,
+  IN UINT64             TimerStartTimestamp
+  )
+{
+  UINT64 Ticks;
+
+  Ticks = GetPerformanceCounter () - TimerStartTimestamp;
+  if (Samples->Count < Samples->Capacity) {
+    Samples->Ticks[Samples->Count++] = Ticks;
+  }
+}
+
+__inline__
+static
+UINT64
+BenchTicksToNanoseconds (
+  IN UINT64   Ticks
+  )
+{
+  return DivU64x64Remainder (MultU64x64 (Ticks, 1000000000ULL), gHpcTicksPerSeconds__, NULL);
+}
+
+/** Prints the column names of the BenchPrintCsv () rows.
+**/
+__inline__
+static
+VOID
+BenchPrintCsvHeader (
+  VOID
+  )
+{
+  PRINTF_ (L"Benchmark,Param,Count,MinNs,MeanNs,P50Ns,P90Ns,P99Ns,MaxNs\n");
+}
+
+/** Prints one CSV row summarizing the samples, which get sorted in place.
+
+  Percentiles use the nearest rank method.
+**/
+__inline__
+static
+VOID
+BenchPrintCsv (
+  IN CONST CHAR16       *Name,
+  IN UINT64             Param,
+  IN OUT BENCH_SAMPLES  *Samples
+  )
+{
+  UINT64 *Ticks;
+  UINT64 Key;
+  UINT64 Sum;
+  UINT32 Count;
+  UINT32 Index;
+  UINT32 Prev;
+
+  Ticks = Samples->Ticks;
+  Count = Samples->Count;
+  if (Count == 0) {
+    PRINTF_ (L"%s,%ld,0,,,,,,\n", Name, Param);
+    return;
+  }
+
+  Sum = 0;
+  for (Index = 0; Index < Count; Index++) {
+    Sum += Ticks[Index];
+
+    Key = Ticks[Index];
+    for (Prev = Index; (Prev > 0) && (Ticks[Prev - 1] > Key); Prev--) {
+      Ticks[Prev] = Ticks[Prev - 1];
+    }
+    Ticks[Prev] = Key;
+  }
+
+#define BENCH_PERCENTILE_(P__) Ticks[((Count * (P__)) + 99) / 100 - 1]
+
+  PRINTF_ (
+    L"%s,%ld,%d,%ld,%ld,%ld,%ld,%ld,%ld\n",
+    Name,
+    Param,
+    Count,
+    BenchTicksToNanoseconds (Ticks[0]),
+    BenchTicksToNanoseconds (DivU64x32 (Sum, Count)),
+    BenchTicksToNanoseconds (BENCH_PERCENTILE_ (50)),
+    BenchTicksToNanoseconds (BENCH_PERCENTILE_ (90)),
+    BenchTicksToNanoseconds (BENCH_PERCENTILE_ (99)),
+    BenchTicksToNanoseconds (Ticks[Count - 1]));
+
+#undef BENCH_PERCENTILE_
+}
+
 // Internal Test Management
 
 __inline__
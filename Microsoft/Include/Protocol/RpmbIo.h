@@ -28,6 +28,13 @@
 
 #define EFI_RPMB_IO_PROTOCOL_REVISION  0x00010000
 
+// Event group signaled by the RPMB IO producer right after an instance of the
+// protocol got uninstalled, UEFI offers no uninstall notification otherwise.
+// Consumers caching the protocol interface must drop it when signaled.
+// {3A1C5B27-9E4F-4F2B-A1D6-7C0E2B98F514}
+#define EFI_RPMB_IO_UNINSTALL_EVENT_GROUP_GUID \
+  { 0x3a1c5b27, 0x9e4f, 0x4f2b, { 0xa1, 0xd6, 0x7c, 0x0e, 0x2b, 0x98, 0xf5, 0x14 } }
+
 // RPMB Request Message Types
 
 #define EFI_RPMB_REQUEST_PROGRAM_KEY     0x0001  // Authentication key programming request
@@ -264,5 +271,6 @@ RpmbOperationResultToString (
 }
 
 extern EFI_GUID gEfiRpmbIoProtocolGuid;
+extern EFI_GUID gEfiRpmbIoUninstallEventGroupGuid;
 
 #endif // __RPMB_IO_H__
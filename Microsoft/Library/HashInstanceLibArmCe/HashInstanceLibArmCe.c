@@ -0,0 +1,267 @@
+/** @file
+  SHA-256 and SHA-384 HashLib instances for ARM platforms.
+
+  Registers both algorithms with HashLibBaseCryptoRouter so the measurement
+  path (Tcg2 HashLogExtendEvent behind TpmMeasureAndLogData) hashes dbx, db,
+  KEK and image payloads with them. SHA-256 compression runs on the ARMv8
+  Crypto Extensions when the core implements them and on the portable C
+  compression otherwise, the choice is made once in the constructor.
+
+  Both engines are checked against known answers in the constructor, an
+  accelerated engine failing its known answer is dropped in favor of the
+  portable one and an algorithm failing both is not registered.
+
+  Copyright (c) 2018 Microsoft Corporation. All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <PiPei.h>
+#include <IndustryStandard/Tpm20.h>
+#include <Protocol/Hash.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HashLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "Sha2Internal.h"
+
+// ID_AA64ISAR0_EL1.SHA2, 1 when SHA256H/SHA256H2/SHA256SU0/SHA256SU1 exist.
+#define ID_AA64ISAR0_SHA2_SHIFT   12
+#define ID_AA64ISAR0_SHA2_MASK    0xF
+
+STATIC SHA2_BLOCK_FUNCTION mSha256Block = Sha256BlockC;
+
+STATIC CONST UINT8 mKatAbc[] = { 'a', 'b', 'c' };
+
+STATIC CONST CHAR8 mKatTwoBlock[] =
+  "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+STATIC CONST UINT8 mSha256KatAbc[SHA256_DIGEST_SIZE] = {
+  0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+  0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+  0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+  0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+};
+
+STATIC CONST UINT8 mSha256KatTwoBlock[SHA256_DIGEST_SIZE] = {
+  0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+  0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+  0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+  0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1
+};
+
+STATIC CONST UINT8 mSha384KatAbc[SHA384_DIGEST_SIZE] = {
+  0xcb, 0x00, 0x75, 0x3f, 0x45, 0xa3, 0x5e, 0x8b,
+  0xb5, 0xa0, 0x3d, 0x69, 0x9a, 0xc6, 0x50, 0x07,
+  0x27, 0x2c, 0x32, 0xab, 0x0e, 0xde, 0xd1, 0x63,
+  0x1a, 0x8b, 0x60, 0x5a, 0x43, 0xff, 0x5b, 0xed,
+  0x80, 0x86, 0x07, 0x2b, 0xa1, 0xe7, 0xcc, 0x23,
+  0x58, 0xba, 0xec, 0xa1, 0x34, 0xc8, 0x25, 0xa7
+};
+
+STATIC
+EFI_STATUS
+EFIAPI
+Sha256HashInit (
+  OUT HASH_HANDLE    *HashHandle
+  )
+{
+  SHA2_CONTEXT *Context;
+
+  Context = AllocatePool (sizeof (*Context));
+  if (Context == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Sha256Init (Context, mSha256Block);
+  *HashHandle = (HASH_HANDLE) Context;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+Sha384HashInit (
+  OUT HASH_HANDLE    *HashHandle
+  )
+{
+  SHA2_CONTEXT *Context;
+
+  Context = AllocatePool (sizeof (*Context));
+  if (Context == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Sha384Init (Context);
+  *HashHandle = (HASH_HANDLE) Context;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+Sha2HashUpdate (
+  IN HASH_HANDLE    HashHandle,
+  IN VOID           *DataToHash,
+  IN UINTN          DataToHashLen
+  )
+{
+  Sha2Update ((SHA2_CONTEXT *) HashHandle, DataToHash, DataToHashLen);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+Sha256HashFinal (
+  IN HASH_HANDLE         HashHandle,
+  OUT TPML_DIGEST_VALUES *DigestList
+  )
+{
+  Sha2Final ((SHA2_CONTEXT *) HashHandle, DigestList->digests[0].digest.sha256);
+  FreePool ((VOID *) HashHandle);
+
+  DigestList->count = 1;
+  DigestList->digests[0].hashAlg = TPM_ALG_SHA256;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+Sha384HashFinal (
+  IN HASH_HANDLE         HashHandle,
+  OUT TPML_DIGEST_VALUES *DigestList
+  )
+{
+  Sha2Final ((SHA2_CONTEXT *) HashHandle, DigestList->digests[0].digest.sha384);
+  FreePool ((VOID *) HashHandle);
+
+  DigestList->count = 1;
+  DigestList->digests[0].hashAlg = TPM_ALG_SHA384;
+  return EFI_SUCCESS;
+}
+
+STATIC HASH_INTERFACE mSha256ArmCeHashInstance = {
+  HASH_ALGORITHM_SHA256_GUID,
+  Sha256HashInit,
+  Sha2HashUpdate,
+  Sha256HashFinal
+};
+
+STATIC HASH_INTERFACE mSha384ArmCeHashInstance = {
+  HASH_ALGORITHM_SHA384_GUID,
+  Sha384HashInit,
+  Sha2HashUpdate,
+  Sha384HashFinal
+};
+
+/** Run the SHA-256 known answers through a compression function.
+**/
+STATIC
+BOOLEAN
+Sha256KnownAnswer (
+  IN SHA2_BLOCK_FUNCTION  Block
+  )
+{
+  SHA2_CONTEXT Context;
+  UINT8 Digest[SHA256_DIGEST_SIZE];
+
+  Sha256Init (&Context, Block);
+  Sha2Update (&Context, mKatAbc, sizeof (mKatAbc));
+  Sha2Final (&Context, Digest);
+  if (CompareMem (Digest, mSha256KatAbc, sizeof (Digest)) != 0) {
+    return FALSE;
+  }
+
+  // Fed in two uneven pieces to also cover the buffered path.
+  Sha256Init (&Context, Block);
+  Sha2Update (&Context, mKatTwoBlock, 5);
+  Sha2Update (&Context, mKatTwoBlock + 5, sizeof (mKatTwoBlock) - 1 - 5);
+  Sha2Final (&Context, Digest);
+  return (CompareMem (Digest, mSha256KatTwoBlock, sizeof (Digest)) == 0);
+}
+
+STATIC
+BOOLEAN
+Sha384KnownAnswer (
+  VOID
+  )
+{
+  SHA2_CONTEXT Context;
+  UINT8 Digest[SHA384_DIGEST_SIZE];
+
+  Sha384Init (&Context);
+  Sha2Update (&Context, mKatAbc, sizeof (mKatAbc));
+  Sha2Final (&Context, Digest);
+  return (CompareMem (Digest, mSha384KatAbc, sizeof (Digest)) == 0);
+}
+
+/** Pick the fastest SHA-256 compression function that passes its known answers.
+
+  @retval TRUE    mSha256Block is usable.
+  @retval FALSE   No SHA-256 compression function passed.
+**/
+STATIC
+BOOLEAN
+Sha256SelectEngine (
+  VOID
+  )
+{
+#if defined (MDE_CPU_AARCH64)
+  UINT64 Isar0;
+
+  Isar0 = Sha2ArmCeReadIsar0 ();
+  if (((RShiftU64 (Isar0, ID_AA64ISAR0_SHA2_SHIFT) & ID_AA64ISAR0_SHA2_MASK) != 0)) {
+    if (Sha256KnownAnswer (Sha256BlockArmCe)) {
+      mSha256Block = Sha256BlockArmCe;
+      DEBUG ((DEBUG_INFO, "HashInstanceLibArmCe: SHA-256 using the ARMv8 Crypto Extensions\n"));
+      return TRUE;
+    }
+
+    DEBUG ((DEBUG_ERROR, "HashInstanceLibArmCe: SHA-256 Crypto Extensions failed the known answer test\n"));
+  }
+#endif
+
+  mSha256Block = Sha256BlockC;
+  return Sha256KnownAnswer (Sha256BlockC);
+}
+
+EFI_STATUS
+EFIAPI
+HashInstanceLibArmCeConstructor (
+  VOID
+  )
+{
+  EFI_STATUS Status;
+
+  if (Sha256SelectEngine ()) {
+    Status = RegisterHashInterfaceLib (&mSha256ArmCeHashInstance);
+    if (EFI_ERROR (Status) && (Status != EFI_UNSUPPORTED)) {
+      return Status;
+    }
+  } else {
+    DEBUG ((DEBUG_ERROR, "HashInstanceLibArmCe: SHA-256 failed the known answer test\n"));
+    ASSERT (FALSE);
+  }
+
+  if (Sha384KnownAnswer ()) {
+    Status = RegisterHashInterfaceLib (&mSha384ArmCeHashInstance);
+    if (EFI_ERROR (Status) && (Status != EFI_UNSUPPORTED)) {
+      return Status;
+    }
+  } else {
+    DEBUG ((DEBUG_ERROR, "HashInstanceLibArmCe: SHA-384 failed the known answer test\n"));
+    ASSERT (FALSE);
+  }
+
+  return EFI_SUCCESS;
+}
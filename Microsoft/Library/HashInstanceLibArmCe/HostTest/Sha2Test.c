@@ -0,0 +1,318 @@
+/** @file
+  Known answers and throughput of the SHA-256/SHA-384 engine of
+  HashInstanceLibArmCe, built as a host program.
+
+  Every compression function available on the host is checked against the
+  FIPS 180-2 vectors, against a digest of the digests of the messages of 0 to
+  300 bytes (reference computed with Python hashlib) and against itself when
+  the message is fed in random pieces. Each one is then timed on a large
+  buffer. The Crypto Extensions one is only built on an AArch64 host and only
+  run when ID_AA64ISAR0_EL1 reports the SHA2 instructions.
+
+  Copyright (c) 2018 Microsoft Corporation. All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <Uefi.h>
+#include <IndustryStandard/Tpm20.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include "../Sha2Internal.h"
+
+#define SWEEP_LENGTH    300
+#define SPLIT_LENGTH    4096
+#define SPLIT_ROUNDS    200
+#define BENCH_SIZE      (16 * 1024 * 1024)
+#define BENCH_ROUNDS    4
+
+typedef struct {
+  CONST CHAR8  *Message;
+  UINTN        Repeat;      // The message is repeated Repeat times
+  CONST CHAR8  *Sha256;
+  CONST CHAR8  *Sha384;
+} KNOWN_ANSWER;
+
+STATIC CONST KNOWN_ANSWER  mKnownAnswers[] = {
+  {
+    "", 1,
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+    "38b060a751ac96384cd9327eb1b1e36a21fdb71114be07434c0cc7bf63f6e1da"
+    "274edebfe76f65fbd51ad2f14898b95b"
+  },
+  {
+    "abc", 1,
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+    "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded1631a8b605a43ff5bed"
+    "8086072ba1e7cc2358baeca134c825a7"
+  },
+  {
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+    "3391fdddfc8dc7393707a65b1b4709397cf8b1d162af05abfe8f450de5f36bc6"
+    "b0455a8520bc4e6f5fe95b1fe3c8452b"
+  },
+  {
+    "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno"
+    "ijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+    "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1",
+    "09330c33f71147e83d192fc782cd1b4753111b173b3b05d22fa08086e3b0f712"
+    "fcc7c71a557e2db966c3e9fa91746039"
+  },
+  {
+    "a", 1000000,
+    "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+    "9d0e1809716474cb086e834e310a4a1ced149e9c00f248527972cec5704c2a5b"
+    "07b8b3dc38ecc4ebae97ddd87f3d8985"
+  },
+};
+
+// Digest of the concatenated digests of SweepPattern() for 0 to 300 bytes.
+STATIC CONST CHAR8  mSha256Sweep[] =
+  "78f25692e2f4dd74482ac3dcf4f505a7c278fa279588b764b99a497144bcd49c";
+STATIC CONST CHAR8  mSha384Sweep[] =
+  "ee5687497e0097f58b34f928dabee44e7963886c5b13a2ff1709df57be7bb56b"
+  "2144b2519cf293aefe6ead490dfea857";
+
+typedef struct {
+  CONST CHAR8          *Name;
+  SHA2_BLOCK_FUNCTION  Block;
+  UINTN                DigestSize;
+} ENGINE;
+
+STATIC
+VOID
+EngineInit (
+  IN  CONST ENGINE  *Engine,
+  OUT SHA2_CONTEXT  *Context
+  )
+{
+  if (Engine->DigestSize == SHA256_DIGEST_SIZE) {
+    Sha256Init (Context, Engine->Block);
+  } else {
+    Sha384Init (Context);
+  }
+}
+
+STATIC
+BOOLEAN
+CheckDigest (
+  IN CONST ENGINE  *Engine,
+  IN CONST CHAR8   *What,
+  IN CONST UINT8   *Digest,
+  IN CONST CHAR8   *Expected
+  )
+{
+  CHAR8  Hex[2 * SHA384_DIGEST_SIZE + 1];
+  UINTN  Index;
+
+  for (Index = 0; Index < Engine->DigestSize; Index++) {
+    snprintf (Hex + 2 * Index, 3, "%02x", Digest[Index]);
+  }
+  if (strcmp (Hex, Expected) == 0) {
+    return TRUE;
+  }
+
+  printf ("  %s, %s: %s, expected %s\n", Engine->Name, What, Hex, Expected);
+  return FALSE;
+}
+
+STATIC
+VOID
+SweepPattern (
+  OUT UINT8  *Buffer,
+  IN  UINTN  Size
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Size; Index++) {
+    Buffer[Index] = (UINT8)(Index * 31 + 7);
+  }
+}
+
+STATIC
+UINTN
+TestKnownAnswers (
+  IN CONST ENGINE  *Engine
+  )
+{
+  CONST KNOWN_ANSWER  *Answer;
+  SHA2_CONTEXT        Context;
+  SHA2_CONTEXT        Outer;
+  UINT8               Digest[SHA384_DIGEST_SIZE];
+  UINT8               Buffer[SWEEP_LENGTH];
+  UINTN               Failures;
+  UINTN               Index;
+  UINTN               Repeat;
+
+  Failures = 0;
+  for (Index = 0; Index < ARRAY_SIZE (mKnownAnswers); Index++) {
+    Answer = &mKnownAnswers[Index];
+    EngineInit (Engine, &Context);
+    for (Repeat = 0; Repeat < Answer->Repeat; Repeat++) {
+      Sha2Update (&Context, Answer->Message, strlen (Answer->Message));
+    }
+    Sha2Final (&Context, Digest);
+    if (!CheckDigest (Engine, "FIPS vector", Digest,
+           (Engine->DigestSize == SHA256_DIGEST_SIZE) ? Answer->Sha256 : Answer->Sha384)) {
+      Failures++;
+    }
+  }
+
+  SweepPattern (Buffer, sizeof (Buffer));
+  EngineInit (Engine, &Outer);
+  for (Index = 0; Index <= SWEEP_LENGTH; Index++) {
+    EngineInit (Engine, &Context);
+    Sha2Update (&Context, Buffer, Index);
+    Sha2Final (&Context, Digest);
+    Sha2Update (&Outer, Digest, Engine->DigestSize);
+  }
+  Sha2Final (&Outer, Digest);
+  if (!CheckDigest (Engine, "0 to 300 byte sweep", Digest,
+         (Engine->DigestSize == SHA256_DIGEST_SIZE) ? mSha256Sweep : mSha384Sweep)) {
+    Failures++;
+  }
+
+  return Failures;
+}
+
+/**
+  Hash the same message in one update and in random pieces, including empty
+  ones and ones straddling the buffered head and tail of an update.
+**/
+STATIC
+UINTN
+TestSplits (
+  IN CONST ENGINE  *Engine
+  )
+{
+  SHA2_CONTEXT  Context;
+  UINT8         *Message;
+  UINT8         Expected[SHA384_DIGEST_SIZE];
+  UINT8         Digest[SHA384_DIGEST_SIZE];
+  UINTN         Round;
+  UINTN         Offset;
+  UINTN         Piece;
+  UINT32        Seed;
+
+  Message = malloc (SPLIT_LENGTH);
+  SweepPattern (Message, SPLIT_LENGTH);
+  EngineInit (Engine, &Context);
+  Sha2Update (&Context, Message, SPLIT_LENGTH);
+  Sha2Final (&Context, Expected);
+
+  Seed = 1;
+  for (Round = 0; Round < SPLIT_ROUNDS; Round++) {
+    EngineInit (Engine, &Context);
+    for (Offset = 0; Offset < SPLIT_LENGTH; Offset += Piece) {
+      Seed = Seed * 1103515245 + 12345;
+      Piece = MIN ((Seed >> 16) % (3 * SHA384_BLOCK_SIZE), SPLIT_LENGTH - Offset);
+      Sha2Update (&Context, Message + Offset, Piece);
+    }
+    Sha2Final (&Context, Digest);
+    if (CompareMem (Digest, Expected, Engine->DigestSize) != 0) {
+      printf ("  %s: split %u differs from the single update\n", Engine->Name, (UINT32)Round);
+      free (Message);
+      return 1;
+    }
+  }
+
+  free (Message);
+  return 0;
+}
+
+STATIC
+double
+Now (
+  VOID
+  )
+{
+  struct timespec  Time;
+
+  clock_gettime (CLOCK_MONOTONIC, &Time);
+  return Time.tv_sec + Time.tv_nsec / 1e9;
+}
+
+/**
+  Time the compression function alone on BENCH_SIZE bytes, best of
+  BENCH_ROUNDS.
+
+  @return The throughput in MB/s.
+**/
+STATIC
+double
+Bench (
+  IN CONST ENGINE  *Engine,
+  IN CONST UINT8   *Buffer
+  )
+{
+  SHA2_CONTEXT  Context;
+  double        Start;
+  double        Best;
+  UINTN         Round;
+
+  Best = 0;
+  for (Round = 0; Round < BENCH_ROUNDS; Round++) {
+    EngineInit (Engine, &Context);
+    Start = Now ();
+    Engine->Block (&Context.State, Buffer, BENCH_SIZE / Context.BlockSize);
+    Start = Now () - Start;
+    if ((Best == 0) || (Start < Best)) {
+      Best = Start;
+    }
+  }
+  return BENCH_SIZE / Best / (1024 * 1024);
+}
+
+int
+main (
+  int   argc,
+  char  **argv
+  )
+{
+  ENGINE   Engines[3];
+  UINTN    EngineCount;
+  UINT8    *Buffer;
+  UINTN    Failures;
+  UINTN    Total;
+  UINTN    Index;
+
+  EngineCount = 0;
+  Engines[EngineCount++] = (ENGINE){ "SHA-256 C", Sha256BlockC, SHA256_DIGEST_SIZE };
+#if defined (MDE_CPU_AARCH64)
+  // ID_AA64ISAR0_EL1.SHA2, see HashInstanceLibArmCe.c
+  if (((Sha2ArmCeReadIsar0 () >> 12) & 0xF) != 0) {
+    Engines[EngineCount++] = (ENGINE){ "SHA-256 ARMv8 CE", Sha256BlockArmCe, SHA256_DIGEST_SIZE };
+  } else {
+    printf ("no SHA2 instructions on this core, SHA-256 ARMv8 CE not run\n");
+  }
+#endif
+  Engines[EngineCount++] = (ENGINE){ "SHA-384 C", Sha512BlockC, SHA384_DIGEST_SIZE };
+
+  Buffer = malloc (BENCH_SIZE);
+  SweepPattern (Buffer, BENCH_SIZE);
+
+  Total = 0;
+  for (Index = 0; Index < EngineCount; Index++) {
+    Failures = TestKnownAnswers (&Engines[Index]);
+    Failures += TestSplits (&Engines[Index]);
+    printf ("%-20s %7.1f MB/s, %u failures\n",
+      Engines[Index].Name, Bench (&Engines[Index], Buffer), (UINT32)Failures);
+    Total += Failures;
+  }
+
+  free (Buffer);
+  return (Total == 0) ? 0 : 1;
+}
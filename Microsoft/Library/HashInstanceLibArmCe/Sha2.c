@@ -0,0 +1,306 @@
+/** @file
+  SHA-256 and SHA-384 message padding and the portable C compression functions.
+
+  The front end hands every run of whole blocks found in the caller's buffer to
+  the compression function in one call, only the head and tail of an update go
+  through the context buffer. That keeps large payloads such as dbx updates on
+  the fast path of the accelerated compression functions.
+
+  Copyright (c) 2018 Microsoft Corporation. All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+#include "Sha2Internal.h"
+
+#define ROTR32(x, n)    (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTR64(x, n)    (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define CH(x, y, z)     (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z)    (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+#define SIGMA256_0(x)   (ROTR32 (x, 2) ^ ROTR32 (x, 13) ^ ROTR32 (x, 22))
+#define SIGMA256_1(x)   (ROTR32 (x, 6) ^ ROTR32 (x, 11) ^ ROTR32 (x, 25))
+#define SIGMA256_S0(x)  (ROTR32 (x, 7) ^ ROTR32 (x, 18) ^ ((x) >> 3))
+#define SIGMA256_S1(x)  (ROTR32 (x, 17) ^ ROTR32 (x, 19) ^ ((x) >> 10))
+
+#define SIGMA512_0(x)   (ROTR64 (x, 28) ^ ROTR64 (x, 34) ^ ROTR64 (x, 39))
+#define SIGMA512_1(x)   (ROTR64 (x, 14) ^ ROTR64 (x, 18) ^ ROTR64 (x, 41))
+#define SIGMA512_S0(x)  (ROTR64 (x, 1) ^ ROTR64 (x, 8) ^ ((x) >> 7))
+#define SIGMA512_S1(x)  (ROTR64 (x, 19) ^ ROTR64 (x, 61) ^ ((x) >> 6))
+
+STATIC CONST UINT32 mSha256K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+STATIC CONST UINT64 mSha512K[80] = {
+  0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+  0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+  0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+  0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+  0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+  0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+  0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+  0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+  0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+  0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+  0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+  0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+  0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+  0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+  0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+  0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+  0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+  0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+  0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+  0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+  0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+  0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+  0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+  0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+  0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+  0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+  0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+  0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+  0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+  0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+  0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+  0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+  0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+  0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+  0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+  0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+  0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+  0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+  0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+  0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+STATIC CONST UINT32 mSha256H0[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+STATIC CONST UINT64 mSha384H0[8] = {
+  0xcbbb9d5dc1059ed8ULL, 0x629a292a367cd507ULL,
+  0x9159015a3070dd17ULL, 0x152fecd8f70e5939ULL,
+  0x67332667ffc00b31ULL, 0x8eb44a8768581511ULL,
+  0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL
+};
+
+VOID
+EFIAPI
+Sha256BlockC (
+  IN OUT VOID         *State,
+  IN CONST UINT8      *Data,
+  IN UINTN            BlockCount
+  )
+{
+  UINT32 *H;
+  UINT32 W[16];
+  UINT32 A, B, C, D, E, F, G, Hh;
+  UINT32 T1, T2;
+  UINTN Index;
+
+  H = (UINT32 *) State;
+
+  while (BlockCount-- > 0) {
+    A = H[0]; B = H[1]; C = H[2]; D = H[3];
+    E = H[4]; F = H[5]; G = H[6]; Hh = H[7];
+
+    // The schedule is kept as a 16 word ring, W[t & 15] holds W[t].
+    for (Index = 0; Index < 64; Index++) {
+      if (Index < 16) {
+        W[Index] = SwapBytes32 (ReadUnaligned32 ((CONST UINT32 *) (Data + Index * 4)));
+      } else {
+        W[Index & 15] += SIGMA256_S1 (W[(Index - 2) & 15]) +
+                         W[(Index - 7) & 15] +
+                         SIGMA256_S0 (W[(Index - 15) & 15]);
+      }
+
+      T1 = Hh + SIGMA256_1 (E) + CH (E, F, G) + mSha256K[Index] + W[Index & 15];
+      T2 = SIGMA256_0 (A) + MAJ (A, B, C);
+      Hh = G; G = F; F = E; E = D + T1;
+      D = C; C = B; B = A; A = T1 + T2;
+    }
+
+    H[0] += A; H[1] += B; H[2] += C; H[3] += D;
+    H[4] += E; H[5] += F; H[6] += G; H[7] += Hh;
+
+    Data += SHA256_BLOCK_SIZE;
+  }
+}
+
+VOID
+EFIAPI
+Sha512BlockC (
+  IN OUT VOID         *State,
+  IN CONST UINT8      *Data,
+  IN UINTN            BlockCount
+  )
+{
+  UINT64 *H;
+  UINT64 W[16];
+  UINT64 A, B, C, D, E, F, G, Hh;
+  UINT64 T1, T2;
+  UINTN Index;
+
+  H = (UINT64 *) State;
+
+  while (BlockCount-- > 0) {
+    A = H[0]; B = H[1]; C = H[2]; D = H[3];
+    E = H[4]; F = H[5]; G = H[6]; Hh = H[7];
+
+    for (Index = 0; Index < 80; Index++) {
+      if (Index < 16) {
+        W[Index] = SwapBytes64 (ReadUnaligned64 ((CONST UINT64 *) (Data + Index * 8)));
+      } else {
+        W[Index & 15] += SIGMA512_S1 (W[(Index - 2) & 15]) +
+                         W[(Index - 7) & 15] +
+                         SIGMA512_S0 (W[(Index - 15) & 15]);
+      }
+
+      T1 = Hh + SIGMA512_1 (E) + CH (E, F, G) + mSha512K[Index] + W[Index & 15];
+      T2 = SIGMA512_0 (A) + MAJ (A, B, C);
+      Hh = G; G = F; F = E; E = D + T1;
+      D = C; C = B; B = A; A = T1 + T2;
+    }
+
+    H[0] += A; H[1] += B; H[2] += C; H[3] += D;
+    H[4] += E; H[5] += F; H[6] += G; H[7] += Hh;
+
+    Data += SHA384_BLOCK_SIZE;
+  }
+}
+
+VOID
+Sha256Init (
+  OUT SHA2_CONTEXT        *Context,
+  IN SHA2_BLOCK_FUNCTION  Block
+  )
+{
+  ZeroMem (Context, sizeof (*Context));
+  CopyMem (Context->State.H32, mSha256H0, sizeof (mSha256H0));
+  Context->BlockSize = SHA256_BLOCK_SIZE;
+  Context->DigestSize = 32;
+  Context->Block = Block;
+}
+
+VOID
+Sha384Init (
+  OUT SHA2_CONTEXT        *Context
+  )
+{
+  ZeroMem (Context, sizeof (*Context));
+  CopyMem (Context->State.H64, mSha384H0, sizeof (mSha384H0));
+  Context->BlockSize = SHA384_BLOCK_SIZE;
+  Context->DigestSize = 48;
+  Context->Block = Sha512BlockC;
+}
+
+VOID
+Sha2Update (
+  IN OUT SHA2_CONTEXT     *Context,
+  IN CONST VOID           *Data,
+  IN UINTN                DataLength
+  )
+{
+  CONST UINT8 *Bytes;
+  UINTN Count;
+
+  Bytes = (CONST UINT8 *) Data;
+  Context->Length += DataLength;
+
+  if (Context->BufferLength != 0) {
+    Count = MIN (DataLength, Context->BlockSize - Context->BufferLength);
+    CopyMem (Context->Buffer + Context->BufferLength, Bytes, Count);
+    Context->BufferLength += Count;
+    Bytes += Count;
+    DataLength -= Count;
+
+    if (Context->BufferLength < Context->BlockSize) {
+      return;
+    }
+
+    Context->Block (&Context->State, Context->Buffer, 1);
+    Context->BufferLength = 0;
+  }
+
+  Count = DataLength / Context->BlockSize;
+  if (Count != 0) {
+    Context->Block (&Context->State, Bytes, Count);
+    Bytes += Count * Context->BlockSize;
+    DataLength -= Count * Context->BlockSize;
+  }
+
+  if (DataLength != 0) {
+    CopyMem (Context->Buffer, Bytes, DataLength);
+    Context->BufferLength = DataLength;
+  }
+}
+
+VOID
+Sha2Final (
+  IN OUT SHA2_CONTEXT     *Context,
+  OUT UINT8               *Digest
+  )
+{
+  UINTN LengthSize;
+  UINTN Index;
+  UINT64 BitLength;
+
+  // SHA-384 carries a 128 bit length, the top bits are always zero here.
+  LengthSize = (Context->BlockSize == SHA256_BLOCK_SIZE) ? 8 : 16;
+  BitLength = LShiftU64 (Context->Length, 3);
+
+  Context->Buffer[Context->BufferLength++] = 0x80;
+  if (Context->BufferLength > Context->BlockSize - LengthSize) {
+    ZeroMem (Context->Buffer + Context->BufferLength, Context->BlockSize - Context->BufferLength);
+    Context->Block (&Context->State, Context->Buffer, 1);
+    Context->BufferLength = 0;
+  }
+
+  ZeroMem (Context->Buffer + Context->BufferLength, Context->BlockSize - Context->BufferLength);
+  WriteUnaligned64 (
+    (UINT64 *) (Context->Buffer + Context->BlockSize - sizeof (UINT64)),
+    SwapBytes64 (BitLength));
+  Context->Block (&Context->State, Context->Buffer, 1);
+
+  if (Context->BlockSize == SHA256_BLOCK_SIZE) {
+    for (Index = 0; Index < Context->DigestSize / sizeof (UINT32); Index++) {
+      WriteUnaligned32 ((UINT32 *) (Digest + Index * 4), SwapBytes32 (Context->State.H32[Index]));
+    }
+  } else {
+    for (Index = 0; Index < Context->DigestSize / sizeof (UINT64); Index++) {
+      WriteUnaligned64 ((UINT64 *) (Digest + Index * 8), SwapBytes64 (Context->State.H64[Index]));
+    }
+  }
+
+  ZeroMem (Context, sizeof (*Context));
+}
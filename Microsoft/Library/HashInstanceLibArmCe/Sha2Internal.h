@@ -0,0 +1,115 @@
+/** @file
+  Internal definitions of the SHA-256/SHA-384 engine behind HashInstanceLibArmCe.
+
+  Copyright (c) 2018 Microsoft Corporation. All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#ifndef __SHA2_INTERNAL_H__
+#define __SHA2_INTERNAL_H__
+
+#define SHA2_MAX_BLOCK_SIZE     128
+#define SHA256_BLOCK_SIZE       64
+#define SHA384_BLOCK_SIZE       128
+
+/**
+  Compress BlockCount consecutive message blocks into State.
+
+  @param[in, out] State       The chaining state, 8 native endian words.
+  @param[in]      Data        The message blocks, no alignment requirement.
+  @param[in]      BlockCount  The number of blocks at Data, at least 1.
+**/
+typedef
+VOID
+(EFIAPI *SHA2_BLOCK_FUNCTION) (
+  IN OUT VOID         *State,
+  IN CONST UINT8      *Data,
+  IN UINTN            BlockCount
+  );
+
+typedef struct {
+  union {
+    UINT32            H32[8];
+    UINT64            H64[8];
+  } State;
+  UINT64              Length;
+  UINTN               BufferLength;
+  UINTN               BlockSize;
+  UINTN               DigestSize;
+  SHA2_BLOCK_FUNCTION Block;
+  UINT8               Buffer[SHA2_MAX_BLOCK_SIZE];
+} SHA2_CONTEXT;
+
+VOID
+EFIAPI
+Sha256BlockC (
+  IN OUT VOID         *State,
+  IN CONST UINT8      *Data,
+  IN UINTN            BlockCount
+  );
+
+VOID
+EFIAPI
+Sha512BlockC (
+  IN OUT VOID         *State,
+  IN CONST UINT8      *Data,
+  IN UINTN            BlockCount
+  );
+
+#if defined (MDE_CPU_AARCH64)
+
+/**
+  SHA-256 compression using the ARMv8 Crypto Extensions, AArch64/Sha256ArmCe.S.
+  Only callable when Sha2ArmCeReadIsar0() reports the SHA2 instructions.
+**/
+VOID
+EFIAPI
+Sha256BlockArmCe (
+  IN OUT VOID         *State,
+  IN CONST UINT8      *Data,
+  IN UINTN            BlockCount
+  );
+
+UINT64
+EFIAPI
+Sha2ArmCeReadIsar0 (
+  VOID
+  );
+
+#endif
+
+VOID
+Sha256Init (
+  OUT SHA2_CONTEXT        *Context,
+  IN SHA2_BLOCK_FUNCTION  Block
+  );
+
+VOID
+Sha384Init (
+  OUT SHA2_CONTEXT        *Context
+  );
+
+VOID
+Sha2Update (
+  IN OUT SHA2_CONTEXT     *Context,
+  IN CONST VOID           *Data,
+  IN UINTN                DataLength
+  );
+
+/**
+  Pad the message and write the big endian digest, Context->DigestSize bytes.
+**/
+VOID
+Sha2Final (
+  IN OUT SHA2_CONTEXT     *Context,
+  OUT UINT8               *Digest
+  );
+
+#endif // __SHA2_INTERNAL_H__
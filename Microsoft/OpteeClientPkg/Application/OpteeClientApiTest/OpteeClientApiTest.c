@@ -12,6 +12,7 @@
 #include <Library/OpteeClientApiLib.h>
 #include <Library/tee_client_api.h>
 #include <Guid/OpteeTrustedAppGuids.h>
+#include <IndustryStandard/Tpm20.h>
 #include <Library/TimerLib.h>
 
 #include <Protocol/RpmbIo.h>
@@ -25,11 +26,50 @@ MODULE ("TEE Client API Test for OPTEE Client API Lib");
 #define OPTEE_TEST_STORAGE_CMD_WRITE (0)
 #define OPTEE_TEST_STORAGE_CMD_READ  (1)
 
+#define OPTEE_TEST_FTPM_CMD_SUBMIT  (0)
+
+//
+// Benchmarks print CSV rows, see BenchPrintCsv (). They only go through the
+// public TEEC API so the same binary can be pointed at a board or at an
+// emulated secure world (e.g. QEMU running OP-TEE) to compare allocator and
+// transport changes.
+//
+#define BENCH_ITERATIONS              256
+#define BENCH_OPEN_SESSION_ITERATIONS 16
+#define BENCH_TMEM_MAX_SIZE           MAX_COMMAND_SIZE
+
 EFI_HANDLE mImageHandle;
 TEEC_Session mSession;
 TEEC_Context mContext;
 TEEC_SharedMemory mSharedMem;
 
+STATIC CONST UINT32 mBenchAllocSizes[] = { 64, 512, SIZE_4KB, SIZE_32KB, SIZE_256KB };
+STATIC CONST UINT32 mBenchTmemSizes[] = { sizeof (TPM2_COMMAND_HEADER), 256, SIZE_1KB, BENCH_TMEM_MAX_SIZE };
+
+STATIC
+VOID
+GetTaUuid (
+  IN  CONST EFI_GUID  *TaGuid,
+  OUT TEEC_UUID       *TeecUuid
+  )
+{
+  C_ASSERT (sizeof (*TeecUuid) == sizeof (*TaGuid));
+  CopyMem (TeecUuid, TaGuid, sizeof (*TeecUuid));
+
+  TeecUuid->timeLow = SwapBytes32 (TeecUuid->timeLow);
+  TeecUuid->timeMid = SwapBytes16 (TeecUuid->timeMid);
+  TeecUuid->timeHiAndVersion = SwapBytes16 (TeecUuid->timeHiAndVersion);
+}
+
+STATIC
+VOID
+GetHelloWorldTaUuid (
+  OUT TEEC_UUID   *TeecUuid
+  )
+{
+  GetTaUuid (&gOpteeHelloWorldTaGuid, TeecUuid);
+}
+
 VOID
 TeecSharedMemAllocateReleaseTest (
   )
@@ -133,12 +173,7 @@ TeecInvokeCommandTest (
   uint32_t ErrorOrigin;
   TEEC_UUID TeecUuid;
 
-  C_ASSERT (sizeof (TeecUuid) == sizeof (gOpteeHelloWorldTaGuid));
-  CopyMem (&TeecUuid, &gOpteeHelloWorldTaGuid, sizeof (TeecUuid));
-
-  TeecUuid.timeLow = SwapBytes32 (TeecUuid.timeLow);
-  TeecUuid.timeMid = SwapBytes16 (TeecUuid.timeMid);
-  TeecUuid.timeHiAndVersion = SwapBytes16 (TeecUuid.timeHiAndVersion);
+  GetHelloWorldTaUuid (&TeecUuid);
 
   VERIFY_ARE_EQUAL (
     TEEC_Result,
@@ -207,6 +242,396 @@ TeecInvokeCommandTest (
   }
 }
 
+VOID
+TeecInvokeCommandAsyncTest (
+  )
+{
+  uint32_t ErrorOrigin;
+  TEEC_UUID TeecUuid;
+  TEEC_Operation TeecOperation = { 0 };
+  EFI_EVENT CompletionEvent;
+  UINTN EventIndex;
+
+  GetHelloWorldTaUuid (&TeecUuid);
+
+  VERIFY_ARE_EQUAL (
+    TEEC_Result,
+    TEEC_SUCCESS,
+    TEEC_OpenSession (
+      &mContext,
+      &mSession,
+      &TeecUuid,
+      TEEC_LOGIN_PUBLIC,
+      NULL,
+      NULL,
+      &ErrorOrigin));
+
+  TeecOperation.paramTypes = TEEC_PARAM_TYPES (
+                                TEEC_VALUE_INOUT,
+                                TEEC_NONE,
+                                TEEC_NONE,
+                                TEEC_NONE);
+  TeecOperation.params[0].value.a = 0x11;
+
+  VERIFY_ARE_EQUAL (
+    TEEC_Result,
+    TEEC_SUCCESS,
+    TEEC_InvokeCommandAsync (
+      &mSession,
+      OPTEE_TEST_HELLO_WORLD_CMD_INC_A,
+      &TeecOperation,
+      &CompletionEvent,
+      &ErrorOrigin));
+
+  // A second start with the same Operation must be refused while pending.
+  VERIFY_ARE_EQUAL (
+    TEEC_Result,
+    TEEC_ERROR_BAD_STATE,
+    TEEC_InvokeCommandAsync (
+      &mSession,
+      OPTEE_TEST_HELLO_WORLD_CMD_INC_A,
+      &TeecOperation,
+      &CompletionEvent,
+      &ErrorOrigin));
+
+  VERIFY_SUCCEEDED (gBS->WaitForEvent (1, &CompletionEvent, &EventIndex));
+
+  VERIFY_ARE_EQUAL (
+    TEEC_Result,
+    TEEC_SUCCESS,
+    TEEC_InvokeCommandAsyncComplete (&TeecOperation, &ErrorOrigin));
+
+  VERIFY_ARE_EQUAL (
+    uint32_t,
+    0x12,
+    TeecOperation.params[0].value.a);
+
+  // The result was collected, the Operation is no longer known. Cancelling
+  // it must be a no-op.
+  TEEC_RequestCancellation (&TeecOperation);
+  VERIFY_ARE_EQUAL (
+    TEEC_Result,
+    TEEC_ERROR_ITEM_NOT_FOUND,
+    TEEC_InvokeCommandAsyncComplete (&TeecOperation, &ErrorOrigin));
+}
+
+/**
+ Benchmark: SMC round trip of a minimal command, the Hello World TA
+ increment of a value parameter, through TEEC_InvokeCommand and through
+ TEEC_InvokeCommandFast.
+**/
+VOID
+TeecNullCommandBench (
+  )
+{
+  uint32_t ErrorOrigin;
+  TEEC_UUID TeecUuid;
+  TEEC_Operation TeecOperation;
+  BENCH_SAMPLES Samples;
+  UINT64 TimerStart;
+  UINT32 Loop;
+
+  GetHelloWorldTaUuid (&TeecUuid);
+  VERIFY_ARE_EQUAL (
+    TEEC_Result,
+    TEEC_SUCCESS,
+    TEEC_OpenSession (
+      &mContext,
+      &mSession,
+      &TeecUuid,
+      TEEC_LOGIN_PUBLIC,
+      NULL,
+      NULL,
+      &ErrorOrigin));
+
+  VERIFY_IS_TRUE (BenchSamplesInit (&Samples, BENCH_ITERATIONS));
+
+  for (Loop = 0; Loop < BENCH_ITERATIONS; Loop++) {
+    ZeroMem (&TeecOperation, sizeof (TeecOperation));
+    TeecOperation.paramTypes = TEEC_PARAM_TYPES (
+                                  TEEC_VALUE_INOUT,
+                                  TEEC_NONE,
+                                  TEEC_NONE,
+                                  TEEC_NONE);
+
+    TimerStart = HpcTimerStart ();
+    if (TEEC_InvokeCommand (
+          &mSession,
+          OPTEE_TEST_HELLO_WORLD_CMD_INC_A,
+          &TeecOperation,
+          &ErrorOrigin) != TEEC_SUCCESS) {
+      break;
+    }
+    BenchSampleAdd (&Samples, TimerStart);
+  }
+
+  BenchPrintCsvHeader ();
+  BenchPrintCsv (L"NullCommand", 0, &Samples);
+  BenchSamplesFree (&Samples);
+
+  VERIFY_ARE_EQUAL (uint32_t, BENCH_ITERATIONS, Loop);
+
+  // Same command through the value-only fast path.
+  VERIFY_IS_TRUE (BenchSamplesInit (&Samples, BENCH_ITERATIONS));
+
+  for (Loop = 0; Loop < BENCH_ITERATIONS; Loop++) {
+    ZeroMem (&TeecOperation, sizeof (TeecOperation));
+    TeecOperation.paramTypes = TEEC_PARAM_TYPES (
+                                  TEEC_VALUE_INOUT,
+                                  TEEC_NONE,
+                                  TEEC_NONE,
+                                  TEEC_NONE);
+    TeecOperation.params[0].value.a = Loop;
+
+    TimerStart = HpcTimerStart ();
+    if (TEEC_InvokeCommandFast (
+          &mSession,
+          OPTEE_TEST_HELLO_WORLD_CMD_INC_A,
+          &TeecOperation,
+          &ErrorOrigin) != TEEC_SUCCESS) {
+      break;
+    }
+    BenchSampleAdd (&Samples, TimerStart);
+
+    if (TeecOperation.params[0].value.a != Loop + 1) {
+      break;
+    }
+  }
+
+  BenchPrintCsv (L"NullCommandFast", 0, &Samples);
+  BenchSamplesFree (&Samples);
+
+  VERIFY_ARE_EQUAL (uint32_t, BENCH_ITERATIONS, Loop);
+}
+
+/**
+ Benchmark: TEEC_AllocateSharedMemory and TEEC_ReleaseSharedMemory cost per
+ size class, a size class the pool cannot satisfy is reported empty.
+**/
+VOID
+TeecSharedMemAllocFreeBench (
+  )
+{
+  BENCH_SAMPLES AllocSamples;
+  BENCH_SAMPLES FreeSamples;
+  TEEC_SharedMemory SharedMem;
+  UINT64 TimerStart;
+  UINT32 Loop;
+  UINTN SizeIndex;
+
+  VERIFY_IS_TRUE (BenchSamplesInit (&AllocSamples, BENCH_ITERATIONS));
+  VERIFY_IS_TRUE (BenchSamplesInit (&FreeSamples, BENCH_ITERATIONS));
+
+  BenchPrintCsvHeader ();
+
+  for (SizeIndex = 0; SizeIndex < sizeof (mBenchAllocSizes) / sizeof (mBenchAllocSizes[0]); SizeIndex++) {
+    AllocSamples.Count = 0;
+    FreeSamples.Count = 0;
+
+    for (Loop = 0; Loop < BENCH_ITERATIONS; Loop++) {
+      ZeroMem (&SharedMem, sizeof (SharedMem));
+      SharedMem.size = mBenchAllocSizes[SizeIndex];
+
+      TimerStart = HpcTimerStart ();
+      if (TEEC_AllocateSharedMemory (&mContext, &SharedMem) != TEEC_SUCCESS) {
+        break;
+      }
+      BenchSampleAdd (&AllocSamples, TimerStart);
+
+      TimerStart = HpcTimerStart ();
+      TEEC_ReleaseSharedMemory (&SharedMem);
+      BenchSampleAdd (&FreeSamples, TimerStart);
+    }
+
+    BenchPrintCsv (L"ShmAlloc", mBenchAllocSizes[SizeIndex], &AllocSamples);
+    BenchPrintCsv (L"ShmFree", mBenchAllocSizes[SizeIndex], &FreeSamples);
+  }
+
+  BenchSamplesFree (&AllocSamples);
+  BenchSamplesFree (&FreeSamples);
+}
+
+/**
+ Benchmark: TEEC_OpenSession cost. Cold opens have no other session to the
+ TA, so OP-TEE loads the TA through the LOAD_TA RPC every time. Warm opens
+ are done while a first session keeps the TA resident.
+**/
+VOID
+TeecOpenSessionBench (
+  )
+{
+  uint32_t ErrorOrigin;
+  TEEC_UUID TeecUuid;
+  TEEC_Session Session;
+  BENCH_SAMPLES Samples;
+  UINT64 TimerStart;
+  UINT32 Loop;
+  BOOLEAN Warm;
+
+  GetHelloWorldTaUuid (&TeecUuid);
+  VERIFY_IS_TRUE (BenchSamplesInit (&Samples, BENCH_OPEN_SESSION_ITERATIONS));
+
+  BenchPrintCsvHeader ();
+
+  for (Warm = FALSE; ; Warm = TRUE) {
+    if (Warm) {
+      VERIFY_ARE_EQUAL (
+        TEEC_Result,
+        TEEC_SUCCESS,
+        TEEC_OpenSession (
+          &mContext,
+          &mSession,
+          &TeecUuid,
+          TEEC_LOGIN_PUBLIC,
+          NULL,
+          NULL,
+          &ErrorOrigin));
+    }
+
+    Samples.Count = 0;
+    for (Loop = 0; Loop < BENCH_OPEN_SESSION_ITERATIONS; Loop++) {
+      ZeroMem (&Session, sizeof (Session));
+
+      TimerStart = HpcTimerStart ();
+      if (TEEC_OpenSession (
+            &mContext,
+            &Session,
+            &TeecUuid,
+            TEEC_LOGIN_PUBLIC,
+            NULL,
+            NULL,
+            &ErrorOrigin) != TEEC_SUCCESS) {
+        break;
+      }
+      BenchSampleAdd (&Samples, TimerStart);
+
+      TEEC_CloseSession (&Session);
+    }
+
+    BenchPrintCsv (Warm ? L"OpenSessionWarm" : L"OpenSessionCold", 0, &Samples);
+
+    if (Warm) {
+      break;
+    }
+  }
+
+  BenchSamplesFree (&Samples);
+}
+
+/**
+ Benchmark: per byte cost of a TMEM parameter. Each sample copies the payload
+ from private memory into shared memory, as a caller of the temp memref path
+ has to, and submits it to the fTPM TA, which takes a command memref and
+ returns a response memref. The payload is a TPM2_GetRandom header whose
+ commandSize covers the whole payload, the TPM answers the extra bytes with
+ an error response code; only the transport has to succeed.
+**/
+VOID
+TeecTmemTransferBench (
+  )
+{
+  uint32_t ErrorOrigin;
+  TEEC_UUID TeecUuid;
+  TEEC_Operation TeecOperation;
+  TEEC_Result TeecResult;
+  BENCH_SAMPLES Samples;
+  TPM2_COMMAND_HEADER *Command;
+  UINT8 *Payload;
+  UINT8 *Response;
+  UINT64 TimerStart;
+  UINT32 Loop;
+  UINTN SizeIndex;
+
+  GetTaUuid (&gOpteeFtpmTaGuid, &TeecUuid);
+  VERIFY_ARE_EQUAL (
+    TEEC_Result,
+    TEEC_SUCCESS,
+    TEEC_OpenSession (
+      &mContext,
+      &mSession,
+      &TeecUuid,
+      TEEC_LOGIN_PUBLIC,
+      NULL,
+      NULL,
+      &ErrorOrigin));
+
+  mSharedMem.size = BENCH_TMEM_MAX_SIZE + MAX_RESPONSE_SIZE;
+  mSharedMem.flags = TEEC_MEM_INPUT | TEEC_MEM_OUTPUT;
+  VERIFY_ARE_EQUAL (
+    TEEC_Result,
+    TEEC_SUCCESS,
+    TEEC_AllocateSharedMemory (&mContext, &mSharedMem));
+  Response = (UINT8 *)mSharedMem.buffer + BENCH_TMEM_MAX_SIZE;
+
+  VERIFY_IS_TRUE (BenchSamplesInit (&Samples, BENCH_ITERATIONS));
+
+  Payload = AllocatePool (BENCH_TMEM_MAX_SIZE);
+  if (Payload == NULL) {
+    BenchSamplesFree (&Samples);
+    VERIFY_IS_NOT_NULL (Payload);
+  }
+  SetMem (Payload, BENCH_TMEM_MAX_SIZE, 0x5A);
+
+  Command = (TPM2_COMMAND_HEADER *)Payload;
+  Command->tag = SwapBytes16 (TPM_ST_NO_SESSIONS);
+  Command->commandCode = SwapBytes32 (TPM_CC_GetRandom);
+
+  BenchPrintCsvHeader ();
+
+  TeecResult = TEEC_SUCCESS;
+  for (SizeIndex = 0; SizeIndex < sizeof (mBenchTmemSizes) / sizeof (mBenchTmemSizes[0]); SizeIndex++) {
+    Samples.Count = 0;
+    Command->paramSize = SwapBytes32 (mBenchTmemSizes[SizeIndex]);
+
+    for (Loop = 0; Loop < BENCH_ITERATIONS; Loop++) {
+      ZeroMem (&TeecOperation, sizeof (TeecOperation));
+      TeecOperation.paramTypes = TEEC_PARAM_TYPES (
+                                    TEEC_MEMREF_TEMP_INPUT,
+                                    TEEC_MEMREF_TEMP_INOUT,
+                                    TEEC_NONE,
+                                    TEEC_NONE);
+      TeecOperation.params[0].tmpref.buffer = mSharedMem.buffer;
+      TeecOperation.params[0].tmpref.size = mBenchTmemSizes[SizeIndex];
+      TeecOperation.params[1].tmpref.buffer = Response;
+      TeecOperation.params[1].tmpref.size = MAX_RESPONSE_SIZE;
+
+      TimerStart = HpcTimerStart ();
+      CopyMem (mSharedMem.buffer, Payload, mBenchTmemSizes[SizeIndex]);
+      TeecResult = TEEC_InvokeCommand (
+                     &mSession,
+                     OPTEE_TEST_FTPM_CMD_SUBMIT,
+                     &TeecOperation,
+                     &ErrorOrigin);
+
+      if ((TeecResult != TEEC_SUCCESS) ||
+          (TeecOperation.params[1].tmpref.size < sizeof (TPM2_RESPONSE_HEADER))) {
+        LOG_ERROR (
+          "fTPM submit of %d bytes failed. (TeecResult=0x%X, ErrorOrigin=%d, Response=%d bytes)",
+          mBenchTmemSizes[SizeIndex],
+          TeecResult,
+          ErrorOrigin,
+          (UINT32)TeecOperation.params[1].tmpref.size);
+        if (TeecResult == TEEC_SUCCESS) {
+          TeecResult = TEEC_ERROR_COMMUNICATION;
+        }
+        break;
+      }
+      BenchSampleAdd (&Samples, TimerStart);
+    }
+
+    if (TeecResult != TEEC_SUCCESS) {
+      break;
+    }
+
+    BenchPrintCsv (L"TmemTransfer", mBenchTmemSizes[SizeIndex], &Samples);
+  }
+
+  BenchSamplesFree (&Samples);
+  FreePool (Payload);
+
+  VERIFY_ARE_EQUAL (TEEC_Result, TEEC_SUCCESS, TeecResult);
+}
+
 BOOLEAN
 ModuleSetup (
   VOID
@@ -280,6 +705,11 @@ UefiMain (
   TEST_CLEANUP (TestCleanup);
   TEST_FUNC (TeecSharedMemAllocateReleaseTest);
   TEST_FUNC (TeecInvokeCommandTest);
+  TEST_FUNC (TeecInvokeCommandAsyncTest);
+  TEST_FUNC (TeecNullCommandBench);
+  TEST_FUNC (TeecSharedMemAllocFreeBench);
+  TEST_FUNC (TeecOpenSessionBench);
+  TEST_FUNC (TeecTmemTransferBench);
 
   if (!RUN_MODULE (0, NULL)) {
     return EFI_ABORTED;
@@ -0,0 +1,213 @@
+/** @file
+*
+*  Shell application that dumps the OP-TEE client RPC dispatch profile of every
+*  driver publishing the OP-TEE Client Profile protocol.
+*
+*  Usage: OpteeClientProfile [-r]
+*    -r  Reset the counters after dumping them.
+*
+*  Copyright (c) 2018 Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Protocol/LoadedImage.h>
+#include <Protocol/OpteeClientProfile.h>
+#include <Protocol/ShellParameters.h>
+
+STATIC CONST CHAR16 *mRpcTypeStr[OpteeProfileRpcMax] = {
+  L"ALLOC",
+  L"FREE",
+  L"FOREIGN_INTR",
+  L"LOAD_TA",
+  L"RPMB",
+  L"GET_TIME",
+  L"SHM_ALLOC",
+  L"SHM_FREE",
+  L"WAIT_QUEUE",
+  L"OTHER"
+};
+
+STATIC
+UINT64
+TicksToMicroSeconds (
+  IN UINT64   Ticks,
+  IN UINT64   Frequency
+  )
+{
+  if (Frequency == 0) {
+    return 0;
+  }
+
+  // Split to avoid overflowing the multiplication on long runs.
+  return MultU64x32 (DivU64x64Remainder (Ticks, Frequency, NULL), 1000000) +
+         DivU64x64Remainder (
+           MultU64x32 (ModU64x32 (Ticks, (UINT32) Frequency), 1000000),
+           Frequency,
+           NULL);
+}
+
+STATIC
+VOID
+PrintCall (
+  IN CONST CHAR16                     *Title,
+  IN CONST OPTEE_CLIENT_PROFILE_CALL  *Call,
+  IN UINT64                           Frequency
+  )
+{
+  UINTN Index;
+  UINT64 RpcTicks;
+
+  RpcTicks = 0;
+  for (Index = 0; Index < OpteeProfileRpcMax; Index++) {
+    RpcTicks += Call->Rpc[Index].Ticks;
+  }
+
+  Print (L"  %s:\n", Title);
+  Print (
+    L"    Total=%ldus Secure=%ldus NormalRpc=%ldus Smc=%ld BytesIn=%ld BytesOut=%ld\n",
+    TicksToMicroSeconds (Call->TotalTicks, Frequency),
+    TicksToMicroSeconds (Call->SecureTicks, Frequency),
+    TicksToMicroSeconds (RpcTicks, Frequency),
+    Call->SmcCount,
+    Call->BytesIn,
+    Call->BytesOut);
+
+  for (Index = 0; Index < OpteeProfileRpcMax; Index++) {
+    if (Call->Rpc[Index].Count == 0) {
+      continue;
+    }
+
+    Print (
+      L"    %-12s Count=%ld Time=%ldus Bytes=%ld\n",
+      mRpcTypeStr[Index],
+      Call->Rpc[Index].Count,
+      TicksToMicroSeconds (Call->Rpc[Index].Ticks, Frequency),
+      Call->Rpc[Index].Bytes);
+  }
+}
+
+STATIC
+VOID
+PrintProfile (
+  IN OPTEE_CLIENT_PROFILE_PROTOCOL  *Profile
+  )
+{
+  EFI_STATUS Status;
+  OPTEE_CLIENT_PROFILE_STATS Stats;
+  EFI_LOADED_IMAGE_PROTOCOL *LoadedImage;
+  CHAR16 *ImageName;
+
+  ImageName = NULL;
+  Status = gBS->HandleProtocol (
+                  Profile->ImageHandle,
+                  &gEfiLoadedImageProtocolGuid,
+                  (VOID **) &LoadedImage);
+
+  if (!EFI_ERROR (Status)) {
+    ImageName = ConvertDevicePathToText (LoadedImage->FilePath, TRUE, TRUE);
+  }
+
+  Print (L"Driver %s (Handle=%p)\n", (ImageName != NULL) ? ImageName : L"?", Profile->ImageHandle);
+
+  if (ImageName != NULL) {
+    FreePool (ImageName);
+  }
+
+  Status = Profile->GetStats (Profile, &Stats);
+  if (EFI_ERROR (Status)) {
+    Print (L"  GetStats() failed. (Status=%r)\n", Status);
+    return;
+  }
+
+  Print (
+    L"  Calls=%ld Invokes=%ld MaxCall=%ldus TickFrequency=%ldHz\n",
+    Stats.CallCount,
+    Stats.InvokeCount,
+    TicksToMicroSeconds (Stats.MaxTotalTicks, Stats.TickFrequency),
+    Stats.TickFrequency);
+
+  if (Stats.CallCount == 0) {
+    return;
+  }
+
+  PrintCall (L"Total", &Stats.Total, Stats.TickFrequency);
+  PrintCall (L"Last", &Stats.Last, Stats.TickFrequency);
+}
+
+EFI_STATUS
+EFIAPI
+UefiMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS Status;
+  EFI_SHELL_PARAMETERS_PROTOCOL *ShellParameters;
+  OPTEE_CLIENT_PROFILE_PROTOCOL *Profile;
+  EFI_HANDLE *Handles;
+  UINTN HandleCount;
+  UINTN Index;
+  BOOLEAN Reset;
+
+  Reset = FALSE;
+  Status = gBS->HandleProtocol (
+                  ImageHandle,
+                  &gEfiShellParametersProtocolGuid,
+                  (VOID **) &ShellParameters);
+
+  if (!EFI_ERROR (Status) && (ShellParameters->Argc > 1)) {
+    if (StrCmp (ShellParameters->Argv[1], L"-r") == 0) {
+      Reset = TRUE;
+    } else {
+      Print (L"Usage: OpteeClientProfile [-r]\n");
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gOpteeClientProfileProtocolGuid,
+                  NULL,
+                  &HandleCount,
+                  &Handles);
+
+  if (EFI_ERROR (Status)) {
+    Print (L"No OP-TEE client profile found, is PcdOpteeClientProfileEnable set?\n");
+    return Status;
+  }
+
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol (
+                    Handles[Index],
+                    &gOpteeClientProfileProtocolGuid,
+                    (VOID **) &Profile);
+
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    PrintProfile (Profile);
+
+    if (Reset) {
+      Profile->Reset (Profile);
+    }
+  }
+
+  FreePool (Handles);
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,264 @@
+/** @file
+*
+*  Shell application that dumps the OP-TEE shared memory usage of every driver
+*  publishing the OP-TEE Client Shared Memory Tracker protocol.
+*
+*  Usage: OpteeClientShmTrack [-r]
+*    -r  Reset the counters and high-water marks after dumping them.
+*
+*  Copyright (c) 2018 Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Protocol/LoadedImage.h>
+#include <Protocol/OpteeClientShmTrack.h>
+#include <Protocol/ShellParameters.h>
+
+STATIC CONST CHAR16 *mSiteStr[OpteeShmSiteMax] = {
+  L"SharedMemory",
+  L"MsgArg",
+  L"ReservedMsgArg",
+  L"Rpc",
+  L"RpcPayloadPool"
+};
+
+STATIC CONST CHAR16 *mLifetimeStr[OPTEE_SHM_TRACK_LIFETIME_BUCKETS] = {
+  L"<100us",
+  L"<1ms",
+  L"<10ms",
+  L"<100ms",
+  L"<1s",
+  L"<10s",
+  L">=10s"
+};
+
+// Sum over all owners, the pool is shared by all of them.
+STATIC UINT64 mTotalLiveBytes;
+STATIC UINT64 mTotalPeakBytes;
+STATIC UINT64 mPoolSize;
+
+STATIC
+VOID
+PrintLive (
+  IN OPTEE_CLIENT_SHM_TRACK_PROTOCOL  *Track,
+  IN EFI_LOADED_IMAGE_PROTOCOL        *LoadedImage OPTIONAL
+  )
+{
+  EFI_STATUS Status;
+  OPTEE_CLIENT_SHM_TRACK_RECORD *Records;
+  UINTN Count;
+  UINTN Index;
+  UINT64 ImageBase;
+
+  Count = 0;
+  Track->GetLive (Track, &Count, NULL);
+  if (Count == 0) {
+    return;
+  }
+
+  Records = AllocatePool (Count * sizeof (*Records));
+  if (Records == NULL) {
+    return;
+  }
+
+  Status = Track->GetLive (Track, &Count, Records);
+  if (EFI_ERROR (Status)) {
+    Print (L"  GetLive() failed. (Status=%r)\n", Status);
+    goto Exit;
+  }
+
+  Print (L"  Live blocks:\n");
+  for (Index = 0; Index < Count; Index++) {
+    Print (
+      L"    %-14s Address=0x%lx Size=0x%lx BlockSize=0x%lx Age=%ldus",
+      mSiteStr[Records[Index].Site],
+      Records[Index].Address,
+      Records[Index].Size,
+      Records[Index].BlockSize,
+      Records[Index].AgeUs);
+
+    // Print call sites as image offsets to look them up in the map file.
+    if (Records[Index].CallSite != 0) {
+      ImageBase = (LoadedImage != NULL) ? (UINT64) (UINTN) LoadedImage->ImageBase : 0;
+      if ((LoadedImage != NULL) &&
+          (Records[Index].CallSite >= ImageBase) &&
+          (Records[Index].CallSite < ImageBase + LoadedImage->ImageSize)) {
+        Print (L" CallSite=+0x%lx", Records[Index].CallSite - ImageBase);
+      } else {
+        Print (L" CallSite=0x%lx", Records[Index].CallSite);
+      }
+    }
+
+    Print (L"\n");
+  }
+
+Exit:
+  FreePool (Records);
+}
+
+STATIC
+VOID
+PrintTrack (
+  IN OPTEE_CLIENT_SHM_TRACK_PROTOCOL  *Track
+  )
+{
+  EFI_STATUS Status;
+  OPTEE_CLIENT_SHM_TRACK_STATS Stats;
+  EFI_LOADED_IMAGE_PROTOCOL *LoadedImage;
+  CHAR16 *ImageName;
+  UINTN Index;
+
+  ImageName = NULL;
+  Status = gBS->HandleProtocol (
+                  Track->ImageHandle,
+                  &gEfiLoadedImageProtocolGuid,
+                  (VOID **) &LoadedImage);
+
+  if (EFI_ERROR (Status)) {
+    LoadedImage = NULL;
+  } else {
+    ImageName = ConvertDevicePathToText (LoadedImage->FilePath, TRUE, TRUE);
+  }
+
+  Print (L"Owner %s (Handle=%p)\n", (ImageName != NULL) ? ImageName : L"?", Track->ImageHandle);
+
+  if (ImageName != NULL) {
+    FreePool (ImageName);
+  }
+
+  Status = Track->GetStats (Track, &Stats);
+  if (EFI_ERROR (Status)) {
+    Print (L"  GetStats() failed. (Status=%r)\n", Status);
+    return;
+  }
+
+  mPoolSize = Stats.PoolSize;
+  mTotalLiveBytes += Stats.LiveBytes;
+  mTotalPeakBytes += Stats.PeakBytes;
+
+  Print (
+    L"  Allocs=%ld Frees=%ld Fails=%ld LargestFail=0x%lx\n",
+    Stats.AllocCount,
+    Stats.FreeCount,
+    Stats.FailCount,
+    Stats.LargestFailure);
+
+  Print (
+    L"  Live=%ld (0x%lx bytes) Peak=%ld (0x%lx bytes) Untracked=%ld\n",
+    Stats.LiveCount,
+    Stats.LiveBytes,
+    Stats.PeakCount,
+    Stats.PeakBytes,
+    Stats.Untracked);
+
+  for (Index = 0; Index < OpteeShmSiteMax; Index++) {
+    if (Stats.SiteCount[Index] != 0) {
+      Print (
+        L"    %-14s Allocs=%ld Bytes=0x%lx\n",
+        mSiteStr[Index],
+        Stats.SiteCount[Index],
+        Stats.SiteBytes[Index]);
+    }
+  }
+
+  Print (L"  Size classes:");
+  for (Index = 0; Index < OPTEE_SHM_TRACK_SIZE_CLASSES - 1; Index++) {
+    Print (L" <=0x%lx:%ld", LShiftU64 (256, Index), Stats.SizeClass[Index]);
+  }
+  Print (L" >0x10000:%ld\n", Stats.SizeClass[OPTEE_SHM_TRACK_SIZE_CLASSES - 1]);
+
+  Print (L"  Lifetimes:");
+  for (Index = 0; Index < OPTEE_SHM_TRACK_LIFETIME_BUCKETS; Index++) {
+    Print (L" %s:%ld", mLifetimeStr[Index], Stats.Lifetime[Index]);
+  }
+  Print (L" live:%ld\n", Stats.LiveCount);
+
+  PrintLive (Track, LoadedImage);
+}
+
+EFI_STATUS
+EFIAPI
+UefiMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS Status;
+  EFI_SHELL_PARAMETERS_PROTOCOL *ShellParameters;
+  OPTEE_CLIENT_SHM_TRACK_PROTOCOL *Track;
+  EFI_HANDLE *Handles;
+  UINTN HandleCount;
+  UINTN Index;
+  BOOLEAN Reset;
+
+  Reset = FALSE;
+  Status = gBS->HandleProtocol (
+                  ImageHandle,
+                  &gEfiShellParametersProtocolGuid,
+                  (VOID **) &ShellParameters);
+
+  if (!EFI_ERROR (Status) && (ShellParameters->Argc > 1)) {
+    if (StrCmp (ShellParameters->Argv[1], L"-r") == 0) {
+      Reset = TRUE;
+    } else {
+      Print (L"Usage: OpteeClientShmTrack [-r]\n");
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gOpteeClientShmTrackProtocolGuid,
+                  NULL,
+                  &HandleCount,
+                  &Handles);
+
+  if (EFI_ERROR (Status)) {
+    Print (L"No OP-TEE shared memory tracker found, is PcdOpteeClientShmTrackEnable set?\n");
+    return Status;
+  }
+
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol (
+                    Handles[Index],
+                    &gOpteeClientShmTrackProtocolGuid,
+                    (VOID **) &Track);
+
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    PrintTrack (Track);
+
+    if (Reset) {
+      Track->Reset (Track);
+    }
+  }
+
+  FreePool (Handles);
+
+  // The owners peaked at different times, their sum is an upper bound of the
+  // pool high-water mark.
+  Print (
+    L"Pool 0x%lx bytes: Live=0x%lx, Sum of owner peaks=0x%lx\n",
+    mPoolSize,
+    mTotalLiveBytes,
+    mTotalPeakBytes);
+
+  return EFI_SUCCESS;
+}
@@ -49,6 +49,8 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Guid/ImageAuthentication.h>
 #include <Guid/OpteeTrustedAppGuids.h>
 
+#include <AuthVarLog.h>
+
 #include <limits.h>
 
 #ifndef min
@@ -107,11 +109,6 @@ NTSTATUS codes from the Auth. Var. TA tha we need to specially handle.
 #define STATUS_BUFFER_TOO_SMALL          (0xC0000023L)
 #define STATUS_NOT_FOUND                 (0xC0000225L)
 
-/*
-Macro to turn on memory leak check on exit boot services.
-*/
-//#define MEMORY_LEAK_CHECK_ON_EXIT_BOOT
-
 /*
 Define a single union of all the outbound parameter structures.
 Some are variable sized and thus overlay a single allocated buffer.
@@ -176,6 +173,71 @@ These must be allocated using the OpTEE client API set.
 TEEC_SharedMemory  mVariableParamMem;
 TEEC_SharedMemory  mVariableResultMem;
 
+/*
+Normal-world read cache of variable data. Only results read back from the TA
+are cached, into private memory rather than the shared transport buffers.
+Any successful SetVariable drops the whole cache since the TA may update
+other variables as a side effect. The services are not available at runtime,
+so the cache is simply left behind at ExitBootServices, where pool must not be
+freed. Entries are kept in LRU order and their total size is bounded by PcdAuthVarReadCacheSize,
+0 disables the cache.
+*/
+
+#define VARIABLE_CACHE_ENTRY_SIGNATURE  SIGNATURE_32('A', 'V', 'C', 'E')
+
+typedef struct _VARIABLE_CACHE_ENTRY {
+  UINT32      Signature;
+  LIST_ENTRY  Link;
+  EFI_GUID    VendorGuid;
+  BOOLEAN     Found;
+  UINT32      Attributes;
+  UINT32      VariableNameSize;
+  UINT32      DataSize;
+  UINT32      EntrySize;
+  //
+  // Followed by VariableNameSize bytes of name and DataSize bytes of data.
+  //
+} VARIABLE_CACHE_ENTRY;
+
+#define VARIABLE_CACHE_ENTRY_FROM_LINK(a) \
+  CR (a, VARIABLE_CACHE_ENTRY, Link, VARIABLE_CACHE_ENTRY_SIGNATURE)
+
+#define VARIABLE_CACHE_ENTRY_NAME(e)  ((CHAR16 *)((e) + 1))
+#define VARIABLE_CACHE_ENTRY_DATA(e)  ((UINT8 *)((e) + 1) + (e)->VariableNameSize)
+
+LIST_ENTRY  mVariableCache = INITIALIZE_LIST_HEAD_VARIABLE(mVariableCache);
+UINT32      mVariableCacheSize = 0;
+
+/*
+Normal-world copy of the QueryVariableInfo answers, one slot per attribute
+mask asked for. The maximum sizes never change. Only the writes that take
+space are charged to the remaining size: appends, and new variables the read
+cache knows are absent, with VARIABLE_INFO_ENTRY_OVERHEAD standing in for the
+TA per-variable bookkeeping. Overwrites and deletes free space in amounts only
+the TA knows, so they drop the copy rather than credit an estimate back. The
+copy is also dropped, and the TA asked again, on any SetVariable failure, on
+authenticated writes whose stored size the TA decides, and every
+VARIABLE_INFO_RESYNC_INTERVAL updates to bound the error of the overhead
+estimate.
+*/
+
+#define VARIABLE_INFO_CACHE_SLOTS       4
+#define VARIABLE_INFO_RESYNC_INTERVAL   32
+#define VARIABLE_INFO_ENTRY_OVERHEAD    sizeof(VARIABLE_SET_PARAM)
+#define VARIABLE_INFO_CLASS_MASK        (EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_HARDWARE_ERROR_RECORD)
+
+typedef struct _VARIABLE_INFO_CACHE_ENTRY {
+  BOOLEAN     Valid;
+  UINT32      Attributes;
+  UINT64      MaximumVariableStorageSize;
+  UINT64      RemainingVariableStorageSize;
+  UINT64      MaximumVariableSize;
+} VARIABLE_INFO_CACHE_ENTRY;
+
+VARIABLE_INFO_CACHE_ENTRY  mVariableInfoCache[VARIABLE_INFO_CACHE_SLOTS];
+UINT32                     mVariableInfoNextSlot = 0;
+UINT32                     mVariableInfoUpdateCount = 0;
+
 GLOBAL_REMOVE_IF_UNREFERENCED CONST CHAR8 *mSetupModeNames[] = {
   "UserMode",
   "SetupMode"
@@ -289,6 +351,223 @@ Exit:
 }
 
 
+/**
+Drop every entry of the variable read cache.
+**/
+VOID
+OpteeRuntimeVariableCacheFlush(
+  VOID
+)
+{
+  VARIABLE_CACHE_ENTRY *Entry;
+
+  while (!IsListEmpty(&mVariableCache)) {
+    Entry = VARIABLE_CACHE_ENTRY_FROM_LINK(GetFirstNode(&mVariableCache));
+    RemoveEntryList(&Entry->Link);
+    FreePool(Entry);
+  }
+
+  mVariableCacheSize = 0;
+}
+
+
+/**
+Look up a variable in the read cache and make it the most recently used.
+@param[in]      VariableNameSize   Size of the variable name, including the terminator.
+@param[in]      VariableName       Name of the variable to look for.
+@param[in]      VendorGuid         Vendor GUID of the variable to look for.
+@retval         The cache entry, or NULL on a cache miss.
+**/
+VARIABLE_CACHE_ENTRY *
+OpteeRuntimeVariableCacheFind(
+  IN UINT32     VariableNameSize,
+  IN CHAR16     *VariableName,
+  IN EFI_GUID   *VendorGuid
+)
+{
+  LIST_ENTRY *Link;
+  VARIABLE_CACHE_ENTRY *Entry;
+
+  for (Link = GetFirstNode(&mVariableCache);
+    !IsNull(&mVariableCache, Link);
+    Link = GetNextNode(&mVariableCache, Link)) {
+
+    Entry = VARIABLE_CACHE_ENTRY_FROM_LINK(Link);
+    if ((Entry->VariableNameSize == VariableNameSize) &&
+      CompareGuid(&Entry->VendorGuid, VendorGuid) &&
+      (CompareMem(VARIABLE_CACHE_ENTRY_NAME(Entry), VariableName, VariableNameSize) == 0)) {
+
+      RemoveEntryList(&Entry->Link);
+      InsertHeadList(&mVariableCache, &Entry->Link);
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+
+/**
+Record the outcome of a variable read from the TA in the read cache,
+evicting the least recently used entries to stay within the size bound.
+@param[in]      VariableNameSize   Size of the variable name, including the terminator.
+@param[in]      VariableName       Name of the variable.
+@param[in]      VendorGuid         Vendor GUID of the variable.
+@param[in]      Found              FALSE to remember that the variable does not exist.
+@param[in]      Attributes         Attributes of the variable.
+@param[in]      DataSize           Size of the variable data.
+@param[in]      Data               The variable data.
+**/
+VOID
+OpteeRuntimeVariableCacheInsert(
+  IN UINT32       VariableNameSize,
+  IN CHAR16       *VariableName,
+  IN EFI_GUID     *VendorGuid,
+  IN BOOLEAN      Found,
+  IN UINT32       Attributes,
+  IN UINT32       DataSize,
+  IN CONST VOID   *Data
+)
+{
+  VARIABLE_CACHE_ENTRY *Entry;
+  UINT32 CacheMaxSize;
+  UINT32 EntrySize;
+
+  CacheMaxSize = FixedPcdGet32(PcdAuthVarReadCacheSize);
+  if (CacheMaxSize == 0) {
+    return;
+  }
+
+  //
+  // Keep large variables such as dbx from washing out the hot small ones.
+  //
+  EntrySize = sizeof(VARIABLE_CACHE_ENTRY) + VariableNameSize + DataSize;
+  if ((VariableNameSize > CacheMaxSize) ||
+    (DataSize > CacheMaxSize) ||
+    (EntrySize > CacheMaxSize / 4)) {
+    return;
+  }
+
+  Entry = OpteeRuntimeVariableCacheFind(VariableNameSize, VariableName, VendorGuid);
+  if (Entry != NULL) {
+    RemoveEntryList(&Entry->Link);
+    mVariableCacheSize -= Entry->EntrySize;
+    FreePool(Entry);
+  }
+
+  while (!IsListEmpty(&mVariableCache) &&
+    (mVariableCacheSize + EntrySize > CacheMaxSize)) {
+
+    Entry = VARIABLE_CACHE_ENTRY_FROM_LINK(GetPreviousNode(&mVariableCache, &mVariableCache));
+    RemoveEntryList(&Entry->Link);
+    mVariableCacheSize -= Entry->EntrySize;
+    FreePool(Entry);
+  }
+
+  Entry = AllocatePool(EntrySize);
+  if (Entry == NULL) {
+    return;
+  }
+
+  Entry->Signature = VARIABLE_CACHE_ENTRY_SIGNATURE;
+  CopyMem(&Entry->VendorGuid, VendorGuid, sizeof(Entry->VendorGuid));
+  Entry->Found = Found;
+  Entry->Attributes = Attributes;
+  Entry->VariableNameSize = VariableNameSize;
+  Entry->DataSize = DataSize;
+  Entry->EntrySize = EntrySize;
+  CopyMem(VARIABLE_CACHE_ENTRY_NAME(Entry), VariableName, VariableNameSize);
+  CopyMem(VARIABLE_CACHE_ENTRY_DATA(Entry), Data, DataSize);
+
+  InsertHeadList(&mVariableCache, &Entry->Link);
+  mVariableCacheSize += EntrySize;
+}
+
+
+/**
+Drop the QueryVariableInfo copy, the next query goes to the TA.
+**/
+VOID
+OpteeRuntimeVariableInfoInvalidate(
+  VOID
+)
+{
+  ZeroMem(mVariableInfoCache, sizeof(mVariableInfoCache));
+  mVariableInfoUpdateCount = 0;
+}
+
+
+/**
+Account a successful SetVariable in the QueryVariableInfo copy. Must run
+before the read cache is flushed, it looks up there whether the variable
+existed.
+@param[in]      VariableNameSize   Size of the variable name, including the terminator.
+@param[in]      VariableName       Name of the variable.
+@param[in]      VendorGuid         Vendor GUID of the variable.
+@param[in]      Attributes         Attributes passed to SetVariable.
+@param[in]      DataSize           Data size passed to SetVariable.
+**/
+VOID
+OpteeRuntimeVariableInfoAccountSet(
+  IN UINT32     VariableNameSize,
+  IN CHAR16     *VariableName,
+  IN EFI_GUID   *VendorGuid,
+  IN UINT32     Attributes,
+  IN UINTN      DataSize
+)
+{
+  VARIABLE_CACHE_ENTRY *Entry;
+  VARIABLE_INFO_CACHE_ENTRY *Info;
+  UINT32 Class;
+  UINT64 Used;
+  UINTN Index;
+
+  if (Attributes & (EFI_VARIABLE_AUTHENTICATED_WRITE_ACCESS |
+    EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS)) {
+
+    OpteeRuntimeVariableInfoInvalidate();
+    return;
+  }
+
+  Entry = OpteeRuntimeVariableCacheFind(VariableNameSize, VariableName, VendorGuid);
+
+  if (Attributes & EFI_VARIABLE_APPEND_WRITE) {
+    Used = DataSize;
+    if ((Entry == NULL) || !Entry->Found) {
+      Used += VARIABLE_INFO_ENTRY_OVERHEAD + VariableNameSize;
+    }
+  } else if ((Entry != NULL) && !Entry->Found && (Attributes != 0) && (DataSize != 0)) {
+    Used = VARIABLE_INFO_ENTRY_OVERHEAD + VariableNameSize + DataSize;
+  } else {
+    //
+    // An overwrite or a delete, of a variable that may exist. What it frees
+    // is up to the TA.
+    //
+    OpteeRuntimeVariableInfoInvalidate();
+    return;
+  }
+
+  Class = Attributes & VARIABLE_INFO_CLASS_MASK;
+  for (Index = 0; Index < VARIABLE_INFO_CACHE_SLOTS; Index++) {
+    Info = &mVariableInfoCache[Index];
+    if (!Info->Valid || ((Info->Attributes & VARIABLE_INFO_CLASS_MASK) != Class)) {
+      continue;
+    }
+
+    if (Info->RemainingVariableStorageSize < Used) {
+      OpteeRuntimeVariableInfoInvalidate();
+      return;
+    }
+
+    Info->RemainingVariableStorageSize -= Used;
+  }
+
+  if (++mVariableInfoUpdateCount >= VARIABLE_INFO_RESYNC_INTERVAL) {
+    OpteeRuntimeVariableInfoInvalidate();
+  }
+}
+
+
 /**
 This code finds variable in storage blocks (Volatile or Non-Volatile).
 Caution: This function may receive untrusted input.
@@ -377,6 +656,36 @@ OpteeRuntimeGetVariable(
 
   LOG_TRACE("LocalDataSize is 0x%x", LocalDataSize);
 
+  {
+    VARIABLE_CACHE_ENTRY *CacheEntry;
+
+    CacheEntry = OpteeRuntimeVariableCacheFind(LocalVariableNameSize, VariableName, VendorGuid);
+    if (CacheEntry != NULL) {
+      if (!CacheEntry->Found) {
+        LOG_TRACE("Get: Not found (cached)");
+        Status = EFI_NOT_FOUND;
+        goto Exit;
+      }
+
+      if (Attributes != NULL) {
+        *Attributes = CacheEntry->Attributes;
+      }
+
+      if (CacheEntry->DataSize > LocalDataSize) {
+        LOG_TRACE("Get Variable: Buffer too small (cached)");
+        *DataSize = CacheEntry->DataSize;
+        Status = EFI_BUFFER_TOO_SMALL;
+        goto Exit;
+      }
+
+      LOG_TRACE("Get Variable Success (cached)");
+      CopyMem(Data, VARIABLE_CACHE_ENTRY_DATA(CacheEntry), CacheEntry->DataSize);
+      *DataSize = CacheEntry->DataSize;
+      Status = EFI_SUCCESS;
+      goto Exit;
+    }
+  }
+
   {
     PVARIABLE_PARAM  VariableParam = (PVARIABLE_PARAM)mVariableParamMem.buffer;
     PVARIABLE_RESULT VariableResult = (PVARIABLE_RESULT)mVariableResultMem.buffer;
@@ -424,10 +733,11 @@ OpteeRuntimeGetVariable(
     }
 
     //
-    // Clear the buffers entirely to start with.
+    // Only clear what is actually transferred, the TA is handed the exact
+    // lengths and the buffers are sized for the largest variable.
     //
-    ZeroMem(mVariableParamMem.buffer, mVariableParamMem.size);
-    ZeroMem(mVariableResultMem.buffer, mVariableResultMem.size);
+    ZeroMem(mVariableParamMem.buffer, VariableParamSize);
+    ZeroMem(mVariableResultMem.buffer, sizeof(VARIABLE_GET_RESULT));
 
     //
     // Fill in the parameter fields.
@@ -464,6 +774,14 @@ OpteeRuntimeGetVariable(
     } else {
       if (Status == EFI_NOT_FOUND) {
         LOG_TRACE("Get: Not found");
+        OpteeRuntimeVariableCacheInsert(
+          LocalVariableNameSize,
+          VariableName,
+          VendorGuid,
+          FALSE,
+          0,
+          0,
+          NULL);
       } else {
         LOG_ERROR("GET VARIABLE FAIL '%S': 0x%x (OP-TEE Status:0x%x)", VariableName, Status, AuthvarStatus);
       }
@@ -496,6 +814,14 @@ OpteeRuntimeGetVariable(
 
     CopyMem(Data, VariableResult->GetResult.Data, VariableResult->GetResult.DataSize);
 
+    OpteeRuntimeVariableCacheInsert(
+      LocalVariableNameSize,
+      VariableName,
+      VendorGuid,
+      TRUE,
+      VariableResult->GetResult.Attributes,
+      (UINT32)*DataSize,
+      Data);
   }
 
 Exit:
@@ -614,10 +940,10 @@ OpteeRuntimeGetNextVariableName(
     }
 
     //
-    // Clear the buffers entirely to start with.
+    // Only clear what is actually transferred.
     //
-    SetMem(mVariableParamMem.buffer, mVariableParamMem.size, 0);
-    SetMem(mVariableResultMem.buffer, mVariableResultMem.size, 0);
+    ZeroMem(mVariableParamMem.buffer, VariableParamSize);
+    ZeroMem(mVariableResultMem.buffer, sizeof(VARIABLE_GET_NEXT_RESULT));
 
     //
     // Fill in the parameter fields.
@@ -752,6 +1078,8 @@ OpteeRuntimeSetVariable(
 
     UINTN *SessionId = (UINTN *)Data;
     mTeecSession.session_id = *SessionId;
+    OpteeRuntimeVariableCacheFlush();
+    OpteeRuntimeVariableInfoInvalidate();
     LOG_INFO("Test Hook for Injecting Session ID");
     return EFI_SUCCESS;
   }
@@ -793,10 +1121,14 @@ OpteeRuntimeSetVariable(
     }
 
     //
-    // Clear the buffers entirely to start with.
+    // Only clear the header and the slack after the payload, the payload
+    // itself is fully written below. No result comes back from a set beyond
+    // the status, so the result buffer is left alone.
     //
-    ZeroMem(mVariableParamMem.buffer, mVariableParamMem.size);
-    ZeroMem(mVariableResultMem.buffer, mVariableResultMem.size);
+    ZeroMem(mVariableParamMem.buffer, OFFSET_OF(VARIABLE_SET_PARAM, Payload));
+    ZeroMem(
+      &VariableParam->SetParam.Payload[VariableNameSize + DataSize],
+      VariableParamSize - OFFSET_OF(VARIABLE_SET_PARAM, Payload) - VariableNameSize - DataSize);
 
     //
     // Fill in the parameter fields.
@@ -826,15 +1158,23 @@ OpteeRuntimeSetVariable(
         LOG_TRACE("Set - Delete : Not found");
       } else {
         LOG_ERROR("SET VARIABLE FAIL '%S': 0x%x (OP-TEE Status:0x%x)", VariableName, Status, AuthvarStatus);
+        OpteeRuntimeVariableInfoInvalidate();
       }
       goto Exit;
     } else {
       LOG_TRACE("Set Variable Success");
+      OpteeRuntimeVariableInfoAccountSet(
+        (UINT32)VariableNameSize,
+        VariableName,
+        VendorGuid,
+        Attributes,
+        DataSize);
     }
   }
 
 Exit:
   if (!EFI_ERROR(Status)) {
+    OpteeRuntimeVariableCacheFlush();
     SecureBootHook(VariableName, VendorGuid);
   }
 
@@ -870,6 +1210,8 @@ OpteeRuntimeQueryVariableInfo(
   //PERF_START(mImageHandle, QUERY_VAR_INFO_TOK, NULL, 0);
 
   EFI_STATUS Status = EFI_SUCCESS;
+  VARIABLE_INFO_CACHE_ENTRY *Info;
+  UINTN Index;
 
   if (EfiAtRuntime()) {
     Status = EFI_UNSUPPORTED;
@@ -892,6 +1234,16 @@ OpteeRuntimeQueryVariableInfo(
     goto Exit;
   }
 
+  for (Index = 0; Index < VARIABLE_INFO_CACHE_SLOTS; Index++) {
+    Info = &mVariableInfoCache[Index];
+    if (Info->Valid && (Info->Attributes == Attributes)) {
+      *MaximumVariableStorageSize = Info->MaximumVariableStorageSize;
+      *RemainingVariableStorageSize = Info->RemainingVariableStorageSize;
+      *MaximumVariableSize = Info->MaximumVariableSize;
+      goto Exit;
+    }
+  }
+
   {
     PVARIABLE_PARAM  VariableParam = (PVARIABLE_PARAM)mVariableParamMem.buffer;
     PVARIABLE_RESULT VariableResult = (PVARIABLE_RESULT)mVariableResultMem.buffer;
@@ -914,10 +1266,10 @@ OpteeRuntimeQueryVariableInfo(
     }
 
     //
-    // Clear the buffers entirely to start with.
+    // Only clear what is actually transferred.
     //
-    SetMem(mVariableParamMem.buffer, mVariableParamMem.size, 0);
-    SetMem(mVariableResultMem.buffer, mVariableResultMem.size, 0);
+    ZeroMem(mVariableParamMem.buffer, VariableParamSize);
+    ZeroMem(mVariableResultMem.buffer, VariableResultSize);
 
     //
     // Fill in the parameter fields.
@@ -943,6 +1295,14 @@ OpteeRuntimeQueryVariableInfo(
     *MaximumVariableStorageSize = VariableResult->QueryResult.MaximumVariableStorageSize;
     *RemainingVariableStorageSize = VariableResult->QueryResult.RemainingVariableStorageSize;
     *MaximumVariableSize = VariableResult->QueryResult.MaximumVariableSize;
+
+    Info = &mVariableInfoCache[mVariableInfoNextSlot];
+    mVariableInfoNextSlot = (mVariableInfoNextSlot + 1) % VARIABLE_INFO_CACHE_SLOTS;
+    Info->Valid = TRUE;
+    Info->Attributes = Attributes;
+    Info->MaximumVariableStorageSize = *MaximumVariableStorageSize;
+    Info->RemainingVariableStorageSize = *RemainingVariableStorageSize;
+    Info->MaximumVariableSize = *MaximumVariableSize;
   }
 
 
@@ -1204,6 +1564,124 @@ Exit:
   return Status;
 }
 
+/*
+Binary variable operation log, VarLog.bin: a VAR_LOG_FILE_HEADER followed by
+EntryCount VAR_LOG_ENTRY records exactly as they are laid out in memory, see
+AuthVarLog.h. VarLogToTsv.py converts it to the tab separated layout of
+the text log, which is still written to VarLog.txt when
+PcdAuthVarLogTextFormat is set. Either way the log is staged in one large
+buffer so that it normally takes a single File->Write.
+*/
+#define VAR_LOG_TEXT_LINE_CHAR_COUNT    256
+#define VAR_LOG_WRITE_BUFFER_MAX_SIZE   SIZE_1MB
+
+typedef struct _VAR_LOG_WRITER {
+  EFI_FILE_PROTOCOL *File;
+  UINT8 *Buffer;
+  UINTN BufferSize;
+  UINTN Used;
+} VAR_LOG_WRITER;
+
+STATIC
+EFI_STATUS
+VarLogWriterFlush(
+  IN OUT VAR_LOG_WRITER *Writer
+)
+{
+  EFI_STATUS Status;
+  UINTN WriteByteCount;
+
+  if (Writer->Used == 0) {
+    return EFI_SUCCESS;
+  }
+
+  WriteByteCount = Writer->Used;
+  Status = Writer->File->Write(Writer->File, &WriteByteCount, Writer->Buffer);
+  if (EFI_ERROR(Status)) {
+    LOG_ERROR("File->Write() failed. (Status=%r)", Status);
+    return Status;
+  }
+  ASSERT(WriteByteCount == Writer->Used);
+
+  Writer->Used = 0;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+VarLogWriterAppend(
+  IN OUT VAR_LOG_WRITER *Writer,
+  IN CONST VOID         *Data,
+  IN UINTN              Size
+)
+{
+  EFI_STATUS Status;
+  UINTN Count;
+
+  while (Size != 0) {
+    if (Writer->Used == Writer->BufferSize) {
+      Status = VarLogWriterFlush(Writer);
+      if (EFI_ERROR(Status)) {
+        return Status;
+      }
+    }
+
+    Count = min(Size, Writer->BufferSize - Writer->Used);
+    CopyMem(Writer->Buffer + Writer->Used, Data, Count);
+    Writer->Used += Count;
+    Data = (CONST UINT8 *)Data + Count;
+    Size -= Count;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/*
+Format one entry as a VarLog.txt line straight into the writer buffer.
+*/
+STATIC
+EFI_STATUS
+VarLogWriterAppendText(
+  IN OUT VAR_LOG_WRITER   *Writer,
+  IN UINTN                LogIndex,
+  IN CONST VAR_LOG_ENTRY  *LogEntry
+)
+{
+  EFI_STATUS Status;
+  UINTN FormattedCharCount;
+
+  if ((Writer->BufferSize - Writer->Used) < (VAR_LOG_TEXT_LINE_CHAR_COUNT * sizeof(CHAR16))) {
+    Status = VarLogWriterFlush(Writer);
+    if (EFI_ERROR(Status)) {
+      return Status;
+    }
+  }
+
+  FormattedCharCount = UnicodeSPrint(
+    (CHAR16 *)(Writer->Buffer + Writer->Used),
+    VAR_LOG_TEXT_LINE_CHAR_COUNT * sizeof(CHAR16),
+    L"%u\t%u\t%a\t%s\t%d\t%u\t"
+    L"%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t0x%08x\n",
+    (UINT32)LogIndex,
+    LogEntry->StartTimeMs,
+    mOperationStr[LogEntry->Operation],
+    (LogEntry->StrParam[0] == L'\0') ? L"NA" : LogEntry->StrParam,
+    LogEntry->IntParam,
+    LogEntry->DurationMs,
+    (UINT32)LogEntry->CacheRebuildCount,
+    LogEntry->CacheRebuildDurationMs,
+    (UINT32)LogEntry->IsNV,
+    (UINT32)LogEntry->IsBS,
+    (UINT32)LogEntry->IsTimeAuthWrite,
+    (UINT32)LogEntry->IsAuthWrite,
+    (UINT32)LogEntry->IsAppendWrite,
+    (UINT32)LogEntry->IsHwError,
+    LogEntry->Status);
+
+  Writer->Used += FormattedCharCount * sizeof(CHAR16);
+  return EFI_SUCCESS;
+}
+
 EFI_STATUS
 OpteeRuntimeVariableWriteLogToDisk(
   IN CONST VAR_LOG_ENTRY  *LogBuffer,
@@ -1217,13 +1695,16 @@ OpteeRuntimeVariableWriteLogToDisk(
   EFI_HANDLE MediaHandle = NULL;
   EFI_DEVICE_PATH_PROTOCOL *DevicePath = NULL;
   EFI_DEVICE_PATH_PROTOCOL *IntermediateDevicePath = NULL;
-  CONST UINTN StrBufferCharCount = 256;
-  CHAR16 StrBuffer[StrBufferCharCount];
-  UINTN FormattedCharCount;
+  VAR_LOG_WRITER Writer;
+  VAR_LOG_FILE_HEADER Header;
   UINTN LogIndex;
-  UINTN WriteByteCount;
+  UINTN TotalSize;
+  BOOLEAN TextFormat;
   CONST CHAR16 *DevicePathText;
 
+  ZeroMem(&Writer, sizeof(Writer));
+  TextFormat = FeatureFlagPcd(PcdAuthVarLogTextFormat);
+
   if (LogCount == 0) {
     goto Exit;
   }
@@ -1237,6 +1718,40 @@ OpteeRuntimeVariableWriteLogToDisk(
     goto Exit;
   }
 
+  DevicePath = ConvertTextToDevicePath(DevicePathText);
+  if (DevicePath == NULL) {
+    Status = EFI_INVALID_PARAMETER;
+    LOG_ERROR("ConvertTextToDevicePath(%s) failed", DevicePathText);
+    goto Exit;
+  }
+
+  //
+  // Stage the whole log when it fits, shrink the buffer on allocation
+  // failure down to a single text line.
+  //
+  if (TextFormat) {
+    TotalSize = LogCount * VAR_LOG_TEXT_LINE_CHAR_COUNT * sizeof(CHAR16);
+  } else {
+    TotalSize = sizeof(Header) + (LogCount * sizeof(*LogBuffer));
+  }
+
+  Writer.BufferSize = min(TotalSize, VAR_LOG_WRITE_BUFFER_MAX_SIZE);
+  for (;;) {
+    Writer.Buffer = AllocatePool(Writer.BufferSize);
+    if ((Writer.Buffer != NULL) ||
+        (Writer.BufferSize <= VAR_LOG_TEXT_LINE_CHAR_COUNT * sizeof(CHAR16))) {
+      break;
+    }
+
+    Writer.BufferSize = MAX(Writer.BufferSize / 2, VAR_LOG_TEXT_LINE_CHAR_COUNT * sizeof(CHAR16));
+  }
+
+  if (Writer.Buffer == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    LOG_ERROR("AllocatePool() failed. (Status=%r)", Status);
+    goto Exit;
+  }
+
   IntermediateDevicePath = DevicePath;
   Status = gBS->LocateDevicePath(
     &gEfiSimpleFileSystemProtocolGuid,
@@ -1282,7 +1797,7 @@ OpteeRuntimeVariableWriteLogToDisk(
   Status = RootVolume->Open(
     RootVolume,
     &File,
-    L"VarLog.txt",
+    TextFormat ? L"VarLog.txt" : L"VarLog.bin",
     EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
     0);
 
@@ -1297,42 +1812,36 @@ OpteeRuntimeVariableWriteLogToDisk(
     goto Exit;
   }
 
-  for (LogIndex = 0; LogIndex < LogCount; ++LogIndex) {
-
-    FormattedCharCount = UnicodeSPrint(
-      StrBuffer,
-      sizeof(StrBuffer),
-      L"%u\t%u\t%a\t%s\t%d\t%u\t"
-      L"%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t0x%08x\n",
-      (UINT32)LogIndex,
-      LogBuffer->StartTimeMs,
-      mOperationStr[LogBuffer->Operation],
-      (LogBuffer->StrParam[0] == L'\0') ? L"NA" : LogBuffer->StrParam,
-      LogBuffer->IntParam,
-      LogBuffer->DurationMs,
-      (UINT32)LogBuffer->CacheRebuildCount,
-      LogBuffer->CacheRebuildDurationMs,
-      (UINT32)LogBuffer->IsNV,
-      (UINT32)LogBuffer->IsBS,
-      (UINT32)LogBuffer->IsTimeAuthWrite,
-      (UINT32)LogBuffer->IsAuthWrite,
-      (UINT32)LogBuffer->IsAppendWrite,
-      (UINT32)LogBuffer->IsHwError,
-      LogBuffer->Status);
-
-    WriteByteCount = FormattedCharCount * sizeof(CHAR16);
-    Status = File->Write(
-      File,
-      &WriteByteCount,
-      StrBuffer);
+  Writer.File = File;
 
+  if (TextFormat) {
+    for (LogIndex = 0; LogIndex < LogCount; ++LogIndex) {
+      Status = VarLogWriterAppendText(&Writer, LogIndex, &LogBuffer[LogIndex]);
+      if (EFI_ERROR(Status)) {
+        goto Exit;
+      }
+    }
+  } else {
+    Header.Signature = VAR_LOG_FILE_SIGNATURE;
+    Header.Version = VAR_LOG_FILE_VERSION;
+    Header.HeaderSize = sizeof(Header);
+    Header.EntrySize = sizeof(*LogBuffer);
+    Header.EntryCount = (UINT32)LogCount;
+
+    Status = VarLogWriterAppend(&Writer, &Header, sizeof(Header));
+    if (EFI_ERROR(Status)) {
+      goto Exit;
+    }
+
+    Status = VarLogWriterAppend(&Writer, LogBuffer, LogCount * sizeof(*LogBuffer));
     if (EFI_ERROR(Status)) {
-      LOG_ERROR("File->Write() failed. (Status=%r)", Status);
       goto Exit;
     }
-    ASSERT(WriteByteCount == FormattedCharCount * sizeof(CHAR16));
+  }
 
-    LogBuffer++;
+  Status = VarLogWriterFlush(&Writer);
+  if (EFI_ERROR(Status)) {
+    goto Exit;
   }
 
   LOG_INFO("Opened media and log is written successfully");
@@ -1364,6 +1873,9 @@ Exit:
     Fs = NULL;
   }
 
+  if (Writer.Buffer != NULL) {
+    FreePool(Writer.Buffer);
+  }
 
   if (DevicePath != NULL) {
     FreePool(DevicePath);
@@ -1466,6 +1978,12 @@ OpteeRuntimeOnExitBootServices(
   TEEC_ReleaseSharedMemory(&mVariableParamMem);
   TEEC_ReleaseSharedMemory(&mVariableResultMem);
 
+  OpteeRuntimeVariableInfoInvalidate();
+
+  //
+  // Checks for leaked shared memory, PcdOpteeClientShmTrackEnable also lists
+  // the leaked blocks with their call sites.
+  //
   OpteeClientApiFinalize();
 
   LOG_TRACE("Status=%r", Status);
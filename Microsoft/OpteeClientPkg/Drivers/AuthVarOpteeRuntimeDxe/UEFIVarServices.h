@@ -122,25 +122,3 @@ typedef struct _VS_GET_FRAG_STATS
                                   EFI_VARIABLE_AUTHENTICATED_WRITE_ACCESS |\
                                   EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS |\
                                   EFI_VARIABLE_APPEND_WRITE)
-
-
-#define VAR_LOG_STR_PARAM_MAX_LENGTH 31
-
-#pragma pack(push, 1)
-typedef struct _VAR_LOG_ENTRY {
-    UINT32 StartTimeMs;
-    UINT32 DurationMs;
-    UINT32 Status;
-    INT32 IntParam;
-    UINT8 Operation;
-    WCHAR StrParam[VAR_LOG_STR_PARAM_MAX_LENGTH];
-    UINT32 CacheRebuildDurationMs;
-    UINT8 CacheRebuildCount;
-    UINT8 IsNV;
-    UINT8 IsBS;
-    UINT8 IsTimeAuthWrite;
-    UINT8 IsAuthWrite;
-    UINT8 IsAppendWrite;
-    UINT8 IsHwError;
-} VAR_LOG_ENTRY;
-#pragma pack(pop)
\ No newline at end of file
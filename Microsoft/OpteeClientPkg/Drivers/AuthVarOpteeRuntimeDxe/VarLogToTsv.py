@@ -0,0 +1,86 @@
+## @file
+#  Convert the binary VarLog.bin written by AuthVarOpteeRuntimeDxe to the tab
+#  separated layout of VarLog.txt.
+#
+#  Usage: python VarLogToTsv.py VarLog.bin [VarLog.tsv]
+#
+#  Copyright (c) 2018 Microsoft Corporation. All rights reserved.
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+##
+
+import struct
+import sys
+
+# VAR_LOG_FILE_HEADER and VAR_LOG_ENTRY, both packed, see
+# Microsoft/OpteeClientPkg/Include/AuthVarLog.h.
+HEADER = struct.Struct("<4sHHII")
+ENTRY = struct.Struct("<IIIiB62sIBBBBBBB")
+SIGNATURE = b"VLOG"
+VERSION = 1
+
+# Mirrors mOperationStr in AuthVarsDxe.c.
+OPERATIONS = [
+    "",
+    "",
+    "VSGetOp",
+    "VSGetNextVarOp",
+    "VSSetOp",
+    "VSQueryInfoOp",
+    "VSSignalExitBootServicesOp",
+]
+
+
+def convert(data, out):
+    if len(data) < HEADER.size:
+        raise ValueError("file too short for the header")
+
+    signature, version, header_size, entry_size, entry_count = HEADER.unpack_from(data)
+    if signature != SIGNATURE or version != VERSION:
+        raise ValueError("not a version %d VarLog.bin" % VERSION)
+
+    if entry_size < ENTRY.size:
+        raise ValueError("entry size %d is smaller than expected" % entry_size)
+
+    if header_size + entry_size * entry_count > len(data):
+        raise ValueError("file truncated, %d entries expected" % entry_count)
+
+    for index in range(entry_count):
+        (start, duration, status, int_param, operation, str_param,
+         rebuild_duration, rebuild_count, is_nv, is_bs, is_time_auth,
+         is_auth, is_append, is_hw_error) = ENTRY.unpack_from(data, header_size + index * entry_size)
+
+        name = str_param.decode("utf-16-le").split("\0", 1)[0] or "NA"
+        op = OPERATIONS[operation] if operation < len(OPERATIONS) else str(operation)
+
+        out.write("%u\t%u\t%s\t%s\t%d\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t0x%08x\n" % (
+            index, start, op, name, int_param, duration, rebuild_count, rebuild_duration,
+            is_nv, is_bs, is_time_auth, is_auth, is_append, is_hw_error, status))
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.stderr.write("Usage: %s VarLog.bin [VarLog.tsv]\n" % sys.argv[0])
+        return 1
+
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+
+    if len(sys.argv) == 3:
+        with open(sys.argv[2], "w") as out:
+            convert(data, out)
+    else:
+        convert(data, sys.stdout)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
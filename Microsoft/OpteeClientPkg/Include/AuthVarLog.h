@@ -0,0 +1,67 @@
+/** @file
+*
+*  Layout of VarLog.bin, the variable operation log written by
+*  AuthVarOpteeRuntimeDxe and replayed by AuthVarTest.
+*
+*  Copyright (c) 2018 Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __AUTH_VAR_LOG_H__
+#define __AUTH_VAR_LOG_H__
+
+#define VAR_LOG_STR_PARAM_MAX_LENGTH  31
+
+//
+// VarLog.bin is a VAR_LOG_FILE_HEADER followed by EntryCount VAR_LOG_ENTRY
+// records of EntrySize bytes each.
+//
+#define VAR_LOG_FILE_SIGNATURE  SIGNATURE_32 ('V', 'L', 'O', 'G')
+#define VAR_LOG_FILE_VERSION    1
+
+//
+// VAR_LOG_ENTRY.Operation values: the Auth. Var. TA operation codes offset
+// by two, which index mOperationStr in AuthVarsDxe.c.
+//
+#define VAR_LOG_OP_GET                        2
+#define VAR_LOG_OP_GET_NEXT                   3
+#define VAR_LOG_OP_SET                        4
+#define VAR_LOG_OP_QUERY                      5
+#define VAR_LOG_OP_SIGNAL_EXIT_BOOT_SERVICES  6
+
+#pragma pack(push, 1)
+typedef struct {
+  UINT32  Signature;
+  UINT16  Version;
+  UINT16  HeaderSize;
+  UINT32  EntrySize;
+  UINT32  EntryCount;
+} VAR_LOG_FILE_HEADER;
+
+typedef struct {
+  UINT32  StartTimeMs;
+  UINT32  DurationMs;
+  UINT32  Status;
+  INT32   IntParam;
+  UINT8   Operation;
+  CHAR16  StrParam[VAR_LOG_STR_PARAM_MAX_LENGTH];
+  UINT32  CacheRebuildDurationMs;
+  UINT8   CacheRebuildCount;
+  UINT8   IsNV;
+  UINT8   IsBS;
+  UINT8   IsTimeAuthWrite;
+  UINT8   IsAuthWrite;
+  UINT8   IsAppendWrite;
+  UINT8   IsHwError;
+} VAR_LOG_ENTRY;
+#pragma pack(pop)
+
+#endif // __AUTH_VAR_LOG_H__
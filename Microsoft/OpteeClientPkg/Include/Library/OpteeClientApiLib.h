@@ -17,6 +17,8 @@
 #ifndef __OPTEE_CLIENT_API_LIB_H__
 #define __OPTEE_CLIENT_API_LIB_H__
 
+#include <Library/tee_client_api.h>
+
 EFI_STATUS
 OpteeClientApiInitialize (
   IN EFI_HANDLE   ImageHandle
@@ -27,6 +29,84 @@ OpteeClientApiFinalize (
   VOID
   );
 
+/**
+  Invokes a command whose parameters are all values.
+
+  Behaves as TEEC_InvokeCommand() but is meant for small signal-style commands:
+  the values are packed straight into a message block the library keeps for
+  synchronous calls and only the parameters up to the last one in use are
+  sent, so the call costs no shared memory allocation nor parameter
+  translation. OpTEE still reads the message block from shared memory, TA
+  commands have no register-only calling convention.
+
+  @param[in] Session        The session to invoke the command in.
+  @param[in] CommandID      The TA command identifier.
+  @param[in,out] Operation  The command parameters, TEEC_NONE and TEEC_VALUE_*
+                            only. May be NULL.
+  @param[out] ReturnOrigin  The origin of the result, may be NULL.
+
+  @retval TEEC_ERROR_BAD_PARAMETERS   Operation holds a memory reference.
+  @retval TEEC_Result                 As TEEC_InvokeCommand().
+**/
+TEEC_Result
+TEEC_InvokeCommandFast (
+  IN TEEC_Session       *Session,
+  IN uint32_t           CommandID,
+  IN OUT TEEC_Operation *Operation,
+  OUT uint32_t          *ReturnOrigin
+  );
+
+/**
+  Starts a TEEC_InvokeCommand without waiting for it to complete.
+
+  The command is resumed from a TPL_CALLBACK timer whenever secure world hands
+  the core back, so long TA operations no longer hold up the rest of DXE.
+  CompletionEvent is signaled once the command completed, the caller then
+  collects the result with TEEC_InvokeCommandAsyncComplete(). The Operation
+  identifies the command for TEEC_RequestCancellation() and must stay valid
+  until then.
+
+  TEEC_CloseSession() cancels the commands still running on the session and
+  waits for them to complete, their results can still be collected.
+  OpteeClientApiFinalize() does the same for all of them. The results nobody
+  collected are dropped when the image unloads.
+
+  @param[in] Session          The session to invoke the command in.
+  @param[in] CommandID        The TA command identifier.
+  @param[in] Operation        The command parameters, must not be NULL.
+  @param[out] CompletionEvent The event signaled on completion. It is owned
+                              by the library, closed by
+                              TEEC_InvokeCommandAsyncComplete().
+  @param[out] ReturnOrigin    The origin of a failure to start, may be NULL.
+
+  @retval TEEC_SUCCESS  The command was started, it may already have completed.
+  @retval TEEC_Result   The command could not be started.
+**/
+TEEC_Result
+TEEC_InvokeCommandAsync (
+  IN TEEC_Session     *Session,
+  IN uint32_t         CommandID,
+  IN TEEC_Operation   *Operation,
+  OUT EFI_EVENT       *CompletionEvent,
+  OUT uint32_t        *ReturnOrigin
+  );
+
+/**
+  Collects the result of a command started by TEEC_InvokeCommandAsync().
+
+  @param[in] Operation      The Operation passed to TEEC_InvokeCommandAsync().
+  @param[out] ReturnOrigin  The origin of the result, may be NULL.
+
+  @retval TEEC_ERROR_BUSY   The command has not completed yet.
+  @retval TEEC_Result       The command result, as TEEC_InvokeCommand() would
+                            have returned it.
+**/
+TEEC_Result
+TEEC_InvokeCommandAsyncComplete (
+  IN TEEC_Operation   *Operation,
+  OUT uint32_t        *ReturnOrigin
+  );
+
 #endif // __OPTEE_CLIENT_API_LIB_H__
 
 
@@ -0,0 +1,50 @@
+/** @file
+  Extensions specific to the OP-TEE fTPM instance of Tpm2DeviceLib.
+
+  The fTPM session owns a long lived shared memory region holding a command
+  and a response area. Callers that know they are linked against this
+  instance can build TPM commands straight into the command area and read
+  responses out of the response area, which lets Tpm2SubmitCommand skip
+  both copies.
+
+  Copyright (c) Microsoft Corporation. All rights reserved.
+
+  This program and the accompanying materials are licensed and made available under
+  the terms and conditions of the BSD License which accompanies this distribution.
+  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#ifndef __TPM2_DEVICE_LIB_OPTEE_H__
+#define __TPM2_DEVICE_LIB_OPTEE_H__
+
+/**
+  Get the fTPM session command and response areas.
+
+  A command built in CommandBuffer and submitted with Tpm2SubmitCommand is
+  sent in place. Passing ResponseBuffer as the output block leaves the
+  response in place. The areas are only valid until the TPM is relinquished
+  and are overwritten by the next Tpm2SubmitCommand.
+
+  @param[out] CommandBuffer       Receives the command area.
+  @param[out] CommandBufferSize   Receives the size of the command area.
+  @param[out] ResponseBuffer      Receives the response area.
+  @param[out] ResponseBufferSize  Receives the size of the response area.
+
+  @retval EFI_SUCCESS             The areas were returned.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+  @retval EFI_NOT_READY           The fTPM session is not open.
+**/
+EFI_STATUS
+EFIAPI
+Tpm2OpteeGetCommandBuffer (
+  OUT UINT8     **CommandBuffer,
+  OUT UINT32    *CommandBufferSize,
+  OUT UINT8     **ResponseBuffer,
+  OUT UINT32    *ResponseBufferSize
+  );
+
+#endif // __TPM2_DEVICE_LIB_OPTEE_H__
@@ -0,0 +1,114 @@
+/** @file
+*
+*  OP-TEE Client Profile protocol exposes the RPC dispatch accounting gathered
+*  by the OpteeClientApiLib instance linked into a driver. It allows telling
+*  apart time spent in the secure world (TA execution) from time spent in the
+*  normal world servicing RPCs (RPMB I/O, shared memory churn, TA loading).
+*
+*  Each driver linking OpteeClientApiLib installs its own instance of the
+*  protocol on its image handle when PcdOpteeClientProfileEnable is TRUE.
+*
+*  Copyright (c) 2018, Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __OPTEE_CLIENT_PROFILE_H__
+#define __OPTEE_CLIENT_PROFILE_H__
+
+// Global ID for the OP-TEE Client Profile Protocol {5C0FCB3A-6E1B-4C4B-9A2D-3F1E7B6A9D41}
+#define OPTEE_CLIENT_PROFILE_PROTOCOL_GUID \
+  { 0x5c0fcb3a, 0x6e1b, 0x4c4b, { 0x9a, 0x2d, 0x3f, 0x1e, 0x7b, 0x6a, 0x9d, 0x41 } }
+
+#define OPTEE_CLIENT_PROFILE_PROTOCOL_REVISION  0x00010000
+
+// RPC types tracked by the profiler. The OPTEE_SMC_RPC_FUNC_CMD sub-commands
+// are broken down individually since they are the interesting ones.
+typedef enum {
+  OpteeProfileRpcAlloc = 0,     // OPTEE_SMC_RPC_FUNC_ALLOC
+  OpteeProfileRpcFree,          // OPTEE_SMC_RPC_FUNC_FREE
+  OpteeProfileRpcForeignIntr,   // OPTEE_SMC_RPC_FUNC_FOREIGN_INTR
+  OpteeProfileRpcLoadTa,        // OPTEE_MSG_RPC_CMD_LOAD_TA
+  OpteeProfileRpcRpmb,          // OPTEE_MSG_RPC_CMD_RPMB
+  OpteeProfileRpcGetTime,       // OPTEE_MSG_RPC_CMD_GET_TIME
+  OpteeProfileRpcShmAlloc,      // OPTEE_MSG_RPC_CMD_SHM_ALLOC
+  OpteeProfileRpcShmFree,       // OPTEE_MSG_RPC_CMD_SHM_FREE
+  OpteeProfileRpcWaitQueue,     // OPTEE_MSG_RPC_CMD_WAIT_QUEUE
+  OpteeProfileRpcOther,         // Anything unrecognized
+  OpteeProfileRpcMax
+} OPTEE_CLIENT_PROFILE_RPC_TYPE;
+
+typedef struct {
+  UINT64  Count;
+  UINT64  Ticks;
+  UINT64  Bytes;
+} OPTEE_CLIENT_PROFILE_RPC_STATS;
+
+// Accounting for a single SMC call, i.e. one TEEC_OpenSession,
+// TEEC_CloseSession or TEEC_InvokeCommand round trip.
+typedef struct {
+  UINT32                          Command;      // OPTEE_MSG_CMD_*
+  UINT32                          Function;     // TA command ID for invoke
+  UINT64                          TotalTicks;   // Wall time of the whole call
+  UINT64                          SecureTicks;  // Time spent inside ArmCallSmc
+  UINT64                          SmcCount;     // Number of world switches
+  UINT64                          BytesIn;      // Temp memref bytes sent
+  UINT64                          BytesOut;     // Temp memref bytes returned
+  OPTEE_CLIENT_PROFILE_RPC_STATS  Rpc[OpteeProfileRpcMax];
+} OPTEE_CLIENT_PROFILE_CALL;
+
+typedef struct {
+  UINT64                          TickFrequency;  // Performance counter Hz
+  UINT64                          CallCount;      // Completed SMC calls
+  UINT64                          InvokeCount;    // ... of which InvokeCommand
+  UINT64                          MaxTotalTicks;  // Slowest single call
+  OPTEE_CLIENT_PROFILE_CALL       Total;          // Sum over all calls
+  OPTEE_CLIENT_PROFILE_CALL       Last;           // Most recent call
+} OPTEE_CLIENT_PROFILE_STATS;
+
+typedef struct _OPTEE_CLIENT_PROFILE_PROTOCOL OPTEE_CLIENT_PROFILE_PROTOCOL;
+
+/** Get a snapshot of the profile counters.
+
+  @param[in]  This    Indicates a pointer to the calling context.
+  @param[out] Stats   Receives a copy of the aggregated counters.
+
+  @retval EFI_SUCCESS             The snapshot was copied.
+  @retval EFI_INVALID_PARAMETER   Stats is NULL.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *OPTEE_CLIENT_PROFILE_GET_STATS) (
+  IN OPTEE_CLIENT_PROFILE_PROTOCOL   *This,
+  OUT OPTEE_CLIENT_PROFILE_STATS     *Stats
+  );
+
+/** Reset all profile counters to zero.
+
+  @param[in]  This    Indicates a pointer to the calling context.
+
+  @retval EFI_SUCCESS   The counters were cleared.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *OPTEE_CLIENT_PROFILE_RESET) (
+  IN OPTEE_CLIENT_PROFILE_PROTOCOL   *This
+  );
+
+struct _OPTEE_CLIENT_PROFILE_PROTOCOL {
+  UINT64                            Revision;
+  EFI_HANDLE                        ImageHandle;  // Driver owning this instance
+  OPTEE_CLIENT_PROFILE_GET_STATS    GetStats;
+  OPTEE_CLIENT_PROFILE_RESET        Reset;
+};
+
+extern EFI_GUID gOpteeClientProfileProtocolGuid;
+
+#endif // __OPTEE_CLIENT_PROFILE_H__
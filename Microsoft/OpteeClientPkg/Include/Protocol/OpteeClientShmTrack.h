@@ -0,0 +1,136 @@
+/** @file
+*
+*  OP-TEE Client shared memory tracker protocol.
+*
+*  Every driver linking OpteeClientApiLib allocates from the same TrustZone
+*  shared memory pool. With PcdOpteeClientShmTrackEnable set, each library
+*  instance accounts for its own allocations and publishes them through this
+*  protocol on its driver image handle, so the owner of an allocation is the
+*  ImageHandle of the instance reporting it.
+*
+*  Copyright (c) 2018 Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __OPTEE_CLIENT_SHM_TRACK_H__
+#define __OPTEE_CLIENT_SHM_TRACK_H__
+
+// Global ID for the OP-TEE Client Shared Memory Tracker Protocol {9E4D2B17-3C5A-4F8E-B1D6-72A0C8E43F59}
+#define OPTEE_CLIENT_SHM_TRACK_PROTOCOL_GUID \
+  { 0x9e4d2b17, 0x3c5a, 0x4f8e, { 0xb1, 0xd6, 0x72, 0xa0, 0xc8, 0xe4, 0x3f, 0x59 } }
+
+#define OPTEE_CLIENT_SHM_TRACK_PROTOCOL_REVISION  0x00010000
+
+// Library call sites allocating from the shared memory pool.
+typedef enum {
+  OpteeShmSiteSharedMemory = 0,   // TEEC_AllocateSharedMemory
+  OpteeShmSiteMsgArg,             // Per call optee_msg_arg
+  OpteeShmSiteReservedMsgArg,     // Reserved optee_msg_arg of the sync calls
+  OpteeShmSiteRpc,                // OPTEE_SMC_RPC_FUNC_ALLOC / CMD_SHM_ALLOC
+  OpteeShmSiteRpcPayloadPool,     // Pool of the CMD_SHM_ALLOC application payloads
+  OpteeShmSiteMax
+} OPTEE_CLIENT_SHM_SITE;
+
+// Block size classes, class N holds blocks up to 256 << N bytes and the last
+// class everything larger than 64KB.
+#define OPTEE_SHM_TRACK_SIZE_CLASSES      10
+
+// Lifetime buckets, bucket N holds blocks freed within 100us * 10^N and the
+// last bucket everything living 10s or more.
+#define OPTEE_SHM_TRACK_LIFETIME_BUCKETS  7
+
+typedef struct {
+  UINT64  PoolSize;         // Size of the whole shared memory pool
+  UINT64  AllocCount;       // Successful allocations
+  UINT64  FreeCount;        // Successful frees
+  UINT64  FailCount;        // Failed allocations
+  UINT64  LargestFailure;   // Largest request that could not be satisfied
+  UINT64  LiveCount;        // Blocks currently allocated
+  UINT64  LiveBytes;        // Pool bytes currently allocated
+  UINT64  PeakCount;        // High-water mark of LiveCount
+  UINT64  PeakBytes;        // High-water mark of LiveBytes
+  UINT64  Untracked;        // Live blocks that did not fit the record table
+  UINT64  SiteCount[OpteeShmSiteMax];
+  UINT64  SiteBytes[OpteeShmSiteMax];
+  UINT64  SizeClass[OPTEE_SHM_TRACK_SIZE_CLASSES];
+  UINT64  Lifetime[OPTEE_SHM_TRACK_LIFETIME_BUCKETS];
+} OPTEE_CLIENT_SHM_TRACK_STATS;
+
+// A block currently allocated from the pool.
+typedef struct {
+  UINT64                  Address;      // Address returned to the caller
+  UINT64                  Size;         // Requested size
+  UINT64                  BlockSize;    // Pool bytes consumed, with header and alignment
+  UINT64                  CallSite;     // Return address into the client, 0 if unknown
+  UINT64                  AgeUs;        // Time since allocation
+  OPTEE_CLIENT_SHM_SITE   Site;
+} OPTEE_CLIENT_SHM_TRACK_RECORD;
+
+typedef struct _OPTEE_CLIENT_SHM_TRACK_PROTOCOL OPTEE_CLIENT_SHM_TRACK_PROTOCOL;
+
+/** Get a snapshot of the tracker counters.
+
+  @param[in]  This    Indicates a pointer to the calling context.
+  @param[out] Stats   Receives a copy of the counters.
+
+  @retval EFI_SUCCESS             The snapshot was copied.
+  @retval EFI_INVALID_PARAMETER   Stats is NULL.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *OPTEE_CLIENT_SHM_TRACK_GET_STATS) (
+  IN OPTEE_CLIENT_SHM_TRACK_PROTOCOL  *This,
+  OUT OPTEE_CLIENT_SHM_TRACK_STATS    *Stats
+  );
+
+/** Get the blocks currently allocated by the owning driver.
+
+  @param[in]      This      Indicates a pointer to the calling context.
+  @param[in, out] Count     On input the number of entries in Records, on
+                            output the number of live records.
+  @param[out]     Records   Receives the live records.
+
+  @retval EFI_SUCCESS             The records were copied.
+  @retval EFI_BUFFER_TOO_SMALL    Records is too small, Count is updated.
+  @retval EFI_INVALID_PARAMETER   Count is NULL.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *OPTEE_CLIENT_SHM_TRACK_GET_LIVE) (
+  IN OPTEE_CLIENT_SHM_TRACK_PROTOCOL    *This,
+  IN OUT UINTN                          *Count,
+  OUT OPTEE_CLIENT_SHM_TRACK_RECORD     *Records OPTIONAL
+  );
+
+/** Clear the counters and histograms. Live blocks stay tracked and the
+  high-water marks restart from the current live totals.
+
+  @param[in]  This    Indicates a pointer to the calling context.
+
+  @retval EFI_SUCCESS   The counters were cleared.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *OPTEE_CLIENT_SHM_TRACK_RESET) (
+  IN OPTEE_CLIENT_SHM_TRACK_PROTOCOL  *This
+  );
+
+struct _OPTEE_CLIENT_SHM_TRACK_PROTOCOL {
+  UINT64                              Revision;
+  EFI_HANDLE                          ImageHandle;  // Driver owning the blocks
+  OPTEE_CLIENT_SHM_TRACK_GET_STATS    GetStats;
+  OPTEE_CLIENT_SHM_TRACK_GET_LIVE     GetLive;
+  OPTEE_CLIENT_SHM_TRACK_RESET        Reset;
+};
+
+extern EFI_GUID gOpteeClientShmTrackProtocolGuid;
+
+#endif // __OPTEE_CLIENT_SHM_TRACK_H__
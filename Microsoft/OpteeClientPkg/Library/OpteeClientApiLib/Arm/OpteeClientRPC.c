@@ -46,6 +46,7 @@
 #include "OpteeClientDefs.h"
 #include "OpteeClientRPC.h"
 #include "OpteeClientMem.h"
+#include "OpteeClientProfile.h"
 #include "Optee/tee_rpmb_fs.h"
 #include "Optee/optee_smc.h"
 
@@ -79,6 +80,253 @@ typedef union {
   } Fields;
 } ADDRESS64;
 
+// Number of shared memory buffers kept aside for the
+// OPTEE_MSG_RPC_SHM_TYPE_APPL payloads OpTEE requests through
+// OPTEE_MSG_RPC_CMD_SHM_ALLOC, and the number of RPMB frames each buffer can
+// hold in addition to the rpmb_req_t header. The request does not tell what
+// the payload is for, so the pool serves every application payload that
+// fits. It is sized for the most frequent ones, the request and response
+// frames of an RPMB operation backing secure storage. The message arguments
+// and kernel buffers, and payloads that do not fit, go to the regular shared
+// memory allocator.
+#define OPTEE_RPC_SHM_POOL_COUNT          2
+#define OPTEE_RPC_SHM_POOL_RPMB_FRAMES    8
+#define OPTEE_RPC_SHM_POOL_BUFFER_SIZE \
+  ALIGN_VALUE ( \
+    sizeof (rpmb_req_t) + (OPTEE_RPC_SHM_POOL_RPMB_FRAMES * sizeof (EFI_RPMB_DATA_PACKET)), \
+    EFI_PAGE_SIZE)
+
+typedef struct {
+  VOID    *Buffer;
+  BOOLEAN InUse;
+} OPTEE_RPC_SHM_POOL_ENTRY;
+
+STATIC OPTEE_RPC_SHM_POOL_ENTRY mShmPool[OPTEE_RPC_SHM_POOL_COUNT];
+
+// Cached RPMB IO binding. It is refreshed by a protocol notify on install and
+// dropped when the RPMB IO producer signals an uninstall, so the RPMB RPC path
+// does not have to search the handle database on every frame exchange.
+STATIC EFI_RPMB_IO_PROTOCOL *mRpmbIo = NULL;
+STATIC EFI_EVENT mRpmbIoInstallEvent = NULL;
+STATIC EFI_EVENT mRpmbIoUninstallEvent = NULL;
+STATIC VOID *mRpmbIoRegistration = NULL;
+
+STATIC
+VOID
+EFIAPI
+OpteeRpcRpmbIoInstallNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  EFI_STATUS Status;
+  EFI_RPMB_IO_PROTOCOL *RpmbIo;
+
+  // Only a single RPMB IO instance is expected on the system, the producer
+  // enforces that.
+  Status = gBS->LocateProtocol (
+                  &gEfiRpmbIoProtocolGuid,
+                  mRpmbIoRegistration,
+                  (VOID **) &RpmbIo);
+
+  if (!EFI_ERROR (Status)) {
+    LOG_TRACE ("RpmbIo=0x%p", RpmbIo);
+    mRpmbIo = RpmbIo;
+  }
+}
+
+STATIC
+VOID
+EFIAPI
+OpteeRpcRpmbIoUninstallNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  EFI_STATUS Status;
+  EFI_RPMB_IO_PROTOCOL *RpmbIo;
+
+  // The event doesn't tell which instance went away, rebind to whatever is
+  // still installed, if anything.
+  Status = gBS->LocateProtocol (&gEfiRpmbIoProtocolGuid, NULL, (VOID **) &RpmbIo);
+  mRpmbIo = EFI_ERROR (Status) ? NULL : RpmbIo;
+
+  LOG_TRACE ("RpmbIo=0x%p", mRpmbIo);
+}
+
+STATIC
+EFI_RPMB_IO_PROTOCOL*
+OpteeRpcGetRpmbIo (
+  VOID
+  )
+{
+  EFI_STATUS Status;
+  EFI_RPMB_IO_PROTOCOL *RpmbIo;
+
+  // Falls back to a lookup if the library was not initialized through
+  // OpteeClientApiInitialize(), e.g. the notify event could not be created.
+  if ((mRpmbIo == NULL) && (mRpmbIoInstallEvent == NULL)) {
+    Status = gBS->LocateProtocol (&gEfiRpmbIoProtocolGuid, NULL, (VOID **) &RpmbIo);
+    if (EFI_ERROR (Status)) {
+      LOG_ERROR ("gBS->LocateProtocol(gEfiRpmbIoProtocolGuid) failed. (Status=%r)", Status);
+      return NULL;
+    }
+
+    mRpmbIo = RpmbIo;
+  }
+
+  return mRpmbIo;
+}
+
+STATIC
+VOID*
+OpteeRpcShmPoolAlloc (
+  IN UINTN    Size,
+  IN UINTN    ByteAlignment,
+  IN BOOLEAN  ApplPayload
+  )
+{
+  UINTN Index;
+
+  // Pool buffers are page aligned, which satisfies any alignment the shared
+  // memory allocator accepts.
+  if (ApplPayload && (Size <= OPTEE_RPC_SHM_POOL_BUFFER_SIZE)) {
+    for (Index = 0; Index < OPTEE_RPC_SHM_POOL_COUNT; Index++) {
+      if ((mShmPool[Index].Buffer != NULL) && !mShmPool[Index].InUse) {
+        mShmPool[Index].InUse = TRUE;
+        return mShmPool[Index].Buffer;
+      }
+    }
+  }
+
+  if (ByteAlignment == 0) {
+    return OpteeClientMemAlloc (Size, OpteeShmSiteRpc);
+  }
+
+  return OpteeClientAlignedMemAlloc (Size, ByteAlignment, OpteeShmSiteRpc);
+}
+
+STATIC
+EFI_STATUS
+OpteeRpcShmPoolFree (
+  IN VOID   *Buffer
+  )
+{
+  UINTN Index;
+
+  for (Index = 0; Index < OPTEE_RPC_SHM_POOL_COUNT; Index++) {
+    if ((Buffer != NULL) && (mShmPool[Index].Buffer == Buffer)) {
+      ASSERT (mShmPool[Index].InUse);
+      mShmPool[Index].InUse = FALSE;
+      return EFI_SUCCESS;
+    }
+  }
+
+  return OpteeClientMemFree (Buffer);
+}
+
+/** Initialize the RPC component: pre-allocate the payload pool and
+  register for RPMB IO protocol availability changes.
+**/
+EFI_STATUS
+OpteeRpcInit (
+  VOID
+  )
+{
+  EFI_STATUS Status;
+  UINTN Index;
+
+  for (Index = 0; Index < OPTEE_RPC_SHM_POOL_COUNT; Index++) {
+    ASSERT (mShmPool[Index].Buffer == NULL);
+    mShmPool[Index].Buffer =
+      OpteeClientAlignedMemAlloc (
+        OPTEE_RPC_SHM_POOL_BUFFER_SIZE,
+        EFI_PAGE_SIZE,
+        OpteeShmSiteRpcPayloadPool);
+    mShmPool[Index].InUse = FALSE;
+
+    // Not fatal, requests will go to the regular allocator.
+    if (mShmPool[Index].Buffer == NULL) {
+      LOG_ERROR ("OpteeClientAlignedMemAlloc() failed for the payload pool.");
+      break;
+    }
+  }
+
+  mRpmbIoInstallEvent = EfiCreateProtocolNotifyEvent (
+                          &gEfiRpmbIoProtocolGuid,
+                          TPL_CALLBACK,
+                          OpteeRpcRpmbIoInstallNotify,
+                          NULL,
+                          &mRpmbIoRegistration);
+
+  if (mRpmbIoInstallEvent == NULL) {
+    LOG_ERROR ("EfiCreateProtocolNotifyEvent(gEfiRpmbIoProtocolGuid) failed.");
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = gBS->CreateEventEx (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  OpteeRpcRpmbIoUninstallNotify,
+                  NULL,
+                  &gEfiRpmbIoUninstallEventGroupGuid,
+                  &mRpmbIoUninstallEvent);
+
+  if (EFI_ERROR (Status)) {
+    LOG_ERROR ("gBS->CreateEventEx() failed. (Status=%r)", Status);
+  }
+
+  return Status;
+}
+
+/** Release the payload pool back to the shared memory allocator.
+
+  This runs from ExitBootServices notifications, the RPMB IO notify events
+  are closed by OpteeRpcUnload().
+**/
+VOID
+OpteeRpcDeinit (
+  VOID
+  )
+{
+  UINTN Index;
+
+  for (Index = 0; Index < OPTEE_RPC_SHM_POOL_COUNT; Index++) {
+    if (mShmPool[Index].Buffer == NULL) {
+      continue;
+    }
+
+    if (mShmPool[Index].InUse) {
+      LOG_ERROR ("Payload pool buffer still in use. (Buffer=0x%p)", mShmPool[Index].Buffer);
+      continue;
+    }
+
+    OpteeClientMemFree (mShmPool[Index].Buffer);
+    mShmPool[Index].Buffer = NULL;
+  }
+}
+
+/** Stop tracking the RPMB IO protocol, from the library destructor.
+**/
+VOID
+OpteeRpcUnload (
+  VOID
+  )
+{
+  if (mRpmbIoInstallEvent != NULL) {
+    gBS->CloseEvent (mRpmbIoInstallEvent);
+    mRpmbIoInstallEvent = NULL;
+    mRpmbIoRegistration = NULL;
+  }
+
+  if (mRpmbIoUninstallEvent != NULL) {
+    gBS->CloseEvent (mRpmbIoUninstallEvent);
+    mRpmbIoUninstallEvent = NULL;
+  }
+
+  mRpmbIo = NULL;
+}
+
 TEEC_Result
 OpteeRpcAlloc (
   IN OUT ARM_SMC_ARGS   *ArmSmcArgs
@@ -91,9 +339,9 @@ OpteeRpcAlloc (
   LOG_TRACE ("Size=0x%p", Size);
 
   if (Size != 0) {
-    Address.P = OpteeClientMemAlloc (Size);
+    Address.P = OpteeRpcShmPoolAlloc (Size, 0, FALSE);
     if (Address.P == NULL) {
-      LOG_ERROR ("OpteeClientMemAlloc(..) failed.");
+      LOG_ERROR ("OpteeRpcShmPoolAlloc(..) failed.");
       TeecResult = TEEC_ERROR_OUT_OF_MEMORY;
       goto Exit;
     }
@@ -124,9 +372,9 @@ OpteeRpcFree (
 
   LOG_TRACE ("Address=0x%p", Address.P);
 
-  Status = OpteeClientMemFree (Address.P);
+  Status = OpteeRpcShmPoolFree (Address.P);
   if (EFI_ERROR (Status)) {
-    LOG_ERROR ("OpteeClientMemAlloc(..) failed. (Status=%r)", Status);
+    LOG_ERROR ("OpteeRpcShmPoolFree(..) failed. (Status=%r)", Status);
     TeecResult = TEEC_ERROR_BAD_PARAMETERS;
   }
 
@@ -313,13 +561,9 @@ OpteeRpcCmdRpmb (
     goto Exit;
   }
 
-  Status = gBS->LocateProtocol (
-                  &gEfiRpmbIoProtocolGuid,
-                  NULL,
-                  (VOID **) &RpmbProtocol);
-
-  if (EFI_ERROR (Status)) {
-    LOG_ERROR ("gBS->LocateProtocol(gEfiRpmbIoProtocolGuid) failed. (Status=%r)", Status);
+  RpmbProtocol = OpteeRpcGetRpmbIo ();
+  if (RpmbProtocol == NULL) {
+    LOG_ERROR ("No EFI_RPMB_IO_PROTOCOL available.");
     TeecResult = TEEC_ERROR_NOT_SUPPORTED;
     goto Exit;
   }
@@ -526,10 +770,13 @@ OpteeRpcCmdShmAlloc (
   BufferSize = (UINTN) MsgParam[0].u.value.b;
   BufferAlignment = (UINTN) MsgParam[0].u.value.c;
 
-  Buffer = OpteeClientAlignedMemAlloc (BufferSize, BufferAlignment);
+  Buffer = OpteeRpcShmPoolAlloc (
+             BufferSize,
+             BufferAlignment,
+             MsgParam[0].u.value.a == OPTEE_MSG_RPC_SHM_TYPE_APPL);
   if (Buffer == NULL) {
     LOG_ERROR (
-      "OpteeClientAlignedMemAlloc() failed.(BufferSize=0x%p, BufferAlignment=0x%p)",
+      "OpteeRpcShmPoolAlloc() failed.(BufferSize=0x%p, BufferAlignment=0x%p)",
       BufferSize,
       BufferAlignment);
 
@@ -591,9 +838,9 @@ OpteeRpcCmdShmFree (
 
   // The cookie we set on shared mem alloc is the physical address itself, so
   // we can use it for free directly.
-  Status = OpteeClientMemFree ((VOID *) (UINTN) MsgParam[0].u.value.b);
+  Status = OpteeRpcShmPoolFree ((VOID *) (UINTN) MsgParam[0].u.value.b);
   if (EFI_ERROR (Status)) {
-    LOG_ERROR ("OpteeClientMemFree() failed. (Status=%r)", Status);
+    LOG_ERROR ("OpteeRpcShmPoolFree() failed. (Status=%r)", Status);
     TeecResult = TEEC_ERROR_BAD_STATE;
     goto Exit;
   }
@@ -652,7 +899,8 @@ Exit:
 
 TEEC_Result
 OpteeRpcCmdWaitQueue (
-    OUT optee_msg_arg_t  *MsgArg
+  IN OUT optee_msg_arg_t  *MsgArg,
+  OUT OPTEE_RPC_RESUME    *Resume
   )
 {
   TEEC_Result TeecResult = TEEC_SUCCESS;
@@ -670,16 +918,19 @@ OpteeRpcCmdWaitQueue (
     goto Exit;
   }
 
-  // The handler simply do nothing, since UEFI is a single thread, single core
-  // environment.
+  // There is no normal world thread to block, the SMC layer parks the call
+  // on a sleep and resumes it after the other calls in flight had a chance
+  // to run. OpTEE re-checks the wait queue on every resume, so a wakeup needs
+  // no bookkeeping here and waking a sleeper early is harmless.
 
   switch (MsgParam[0].u.value.a) {
     case OPTEE_MSG_RPC_WAIT_QUEUE_SLEEP:
-      LOG_ERROR ("OPTEE_MSG_RPC_WAIT_QUEUE_SLEEP (key = 0x%lX)", MsgParam[0].u.value.b);
+      LOG_TRACE ("OPTEE_MSG_RPC_WAIT_QUEUE_SLEEP (key = 0x%lX)", MsgParam[0].u.value.b);
+      *Resume = OpteeRpcResumeSleep;
       break;
 
     case OPTEE_MSG_RPC_WAIT_QUEUE_WAKEUP:
-      LOG_ERROR ("OPTEE_MSG_RPC_WAIT_QUEUE_WAKEUP (key = 0x%lX)", MsgParam[0].u.value.b);
+      LOG_TRACE ("OPTEE_MSG_RPC_WAIT_QUEUE_WAKEUP (key = 0x%lX)", MsgParam[0].u.value.b);
       break;
 
     default:
@@ -698,13 +949,20 @@ Exit:
  */
 TEEC_Result
 OpteeRpcCallback (
-  IN ARM_SMC_ARGS   *ArmSmcArgs
+  IN OUT ARM_SMC_ARGS   *ArmSmcArgs,
+  OUT OPTEE_RPC_RESUME  *Resume
   )
 {
   TEEC_Result TeecResult = TEEC_SUCCESS;
+  OPTEE_CLIENT_PROFILE_RPC_TYPE RpcType = OpteeProfileRpcOther;
+  UINT64 RpcBytes = 0;
+  UINT64 RpcStartTick;
 
   ASSERT (OPTEE_SMC_RETURN_IS_RPC (ArmSmcArgs->Arg0));
 
+  RpcStartTick = OpteeProfileRpcBegin ();
+  *Resume = OpteeRpcResumeNow;
+
   LOG_TRACE(
     "Arg0=0x%p, Arg1=0x%p, Arg2=0x%p",
     ArmSmcArgs->Arg0,
@@ -714,11 +972,14 @@ OpteeRpcCallback (
   switch (OPTEE_SMC_RETURN_GET_RPC_FUNC (ArmSmcArgs->Arg0)) {
     case OPTEE_SMC_RPC_FUNC_ALLOC:
       LOG_TRACE ("OPTEE_SMC_RPC_FUNC_ALLOC");
+      RpcType = OpteeProfileRpcAlloc;
+      RpcBytes = ArmSmcArgs->Arg1;
       TeecResult = OpteeRpcAlloc (ArmSmcArgs);
       break;
 
     case OPTEE_SMC_RPC_FUNC_FREE:
       LOG_TRACE ("OPTEE_SMC_RPC_FUNC_FREE");
+      RpcType = OpteeProfileRpcFree;
       TeecResult = OpteeRpcFree (ArmSmcArgs);
       break;
 
@@ -726,6 +987,8 @@ OpteeRpcCallback (
     // so there is no further action to take other than to return.
     case OPTEE_SMC_RPC_FUNC_FOREIGN_INTR:
       LOG_TRACE ("OPTEE_SMC_RPC_FUNC_FOREIGN_INTR");
+      RpcType = OpteeProfileRpcForeignIntr;
+      *Resume = OpteeRpcResumeYield;
       break;
 
     // This actually means an arg parameter block has come back that breaks
@@ -748,32 +1011,38 @@ OpteeRpcCallback (
       switch (MsgArg->cmd) {
         case OPTEE_MSG_RPC_CMD_LOAD_TA:
           LOG_TRACE ("OPTEE_MSG_RPC_CMD_LOAD_TA");
+          RpcType = OpteeProfileRpcLoadTa;
           TeecResult = OpteeRpcCmdLoadTa (MsgArg);
           break;
 
         case OPTEE_MSG_RPC_CMD_RPMB:
           LOG_TRACE ("OPTEE_MSG_RPC_CMD_RPMB");
+          RpcType = OpteeProfileRpcRpmb;
           TeecResult = OpteeRpcCmdRpmb (MsgArg);
           break;
 
         case OPTEE_MSG_RPC_CMD_GET_TIME:
           LOG_TRACE ("OPTEE_MSG_RPC_CMD_GET_TIME");
+          RpcType = OpteeProfileRpcGetTime;
           TeecResult = OpteeRpcCmdGetTime (MsgArg);
           break;
 
         case OPTEE_MSG_RPC_CMD_SHM_ALLOC:
           LOG_TRACE ("OPTEE_MSG_RPC_CMD_SHM_ALLOC");
+          RpcType = OpteeProfileRpcShmAlloc;
           TeecResult = OpteeRpcCmdShmAlloc (MsgArg);
           break;
 
         case OPTEE_MSG_RPC_CMD_SHM_FREE:
           LOG_TRACE ("OPTEE_MSG_RPC_CMD_SHM_FREE");
+          RpcType = OpteeProfileRpcShmFree;
           TeecResult = OpteeRpcCmdShmFree (MsgArg);
           break;
 
         case OPTEE_MSG_RPC_CMD_WAIT_QUEUE:
           LOG_TRACE ("OPTEE_MSG_RPC_CMD_WAIT_QUEUE");
-          TeecResult = OpteeRpcCmdWaitQueue (MsgArg);
+          RpcType = OpteeProfileRpcWaitQueue;
+          TeecResult = OpteeRpcCmdWaitQueue (MsgArg, Resume);
           break;
 
         default:
@@ -783,6 +1052,11 @@ OpteeRpcCallback (
       }
 
       MsgArg->ret = TeecResult;
+
+      // Account for the buffers moved in both directions by the RPC.
+      RpcBytes =
+        OpteeProfileMsgArgBytes (MsgArg, FALSE) +
+        OpteeProfileMsgArgBytes (MsgArg, TRUE);
       break;
     }
 
@@ -792,6 +1066,8 @@ OpteeRpcCallback (
       break;
   }
 
+  OpteeProfileRpcEnd (RpcType, RpcBytes, RpcStartTick);
+
   // Send back the return code for the next call.
   ArmSmcArgs->Arg0 = OPTEE_SMC_CALL_RETURN_FROM_RPC;
 
@@ -35,12 +35,15 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/ArmSmcLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
 #include <Library/tee_client_api.h>
 
 #include "OpteeClientDefs.h"
 #include "OpteeClientSMC.h"
 #include "OpteeClientRPC.h"
 #include "OpteeClientMem.h"
+#include "OpteeClientProfile.h"
 #include "Optee/optee_smc.h"
 
 #undef ARRAY_SIZE
@@ -55,6 +58,49 @@ typedef struct optee_msg_param_value optee_msg_param_value_t;
 typedef struct optee_msg_param optee_msg_param_t;
 typedef struct optee_msg_arg optee_msg_arg_t;
 
+// An OPTEE_SMC_CALL_WITH_ARG in flight. Between two steps the registers hold
+// the resume information secure world handed back with its last RPC.
+typedef struct {
+  optee_msg_arg_t   *MsgArg;
+  ARM_SMC_ARGS      ArmSmcArgs;
+} OPTEE_SMC_CALL;
+
+#define OPTEE_ASYNC_INVOKE_SIGNATURE  SIGNATURE_32 ('T', 'E', 'A', 'I')
+
+// An asynchronous TEEC_InvokeCommand, see TEEC_SMC_InvokeCommandAsync().
+typedef struct {
+  UINT32          Signature;
+  LIST_ENTRY      Link;
+  OPTEE_SMC_CALL  Call;
+  TEEC_Operation  *Operation;
+  EFI_EVENT       CompletionEvent;
+  BOOLEAN         Completed;
+  BOOLEAN         CancelRequested;
+  TEEC_Result     TeecResult;
+  uint32_t        ErrorOrigin;
+} OPTEE_ASYNC_INVOKE;
+
+#define OPTEE_ASYNC_INVOKE_FROM_LINK(a) \
+  CR (a, OPTEE_ASYNC_INVOKE, Link, OPTEE_ASYNC_INVOKE_SIGNATURE)
+
+// Period of the timer resuming the asynchronous calls, in 100ns units.
+#define OPTEE_ASYNC_POLL_PERIOD   (1 * 10 * 1000)
+
+UINTN gOpteeClientCallDepth = 0;
+
+// Message block kept aside for the synchronous calls, it saves a shared
+// memory allocation and release per call. A call finding it taken, e.g. one
+// issued from an RPC handler, allocates its own.
+#define OPTEE_RESERVED_MSG_ARG_PARAMS   TEEC_CONFIG_PAYLOAD_REF_COUNT
+
+STATIC optee_msg_arg_t *mReservedMsgArg = NULL;
+STATIC BOOLEAN mReservedMsgArgInUse = FALSE;
+
+STATIC LIST_ENTRY mAsyncInvokeList = INITIALIZE_LIST_HEAD_VARIABLE (mAsyncInvokeList);
+STATIC EFI_EVENT mAsyncPollEvent = NULL;
+STATIC UINTN mAsyncRunningCount = 0;
+STATIC UINT32 mNextCancelId = 1;
+
 VOID
 SetMsgParams (
   IN TEEC_Operation       *Operation,
@@ -72,6 +118,142 @@ OpteeSmcCall (
   IN optee_msg_arg_t  *MsgArg
   );
 
+STATIC
+VOID
+OpteeSmcAsyncRunAll (
+  VOID
+  );
+
+STATIC
+VOID
+OpteeSmcAsyncDrain (
+  IN UINT32   SessionId,
+  IN BOOLEAN  AllSessions
+  );
+
+/*
+ * Reserve the message block for the synchronous calls.
+ */
+EFI_STATUS
+OpteeSmcInit (
+  VOID
+  )
+{
+  ASSERT (mReservedMsgArg == NULL);
+
+  mReservedMsgArg = (optee_msg_arg_t *) OpteeClientMemAlloc (
+                                          OPTEE_MSG_GET_ARG_SIZE (OPTEE_RESERVED_MSG_ARG_PARAMS),
+                                          OpteeShmSiteReservedMsgArg);
+  if (mReservedMsgArg == NULL) {
+    LOG_ERROR ("OpteeClientMemAlloc() failed for the reserved message block.");
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  mReservedMsgArgInUse = FALSE;
+  return EFI_SUCCESS;
+}
+
+/*
+ * Complete the asynchronous calls and release the reserved message block
+ * back to the shared memory allocator.
+ *
+ * This runs from ExitBootServices notifications, so it neither closes events
+ * nor frees pool memory. The records of the results nobody collected and the
+ * poll timer are released by OpteeSmcUnload().
+ */
+VOID
+OpteeSmcDeinit (
+  VOID
+  )
+{
+  // The asynchronous calls cannot outlive the library: the running ones are
+  // cancelled and run to completion.
+  gOpteeClientCallDepth++;
+  OpteeSmcAsyncDrain (0, TRUE);
+  gOpteeClientCallDepth--;
+
+  if (mAsyncPollEvent != NULL) {
+    gBS->SetTimer (mAsyncPollEvent, TimerCancel, 0);
+  }
+
+  if (mReservedMsgArg == NULL) {
+    return;
+  }
+
+  if (mReservedMsgArgInUse) {
+    LOG_ERROR ("Reserved message block still in use.");
+    return;
+  }
+
+  OpteeClientMemFree (mReservedMsgArg);
+  mReservedMsgArg = NULL;
+}
+
+/*
+ * Drop the results of the asynchronous calls nobody collected and close the
+ * poll timer, from the library destructor.
+ */
+VOID
+OpteeSmcUnload (
+  VOID
+  )
+{
+  LIST_ENTRY *Link;
+  OPTEE_ASYNC_INVOKE *Invoke;
+
+  // Nothing is left running unless OpteeClientApiFinalize() was skipped.
+  gOpteeClientCallDepth++;
+  OpteeSmcAsyncDrain (0, TRUE);
+  gOpteeClientCallDepth--;
+
+  while (!IsListEmpty (&mAsyncInvokeList)) {
+    Link = GetFirstNode (&mAsyncInvokeList);
+    Invoke = OPTEE_ASYNC_INVOKE_FROM_LINK (Link);
+    LOG_ERROR ("Dropping the result of Operation=0x%p, it was never collected.", Invoke->Operation);
+    RemoveEntryList (Link);
+    gBS->CloseEvent (Invoke->CompletionEvent);
+    FreePool (Invoke);
+  }
+
+  if (mAsyncPollEvent != NULL) {
+    gBS->CloseEvent (mAsyncPollEvent);
+    mAsyncPollEvent = NULL;
+  }
+}
+
+STATIC
+optee_msg_arg_t*
+OpteeSmcMsgArgAlloc (
+  IN UINTN  NumParams
+  )
+{
+  if ((mReservedMsgArg != NULL) &&
+      !mReservedMsgArgInUse &&
+      (NumParams <= OPTEE_RESERVED_MSG_ARG_PARAMS)) {
+    mReservedMsgArgInUse = TRUE;
+    return mReservedMsgArg;
+  }
+
+  return (optee_msg_arg_t *) OpteeClientMemAlloc (
+                                OPTEE_MSG_GET_ARG_SIZE (NumParams),
+                                OpteeShmSiteMsgArg);
+}
+
+STATIC
+VOID
+OpteeSmcMsgArgFree (
+  IN optee_msg_arg_t  *MsgArg
+  )
+{
+  if (MsgArg == mReservedMsgArg) {
+    ASSERT (mReservedMsgArgInUse);
+    mReservedMsgArgInUse = FALSE;
+    return;
+  }
+
+  OpteeClientMemFree (MsgArg);
+}
+
 /*
  * This function opens a new Session between the Client application and the
  * specified TEE application.
@@ -96,13 +278,14 @@ TEEC_SMC_OpenSession (
   static const UINTN MetaParamCount = 2;
 
   *ErrorOrigin = TEEC_ORIGIN_API;
+  gOpteeClientCallDepth++;
 
   // Allocate the primary data packet from the OpTEE OS shared pool.
   {
     UINTN MsgArgSize =
       OPTEE_MSG_GET_ARG_SIZE (TEEC_CONFIG_PAYLOAD_REF_COUNT + MetaParamCount);
 
-    MsgArg = (optee_msg_arg_t *) OpteeClientMemAlloc (MsgArgSize);
+    MsgArg = (optee_msg_arg_t *) OpteeClientMemAlloc (MsgArgSize, OpteeShmSiteMsgArg);
     if (MsgArg == NULL) {
       TeecResult = TEEC_ERROR_OUT_OF_MEMORY;
       goto Exit;
@@ -146,6 +329,7 @@ Exit:
     OpteeClientMemFree (MsgArg);
   }
 
+  gOpteeClientCallDepth--;
   return TeecResult;
 }
 
@@ -156,6 +340,10 @@ Exit:
  * Note that the GP specification does not allow for this API to fail and return
  * a failure code however we'll support this at the SMC level so we can get
  * see debug information about such failures.
+ *
+ * Asynchronous commands still running on the session are cancelled and run
+ * to completion first, their results are left for
+ * TEEC_SMC_InvokeCommandAsyncComplete().
  */
 TEEC_Result
 TEEC_SMC_CloseSession (
@@ -167,12 +355,15 @@ TEEC_SMC_CloseSession (
   optee_msg_arg_t *MsgArg = NULL;
 
   *ErrorOrigin = TEEC_ORIGIN_API;
+  gOpteeClientCallDepth++;
 
-  // Allocate the primary data packet from the OpTEE OS shared pool.
+  OpteeSmcAsyncDrain (Session->session_id, FALSE);
+
+  // Get the primary data packet from the OpTEE OS shared pool.
   {
     UINTN MsgArgSize = OPTEE_MSG_GET_ARG_SIZE (0);
 
-    MsgArg = (optee_msg_arg_t*) OpteeClientMemAlloc (MsgArgSize);
+    MsgArg = OpteeSmcMsgArgAlloc (0);
     if (MsgArg == NULL) {
       TeecResult = TEEC_ERROR_OUT_OF_MEMORY;
       goto Exit;
@@ -195,9 +386,10 @@ TEEC_SMC_CloseSession (
 
 Exit:
   if (MsgArg != NULL) {
-    OpteeClientMemFree (MsgArg);
+    OpteeSmcMsgArgFree (MsgArg);
   }
 
+  gOpteeClientCallDepth--;
   return TeecResult;
 }
 
@@ -217,12 +409,13 @@ TEEC_SMC_InvokeCommand (
   optee_msg_param_t *MsgParam = NULL;
 
   *ErrorOrigin = TEEC_ORIGIN_API;
+  gOpteeClientCallDepth++;
 
-  // Allocate the primary data packet from the OpTEE OS shared pool.
+  // Get the primary data packet from the OpTEE OS shared pool.
   {
     UINTN MsgArgSize = OPTEE_MSG_GET_ARG_SIZE (TEEC_CONFIG_PAYLOAD_REF_COUNT);
 
-    MsgArg = (optee_msg_arg_t*) OpteeClientMemAlloc (MsgArgSize);
+    MsgArg = OpteeSmcMsgArgAlloc (TEEC_CONFIG_PAYLOAD_REF_COUNT);
     if (MsgArg == NULL) {
       TeecResult = TEEC_ERROR_OUT_OF_MEMORY;
       goto Exit;
@@ -255,9 +448,97 @@ TEEC_SMC_InvokeCommand (
 
 Exit:
   if (MsgArg != NULL) {
-    OpteeClientMemFree (MsgArg);
+    OpteeSmcMsgArgFree (MsgArg);
+  }
+
+  gOpteeClientCallDepth--;
+  return TeecResult;
+}
+
+/*
+ * Invokes a TEE command whose parameters are all values.
+ *
+ * Only the parameters up to the last one in use are sent and they are packed
+ * straight into the reserved message block, no shared memory is allocated and
+ * no memory reference needs translating.
+ */
+TEEC_Result
+TEEC_SMC_InvokeCommandFast (
+  IN TEEC_Session       *Session,
+  IN uint32_t           CmdId,
+  IN OUT TEEC_Operation *Operation,
+  OUT uint32_t          *ErrorOrigin
+  )
+{
+  TEEC_Result TeecResult = TEEC_SUCCESS;
+  optee_msg_arg_t *MsgArg = NULL;
+  UINTN NumParams;
+  UINTN Index;
+  UINT32 Type;
+
+  *ErrorOrigin = TEEC_ORIGIN_API;
+  gOpteeClientCallDepth++;
+
+  NumParams = 0;
+  for (Index = 0; Index < TEEC_CONFIG_PAYLOAD_REF_COUNT; Index++) {
+    Type = TEEC_PARAM_TYPE_GET (Operation->paramTypes, Index);
+    if (Type == TEEC_NONE) {
+      continue;
+    }
+
+    if ((Type < TEEC_VALUE_INPUT) || (Type > TEEC_VALUE_INOUT)) {
+      TeecResult = TEEC_ERROR_BAD_PARAMETERS;
+      goto Exit;
+    }
+
+    NumParams = Index + 1;
+  }
+
+  MsgArg = OpteeSmcMsgArgAlloc (NumParams);
+  if (MsgArg == NULL) {
+    TeecResult = TEEC_ERROR_OUT_OF_MEMORY;
+    goto Exit;
   }
+  ZeroMem (MsgArg, OPTEE_MSG_GET_ARG_SIZE (NumParams));
 
+  MsgArg->cmd = OPTEE_MSG_CMD_INVOKE_COMMAND;
+  MsgArg->func = CmdId;
+  MsgArg->session = Session->session_id;
+  MsgArg->num_params = (uint32_t) NumParams;
+
+  for (Index = 0; Index < NumParams; Index++) {
+    Type = TEEC_PARAM_TYPE_GET (Operation->paramTypes, Index);
+    if (Type != TEEC_NONE) {
+      MsgArg->params[Index].attr = OPTEE_MSG_ATTR_TYPE_VALUE_INPUT + (Type - TEEC_VALUE_INPUT);
+      MsgArg->params[Index].u.value.a = Operation->params[Index].value.a;
+      MsgArg->params[Index].u.value.b = Operation->params[Index].value.b;
+    }
+  }
+
+  *ErrorOrigin = TEEC_ORIGIN_COMMS;
+
+  TeecResult = OpteeSmcCall (MsgArg);
+  if (TeecResult != TEEC_SUCCESS) {
+    goto Exit;
+  }
+
+  TeecResult = MsgArg->ret;
+  *ErrorOrigin = MsgArg->ret_origin;
+
+  for (Index = 0; Index < NumParams; Index++) {
+    Type = TEEC_PARAM_TYPE_GET (Operation->paramTypes, Index);
+    if ((Type == TEEC_VALUE_OUTPUT) || (Type == TEEC_VALUE_INOUT)) {
+      Operation->params[Index].value.a = (uint32_t) MsgArg->params[Index].u.value.a;
+      Operation->params[Index].value.b = (uint32_t) MsgArg->params[Index].u.value.b;
+    }
+  }
+
+Exit:
+  if (MsgArg != NULL) {
+    OpteeSmcMsgArgFree (MsgArg);
+  }
+
+  gOpteeClientCallDepth--;
   return TeecResult;
 }
 
@@ -368,27 +649,45 @@ GetMsgParams (
 }
 
 /*
- * Populate the SMC registers and make the call with OpTEE specific
- * handling.
+ * Populate the SMC registers for a new OPTEE_SMC_CALL_WITH_ARG.
  */
-TEEC_Result
-OpteeSmcCall (
-  IN optee_msg_arg_t  *MsgArg
+STATIC
+VOID
+OpteeSmcCallInit (
+  OUT OPTEE_SMC_CALL    *Call,
+  IN optee_msg_arg_t    *MsgArg
   )
 {
-  TEEC_Result TeecResult = TEEC_SUCCESS;
-  ARM_SMC_ARGS ArmSmcArgs = { 0 };
   EFI_PHYSICAL_ADDRESS MsgAddr = (EFI_PHYSICAL_ADDRESS) (UINTN) MsgArg;
 
-  LOG_TRACE ("MsgArg=0x%p", MsgArg);
+  ZeroMem (Call, sizeof (*Call));
+  Call->MsgArg = MsgArg;
 
   // Use the STD call style.
   // a0: SMC Function ID, OPTEE_SMC*CALL_WITH_ARG
   // a1: Upper 32 bits of a 64-bit physical pointer to a struct optee_msg_arg
   // a2: Lower 32 bits of a 64-bit physical pointer to a struct optee_msg_arg
-  ArmSmcArgs.Arg0 = OPTEE_SMC_CALL_WITH_ARG;
-  ArmSmcArgs.Arg1 = (UINTN) (MsgAddr >> 32);
-  ArmSmcArgs.Arg2 = (UINTN) (MsgAddr & 0xFFFFFFFF);
+  Call->ArmSmcArgs.Arg0 = OPTEE_SMC_CALL_WITH_ARG;
+  Call->ArmSmcArgs.Arg1 = (UINTN) (MsgAddr >> 32);
+  Call->ArmSmcArgs.Arg2 = (UINTN) (MsgAddr & 0xFFFFFFFF);
+}
+
+/*
+ * Drive a call forward until it completes or, when Yield is set, until secure
+ * world gives the core back for a foreign interrupt or a wait queue sleep.
+ *
+ * Returns TRUE and the call result in TeecResult when the call completed.
+ */
+STATIC
+BOOLEAN
+OpteeSmcCallRun (
+  IN OUT OPTEE_SMC_CALL   *Call,
+  IN BOOLEAN              Yield,
+  OUT TEEC_Result         *TeecResult
+  )
+{
+  OPTEE_RPC_RESUME Resume;
+  UINT64 SmcStartTick;
 
   // This is a loop because the call may result in RPC's that will need
   // to be processed and may result in further calls until the originating
@@ -397,34 +696,470 @@ OpteeSmcCall (
 
     LOG_TRACE (
       "--> SMC Call (MsgArg=0x%p, Arg0=0x%p, Arg1=0x%p, Arg2=0x%p)",
-      MsgArg,
-      ArmSmcArgs.Arg0,
-      ArmSmcArgs.Arg1,
-      ArmSmcArgs.Arg2);
+      Call->MsgArg,
+      Call->ArmSmcArgs.Arg0,
+      Call->ArmSmcArgs.Arg1,
+      Call->ArmSmcArgs.Arg2);
 
-    ArmCallSmc (&ArmSmcArgs);
+    SmcStartTick = OpteeProfileSmcBegin ();
+    ArmCallSmc (&Call->ArmSmcArgs);
+    OpteeProfileSmcEnd (SmcStartTick);
 
-    LOG_TRACE ("<-- SMC Return (Arg0=0x%p)", ArmSmcArgs.Arg0);
+    LOG_TRACE ("<-- SMC Return (Arg0=0x%p)", Call->ArmSmcArgs.Arg0);
 
-    if (OPTEE_SMC_RETURN_IS_RPC (ArmSmcArgs.Arg0)) {
+    if (OPTEE_SMC_RETURN_IS_RPC (Call->ArmSmcArgs.Arg0)) {
 
       // We must service the RPC even if it's processing failed
       // and let the OpTEE OS unwind and return back to us with
       // it's error information.
       LOG_TRACE ("--> RPC Call");
-      (VOID) OpteeRpcCallback (&ArmSmcArgs);
+      (VOID) OpteeRpcCallback (&Call->ArmSmcArgs, &Resume);
       LOG_TRACE ("<-- RPC Return");
-    } else if (ArmSmcArgs.Arg0 == OPTEE_SMC_RETURN_UNKNOWN_FUNCTION) {
-      TeecResult = TEEC_ERROR_NOT_IMPLEMENTED;
-      break;
-    } else if (ArmSmcArgs.Arg0 != OPTEE_SMC_RETURN_OK) {
-      TeecResult = TEEC_ERROR_COMMUNICATION;
-      break;
+
+      if (Resume == OpteeRpcResumeNow) {
+        continue;
+      }
+
+      if (Yield) {
+        return FALSE;
+      }
+
+      // A synchronous call cannot give the core away. If it sleeps on a wait
+      // queue, the holder can only be one of the asynchronous calls, let them
+      // run so it gets released.
+      if ((Resume == OpteeRpcResumeSleep) && (mAsyncRunningCount != 0)) {
+        OpteeSmcAsyncRunAll ();
+      }
+    } else if (Call->ArmSmcArgs.Arg0 == OPTEE_SMC_RETURN_UNKNOWN_FUNCTION) {
+      *TeecResult = TEEC_ERROR_NOT_IMPLEMENTED;
+      return TRUE;
+    } else if (Call->ArmSmcArgs.Arg0 != OPTEE_SMC_RETURN_OK) {
+      *TeecResult = TEEC_ERROR_COMMUNICATION;
+      return TRUE;
     } else {
-      TeecResult = TEEC_SUCCESS;
-      break;
+      *TeecResult = TEEC_SUCCESS;
+      return TRUE;
     }
   }
+}
+
+/*
+ * Populate the SMC registers and make the call with OpTEE specific
+ * handling.
+ */
+TEEC_Result
+OpteeSmcCall (
+  IN optee_msg_arg_t  *MsgArg
+  )
+{
+  TEEC_Result TeecResult = TEEC_SUCCESS;
+  OPTEE_SMC_CALL Call;
+
+  LOG_TRACE ("MsgArg=0x%p", MsgArg);
+
+  gOpteeClientCallDepth++;
+  OpteeProfileCallBegin (MsgArg);
+
+  OpteeSmcCallInit (&Call, MsgArg);
+  (VOID) OpteeSmcCallRun (&Call, FALSE, &TeecResult);
+
+  OpteeProfileCallEnd (MsgArg);
+  gOpteeClientCallDepth--;
 
   return TeecResult;
 }
+
+/*
+ * Ask OpTEE to cancel the command carrying the given cancellation id.
+ */
+STATIC
+TEEC_Result
+OpteeSmcCancel (
+  IN UINT32   Session,
+  IN UINT32   CancelId
+  )
+{
+  TEEC_Result TeecResult = TEEC_SUCCESS;
+  optee_msg_arg_t *MsgArg = NULL;
+  UINTN MsgArgSize = OPTEE_MSG_GET_ARG_SIZE (0);
+
+  MsgArg = OpteeSmcMsgArgAlloc (0);
+  if (MsgArg == NULL) {
+    TeecResult = TEEC_ERROR_OUT_OF_MEMORY;
+    goto Exit;
+  }
+  ZeroMem (MsgArg, MsgArgSize);
+
+  MsgArg->cmd = OPTEE_MSG_CMD_CANCEL;
+  MsgArg->session = Session;
+  MsgArg->cancel_id = CancelId;
+
+  TeecResult = OpteeSmcCall (MsgArg);
+  if (TeecResult == TEEC_SUCCESS) {
+    TeecResult = MsgArg->ret;
+  }
+
+Exit:
+  if (MsgArg != NULL) {
+    OpteeSmcMsgArgFree (MsgArg);
+  }
+
+  LOG_TRACE ("Session=0x%X, CancelId=0x%X, TeecResult=0x%X", Session, CancelId, TeecResult);
+  return TeecResult;
+}
+
+/*
+ * Record the result of an asynchronous call that returned, release its
+ * message block and signal its completion event.
+ */
+STATIC
+VOID
+OpteeSmcAsyncComplete (
+  IN OPTEE_ASYNC_INVOKE   *Invoke,
+  IN TEEC_Result          TeecResult
+  )
+{
+  Invoke->ErrorOrigin = TEEC_ORIGIN_COMMS;
+  if (TeecResult == TEEC_SUCCESS) {
+    TeecResult = Invoke->Call.MsgArg->ret;
+    Invoke->ErrorOrigin = Invoke->Call.MsgArg->ret_origin;
+
+    // Update the caller supplied Operation parameters with those returned from the call.
+    GetMsgParams (Invoke->Call.MsgArg->params, Invoke->Operation);
+  }
+
+  Invoke->TeecResult = TeecResult;
+  Invoke->Completed = TRUE;
+
+  OpteeClientMemFree (Invoke->Call.MsgArg);
+  Invoke->Call.MsgArg = NULL;
+
+  ASSERT (mAsyncRunningCount != 0);
+  mAsyncRunningCount--;
+  if (mAsyncRunningCount == 0) {
+    gBS->SetTimer (mAsyncPollEvent, TimerCancel, 0);
+  }
+
+  LOG_TRACE ("Operation=0x%p completed, TeecResult=0x%X", Invoke->Operation, TeecResult);
+  gBS->SignalEvent (Invoke->CompletionEvent);
+}
+
+/*
+ * Give every asynchronous call still running in secure world a step, deliver
+ * the pending cancellation requests and complete the calls that returned.
+ */
+STATIC
+VOID
+OpteeSmcAsyncRunAll (
+  VOID
+  )
+{
+  LIST_ENTRY *Link;
+  OPTEE_ASYNC_INVOKE *Invoke;
+  TEEC_Result TeecResult;
+
+  for (Link = GetFirstNode (&mAsyncInvokeList);
+       !IsNull (&mAsyncInvokeList, Link);
+       Link = GetNextNode (&mAsyncInvokeList, Link)) {
+
+    Invoke = OPTEE_ASYNC_INVOKE_FROM_LINK (Link);
+    if (Invoke->Completed) {
+      continue;
+    }
+
+    // The command may be parked on an RPC when the request comes in, OpTEE
+    // acts on it when the command thread resumes below.
+    if (Invoke->CancelRequested) {
+      Invoke->CancelRequested = FALSE;
+      (VOID) OpteeSmcCancel (Invoke->Call.MsgArg->session, Invoke->Call.MsgArg->cancel_id);
+
+      // The cancel request is a synchronous call, if it slept the calls were
+      // stepped from a nested run which may have completed this one.
+      if (Invoke->Completed) {
+        continue;
+      }
+    }
+
+    if (OpteeSmcCallRun (&Invoke->Call, TRUE, &TeecResult)) {
+      OpteeSmcAsyncComplete (Invoke, TeecResult);
+    }
+  }
+}
+
+/*
+ * Cancel the asynchronous calls still running on a session, or on any
+ * session, and run them to completion. Their results stay for
+ * TEEC_SMC_InvokeCommandAsyncComplete().
+ */
+STATIC
+VOID
+OpteeSmcAsyncDrain (
+  IN UINT32   SessionId,
+  IN BOOLEAN  AllSessions
+  )
+{
+  LIST_ENTRY *Link;
+  OPTEE_ASYNC_INVOKE *Invoke;
+  TEEC_Result TeecResult;
+
+  for (;;) {
+    Invoke = NULL;
+    for (Link = GetFirstNode (&mAsyncInvokeList);
+         !IsNull (&mAsyncInvokeList, Link);
+         Link = GetNextNode (&mAsyncInvokeList, Link)) {
+
+      Invoke = OPTEE_ASYNC_INVOKE_FROM_LINK (Link);
+      if (!Invoke->Completed &&
+          (AllSessions || (Invoke->Call.MsgArg->session == SessionId))) {
+        break;
+      }
+      Invoke = NULL;
+    }
+
+    if (Invoke == NULL) {
+      return;
+    }
+
+    // Off the list while it runs, the other calls get stepped if it sleeps
+    // on a wait queue and this one must not be stepped from there as well.
+    RemoveEntryList (&Invoke->Link);
+    Invoke->CancelRequested = FALSE;
+    (VOID) OpteeSmcCancel (Invoke->Call.MsgArg->session, Invoke->Call.MsgArg->cancel_id);
+    (VOID) OpteeSmcCallRun (&Invoke->Call, FALSE, &TeecResult);
+    InsertTailList (&mAsyncInvokeList, &Invoke->Link);
+
+    OpteeSmcAsyncComplete (Invoke, TeecResult);
+  }
+}
+
+/*
+ * Timer notification resuming the asynchronous calls.
+ */
+STATIC
+VOID
+EFIAPI
+OpteeSmcAsyncPollNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  // The timer may have interrupted the library, shared memory allocator
+  // included, in which case try again on the next tick.
+  if (gOpteeClientCallDepth != 0) {
+    return;
+  }
+
+  gOpteeClientCallDepth++;
+  OpteeSmcAsyncRunAll ();
+  gOpteeClientCallDepth--;
+}
+
+STATIC
+OPTEE_ASYNC_INVOKE*
+OpteeSmcAsyncFind (
+  IN TEEC_Operation   *Operation
+  )
+{
+  LIST_ENTRY *Link;
+  OPTEE_ASYNC_INVOKE *Invoke;
+
+  for (Link = GetFirstNode (&mAsyncInvokeList);
+       !IsNull (&mAsyncInvokeList, Link);
+       Link = GetNextNode (&mAsyncInvokeList, Link)) {
+
+    Invoke = OPTEE_ASYNC_INVOKE_FROM_LINK (Link);
+    if (Invoke->Operation == Operation) {
+      return Invoke;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Starts a TEE command and returns without waiting for it to complete.
+ *
+ * The command runs in secure world until it first gives the core back and is
+ * then resumed from a timer callback at TPL_CALLBACK, so the caller should
+ * wait on CompletionEvent from a lower TPL. The Operation identifies the call
+ * and must stay valid until TEEC_SMC_InvokeCommandAsyncComplete().
+ */
+TEEC_Result
+TEEC_SMC_InvokeCommandAsync (
+  IN TEEC_Session     *Session,
+  IN uint32_t         CmdId,
+  IN TEEC_Operation   *Operation,
+  OUT EFI_EVENT       *CompletionEvent,
+  OUT uint32_t        *ErrorOrigin
+  )
+{
+  TEEC_Result TeecResult = TEEC_SUCCESS;
+  OPTEE_ASYNC_INVOKE *Invoke = NULL;
+  optee_msg_arg_t *MsgArg = NULL;
+  EFI_STATUS Status;
+
+  *ErrorOrigin = TEEC_ORIGIN_API;
+  gOpteeClientCallDepth++;
+
+  if (OpteeSmcAsyncFind (Operation) != NULL) {
+    TeecResult = TEEC_ERROR_BAD_STATE;
+    goto Exit;
+  }
+
+  if (mAsyncPollEvent == NULL) {
+    Status = gBS->CreateEvent (
+                    EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                    TPL_CALLBACK,
+                    OpteeSmcAsyncPollNotify,
+                    NULL,
+                    &mAsyncPollEvent);
+
+    if (EFI_ERROR (Status)) {
+      LOG_ERROR ("gBS->CreateEvent() failed. (Status=%r)", Status);
+      mAsyncPollEvent = NULL;
+      TeecResult = TEEC_ERROR_NOT_SUPPORTED;
+      goto Exit;
+    }
+  }
+
+  Invoke = AllocateZeroPool (sizeof (*Invoke));
+  if (Invoke == NULL) {
+    TeecResult = TEEC_ERROR_OUT_OF_MEMORY;
+    goto Exit;
+  }
+
+  Status = gBS->CreateEvent (0, 0, NULL, NULL, &Invoke->CompletionEvent);
+  if (EFI_ERROR (Status)) {
+    LOG_ERROR ("gBS->CreateEvent() failed. (Status=%r)", Status);
+    Invoke->CompletionEvent = NULL;
+    TeecResult = TEEC_ERROR_OUT_OF_MEMORY;
+    goto Exit;
+  }
+
+  // Allocate the primary data packet from the OpTEE OS shared pool, it lives
+  // until the call completes.
+  {
+    UINTN MsgArgSize = OPTEE_MSG_GET_ARG_SIZE (TEEC_CONFIG_PAYLOAD_REF_COUNT);
+
+    MsgArg = (optee_msg_arg_t*) OpteeClientMemAlloc (MsgArgSize, OpteeShmSiteMsgArg);
+    if (MsgArg == NULL) {
+      TeecResult = TEEC_ERROR_OUT_OF_MEMORY;
+      goto Exit;
+    }
+    ZeroMem (MsgArg, MsgArgSize);
+  }
+
+  MsgArg->cmd = OPTEE_MSG_CMD_INVOKE_COMMAND;
+  MsgArg->func = CmdId;
+  MsgArg->session = Session->session_id;
+  MsgArg->cancel_id = mNextCancelId++;
+  MsgArg->num_params = TEEC_CONFIG_PAYLOAD_REF_COUNT;
+
+  // Fill in the caller supplied Operation parameters.
+  SetMsgParams (Operation, MsgArg->params);
+
+  Invoke->Signature = OPTEE_ASYNC_INVOKE_SIGNATURE;
+  Invoke->Operation = Operation;
+  Operation->session = Session;
+  Operation->started = 1;
+  OpteeSmcCallInit (&Invoke->Call, MsgArg);
+  InsertTailList (&mAsyncInvokeList, &Invoke->Link);
+
+  if (mAsyncRunningCount++ == 0) {
+    Status = gBS->SetTimer (mAsyncPollEvent, TimerPeriodic, OPTEE_ASYNC_POLL_PERIOD);
+    ASSERT_EFI_ERROR (Status);
+  }
+
+  *CompletionEvent = Invoke->CompletionEvent;
+  *ErrorOrigin = TEEC_ORIGIN_COMMS;
+
+  // Run the first leg synchronously, short commands complete right here and
+  // the event is already signaled on return.
+  OpteeSmcAsyncRunAll ();
+
+  gOpteeClientCallDepth--;
+  return TEEC_SUCCESS;
+
+Exit:
+  if (MsgArg != NULL) {
+    OpteeClientMemFree (MsgArg);
+  }
+
+  if (Invoke != NULL) {
+    if (Invoke->CompletionEvent != NULL) {
+      gBS->CloseEvent (Invoke->CompletionEvent);
+    }
+    FreePool (Invoke);
+  }
+
+  gOpteeClientCallDepth--;
+  return TeecResult;
+}
+
+/*
+ * Collects the result of a TEEC_SMC_InvokeCommandAsync() call and releases it.
+ *
+ * Returns TEEC_ERROR_BUSY, leaving the call untouched, if it did not complete.
+ */
+TEEC_Result
+TEEC_SMC_InvokeCommandAsyncComplete (
+  IN TEEC_Operation   *Operation,
+  OUT uint32_t        *ErrorOrigin
+  )
+{
+  OPTEE_ASYNC_INVOKE *Invoke;
+  TEEC_Result TeecResult;
+
+  *ErrorOrigin = TEEC_ORIGIN_API;
+  gOpteeClientCallDepth++;
+
+  Invoke = OpteeSmcAsyncFind (Operation);
+  if (Invoke == NULL) {
+    TeecResult = TEEC_ERROR_ITEM_NOT_FOUND;
+    goto Exit;
+  }
+
+  if (!Invoke->Completed) {
+    TeecResult = TEEC_ERROR_BUSY;
+    goto Exit;
+  }
+
+  TeecResult = Invoke->TeecResult;
+  *ErrorOrigin = Invoke->ErrorOrigin;
+
+  RemoveEntryList (&Invoke->Link);
+  gBS->CloseEvent (Invoke->CompletionEvent);
+  FreePool (Invoke);
+
+Exit:
+  gOpteeClientCallDepth--;
+  return TeecResult;
+}
+
+/*
+ * Requests the cancellation of an asynchronous command. The request is sent
+ * to OpTEE as an OPTEE_MSG_CMD_CANCEL from the next poll of the command, the
+ * command still completes through its completion event, typically with
+ * TEEC_ERROR_CANCEL if the TA honored the request.
+ *
+ * Returns FALSE if the Operation is not an asynchronous command in flight.
+ */
+BOOLEAN
+TEEC_SMC_RequestCancellation (
+  IN TEEC_Operation   *Operation
+  )
+{
+  OPTEE_ASYNC_INVOKE *Invoke;
+  BOOLEAN Requested;
+
+  gOpteeClientCallDepth++;
+
+  Invoke = OpteeSmcAsyncFind (Operation);
+  Requested = (Invoke != NULL) && !Invoke->Completed;
+  if (Requested) {
+    Invoke->CancelRequested = TRUE;
+  }
+
+  gOpteeClientCallDepth--;
+  return Requested;
+}
@@ -19,12 +19,16 @@
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/ArmSmcLib.h>
 #include <Library/OpteeClientApiLib.h>
 #include <Library/tee_client_api.h>
 
 #include "OpteeClientMem.h"
 #include "OpteeClientSMC.h"
+#include "OpteeClientRPC.h"
 #include "OpteeClientDefs.h"
+#include "OpteeClientProfile.h"
+#include "OpteeClientShmTrack.h"
 
 // Driver image handle to use for memory allocation.
 EFI_HANDLE gDriverImageHandle = NULL;
@@ -44,11 +48,40 @@ OpteeClientApiInitialize (
   Status = OpteeClientMemInit ();
   if (EFI_ERROR (Status)) {
     LOG_ERROR ("OpteeClientMemInit() failed. (Status=%r)", Status);
+    return Status;
   }
 
+  // The RPC payload pool and RPMB IO binding cache are an optimization, the
+  // RPC handlers fall back to the slow path if they could not be set up.
+  (VOID) OpteeRpcInit ();
+
+  // Same for the reserved message block of the synchronous calls.
+  (VOID) OpteeSmcInit ();
+
+  // Profiling is best effort, failing to publish it is not fatal.
+  (VOID) OpteeProfileInit ();
+
   return Status;
 }
 
+/** Release what the library keeps in pool memory and its events when the
+  image unloads. OpteeClientApiFinalize() runs from ExitBootServices
+  notifications and leaves them alone.
+**/
+EFI_STATUS
+EFIAPI
+OpteeClientApiLibDestructor (
+  IN EFI_HANDLE         ImageHandle,
+  IN EFI_SYSTEM_TABLE   *SystemTable
+  )
+{
+  OpteeSmcUnload ();
+  OpteeRpcUnload ();
+  OpteeShmTrackUnload ();
+
+  return EFI_SUCCESS;
+}
+
 /**
   This function initializes a new TEE Context, forming a connection between this
   Client Application and the TEE identified by the string identifier Name.
@@ -169,7 +202,9 @@ TEEC_AllocateSharedMemory (
 
   LOG_TRACE ("size=%d, flags=0x%p", SharedMem->size, SharedMem->flags);
 
-  SharedMem->buffer = OpteeClientMemAlloc (SharedMem->size);
+  gOpteeClientCallDepth++;
+  SharedMem->buffer = OpteeClientMemAlloc (SharedMem->size, OpteeShmSiteSharedMemory);
+  gOpteeClientCallDepth--;
   if (SharedMem->buffer == NULL) {
     LOG_ERROR (
       "OpteeClientMemAlloc() failed. (size=%p)",
@@ -178,6 +213,9 @@ TEEC_AllocateSharedMemory (
     goto Exit;
   }
 
+  // Attribute the block to the client code rather than to this function.
+  OpteeShmTrackSetCallSite ((UINTN) SharedMem->buffer, (UINTN) RETURN_ADDRESS (0));
+
   SharedMem->shadow_buffer = SharedMem->buffer;
 
 Exit:
@@ -222,7 +260,9 @@ TEEC_ReleaseSharedMemory (
   if (SharedMem->shadow_buffer != NULL) {
     EFI_STATUS Status;
 
+    gOpteeClientCallDepth++;
     Status = OpteeClientMemFree (SharedMem->shadow_buffer);
+    gOpteeClientCallDepth--;
     if (EFI_ERROR (Status)) {
       LOG_ERROR (
         "OpteeClientMemFree() failed. (shadow_buffer=%p)",
@@ -459,11 +499,155 @@ Exit:
   return TeecResult;
 }
 
+/**
+  Invokes a command whose parameters are all values without going through
+  shared memory allocations, see OpteeClientApiLib.h.
+**/
+TEEC_Result
+TEEC_InvokeCommandFast (
+  IN TEEC_Session       *Session,
+  IN uint32_t           CommandID,
+  IN OUT TEEC_Operation *Operation,
+  OUT uint32_t          *ReturnOrigin
+  )
+{
+  TEEC_Result TeecResult = TEEC_SUCCESS;
+  uint32_t TeecErrorOrigin = TEEC_ORIGIN_API;
+
+  LOG_TRACE (
+    "Session=0x%p, CommandID=0x%X, Operation=0x%p",
+    Session,
+    CommandID,
+    Operation);
+
+  if (Session == NULL) {
+    TeecResult = TEEC_ERROR_BAD_PARAMETERS;
+    goto Exit;
+  }
+
+  {
+    TEEC_Operation TeecNullOperation = { 0 };
+    TEEC_Operation *TeecOperation;
+
+    if (Operation == NULL) {
+      TeecOperation = &TeecNullOperation;
+    } else {
+      TeecOperation = Operation;
+    }
+
+    TeecResult = TEEC_SMC_InvokeCommandFast (
+                    Session,
+                    CommandID,
+                    TeecOperation,
+                    &TeecErrorOrigin);
+  }
+
+Exit:
+  if (ReturnOrigin != NULL) {
+    *ReturnOrigin = TeecErrorOrigin;
+  }
+
+  LOG_TRACE (
+    "TeecResult=0x%X, TeecErrorOrigin=0x%X",
+    TeecResult,
+    TeecErrorOrigin);
+
+  return TeecResult;
+}
+
+/**
+  Starts a TEEC_InvokeCommand without waiting for it to complete, see
+  OpteeClientApiLib.h.
+**/
+TEEC_Result
+TEEC_InvokeCommandAsync (
+  IN TEEC_Session     *Session,
+  IN uint32_t         CommandID,
+  IN TEEC_Operation   *Operation,
+  OUT EFI_EVENT       *CompletionEvent,
+  OUT uint32_t        *ReturnOrigin
+  )
+{
+  TEEC_Result TeecResult = TEEC_SUCCESS;
+  uint32_t TeecErrorOrigin = TEEC_ORIGIN_API;
+
+  LOG_TRACE (
+    "Session=0x%p, CommandID=0x%X, Operation=0x%p",
+    Session,
+    CommandID,
+    Operation);
+
+  // Unlike TEEC_InvokeCommand the Operation is required, it identifies the
+  // command until its result is collected.
+  if ((Session == NULL) || (Operation == NULL) || (CompletionEvent == NULL)) {
+    TeecResult = TEEC_ERROR_BAD_PARAMETERS;
+    goto Exit;
+  }
+
+  TeecResult = TEEC_SMC_InvokeCommandAsync (
+                  Session,
+                  CommandID,
+                  Operation,
+                  CompletionEvent,
+                  &TeecErrorOrigin);
+
+Exit:
+  if (ReturnOrigin != NULL) {
+    *ReturnOrigin = TeecErrorOrigin;
+  }
+
+  LOG_TRACE (
+    "TeecResult=0x%X, TeecErrorOrigin=0x%X",
+    TeecResult,
+    TeecErrorOrigin);
+
+  return TeecResult;
+}
+
+/**
+  Collects the result of a command started by TEEC_InvokeCommandAsync(), see
+  OpteeClientApiLib.h.
+**/
+TEEC_Result
+TEEC_InvokeCommandAsyncComplete (
+  IN TEEC_Operation   *Operation,
+  OUT uint32_t        *ReturnOrigin
+  )
+{
+  TEEC_Result TeecResult = TEEC_SUCCESS;
+  uint32_t TeecErrorOrigin = TEEC_ORIGIN_API;
+
+  LOG_TRACE ("Operation=0x%p", Operation);
+
+  if (Operation == NULL) {
+    TeecResult = TEEC_ERROR_BAD_PARAMETERS;
+    goto Exit;
+  }
+
+  TeecResult = TEEC_SMC_InvokeCommandAsyncComplete (Operation, &TeecErrorOrigin);
+
+Exit:
+  if (ReturnOrigin != NULL) {
+    *ReturnOrigin = TeecErrorOrigin;
+  }
+
+  LOG_TRACE (
+    "TeecResult=0x%X, TeecErrorOrigin=0x%X",
+    TeecResult,
+    TeecErrorOrigin);
+
+  return TeecResult;
+}
+
 /**
   This function requests the cancellation of a pending open Session operation or
-  a Command invocation operation. As this is a synchronous API, this function must
-  be called from a thread other than the one executing the TEEC_OpenSession or
-  TEEC_InvokeCommand function.
+  a Command invocation operation.
+
+  UEFI being single threaded, only a command started with
+  TEEC_InvokeCommandAsync() can be pending when this is called. The request is
+  forwarded to OpTEE, the command still completes through its completion
+  event, with TEEC_ERROR_CANCEL if the TA acted on the request. The function
+  does nothing for any other Operation.
 
   @param[in] Operation  a pointer to a Client Application instantiated Operation
   structure.
@@ -473,7 +657,13 @@ TEEC_RequestCancellation (
   IN TEEC_Operation *Operation
   )
 {
-  ASSERT (FALSE);
-  return;
-}
+  LOG_TRACE ("Operation=0x%p", Operation);
 
+  if (Operation == NULL) {
+    return;
+  }
+
+  if (!TEEC_SMC_RequestCancellation (Operation)) {
+    LOG_TRACE ("No asynchronous command pending for Operation=0x%p", Operation);
+  }
+}
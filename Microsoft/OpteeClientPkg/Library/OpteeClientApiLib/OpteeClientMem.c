@@ -43,9 +43,14 @@
 #include <Library/DebugLib.h>
 #include <Library/DxeServicesTableLib.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/tee_client_api.h>
 
 #include "OpteeClientMem.h"
+#include "OpteeClientSMC.h"
+#include "OpteeClientRPC.h"
 #include "OpteeClientDefs.h"
+#include "OpteeClientShmTrack.h"
 
 // Attributes for reserved memory which are missing from the common headers.
 
@@ -340,6 +345,31 @@ OpteeClientMemInit (
       goto Exit;
   }
 
+  // Map the shared memory write-back cacheable when the platform allows it,
+  // which needs OP-TEE to map its side of the region as Normal WB too.
+  // Failing to do so only costs performance.
+  if (FeatureFlagPcd (PcdOpteeClientSharedMemoryCached) &&
+      ((GcdMemDescriptor.Attributes & EFI_MEMORY_WB) == 0)) {
+
+    if ((GcdMemDescriptor.Capabilities & EFI_MEMORY_WB) == 0) {
+      LOG_INFO ("OPTEE Shared Memory is not WB capable, leaving it uncached");
+    } else {
+      Status = gDS->SetMemorySpaceAttributes (
+                      OPTEE_SHM_START,
+                      OPTEE_SHM_SIZE,
+                      EFI_MEMORY_WB);
+
+      if (EFI_ERROR (Status)) {
+        LOG_ERROR ("gDS->SetMemorySpaceAttributes(WB) failed. (Status=%r)", Status);
+      }
+
+      Status = EFI_SUCCESS;
+    }
+  }
+
+  // Tracking is best effort, failing to publish it is not fatal.
+  (VOID) OpteeShmTrackInit (OPTEE_SHM_SIZE);
+
 Exit:
 
   return Status;
@@ -347,8 +377,9 @@ Exit:
 
 VOID*
 InternalMemAlloc (
-  IN UINTN  Size,
-  IN UINTN  ByteAlignment
+  IN UINTN                  Size,
+  IN UINTN                  ByteAlignment,
+  IN OPTEE_CLIENT_SHM_SITE  Site
   )
 {
   EFI_STATUS Status;
@@ -400,6 +431,7 @@ InternalMemAlloc (
       AlignmentShift,
       Status);
 
+    OpteeShmTrackAllocFailed (BlockSize);
     goto Exit;
   }
 
@@ -445,6 +477,7 @@ InternalMemAlloc (
     ZeroMem (Header, sizeof (*Header));
 
     Header->Signature = OPTEE_SHM_SIGNATURE;
+    Header->Owner = gDriverImageHandle;
     Header->Size = BlockSize;
     Header->Address = BaseAddress;
 
@@ -452,6 +485,8 @@ InternalMemAlloc (
     mSharedMemAllocSize += Header->Size;
   }
 
+  OpteeShmTrackAlloc (UserBaseAddress, Size, BlockSize, Site);
+
 Exit:
   return (VOID *) UserBaseAddress;
 
@@ -459,25 +494,28 @@ Exit:
 
 /** Allocate block of memory from the TrustZone shared memory block.
 
-  The allocated block is guaranteed to be 16-byte (128-bit) aligned
+  The allocated block is guaranteed to be 16-byte (128-bit) aligned. Site
+  tells the shared memory tracker which part of the library asked for it.
 **/
 VOID*
 OpteeClientMemAlloc (
-  IN UINTN  Size
+  IN UINTN                  Size,
+  IN OPTEE_CLIENT_SHM_SITE  Site
   )
 {
-  return InternalMemAlloc (Size, OPTEE_CLIENT_MEM_BYTE_ALIGNMENT);
+  return InternalMemAlloc (Size, OPTEE_CLIENT_MEM_BYTE_ALIGNMENT, Site);
 }
 
 /** Allocate aligned block of memory from the TrustZone shared memory block.
 **/
 VOID*
 OpteeClientAlignedMemAlloc (
-  IN UINTN  Size,
-  IN UINTN  ByteAlignment
+  IN UINTN                  Size,
+  IN UINTN                  ByteAlignment,
+  IN OPTEE_CLIENT_SHM_SITE  Site
   )
 {
-  return InternalMemAlloc (Size, ByteAlignment);
+  return InternalMemAlloc (Size, ByteAlignment, Site);
 }
 
 /** Free a block of memory previously allocated using OpteeClientMemAlloc(..).
@@ -499,6 +537,16 @@ OpteeClientMemFree (
   EFI_PHYSICAL_ADDRESS Address = Header->Address;
   UINT64 Size = Header->Size;
 
+  // The pool is shared by all the drivers linking this library, a block must
+  // go back through the instance which accounted for it.
+  if (Header->Owner != gDriverImageHandle) {
+    LOG_ERROR (
+      "Freeing a block owned by another driver. (Mem=0x%p, Owner=%p)",
+      Mem,
+      Header->Owner);
+    ASSERT (FALSE);
+  }
+
   MarkSharedMemoryRegionAsFree (Header->Address, Header->Size);
 
   Status = gDS->FreeMemorySpace (Address, Size);
@@ -510,6 +558,8 @@ OpteeClientMemFree (
   mSharedMemAllocationCount -= 1;
   mSharedMemAllocSize -= Size;
 
+  OpteeShmTrackFree ((UINTN) Mem, Size);
+
 Exit:
   return Status;
 }
@@ -521,6 +571,11 @@ OpteeClientApiFinalize (
 {
   LOG_INFO ("Finalizing OPTEE Client API Lib");
 
+  // Give back the buffers the SMC and RPC layers keep around before checking
+  // for leaks.
+  OpteeSmcDeinit ();
+  OpteeRpcDeinit ();
+
   DumpGcdMemorySpaceMap ();
 
   LOG_INFO (
@@ -528,6 +583,9 @@ OpteeClientApiFinalize (
       mSharedMemAllocationCount,
       mSharedMemAllocSize);
 
+  // Lists the leaked blocks, if any, with the call site that allocated them.
+  OpteeShmTrackReport ();
+
   if (mSharedMemAllocationCount != 0 || mSharedMemAllocSize != 0) {
     LOG_ERROR ("!! Potential shared memory leak detected !!");
     ASSERT (FALSE);
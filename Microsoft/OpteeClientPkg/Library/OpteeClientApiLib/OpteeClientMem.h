@@ -32,19 +32,23 @@
 #ifndef __OPTEE_CLIENT_MEM_H__
 #define __OPTEE_CLIENT_MEM_H__
 
+#include "OpteeClientShmTrack.h"
+
 EFI_STATUS
 OpteeClientMemInit (
   );
 
 VOID*
 OpteeClientMemAlloc (
-  IN UINTN  Size
+  IN UINTN                  Size,
+  IN OPTEE_CLIENT_SHM_SITE  Site
   );
 
 VOID*
 OpteeClientAlignedMemAlloc (
-  IN UINTN  Size,
-  IN UINTN  ByteAlignment
+  IN UINTN                  Size,
+  IN UINTN                  ByteAlignment,
+  IN OPTEE_CLIENT_SHM_SITE  Site
   );
 
 EFI_STATUS
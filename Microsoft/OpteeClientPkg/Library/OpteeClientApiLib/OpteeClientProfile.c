@@ -0,0 +1,296 @@
+/** @file
+  The OP-TEE Client profiler accounts for the time spent in secure world and
+  in the normal world RPC handlers for every SMC call issued by the library.
+
+  The accounting is single threaded by nature, UEFI runs on a single core and
+  an SMC call never nests into another, so a single in-flight call record is
+  enough. On call completion the record is folded into the running totals and
+  kept as the last call snapshot.
+
+  Asynchronous invokes are the exception, they are resumed between other calls
+  and are not broken out: their SMC and RPC time is charged to the call in
+  flight when they run, if any.
+
+  Copyright (c) 2018, Microsoft Corporation. All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include "OpteeClientDefs.h"
+#include "OpteeClientProfile.h"
+
+#undef ARRAY_SIZE
+#undef BIT32
+#include "Optee/optee_msg.h"
+
+typedef struct optee_msg_param optee_msg_param_t;
+typedef struct optee_msg_arg optee_msg_arg_t;
+
+STATIC OPTEE_CLIENT_PROFILE_STATS mProfileStats;
+
+// The call currently in flight and its start tick.
+STATIC OPTEE_CLIENT_PROFILE_CALL mProfileCall;
+STATIC UINT64 mProfileCallStartTick;
+
+// Performance counter direction and range, used to handle wrap around.
+STATIC UINT64 mCounterStart;
+STATIC UINT64 mCounterEnd;
+
+STATIC
+UINT64
+OpteeProfileElapsed (
+  IN UINT64   StartTick,
+  IN UINT64   EndTick
+  )
+{
+  if (mCounterEnd >= mCounterStart) {
+    if (EndTick >= StartTick) {
+      return EndTick - StartTick;
+    }
+    return (mCounterEnd - StartTick) + (EndTick - mCounterStart);
+  }
+
+  // Count down timer.
+  if (StartTick >= EndTick) {
+    return StartTick - EndTick;
+  }
+  return (StartTick - mCounterEnd) + (mCounterStart - EndTick);
+}
+
+STATIC
+VOID
+OpteeProfileAccumulate (
+  IN OUT OPTEE_CLIENT_PROFILE_CALL  *Total,
+  IN CONST OPTEE_CLIENT_PROFILE_CALL *Call
+  )
+{
+  UINTN Index;
+
+  Total->TotalTicks += Call->TotalTicks;
+  Total->SecureTicks += Call->SecureTicks;
+  Total->SmcCount += Call->SmcCount;
+  Total->BytesIn += Call->BytesIn;
+  Total->BytesOut += Call->BytesOut;
+
+  for (Index = 0; Index < OpteeProfileRpcMax; Index++) {
+    Total->Rpc[Index].Count += Call->Rpc[Index].Count;
+    Total->Rpc[Index].Ticks += Call->Rpc[Index].Ticks;
+    Total->Rpc[Index].Bytes += Call->Rpc[Index].Bytes;
+  }
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+OpteeProfileGetStats (
+  IN OPTEE_CLIENT_PROFILE_PROTOCOL  *This,
+  OUT OPTEE_CLIENT_PROFILE_STATS    *Stats
+  )
+{
+  if (Stats == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Stats, &mProfileStats, sizeof (*Stats));
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+OpteeProfileReset (
+  IN OPTEE_CLIENT_PROFILE_PROTOCOL  *This
+  )
+{
+  UINT64 TickFrequency;
+
+  TickFrequency = mProfileStats.TickFrequency;
+  ZeroMem (&mProfileStats, sizeof (mProfileStats));
+  mProfileStats.TickFrequency = TickFrequency;
+
+  return EFI_SUCCESS;
+}
+
+STATIC OPTEE_CLIENT_PROFILE_PROTOCOL mOpteeClientProfile = {
+  OPTEE_CLIENT_PROFILE_PROTOCOL_REVISION,
+  NULL,
+  OpteeProfileGetStats,
+  OpteeProfileReset
+};
+
+/** Initialize the profiler and publish its protocol on the driver image handle.
+**/
+EFI_STATUS
+OpteeProfileInit (
+  VOID
+  )
+{
+  EFI_STATUS Status;
+  EFI_HANDLE Handle;
+
+  if (!FeatureFlagPcd (PcdOpteeClientProfileEnable)) {
+    return EFI_SUCCESS;
+  }
+
+  ZeroMem (&mProfileStats, sizeof (mProfileStats));
+  mProfileStats.TickFrequency =
+    GetPerformanceCounterProperties (&mCounterStart, &mCounterEnd);
+
+  Handle = gDriverImageHandle;
+  mOpteeClientProfile.ImageHandle = gDriverImageHandle;
+
+  Status = gBS->InstallMultipleProtocolInterfaces (
+                  &Handle,
+                  &gOpteeClientProfileProtocolGuid,
+                  &mOpteeClientProfile,
+                  NULL);
+
+  if (EFI_ERROR (Status)) {
+    LOG_ERROR ("InstallMultipleProtocolInterfaces() failed. (Status=%r)", Status);
+  }
+
+  return Status;
+}
+
+/** Sum the temp memref bytes referenced by a message argument block.
+
+  @param[in] MsgArg   The message argument block to inspect.
+  @param[in] Output   TRUE to count buffers flowing back to the caller,
+                      FALSE to count buffers flowing to the callee.
+**/
+UINT64
+OpteeProfileMsgArgBytes (
+  IN optee_msg_arg_t  *MsgArg,
+  IN BOOLEAN          Output
+  )
+{
+  UINTN Index;
+  UINT64 Bytes;
+  UINT32 Attr;
+
+  Bytes = 0;
+
+  if (!FeatureFlagPcd (PcdOpteeClientProfileEnable) || (MsgArg == NULL)) {
+    return 0;
+  }
+
+  for (Index = 0; Index < MsgArg->num_params; Index++) {
+    Attr = OPTEE_MSG_ATTR_GET_TYPE (MsgArg->params[Index].attr);
+
+    if ((Attr == OPTEE_MSG_ATTR_TYPE_TMEM_INOUT) ||
+        (!Output && (Attr == OPTEE_MSG_ATTR_TYPE_TMEM_INPUT)) ||
+        (Output && (Attr == OPTEE_MSG_ATTR_TYPE_TMEM_OUTPUT))) {
+      Bytes += MsgArg->params[Index].u.tmem.size;
+    }
+  }
+
+  return Bytes;
+}
+
+VOID
+OpteeProfileCallBegin (
+  IN optee_msg_arg_t  *MsgArg
+  )
+{
+  if (!FeatureFlagPcd (PcdOpteeClientProfileEnable)) {
+    return;
+  }
+
+  ZeroMem (&mProfileCall, sizeof (mProfileCall));
+  mProfileCall.Command = MsgArg->cmd;
+  mProfileCall.Function = MsgArg->func;
+  mProfileCall.BytesIn = OpteeProfileMsgArgBytes (MsgArg, FALSE);
+  mProfileCallStartTick = GetPerformanceCounter ();
+}
+
+VOID
+OpteeProfileCallEnd (
+  IN optee_msg_arg_t  *MsgArg
+  )
+{
+  if (!FeatureFlagPcd (PcdOpteeClientProfileEnable)) {
+    return;
+  }
+
+  mProfileCall.TotalTicks =
+    OpteeProfileElapsed (mProfileCallStartTick, GetPerformanceCounter ());
+  mProfileCall.BytesOut = OpteeProfileMsgArgBytes (MsgArg, TRUE);
+
+  mProfileStats.CallCount++;
+  if (mProfileCall.Command == OPTEE_MSG_CMD_INVOKE_COMMAND) {
+    mProfileStats.InvokeCount++;
+  }
+
+  if (mProfileCall.TotalTicks > mProfileStats.MaxTotalTicks) {
+    mProfileStats.MaxTotalTicks = mProfileCall.TotalTicks;
+  }
+
+  OpteeProfileAccumulate (&mProfileStats.Total, &mProfileCall);
+  CopyMem (&mProfileStats.Last, &mProfileCall, sizeof (mProfileCall));
+}
+
+UINT64
+OpteeProfileSmcBegin (
+  VOID
+  )
+{
+  if (!FeatureFlagPcd (PcdOpteeClientProfileEnable)) {
+    return 0;
+  }
+
+  return GetPerformanceCounter ();
+}
+
+VOID
+OpteeProfileSmcEnd (
+  IN UINT64   StartTick
+  )
+{
+  if (!FeatureFlagPcd (PcdOpteeClientProfileEnable)) {
+    return;
+  }
+
+  mProfileCall.SecureTicks += OpteeProfileElapsed (StartTick, GetPerformanceCounter ());
+  mProfileCall.SmcCount++;
+}
+
+UINT64
+OpteeProfileRpcBegin (
+  VOID
+  )
+{
+  return OpteeProfileSmcBegin ();
+}
+
+VOID
+OpteeProfileRpcEnd (
+  IN OPTEE_CLIENT_PROFILE_RPC_TYPE  RpcType,
+  IN UINT64                         Bytes,
+  IN UINT64                         StartTick
+  )
+{
+  if (!FeatureFlagPcd (PcdOpteeClientProfileEnable)) {
+    return;
+  }
+
+  ASSERT (RpcType < OpteeProfileRpcMax);
+
+  mProfileCall.Rpc[RpcType].Count++;
+  mProfileCall.Rpc[RpcType].Bytes += Bytes;
+  mProfileCall.Rpc[RpcType].Ticks +=
+    OpteeProfileElapsed (StartTick, GetPerformanceCounter ());
+}
@@ -0,0 +1,68 @@
+/** @file
+  The OP-TEE Client profiler accounts for the time spent in secure world and
+  in the normal world RPC handlers for every SMC call issued by the library.
+
+  All hooks compile down to nothing when PcdOpteeClientProfileEnable is FALSE.
+
+  Copyright (c) 2018, Microsoft Corporation. All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#ifndef __OPTEE_CLIENT_PROFILE_INTERNAL_H__
+#define __OPTEE_CLIENT_PROFILE_INTERNAL_H__
+
+#include <Protocol/OpteeClientProfile.h>
+
+struct optee_msg_arg;
+
+EFI_STATUS
+OpteeProfileInit (
+  VOID
+  );
+
+VOID
+OpteeProfileCallBegin (
+  IN struct optee_msg_arg  *MsgArg
+  );
+
+VOID
+OpteeProfileCallEnd (
+  IN struct optee_msg_arg  *MsgArg
+  );
+
+UINT64
+OpteeProfileSmcBegin (
+  VOID
+  );
+
+VOID
+OpteeProfileSmcEnd (
+  IN UINT64   StartTick
+  );
+
+UINT64
+OpteeProfileRpcBegin (
+  VOID
+  );
+
+VOID
+OpteeProfileRpcEnd (
+  IN OPTEE_CLIENT_PROFILE_RPC_TYPE  RpcType,
+  IN UINT64                         Bytes,
+  IN UINT64                         StartTick
+  );
+
+UINT64
+OpteeProfileMsgArgBytes (
+  IN struct optee_msg_arg   *MsgArg,
+  IN BOOLEAN                Output
+  );
+
+#endif // __OPTEE_CLIENT_PROFILE_INTERNAL_H__
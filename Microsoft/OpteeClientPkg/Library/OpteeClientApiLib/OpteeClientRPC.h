@@ -32,9 +32,37 @@
 #ifndef __OPTEE_CLIENT_RPC_H__
 #define __OPTEE_CLIENT_RPC_H__
 
+EFI_STATUS
+OpteeRpcInit (
+  VOID
+  );
+
+VOID
+OpteeRpcDeinit (
+  VOID
+  );
+
+VOID
+OpteeRpcUnload (
+  VOID
+  );
+
+// How the secure call that returned with an RPC should be resumed.
+typedef enum {
+  // Resume right away.
+  OpteeRpcResumeNow,
+  // Resume when convenient, secure world gave the core back on a foreign
+  // interrupt.
+  OpteeRpcResumeYield,
+  // Resume when convenient, the secure thread waits on a wait queue held by
+  // another secure thread. Resuming early is harmless, it goes back to sleep.
+  OpteeRpcResumeSleep
+} OPTEE_RPC_RESUME;
+
 TEEC_Result
 OpteeRpcCallback (
-  ARM_SMC_ARGS  *ArmSmcArgs
+  IN OUT ARM_SMC_ARGS   *ArmSmcArgs,
+  OUT OPTEE_RPC_RESUME  *Resume
   );
 
 #endif // __OPTEE_CLIENT_RPC_H__
@@ -32,6 +32,21 @@
 #ifndef __OPTEE_CLIENT_SMC_H__
 #define __OPTEE_CLIENT_SMC_H__
 
+EFI_STATUS
+OpteeSmcInit (
+  VOID
+  );
+
+VOID
+OpteeSmcDeinit (
+  VOID
+  );
+
+VOID
+OpteeSmcUnload (
+  VOID
+  );
+
 TEEC_Result
 TEEC_SMC_OpenSession (
   IN TEEC_Context     *Context,
@@ -55,4 +70,36 @@ TEEC_SMC_InvokeCommand (
   OUT uint32_t        *ReturnOrigin
   );
 
+TEEC_Result
+TEEC_SMC_InvokeCommandFast (
+  IN TEEC_Session       *Session,
+  IN uint32_t           CommandId,
+  IN OUT TEEC_Operation *Operation,
+  OUT uint32_t          *ReturnOrigin
+  );
+
+TEEC_Result
+TEEC_SMC_InvokeCommandAsync (
+  IN TEEC_Session     *Session,
+  IN uint32_t         CommandId,
+  IN TEEC_Operation   *Operation,
+  OUT EFI_EVENT       *CompletionEvent,
+  OUT uint32_t        *ReturnOrigin
+  );
+
+TEEC_Result
+TEEC_SMC_InvokeCommandAsyncComplete (
+  IN TEEC_Operation   *Operation,
+  OUT uint32_t        *ReturnOrigin
+  );
+
+BOOLEAN
+TEEC_SMC_RequestCancellation (
+  IN TEEC_Operation   *Operation
+  );
+
+// Nesting count of the library calls in progress. The timer resuming the
+// asynchronous commands backs off while it is not zero.
+extern UINTN gOpteeClientCallDepth;
+
 #endif // __OPTEE_CLIENT_SMC_H__
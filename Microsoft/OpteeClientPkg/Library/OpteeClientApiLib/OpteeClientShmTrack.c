@@ -0,0 +1,533 @@
+/** @file
+  The OP-TEE Client shared memory tracker accounts for the blocks this library
+  instance allocates from the TrustZone shared memory pool: who asked for them,
+  their size class, how long they lived and the high-water marks of the pool
+  usage. The numbers are meant to size PcdTrustZoneSharedMemorySize from data.
+
+  The pool is shared by every driver linking the library, and each instance
+  only sees its own blocks. The owner of a block is therefore the driver image
+  handle publishing the tracker protocol, which is also the handle recorded in
+  the block header and in the GCD.
+
+  Live blocks are kept in a fixed table so that tracking never allocates from
+  the pool it is measuring; blocks which do not fit are only counted. The
+  asynchronous invoke poll timer allocates and frees blocks from a TPL_CALLBACK
+  notification, and the protocol may be called at any TPL up to TPL_NOTIFY, so
+  every access to the table and the counters is done at TPL_NOTIFY.
+
+  Copyright (c) 2018, Microsoft Corporation. All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include "OpteeClientDefs.h"
+#include "OpteeClientShmTrack.h"
+
+// Number of live blocks tracked individually. A driver rarely holds more than
+// a handful of blocks, the RPC payload pool being the largest user.
+#define OPTEE_SHM_TRACK_MAX_RECORDS   64
+
+// Smallest size class limit and first lifetime bucket limit.
+#define OPTEE_SHM_TRACK_SIZE_CLASS_MIN    256
+#define OPTEE_SHM_TRACK_LIFETIME_MIN_US   100
+
+typedef struct {
+  BOOLEAN                 InUse;
+  OPTEE_CLIENT_SHM_SITE   Site;
+  UINTN                   Address;
+  UINT64                  Size;
+  UINT64                  BlockSize;
+  UINTN                   CallSite;
+  UINT64                  StartTick;
+} OPTEE_SHM_TRACK_ENTRY;
+
+STATIC CONST CHAR8 *mShmSiteStr[OpteeShmSiteMax] = {
+  "SharedMemory",
+  "MsgArg",
+  "ReservedMsgArg",
+  "Rpc",
+  "RpcPayloadPool"
+};
+
+STATIC BOOLEAN mShmTrackInstalled = FALSE;
+STATIC OPTEE_CLIENT_SHM_TRACK_STATS mShmTrackStats;
+STATIC OPTEE_SHM_TRACK_ENTRY mShmTrackEntries[OPTEE_SHM_TRACK_MAX_RECORDS];
+
+// Performance counter direction and range, used to handle wrap around.
+STATIC UINT64 mCounterStart;
+STATIC UINT64 mCounterEnd;
+
+STATIC
+UINT64
+OpteeShmTrackElapsedUs (
+  IN UINT64   StartTick
+  )
+{
+  UINT64 EndTick;
+  UINT64 Ticks;
+
+  EndTick = GetPerformanceCounter ();
+
+  if (mCounterEnd >= mCounterStart) {
+    if (EndTick >= StartTick) {
+      Ticks = EndTick - StartTick;
+    } else {
+      Ticks = (mCounterEnd - StartTick) + (EndTick - mCounterStart);
+    }
+  } else if (StartTick >= EndTick) {
+    // Count down timer.
+    Ticks = StartTick - EndTick;
+  } else {
+    Ticks = (StartTick - mCounterEnd) + (mCounterStart - EndTick);
+  }
+
+  return DivU64x32 (GetTimeInNanoSecond (Ticks), 1000);
+}
+
+STATIC
+UINTN
+OpteeShmTrackSizeClass (
+  IN UINT64   BlockSize
+  )
+{
+  UINTN Class;
+  UINT64 Limit;
+
+  Class = 0;
+  Limit = OPTEE_SHM_TRACK_SIZE_CLASS_MIN;
+
+  while ((BlockSize > Limit) && (Class < (OPTEE_SHM_TRACK_SIZE_CLASSES - 1))) {
+    Limit <<= 1;
+    Class++;
+  }
+
+  return Class;
+}
+
+STATIC
+UINTN
+OpteeShmTrackLifetimeBucket (
+  IN UINT64   LifetimeUs
+  )
+{
+  UINTN Bucket;
+  UINT64 Limit;
+
+  Bucket = 0;
+  Limit = OPTEE_SHM_TRACK_LIFETIME_MIN_US;
+
+  while ((LifetimeUs >= Limit) && (Bucket < (OPTEE_SHM_TRACK_LIFETIME_BUCKETS - 1))) {
+    Limit = MultU64x32 (Limit, 10);
+    Bucket++;
+  }
+
+  return Bucket;
+}
+
+STATIC
+OPTEE_SHM_TRACK_ENTRY *
+OpteeShmTrackFind (
+  IN UINTN    Address
+  )
+{
+  UINTN Index;
+
+  for (Index = 0; Index < OPTEE_SHM_TRACK_MAX_RECORDS; Index++) {
+    if (mShmTrackEntries[Index].InUse && (mShmTrackEntries[Index].Address == Address)) {
+      return &mShmTrackEntries[Index];
+    }
+  }
+
+  return NULL;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+OpteeShmTrackGetStats (
+  IN OPTEE_CLIENT_SHM_TRACK_PROTOCOL  *This,
+  OUT OPTEE_CLIENT_SHM_TRACK_STATS    *Stats
+  )
+{
+  EFI_TPL OldTpl;
+
+  if (Stats == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  CopyMem (Stats, &mShmTrackStats, sizeof (*Stats));
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+OpteeShmTrackGetLive (
+  IN OPTEE_CLIENT_SHM_TRACK_PROTOCOL    *This,
+  IN OUT UINTN                          *Count,
+  OUT OPTEE_CLIENT_SHM_TRACK_RECORD     *Records OPTIONAL
+  )
+{
+  UINTN Index;
+  UINTN LiveCount;
+  OPTEE_SHM_TRACK_ENTRY *Entry;
+  EFI_TPL OldTpl;
+
+  if (Count == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  LiveCount = 0;
+  for (Index = 0; Index < OPTEE_SHM_TRACK_MAX_RECORDS; Index++) {
+    Entry = &mShmTrackEntries[Index];
+    if (!Entry->InUse) {
+      continue;
+    }
+
+    if ((Records != NULL) && (LiveCount < *Count)) {
+      Records[LiveCount].Address = Entry->Address;
+      Records[LiveCount].Size = Entry->Size;
+      Records[LiveCount].BlockSize = Entry->BlockSize;
+      Records[LiveCount].CallSite = Entry->CallSite;
+      Records[LiveCount].AgeUs = OpteeShmTrackElapsedUs (Entry->StartTick);
+      Records[LiveCount].Site = Entry->Site;
+    }
+
+    LiveCount++;
+  }
+
+  gBS->RestoreTPL (OldTpl);
+
+  if ((Records == NULL) || (LiveCount > *Count)) {
+    *Count = LiveCount;
+    return (LiveCount == 0) ? EFI_SUCCESS : EFI_BUFFER_TOO_SMALL;
+  }
+
+  *Count = LiveCount;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+OpteeShmTrackReset (
+  IN OPTEE_CLIENT_SHM_TRACK_PROTOCOL  *This
+  )
+{
+  OPTEE_CLIENT_SHM_TRACK_STATS Live;
+  EFI_TPL OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  CopyMem (&Live, &mShmTrackStats, sizeof (Live));
+  ZeroMem (&mShmTrackStats, sizeof (mShmTrackStats));
+
+  mShmTrackStats.PoolSize = Live.PoolSize;
+  mShmTrackStats.LiveCount = Live.LiveCount;
+  mShmTrackStats.LiveBytes = Live.LiveBytes;
+  mShmTrackStats.PeakCount = Live.LiveCount;
+  mShmTrackStats.PeakBytes = Live.LiveBytes;
+  mShmTrackStats.Untracked = Live.Untracked;
+
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+STATIC OPTEE_CLIENT_SHM_TRACK_PROTOCOL mOpteeClientShmTrack = {
+  OPTEE_CLIENT_SHM_TRACK_PROTOCOL_REVISION,
+  NULL,
+  OpteeShmTrackGetStats,
+  OpteeShmTrackGetLive,
+  OpteeShmTrackReset
+};
+
+/** Initialize the tracker and publish its protocol on the driver image handle.
+
+  @param[in] PoolSize   Size in bytes of the shared memory pool.
+**/
+EFI_STATUS
+OpteeShmTrackInit (
+  IN UINT64   PoolSize
+  )
+{
+  EFI_STATUS Status;
+  EFI_HANDLE Handle;
+
+  if (!FeatureFlagPcd (PcdOpteeClientShmTrackEnable)) {
+    return EFI_SUCCESS;
+  }
+
+  ZeroMem (&mShmTrackStats, sizeof (mShmTrackStats));
+  ZeroMem (mShmTrackEntries, sizeof (mShmTrackEntries));
+  mShmTrackStats.PoolSize = PoolSize;
+  GetPerformanceCounterProperties (&mCounterStart, &mCounterEnd);
+
+  Handle = gDriverImageHandle;
+  mOpteeClientShmTrack.ImageHandle = gDriverImageHandle;
+
+  Status = gBS->InstallMultipleProtocolInterfaces (
+                  &Handle,
+                  &gOpteeClientShmTrackProtocolGuid,
+                  &mOpteeClientShmTrack,
+                  NULL);
+
+  if (EFI_ERROR (Status)) {
+    LOG_ERROR ("InstallMultipleProtocolInterfaces() failed. (Status=%r)", Status);
+  } else {
+    mShmTrackInstalled = TRUE;
+  }
+
+  return Status;
+}
+
+/** Withdraw the tracker protocol, from the library destructor. Not done by
+  OpteeClientApiFinalize, which runs from ExitBootServices notifications.
+**/
+VOID
+OpteeShmTrackUnload (
+  VOID
+  )
+{
+  EFI_STATUS Status;
+
+  if (!mShmTrackInstalled) {
+    return;
+  }
+
+  Status = gBS->UninstallMultipleProtocolInterfaces (
+                  gDriverImageHandle,
+                  &gOpteeClientShmTrackProtocolGuid,
+                  &mOpteeClientShmTrack,
+                  NULL);
+
+  if (EFI_ERROR (Status)) {
+    LOG_ERROR ("UninstallMultipleProtocolInterfaces() failed. (Status=%r)", Status);
+    return;
+  }
+
+  mShmTrackInstalled = FALSE;
+}
+
+VOID
+OpteeShmTrackAlloc (
+  IN UINTN                  Address,
+  IN UINT64                 Size,
+  IN UINT64                 BlockSize,
+  IN OPTEE_CLIENT_SHM_SITE  Site
+  )
+{
+  OPTEE_SHM_TRACK_ENTRY *Entry;
+  EFI_TPL OldTpl;
+
+  if (!FeatureFlagPcd (PcdOpteeClientShmTrackEnable)) {
+    return;
+  }
+
+  ASSERT (Site < OpteeShmSiteMax);
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  mShmTrackStats.AllocCount++;
+  mShmTrackStats.LiveCount++;
+  mShmTrackStats.LiveBytes += BlockSize;
+  mShmTrackStats.SiteCount[Site]++;
+  mShmTrackStats.SiteBytes[Site] += BlockSize;
+  mShmTrackStats.SizeClass[OpteeShmTrackSizeClass (BlockSize)]++;
+
+  if (mShmTrackStats.LiveCount > mShmTrackStats.PeakCount) {
+    mShmTrackStats.PeakCount = mShmTrackStats.LiveCount;
+  }
+
+  if (mShmTrackStats.LiveBytes > mShmTrackStats.PeakBytes) {
+    mShmTrackStats.PeakBytes = mShmTrackStats.LiveBytes;
+  }
+
+  for (Entry = &mShmTrackEntries[0];
+       Entry < &mShmTrackEntries[OPTEE_SHM_TRACK_MAX_RECORDS];
+       Entry++) {
+    if (!Entry->InUse) {
+      break;
+    }
+  }
+
+  if (Entry == &mShmTrackEntries[OPTEE_SHM_TRACK_MAX_RECORDS]) {
+    mShmTrackStats.Untracked++;
+  } else {
+    Entry->InUse = TRUE;
+    Entry->Site = Site;
+    Entry->Address = Address;
+    Entry->Size = Size;
+    Entry->BlockSize = BlockSize;
+    Entry->CallSite = 0;
+    Entry->StartTick = GetPerformanceCounter ();
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+VOID
+OpteeShmTrackAllocFailed (
+  IN UINT64   Size
+  )
+{
+  EFI_TPL OldTpl;
+
+  if (!FeatureFlagPcd (PcdOpteeClientShmTrackEnable)) {
+    return;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  mShmTrackStats.FailCount++;
+  if (Size > mShmTrackStats.LargestFailure) {
+    mShmTrackStats.LargestFailure = Size;
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+VOID
+OpteeShmTrackFree (
+  IN UINTN    Address,
+  IN UINT64   BlockSize
+  )
+{
+  OPTEE_SHM_TRACK_ENTRY *Entry;
+  EFI_TPL OldTpl;
+
+  if (!FeatureFlagPcd (PcdOpteeClientShmTrackEnable)) {
+    return;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  mShmTrackStats.FreeCount++;
+  mShmTrackStats.LiveCount--;
+  mShmTrackStats.LiveBytes -= BlockSize;
+
+  Entry = OpteeShmTrackFind (Address);
+  if (Entry == NULL) {
+    // Its lifetime is unknown, keep it out of the histogram.
+    ASSERT (mShmTrackStats.Untracked != 0);
+    mShmTrackStats.Untracked--;
+  } else {
+    mShmTrackStats.Lifetime[
+      OpteeShmTrackLifetimeBucket (OpteeShmTrackElapsedUs (Entry->StartTick))]++;
+
+    ZeroMem (Entry, sizeof (*Entry));
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+/** Attribute a live block to the client code which asked for it.
+
+  @param[in] Address    Address returned by the allocation.
+  @param[in] CallSite   Return address into the client.
+**/
+VOID
+OpteeShmTrackSetCallSite (
+  IN UINTN    Address,
+  IN UINTN    CallSite
+  )
+{
+  OPTEE_SHM_TRACK_ENTRY *Entry;
+  EFI_TPL OldTpl;
+
+  if (!FeatureFlagPcd (PcdOpteeClientShmTrackEnable)) {
+    return;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  Entry = OpteeShmTrackFind (Address);
+  if (Entry != NULL) {
+    Entry->CallSite = CallSite;
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+/** Log the usage summary and every block still allocated. Called from
+  OpteeClientApiFinalize once the library released its own buffers, so any
+  block left is a leak of the owning driver.
+**/
+VOID
+OpteeShmTrackReport (
+  VOID
+  )
+{
+  UINTN Index;
+  OPTEE_SHM_TRACK_ENTRY *Entry;
+
+  if (!FeatureFlagPcd (PcdOpteeClientShmTrackEnable)) {
+    return;
+  }
+
+  LOG_INFO (
+    "Shared memory usage: Pool=0x%lX, Allocs=%ld, Fails=%ld (Largest=0x%lX), "
+    "PeakCount=%ld, PeakBytes=0x%lX",
+    mShmTrackStats.PoolSize,
+    mShmTrackStats.AllocCount,
+    mShmTrackStats.FailCount,
+    mShmTrackStats.LargestFailure,
+    mShmTrackStats.PeakCount,
+    mShmTrackStats.PeakBytes);
+
+  for (Index = 0; Index < OpteeShmSiteMax; Index++) {
+    if (mShmTrackStats.SiteCount[Index] != 0) {
+      LOG_INFO (
+        "  %a: Allocs=%ld, Bytes=0x%lX",
+        mShmSiteStr[Index],
+        mShmTrackStats.SiteCount[Index],
+        mShmTrackStats.SiteBytes[Index]);
+    }
+  }
+
+  if (mShmTrackStats.LiveCount == 0) {
+    return;
+  }
+
+  LOG_ERROR (
+    "%ld shared memory block(s) leaked, 0x%lX bytes (Owner=%p, Untracked=%ld)",
+    mShmTrackStats.LiveCount,
+    mShmTrackStats.LiveBytes,
+    gDriverImageHandle,
+    mShmTrackStats.Untracked);
+
+  for (Index = 0; Index < OPTEE_SHM_TRACK_MAX_RECORDS; Index++) {
+    Entry = &mShmTrackEntries[Index];
+    if (!Entry->InUse) {
+      continue;
+    }
+
+    LOG_ERROR (
+      "  Leaked %a block: Address=0x%p, Size=0x%lX, BlockSize=0x%lX, CallSite=0x%p, Age=%ldus",
+      mShmSiteStr[Entry->Site],
+      Entry->Address,
+      Entry->Size,
+      Entry->BlockSize,
+      Entry->CallSite,
+      OpteeShmTrackElapsedUs (Entry->StartTick));
+  }
+}
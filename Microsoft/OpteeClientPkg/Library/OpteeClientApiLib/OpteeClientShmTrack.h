@@ -0,0 +1,63 @@
+/** @file
+  The OP-TEE Client shared memory tracker accounts for the blocks this library
+  instance allocates from the TrustZone shared memory pool.
+
+  All hooks compile down to nothing when PcdOpteeClientShmTrackEnable is FALSE.
+
+  Copyright (c) 2018, Microsoft Corporation. All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#ifndef __OPTEE_CLIENT_SHM_TRACK_INTERNAL_H__
+#define __OPTEE_CLIENT_SHM_TRACK_INTERNAL_H__
+
+#include <Protocol/OpteeClientShmTrack.h>
+
+EFI_STATUS
+OpteeShmTrackInit (
+  IN UINT64   PoolSize
+  );
+
+VOID
+OpteeShmTrackAlloc (
+  IN UINTN                  Address,
+  IN UINT64                 Size,
+  IN UINT64                 BlockSize,
+  IN OPTEE_CLIENT_SHM_SITE  Site
+  );
+
+VOID
+OpteeShmTrackAllocFailed (
+  IN UINT64   Size
+  );
+
+VOID
+OpteeShmTrackFree (
+  IN UINTN    Address,
+  IN UINT64   BlockSize
+  );
+
+VOID
+OpteeShmTrackSetCallSite (
+  IN UINTN    Address,
+  IN UINTN    CallSite
+  );
+
+VOID
+OpteeShmTrackReport (
+  VOID
+  );
+
+VOID
+OpteeShmTrackUnload (
+  VOID
+  );
+
+#endif // __OPTEE_CLIENT_SHM_TRACK_INTERNAL_H__
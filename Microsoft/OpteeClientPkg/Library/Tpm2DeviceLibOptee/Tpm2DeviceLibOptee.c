@@ -23,6 +23,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/OpteeClientApiLib.h>
 #include <Library/tee_client_api.h>
 #include <Library/Tcg2PhysicalPresenceLib.h>
+#include <Library/Tpm2DeviceLibOptee.h>
 
 #include <Protocol/TrEEProtocol.h>
 #include <Protocol/RpmbIo.h>
@@ -41,6 +42,16 @@ static BOOLEAN Initialized = FALSE;
 static TEEC_Context FtpmContext;
 static TEEC_Session FtpmSession;
 
+//
+// Shared memory kept for the lifetime of the fTPM session, a command area
+// followed by a response area, each sized for the largest TPM buffer.
+//
+#define FTPM_COMMAND_BUFFER_SIZE  MAX_COMMAND_SIZE
+#define FTPM_RESPONSE_BUFFER_SIZE MAX_RESPONSE_SIZE
+
+static BOOLEAN FtpmSharedMemAllocated = FALSE;
+static TEEC_SharedMemory FtpmSharedMem;
+
 /**
   This service enables the sending of commands to the TPM2.
 
@@ -67,6 +78,7 @@ Tpm2SubmitCommand (
   BOOLEAN ReleaseMemory;
   UINT8 *SharedInput;
   UINT8 *SharedOutput;
+  UINT32 SharedOutputSize;
   TEEC_Operation TeecOperation = {0};
   TEEC_Result TeecResult;
   TEEC_SharedMemory TeecSharedMem = {0};
@@ -80,26 +92,47 @@ Tpm2SubmitCommand (
     goto Tpm2SubmitCommandEnd;
   }
 
-  TeecSharedMem.size = InputParameterBlockSize + *OutputParameterBlockSize;
-  TeecResult = TEEC_AllocateSharedMemory(&FtpmContext, &TeecSharedMem);
-  if (TeecResult != TEEC_SUCCESS) {
-    ASSERT(FALSE);
-    if (TeecResult == TEEC_ERROR_OUT_OF_MEMORY) {
-      EfiStatus = EFI_OUT_OF_RESOURCES;
+  if (FtpmSharedMemAllocated &&
+      (InputParameterBlockSize <= FTPM_COMMAND_BUFFER_SIZE)) {
+    //
+    // A TPM response never exceeds MAX_RESPONSE_SIZE, so a larger output
+    // block is simply capped to the response area.
+    //
+    SharedInput = (UINT8 *)FtpmSharedMem.buffer;
+    SharedOutput = SharedInput + FTPM_COMMAND_BUFFER_SIZE;
+    SharedOutputSize = MIN(*OutputParameterBlockSize, FTPM_RESPONSE_BUFFER_SIZE);
+  } else {
+    //
+    // No session buffer, or an oversized command: allocate for this one.
+    //
+    TeecSharedMem.size = InputParameterBlockSize + *OutputParameterBlockSize;
+    TeecResult = TEEC_AllocateSharedMemory(&FtpmContext, &TeecSharedMem);
+    if (TeecResult != TEEC_SUCCESS) {
+      ASSERT(FALSE);
+      if (TeecResult == TEEC_ERROR_OUT_OF_MEMORY) {
+        EfiStatus = EFI_OUT_OF_RESOURCES;
+      }
+
+      goto Tpm2SubmitCommandEnd;
     }
 
-    goto Tpm2SubmitCommandEnd;
+    ReleaseMemory = TRUE;
+    SharedInput = (UINT8 *)TeecSharedMem.buffer;
+    SharedOutput = SharedInput + InputParameterBlockSize;
+    SharedOutputSize = *OutputParameterBlockSize;
   }
 
-  ReleaseMemory = TRUE;
-  SharedInput = (UINT8 *)TeecSharedMem.buffer;
-  SharedOutput = SharedInput + InputParameterBlockSize;
-  CopyMem(SharedInput, InputParameterBlock, InputParameterBlockSize);
+  //
+  // Commands built in place with Tpm2OpteeGetCommandBuffer need no copy.
+  //
+  if (InputParameterBlock != SharedInput) {
+    CopyMem(SharedInput, InputParameterBlock, InputParameterBlockSize);
+  }
 
   TeecOperation.params[0].tmpref.buffer = SharedInput;
   TeecOperation.params[0].tmpref.size = InputParameterBlockSize;
   TeecOperation.params[1].tmpref.buffer = SharedOutput;
-  TeecOperation.params[1].tmpref.size = *OutputParameterBlockSize;
+  TeecOperation.params[1].tmpref.size = SharedOutputSize;
   TeecOperation.paramTypes = TEEC_PARAM_TYPES(TEEC_MEMREF_TEMP_INPUT,
                                               TEEC_MEMREF_TEMP_INOUT,
                                               TEEC_NONE,
@@ -123,7 +156,15 @@ Tpm2SubmitCommand (
     goto Tpm2SubmitCommandEnd;
   }
 
-  CopyMem(OutputParameterBlock, SharedOutput, TeecOperation.params[1].memref.size);
+  if (TeecOperation.params[1].memref.size > SharedOutputSize) {
+    ASSERT(FALSE);
+    goto Tpm2SubmitCommandEnd;
+  }
+
+  if (OutputParameterBlock != SharedOutput) {
+    CopyMem(OutputParameterBlock, SharedOutput, TeecOperation.params[1].memref.size);
+  }
+
   *OutputParameterBlockSize = TeecOperation.params[1].memref.size;
   EfiStatus = EFI_SUCCESS;
 
@@ -135,6 +176,44 @@ Tpm2SubmitCommandEnd:
   return EfiStatus;
 }
 
+/**
+  Get the fTPM session command and response areas.
+
+  @param[out] CommandBuffer       Receives the command area.
+  @param[out] CommandBufferSize   Receives the size of the command area.
+  @param[out] ResponseBuffer      Receives the response area.
+  @param[out] ResponseBufferSize  Receives the size of the response area.
+
+  @retval EFI_SUCCESS             The areas were returned.
+  @retval EFI_INVALID_PARAMETER   A parameter is NULL.
+  @retval EFI_NOT_READY           The fTPM session is not open.
+**/
+EFI_STATUS
+EFIAPI
+Tpm2OpteeGetCommandBuffer (
+  OUT UINT8     **CommandBuffer,
+  OUT UINT32    *CommandBufferSize,
+  OUT UINT8     **ResponseBuffer,
+  OUT UINT32    *ResponseBufferSize
+  )
+{
+  if ((CommandBuffer == NULL) || (CommandBufferSize == NULL) ||
+      (ResponseBuffer == NULL) || (ResponseBufferSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((Initialized == FALSE) || (FtpmSharedMemAllocated == FALSE)) {
+    return EFI_NOT_READY;
+  }
+
+  *CommandBuffer = (UINT8 *)FtpmSharedMem.buffer;
+  *CommandBufferSize = FTPM_COMMAND_BUFFER_SIZE;
+  *ResponseBuffer = *CommandBuffer + FTPM_COMMAND_BUFFER_SIZE;
+  *ResponseBufferSize = FTPM_RESPONSE_BUFFER_SIZE;
+
+  return EFI_SUCCESS;
+}
+
 /**
   This service requests use TPM2.
 
@@ -182,6 +261,19 @@ Tpm2RequestUseTpm (
   Initialized = TRUE;
   EfiStatus = EFI_SUCCESS;
 
+  //
+  // Keep one command/response buffer for the whole session. Without it
+  // every command falls back to allocating its own.
+  //
+  FtpmSharedMem.size = FTPM_COMMAND_BUFFER_SIZE + FTPM_RESPONSE_BUFFER_SIZE;
+  TeecResult = TEEC_AllocateSharedMemory(&FtpmContext, &FtpmSharedMem);
+  if (TeecResult == TEEC_SUCCESS) {
+    FtpmSharedMemAllocated = TRUE;
+  } else {
+    FTPM_PRINT_ERROR("%a: TEEC_AllocateSharedMemory failed 0x%X\n",
+                     __func__, TeecResult);
+  }
+
 Tpm2RequestUseTpmEnd:
   return EfiStatus;
 }
@@ -203,6 +295,11 @@ Tpm2RelinquishUseTpm (
 
   if (Initialized != FALSE) {
     FTPM_PRINT("%a: closing session and finalizing context\n", __func__);
+    if (FtpmSharedMemAllocated != FALSE) {
+      TEEC_ReleaseSharedMemory(&FtpmSharedMem);
+      FtpmSharedMemAllocated = FALSE;
+    }
+
     TEEC_CloseSession(&FtpmSession);
     TEEC_FinalizeContext(&FtpmContext);
     Initialized = FALSE;
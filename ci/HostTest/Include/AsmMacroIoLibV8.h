@@ -0,0 +1,22 @@
+/** @file
+*
+*  Host build stand-in for the ArmPkg assembler macros, for building AArch64
+*  assembly sources on an AArch64 host.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __HOST_ASM_MACRO_IO_LIB_V8_H__
+#define __HOST_ASM_MACRO_IO_LIB_V8_H__
+
+#define ASM_FUNC(Name)  \
+  .text ; .p2align 2 ; .global Name ; .type Name, %function ; Name:
+
+#endif
@@ -0,0 +1,38 @@
+/** @file
+*
+*  Host build stand-in for the EFI_FILE_SYSTEM_INFO information type.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __HOST_FILE_SYSTEM_INFO_H__
+#define __HOST_FILE_SYSTEM_INFO_H__
+
+#include <Uefi.h>
+
+#define EFI_FILE_SYSTEM_INFO_ID \
+  { \
+    0x09576e93, 0x6d3f, 0x11d2, {0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } \
+  }
+
+typedef struct {
+  UINT64    Size;
+  BOOLEAN   ReadOnly;
+  UINT64    VolumeSize;
+  UINT64    FreeSpace;
+  UINT32    BlockSize;
+  CHAR16    VolumeLabel[1];
+} EFI_FILE_SYSTEM_INFO;
+
+#define SIZE_OF_EFI_FILE_SYSTEM_INFO  OFFSET_OF (EFI_FILE_SYSTEM_INFO, VolumeLabel)
+
+extern EFI_GUID gEfiFileSystemInfoGuid;
+
+#endif
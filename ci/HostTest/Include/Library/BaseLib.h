@@ -0,0 +1,310 @@
+/** @file
+*
+*  Host build stand-in for the BaseLib services. The list, string and
+*  arithmetic services are in ARM/Drivers/BootMonFs/HostTest/HostLib.c, the
+*  byte swap, shift and unaligned access helpers are inline here.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __HOST_BASE_LIB_H__
+#define __HOST_BASE_LIB_H__
+
+#include <string.h>
+
+#include <Uefi.h>
+
+LIST_ENTRY *
+EFIAPI
+InitializeListHead (
+  IN OUT LIST_ENTRY  *ListHead
+  );
+
+LIST_ENTRY *
+EFIAPI
+InsertHeadList (
+  IN OUT LIST_ENTRY  *ListHead,
+  IN OUT LIST_ENTRY  *Entry
+  );
+
+LIST_ENTRY *
+EFIAPI
+InsertTailList (
+  IN OUT LIST_ENTRY  *ListHead,
+  IN OUT LIST_ENTRY  *Entry
+  );
+
+LIST_ENTRY *
+EFIAPI
+GetFirstNode (
+  IN CONST LIST_ENTRY  *List
+  );
+
+LIST_ENTRY *
+EFIAPI
+GetNextNode (
+  IN CONST LIST_ENTRY  *List,
+  IN CONST LIST_ENTRY  *Node
+  );
+
+LIST_ENTRY *
+EFIAPI
+GetPreviousNode (
+  IN CONST LIST_ENTRY  *List,
+  IN CONST LIST_ENTRY  *Node
+  );
+
+BOOLEAN
+EFIAPI
+IsListEmpty (
+  IN CONST LIST_ENTRY  *ListHead
+  );
+
+BOOLEAN
+EFIAPI
+IsNull (
+  IN CONST LIST_ENTRY  *List,
+  IN CONST LIST_ENTRY  *Node
+  );
+
+BOOLEAN
+EFIAPI
+IsNodeAtEnd (
+  IN CONST LIST_ENTRY  *List,
+  IN CONST LIST_ENTRY  *Node
+  );
+
+LIST_ENTRY *
+EFIAPI
+RemoveEntryList (
+  IN CONST LIST_ENTRY  *Entry
+  );
+
+UINTN
+EFIAPI
+StrLen (
+  IN CONST CHAR16  *String
+  );
+
+UINTN
+EFIAPI
+StrSize (
+  IN CONST CHAR16  *String
+  );
+
+INTN
+EFIAPI
+StrCmp (
+  IN CONST CHAR16  *FirstString,
+  IN CONST CHAR16  *SecondString
+  );
+
+INTN
+EFIAPI
+StrnCmp (
+  IN CONST CHAR16  *FirstString,
+  IN CONST CHAR16  *SecondString,
+  IN UINTN         Length
+  );
+
+CHAR16 *
+EFIAPI
+StrStr (
+  IN CONST CHAR16  *String,
+  IN CONST CHAR16  *SearchString
+  );
+
+RETURN_STATUS
+EFIAPI
+StrCpyS (
+  OUT CHAR16       *Destination,
+  IN  UINTN        DestMax,
+  IN  CONST CHAR16 *Source
+  );
+
+UINTN
+EFIAPI
+AsciiStrLen (
+  IN CONST CHAR8  *String
+  );
+
+UINTN
+EFIAPI
+AsciiStrSize (
+  IN CONST CHAR8  *String
+  );
+
+INTN
+EFIAPI
+AsciiStrCmp (
+  IN CONST CHAR8  *FirstString,
+  IN CONST CHAR8  *SecondString
+  );
+
+RETURN_STATUS
+EFIAPI
+AsciiStrCpyS (
+  OUT CHAR8        *Destination,
+  IN  UINTN        DestMax,
+  IN  CONST CHAR8  *Source
+  );
+
+RETURN_STATUS
+EFIAPI
+AsciiStrnCpyS (
+  OUT CHAR8        *Destination,
+  IN  UINTN        DestMax,
+  IN  CONST CHAR8  *Source,
+  IN  UINTN        Length
+  );
+
+RETURN_STATUS
+EFIAPI
+AsciiStrToUnicodeStrS (
+  IN  CONST CHAR8  *Source,
+  OUT CHAR16       *Destination,
+  IN  UINTN        DestMax
+  );
+
+RETURN_STATUS
+EFIAPI
+UnicodeStrToAsciiStrS (
+  IN  CONST CHAR16  *Source,
+  OUT CHAR8         *Destination,
+  IN  UINTN         DestMax
+  );
+
+CHAR16 *
+EFIAPI
+PathCleanUpDirectories (
+  IN CHAR16  *Path
+  );
+
+UINT64
+EFIAPI
+MultU64x32 (
+  IN UINT64  Multiplicand,
+  IN UINT32  Multiplier
+  );
+
+UINT64
+EFIAPI
+DivU64x32 (
+  IN UINT64  Dividend,
+  IN UINT32  Divisor
+  );
+
+UINT32
+EFIAPI
+ModU64x32 (
+  IN UINT64  Dividend,
+  IN UINT32  Divisor
+  );
+
+UINT32
+EFIAPI
+CalculateCrc32 (
+  IN VOID   *Buffer,
+  IN UINTN  Length
+  );
+
+STATIC inline
+UINT32
+EFIAPI
+SwapBytes32 (
+  IN UINT32  Value
+  )
+{
+  return __builtin_bswap32 (Value);
+}
+
+STATIC inline
+UINT64
+EFIAPI
+SwapBytes64 (
+  IN UINT64  Value
+  )
+{
+  return __builtin_bswap64 (Value);
+}
+
+STATIC inline
+UINT64
+EFIAPI
+LShiftU64 (
+  IN UINT64  Operand,
+  IN UINTN   Count
+  )
+{
+  return Operand << Count;
+}
+
+STATIC inline
+UINT64
+EFIAPI
+RShiftU64 (
+  IN UINT64  Operand,
+  IN UINTN   Count
+  )
+{
+  return Operand >> Count;
+}
+
+STATIC inline
+UINT32
+EFIAPI
+ReadUnaligned32 (
+  IN CONST UINT32  *Buffer
+  )
+{
+  UINT32  Value;
+
+  memcpy (&Value, Buffer, sizeof (Value));
+  return Value;
+}
+
+STATIC inline
+UINT64
+EFIAPI
+ReadUnaligned64 (
+  IN CONST UINT64  *Buffer
+  )
+{
+  UINT64  Value;
+
+  memcpy (&Value, Buffer, sizeof (Value));
+  return Value;
+}
+
+STATIC inline
+UINT32
+EFIAPI
+WriteUnaligned32 (
+  OUT UINT32  *Buffer,
+  IN  UINT32  Value
+  )
+{
+  memcpy (Buffer, &Value, sizeof (Value));
+  return Value;
+}
+
+STATIC inline
+UINT64
+EFIAPI
+WriteUnaligned64 (
+  OUT UINT64  *Buffer,
+  IN  UINT64  Value
+  )
+{
+  memcpy (Buffer, &Value, sizeof (Value));
+  return Value;
+}
+
+#endif
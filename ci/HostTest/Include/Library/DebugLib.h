@@ -0,0 +1,53 @@
+/** @file
+*
+*  Host build stand-in for DebugLib. HostDebugPrint() and HostAssert() are
+*  provided by the host library the test links with, see
+*  ARM/Drivers/BootMonFs/HostTest/HostLib.c. Only DEBUG_ERROR messages are
+*  printed there, and only when HostDebugEnabled is set.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __HOST_DEBUG_LIB_H__
+#define __HOST_DEBUG_LIB_H__
+
+#include <Uefi.h>
+
+#define DEBUG_INFO      0x00000040
+#define DEBUG_VERBOSE   0x00400000
+#define DEBUG_ERROR     0x80000000
+#define DEBUG_WARN      0x00000002
+#define EFI_D_INFO      DEBUG_INFO
+#define EFI_D_ERROR     DEBUG_ERROR
+#define EFI_D_WARN      DEBUG_WARN
+
+extern BOOLEAN  HostDebugEnabled;
+
+VOID
+HostDebugPrint (
+  IN UINTN        ErrorLevel,
+  IN CONST CHAR8  *Format,
+  ...
+  );
+
+VOID
+HostAssert (
+  IN CONST CHAR8  *FileName,
+  IN UINTN        LineNumber,
+  IN CONST CHAR8  *Description
+  );
+
+#define DEBUG(Expression)       HostDebugPrint Expression
+#define ASSERT(Expression)      do { if (!(Expression)) { HostAssert (__FILE__, __LINE__, #Expression); } } while (0)
+#define ASSERT_EFI_ERROR(StatusParameter)  ASSERT (!EFI_ERROR (StatusParameter))
+#define DEBUG_CODE_BEGIN()      do { if (0) {
+#define DEBUG_CODE_END()        } } while (0)
+
+#endif
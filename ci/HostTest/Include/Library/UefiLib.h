@@ -0,0 +1,33 @@
+/** @file
+*
+*  Host build stand-in for the UefiLib services used by the driver.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __HOST_UEFI_LIB_H__
+#define __HOST_UEFI_LIB_H__
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Protocol/DriverBinding.h>
+
+extern EFI_GUID gEfiEventReadyToBootGuid;
+
+EFI_STATUS
+EFIAPI
+EfiCreateEventReadyToBootEx (
+  IN  EFI_TPL           NotifyTpl,
+  IN  EFI_EVENT_NOTIFY  NotifyFunction  OPTIONAL,
+  IN  VOID              *NotifyContext  OPTIONAL,
+  OUT EFI_EVENT         *ReadyToBootEvent
+  );
+
+#endif
@@ -0,0 +1,22 @@
+/** @file
+*
+*  Host build stand-in for the runtime services table, see HostLib.c.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __HOST_UEFI_RUNTIME_SERVICES_TABLE_LIB_H__
+#define __HOST_UEFI_RUNTIME_SERVICES_TABLE_LIB_H__
+
+#include <Uefi.h>
+
+extern EFI_RUNTIME_SERVICES  *gRT;
+
+#endif
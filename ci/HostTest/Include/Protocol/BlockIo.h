@@ -0,0 +1,81 @@
+/** @file
+*
+*  Host build stand-in for the block I/O protocol.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __HOST_BLOCK_IO_H__
+#define __HOST_BLOCK_IO_H__
+
+#include <Uefi.h>
+
+typedef struct _EFI_BLOCK_IO_PROTOCOL  EFI_BLOCK_IO_PROTOCOL;
+
+typedef struct {
+  UINT32    MediaId;
+  BOOLEAN   RemovableMedia;
+  BOOLEAN   MediaPresent;
+  BOOLEAN   LogicalPartition;
+  BOOLEAN   ReadOnly;
+  BOOLEAN   WriteCaching;
+  UINT32    BlockSize;
+  UINT32    IoAlign;
+  EFI_LBA   LastBlock;
+  EFI_LBA   LowestAlignedLba;
+  UINT32    LogicalBlocksPerPhysicalBlock;
+  UINT32    OptimalTransferLengthGranularity;
+} EFI_BLOCK_IO_MEDIA;
+
+typedef
+EFI_STATUS
+(EFIAPI *EFI_BLOCK_RESET) (
+  IN EFI_BLOCK_IO_PROTOCOL  *This,
+  IN BOOLEAN                ExtendedVerification
+  );
+
+typedef
+EFI_STATUS
+(EFIAPI *EFI_BLOCK_READ) (
+  IN EFI_BLOCK_IO_PROTOCOL  *This,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  OUT VOID                  *Buffer
+  );
+
+typedef
+EFI_STATUS
+(EFIAPI *EFI_BLOCK_WRITE) (
+  IN EFI_BLOCK_IO_PROTOCOL  *This,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  IN VOID                   *Buffer
+  );
+
+typedef
+EFI_STATUS
+(EFIAPI *EFI_BLOCK_FLUSH) (
+  IN EFI_BLOCK_IO_PROTOCOL  *This
+  );
+
+struct _EFI_BLOCK_IO_PROTOCOL {
+  UINT64              Revision;
+  EFI_BLOCK_IO_MEDIA  *Media;
+  EFI_BLOCK_RESET     Reset;
+  EFI_BLOCK_READ      ReadBlocks;
+  EFI_BLOCK_WRITE     WriteBlocks;
+  EFI_BLOCK_FLUSH     FlushBlocks;
+};
+
+extern EFI_GUID gEfiBlockIoProtocolGuid;
+
+#endif
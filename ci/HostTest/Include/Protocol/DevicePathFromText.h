@@ -0,0 +1,39 @@
+/** @file
+*
+*  Host build stand-in for the device path from text protocol.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __HOST_DEVICE_PATH_FROM_TEXT_H__
+#define __HOST_DEVICE_PATH_FROM_TEXT_H__
+
+#include <Protocol/DevicePath.h>
+
+typedef
+EFI_DEVICE_PATH_PROTOCOL *
+(EFIAPI *EFI_DEVICE_PATH_FROM_TEXT_NODE) (
+  IN CONST CHAR16  *TextDeviceNode
+  );
+
+typedef
+EFI_DEVICE_PATH_PROTOCOL *
+(EFIAPI *EFI_DEVICE_PATH_FROM_TEXT_PATH) (
+  IN CONST CHAR16  *TextDevicePath
+  );
+
+typedef struct {
+  EFI_DEVICE_PATH_FROM_TEXT_NODE  ConvertTextToDeviceNode;
+  EFI_DEVICE_PATH_FROM_TEXT_PATH  ConvertTextToDevicePath;
+} EFI_DEVICE_PATH_FROM_TEXT_PROTOCOL;
+
+extern EFI_GUID gEfiDevicePathFromTextProtocolGuid;
+
+#endif
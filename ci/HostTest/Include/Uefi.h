@@ -0,0 +1,195 @@
+/** @file
+*
+*  Minimal subset of the UEFI base types and services needed to build
+*  firmware sources of this tree as host programs, for their host tests.
+*  Only what those sources use is here, with the layout of the MdePkg
+*  definitions wherever they depend on it (device paths, image
+*  descriptions, file information).
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __HOST_UEFI_H__
+#define __HOST_UEFI_H__
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Base types. CHAR16 literals need -fshort-wchar.
+//
+typedef uint8_t             UINT8;
+typedef int8_t              INT8;
+typedef uint16_t            UINT16;
+typedef int16_t             INT16;
+typedef uint32_t            UINT32;
+typedef int32_t             INT32;
+typedef uint64_t            UINT64;
+typedef int64_t             INT64;
+typedef uintptr_t           UINTN;
+typedef intptr_t            INTN;
+typedef unsigned char       BOOLEAN;
+typedef char                CHAR8;
+typedef unsigned short      CHAR16;
+typedef void                VOID;
+
+typedef UINTN               RETURN_STATUS;
+typedef RETURN_STATUS       EFI_STATUS;
+typedef VOID                *EFI_HANDLE;
+typedef VOID                *EFI_EVENT;
+typedef UINTN               EFI_TPL;
+typedef UINT64              EFI_LBA;
+typedef UINT64              EFI_PHYSICAL_ADDRESS;
+
+typedef struct {
+  UINT32  Data1;
+  UINT16  Data2;
+  UINT16  Data3;
+  UINT8   Data4[8];
+} EFI_GUID;
+
+typedef struct {
+  UINT16  Year;
+  UINT8   Month;
+  UINT8   Day;
+  UINT8   Hour;
+  UINT8   Minute;
+  UINT8   Second;
+  UINT8   Pad1;
+  UINT32  Nanosecond;
+  INT16   TimeZone;
+  UINT8   Daylight;
+  UINT8   Pad2;
+} EFI_TIME;
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST     const
+#define STATIC    static
+#define EFIAPI
+#define TRUE      ((BOOLEAN)1)
+#define FALSE     ((BOOLEAN)0)
+#ifndef NULL
+#define NULL      ((VOID *) 0)
+#endif
+
+#define VA_LIST             va_list
+#define VA_START(a, b)      va_start (a, b)
+#define VA_ARG(a, t)        va_arg (a, t)
+#define VA_END(a)           va_end (a)
+
+#define MAX_UINTN           ((UINTN)-1)
+#define MAX_UINT32          ((UINT32)0xFFFFFFFF)
+#define MAX_UINT64          ((UINT64)0xFFFFFFFFFFFFFFFFULL)
+
+#define SIZE_1KB            0x00000400
+#define SIZE_4KB            0x00001000
+#define SIZE_64KB           0x00010000
+#define SIZE_256KB          0x00040000
+#define SIZE_1MB            0x00100000
+
+#define OFFSET_OF(TYPE, Field)  ((UINTN) offsetof (TYPE, Field))
+#define BASE_CR(Record, TYPE, Field)  ((TYPE *) ((CHAR8 *) (Record) - OFFSET_OF (TYPE, Field)))
+#define CR(Record, TYPE, Field, TestSignature)  BASE_CR (Record, TYPE, Field)
+#define SIGNATURE_16(A, B)        ((A) | (B << 8))
+#define SIGNATURE_32(A, B, C, D)  (SIGNATURE_16 (A, B) | (SIGNATURE_16 (C, D) << 16))
+#define MAX(a, b)           (((a) > (b)) ? (a) : (b))
+#define MIN(a, b)           (((a) < (b)) ? (a) : (b))
+#define ARRAY_SIZE(Array)   (sizeof (Array) / sizeof ((Array)[0]))
+#define ALIGN_VALUE(Value, Alignment)  ((Value) + (((Alignment) - (Value)) & ((Alignment) - 1)))
+
+//
+// Status codes
+//
+#define MAX_BIT                     ((UINTN)1 << (sizeof (UINTN) * 8 - 1))
+#define ENCODE_ERROR(a)             ((RETURN_STATUS)(MAX_BIT | (a)))
+#define ENCODE_WARNING(a)           ((RETURN_STATUS)(a))
+#define RETURN_ERROR(a)             (((INTN)(RETURN_STATUS)(a)) < 0)
+#define EFI_ERROR(a)                RETURN_ERROR (a)
+
+#define EFI_SUCCESS                 ((EFI_STATUS)0)
+#define EFI_LOAD_ERROR              ENCODE_ERROR (1)
+#define EFI_INVALID_PARAMETER       ENCODE_ERROR (2)
+#define EFI_UNSUPPORTED             ENCODE_ERROR (3)
+#define EFI_BAD_BUFFER_SIZE         ENCODE_ERROR (4)
+#define EFI_BUFFER_TOO_SMALL        ENCODE_ERROR (5)
+#define EFI_NOT_READY               ENCODE_ERROR (6)
+#define EFI_DEVICE_ERROR            ENCODE_ERROR (7)
+#define EFI_WRITE_PROTECTED         ENCODE_ERROR (8)
+#define EFI_OUT_OF_RESOURCES        ENCODE_ERROR (9)
+#define EFI_VOLUME_CORRUPTED        ENCODE_ERROR (10)
+#define EFI_VOLUME_FULL             ENCODE_ERROR (11)
+#define EFI_NO_MEDIA                ENCODE_ERROR (12)
+#define EFI_MEDIA_CHANGED           ENCODE_ERROR (13)
+#define EFI_NOT_FOUND               ENCODE_ERROR (14)
+#define EFI_ACCESS_DENIED           ENCODE_ERROR (15)
+#define EFI_CRC_ERROR               ENCODE_ERROR (27)
+#define EFI_WARN_DELETE_FAILURE     ENCODE_WARNING (2)
+
+//
+// Lists
+//
+typedef struct _LIST_ENTRY LIST_ENTRY;
+struct _LIST_ENTRY {
+  LIST_ENTRY  *ForwardLink;
+  LIST_ENTRY  *BackLink;
+};
+
+//
+// Boot and runtime services used by the driver
+//
+#define TPL_APPLICATION       4
+#define TPL_CALLBACK          8
+#define TPL_NOTIFY            16
+
+#define EFI_OPEN_PROTOCOL_BY_HANDLE_PROTOCOL  0x00000001
+#define EFI_OPEN_PROTOCOL_GET_PROTOCOL        0x00000002
+#define EFI_OPEN_PROTOCOL_TEST_PROTOCOL       0x00000004
+#define EFI_OPEN_PROTOCOL_BY_CHILD_CONTROLLER 0x00000008
+#define EFI_OPEN_PROTOCOL_BY_DRIVER           0x00000010
+#define EFI_OPEN_PROTOCOL_EXCLUSIVE           0x00000020
+
+#define EFI_VARIABLE_NON_VOLATILE         0x00000001
+#define EFI_VARIABLE_BOOTSERVICE_ACCESS   0x00000002
+#define EFI_VARIABLE_RUNTIME_ACCESS       0x00000004
+
+typedef
+VOID
+(EFIAPI *EFI_EVENT_NOTIFY) (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  );
+
+typedef struct {
+  EFI_STATUS  (EFIAPI *OpenProtocol) (EFI_HANDLE, EFI_GUID *, VOID **, EFI_HANDLE, EFI_HANDLE, UINT32);
+  EFI_STATUS  (EFIAPI *CloseProtocol) (EFI_HANDLE, EFI_GUID *, EFI_HANDLE, EFI_HANDLE);
+  EFI_STATUS  (EFIAPI *LocateProtocol) (EFI_GUID *, VOID *, VOID **);
+  EFI_STATUS  (EFIAPI *InstallMultipleProtocolInterfaces) (EFI_HANDLE *, ...);
+  EFI_STATUS  (EFIAPI *UninstallMultipleProtocolInterfaces) (EFI_HANDLE, ...);
+  EFI_STATUS  (EFIAPI *CalculateCrc32) (VOID *, UINTN, UINT32 *);
+  EFI_TPL     (EFIAPI *RaiseTPL) (EFI_TPL);
+  VOID        (EFIAPI *RestoreTPL) (EFI_TPL);
+} EFI_BOOT_SERVICES;
+
+typedef struct {
+  EFI_STATUS  (EFIAPI *GetVariable) (CHAR16 *, EFI_GUID *, UINT32 *, UINTN *, VOID *);
+  EFI_STATUS  (EFIAPI *SetVariable) (CHAR16 *, EFI_GUID *, UINT32, UINTN, VOID *);
+} EFI_RUNTIME_SERVICES;
+
+typedef struct {
+  EFI_BOOT_SERVICES     *BootServices;
+  EFI_RUNTIME_SERVICES  *RuntimeServices;
+} EFI_SYSTEM_TABLE;
+
+#include <Protocol/DevicePath.h>
+
+#endif